@@ -0,0 +1,219 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "sbcbatch.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SBC_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+static void SbcTranslateBatchScalar(const SBC_U8 *Packets, size_t Count, HIDFX2_INPUT_REPORT *Reports)
+{
+	size_t i;
+	for (i = 0; i < Count; ++i)
+	{
+		SbcTranslateReport(Packets + i * SBC_INPUT_PACKET_SIZE, Reports + i);
+	}
+}
+
+#ifdef SBC_BATCH_X86
+
+//
+// Both kernels build the 16 byte report of one packet in a 128 bit lane:
+//
+//  - bytes 0..4:   buttons, packet bytes 2..6
+//  - bytes 5..12:  axes, from the 8 16 bit values at packet offset 8. The
+//                  unsigned ones keep the high byte, the signed ones are
+//                  divided rounding towards zero like the scalar code and
+//                  re-centered at 128.
+//  - bytes 13..14: tuner and gear, neutral gear (negative) plus one.
+//  - byte 15:      VirtualButtons, zeroed by the masks like the scalar
+//                  translation leaves it for the combo engine.
+//
+// The three loads per packet (offsets 0, 8 and 10) stay inside the 26 bytes,
+// and each 16 byte store writes exactly one report.
+//
+
+__attribute__((target("sse2")))
+static __inline __m128i SbcBuildSse2(const SBC_U8 *Packet, __m128i SignedLanes, __m128i ButtonsMask, __m128i TailMask, __m128i GearMask)
+{
+	__m128i head = _mm_loadu_si128((const __m128i *)Packet);
+	__m128i axes = _mm_loadu_si128((const __m128i *)(Packet + SBC_OFFSET_AIMX));
+	__m128i tail = _mm_loadu_si128((const __m128i *)(Packet + SBC_OFFSET_TUNER - 14));
+	__m128i zero = _mm_setzero_si128();
+	__m128i u, s;
+
+	u = _mm_srli_epi16(axes, 8);
+	s = _mm_add_epi16(axes, _mm_and_si128(_mm_srai_epi16(axes, 15), _mm_set1_epi16(255)));
+	s = _mm_and_si128(_mm_add_epi16(_mm_srai_epi16(s, 8), _mm_set1_epi16(128)), _mm_set1_epi16(255));
+	axes = _mm_or_si128(_mm_and_si128(SignedLanes, s), _mm_andnot_si128(SignedLanes, u));
+	axes = _mm_slli_si128(_mm_packus_epi16(axes, zero), 5);
+
+	head = _mm_and_si128(_mm_srli_si128(head, 2), ButtonsMask);
+
+	tail = _mm_srli_si128(tail, 1);
+	tail = _mm_sub_epi8(tail, _mm_and_si128(_mm_cmplt_epi8(tail, zero), GearMask));
+	tail = _mm_and_si128(tail, TailMask);
+
+	return _mm_or_si128(_mm_or_si128(head, axes), tail);
+}
+
+__attribute__((target("sse2")))
+static void SbcTranslateBatchSse2(const SBC_U8 *Packets, size_t Count, HIDFX2_INPUT_REPORT *Reports)
+{
+	__m128i signedLanes = _mm_set_epi16(0, 0, 0, -1, -1, -1, 0, 0);
+	__m128i buttonsMask = _mm_set_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1, -1);
+	__m128i tailMask = _mm_set_epi8(0, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	__m128i gearMask = _mm_set_epi8(0, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	size_t i;
+
+	for (i = 0; i < Count; ++i)
+	{
+		__m128i r = SbcBuildSse2(Packets + i * SBC_INPUT_PACKET_SIZE, signedLanes, buttonsMask, tailMask, gearMask);
+		_mm_storeu_si128((__m128i *)(Reports + i), r);
+	}
+}
+
+__attribute__((target("avx2")))
+static __inline __m256i SbcLoad2Avx2(const SBC_U8 *Packet, size_t Offset)
+{
+	__m128i lo = _mm_loadu_si128((const __m128i *)(Packet + Offset));
+	__m128i hi = _mm_loadu_si128((const __m128i *)(Packet + SBC_INPUT_PACKET_SIZE + Offset));
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+__attribute__((target("avx2")))
+static void SbcTranslateBatchAvx2(const SBC_U8 *Packets, size_t Count, HIDFX2_INPUT_REPORT *Reports)
+{
+	__m256i signedLanes = _mm256_broadcastsi128_si256(_mm_set_epi16(0, 0, 0, -1, -1, -1, 0, 0));
+	__m256i buttonsMask = _mm256_broadcastsi128_si256(_mm_set_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1, -1));
+	__m256i tailMask = _mm256_broadcastsi128_si256(_mm_set_epi8(0, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+	__m256i gearMask = _mm256_broadcastsi128_si256(_mm_set_epi8(0, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+	__m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+
+	// Two packets per iteration, one in each 128 bit lane. An odd one left
+	// at the end goes through the SSE2 kernel.
+	for (; i + 2 <= Count; i += 2)
+	{
+		const SBC_U8 *p = Packets + i * SBC_INPUT_PACKET_SIZE;
+		__m256i head = SbcLoad2Avx2(p, 0);
+		__m256i axes = SbcLoad2Avx2(p, SBC_OFFSET_AIMX);
+		__m256i tail = SbcLoad2Avx2(p, SBC_OFFSET_TUNER - 14);
+		__m256i u, s, r;
+
+		u = _mm256_srli_epi16(axes, 8);
+		s = _mm256_add_epi16(axes, _mm256_and_si256(_mm256_srai_epi16(axes, 15), _mm256_set1_epi16(255)));
+		s = _mm256_and_si256(_mm256_add_epi16(_mm256_srai_epi16(s, 8), _mm256_set1_epi16(128)), _mm256_set1_epi16(255));
+		axes = _mm256_blendv_epi8(u, s, signedLanes);
+		axes = _mm256_slli_si256(_mm256_packus_epi16(axes, zero), 5);
+
+		head = _mm256_and_si256(_mm256_srli_si256(head, 2), buttonsMask);
+
+		tail = _mm256_srli_si256(tail, 1);
+		tail = _mm256_sub_epi8(tail, _mm256_and_si256(_mm256_cmpgt_epi8(zero, tail), gearMask));
+		tail = _mm256_and_si256(tail, tailMask);
+
+		r = _mm256_or_si256(_mm256_or_si256(head, axes), tail);
+		_mm256_storeu_si256((__m256i *)(Reports + i), r);
+	}
+
+	SbcTranslateBatchSse2(Packets + i * SBC_INPUT_PACKET_SIZE, Count - i, Reports + i);
+}
+
+#endif // SBC_BATCH_X86
+
+int SbcBatchPathSupported(SBC_BATCH_PATH Path)
+{
+	switch (Path)
+	{
+	case SbcBatchAuto:
+	case SbcBatchScalar:
+		return 1;
+#ifdef SBC_BATCH_X86
+	case SbcBatchSse2:
+		return __builtin_cpu_supports("sse2");
+	case SbcBatchAvx2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+SBC_BATCH_PATH SbcBatchBestPath(void)
+{
+	static SBC_BATCH_PATH best = SbcBatchAuto;
+
+	if (best == SbcBatchAuto)
+	{
+		if (SbcBatchPathSupported(SbcBatchAvx2)) best = SbcBatchAvx2;
+		else if (SbcBatchPathSupported(SbcBatchSse2)) best = SbcBatchSse2;
+		else best = SbcBatchScalar;
+	}
+	return best;
+}
+
+const char *SbcBatchPathName(SBC_BATCH_PATH Path)
+{
+	switch (Path)
+	{
+	case SbcBatchAuto:      return "auto";
+	case SbcBatchScalar:    return "scalar";
+	case SbcBatchSse2:      return "sse2";
+	case SbcBatchAvx2:      return "avx2";
+	default:                return "unknown";
+	}
+}
+
+void SbcTranslateBatchPath
+(
+	SBC_BATCH_PATH Path,
+	const SBC_U8 *Packets,
+	size_t Count,
+	HIDFX2_INPUT_REPORT *Reports
+)
+/*++
+Routine Description:
+    Translates Count packets with the given kernel. Unsupported paths fall
+    back to the best supported one.
+
+Arguments:
+    Path - Kernel to use
+
+    Packets - Count packets of SBC_INPUT_PACKET_SIZE bytes back to back
+
+    Count - Number of packets
+
+    Reports - Receives Count reports
+
+Return Value:
+    None
+--*/
+{
+	if (Path == SbcBatchAuto || !SbcBatchPathSupported(Path)) Path = SbcBatchBestPath();
+
+	switch (Path)
+	{
+#ifdef SBC_BATCH_X86
+	case SbcBatchAvx2:
+		SbcTranslateBatchAvx2(Packets, Count, Reports);
+		break;
+	case SbcBatchSse2:
+		SbcTranslateBatchSse2(Packets, Count, Reports);
+		break;
+#endif
+	default:
+		SbcTranslateBatchScalar(Packets, Count, Reports);
+		break;
+	}
+}
+
+void SbcTranslateBatch(const SBC_U8 *Packets, size_t Count, HIDFX2_INPUT_REPORT *Reports)
+{
+	SbcTranslateBatchPath(SbcBatchAuto, Packets, Count, Reports);
+}
@@ -0,0 +1,45 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCBATCH_H_
+#define _SBCBATCH_H_
+
+//
+// Batch translation for offline tools (replay, analytics, calibration).
+// Converts N packets stored back to back (SBC_INPUT_PACKET_SIZE bytes each)
+// into N HIDFX2_INPUT_REPORTs with the same result as SbcTranslateReport.
+// The SIMD kernel is picked at runtime from the CPU features.
+//
+
+#include <stddef.h>
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum _SBC_BATCH_PATH
+{
+	SbcBatchAuto = 0,
+	SbcBatchScalar,
+	SbcBatchSse2,
+	SbcBatchAvx2,
+	SbcBatchPathCount
+} SBC_BATCH_PATH;
+
+int SbcBatchPathSupported(SBC_BATCH_PATH Path);
+SBC_BATCH_PATH SbcBatchBestPath(void);
+const char *SbcBatchPathName(SBC_BATCH_PATH Path);
+
+void SbcTranslateBatch(const SBC_U8 *Packets, size_t Count, HIDFX2_INPUT_REPORT *Reports);
+void SbcTranslateBatchPath(SBC_BATCH_PATH Path, const SBC_U8 *Packets, size_t Count, HIDFX2_INPUT_REPORT *Reports);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCBATCH_H_
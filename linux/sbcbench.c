@@ -0,0 +1,138 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Microbenchmark for the packet to report translation, one packet at a time
+// like the read completion routine and in batches with every batch kernel
+// this CPU supports.
+//
+// Usage: sbcbench [packets] [iterations]
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sbcbatch.h"
+
+#define DEFAULT_PACKETS     4096
+#define DEFAULT_ITERATIONS  2000
+
+static SBC_U64 NowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+static SBC_U32 XorShift(SBC_U32 *State)
+{
+	SBC_U32 x = *State;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*State = x;
+	return x;
+}
+
+static void Run(SBC_REPORT_MODE Mode, const char *Name, const SBC_U8 *Data, size_t Packets, size_t Iterations)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 checksum = 0;
+	SBC_U64 start, elapsed;
+	double total;
+	size_t i, j;
+
+	start = NowNs();
+	for (j = 0; j < Iterations; ++j)
+	{
+		for (i = 0; i < Packets; ++i)
+		{
+			SBC_U32 size = SbcBuildInputReport(Mode, Data + i * SBC_INPUT_PACKET_SIZE, report);
+			checksum += report[5] ^ report[size - 1];
+		}
+	}
+	elapsed = NowNs() - start;
+
+	total = (double)Packets * (double)Iterations;
+	printf("%s\n", Name);
+	printf("  packets:      %.0f\n", total);
+	printf("  elapsed:      %.3f ms\n", (double)elapsed / 1e6);
+	printf("  packets/sec:  %.0f\n", total * 1e9 / (double)elapsed);
+	printf("  ns/packet:    %.3f\n", (double)elapsed / total);
+	printf("  checksum:     %08x\n", checksum);
+}
+
+static void RunBatch(SBC_BATCH_PATH Path, const SBC_U8 *Data, size_t Packets, size_t Iterations)
+{
+	HIDFX2_INPUT_REPORT *reports = malloc(Packets * sizeof(HIDFX2_INPUT_REPORT));
+	SBC_U32 checksum = 0;
+	SBC_U64 start, elapsed;
+	double total;
+	size_t i, j;
+
+	if (reports == NULL) return;
+
+	start = NowNs();
+	for (j = 0; j < Iterations; ++j)
+	{
+		SbcTranslateBatchPath(Path, Data, Packets, reports);
+		checksum += reports[j % Packets].AimX ^ (SBC_U8)reports[Packets - 1].Gear;
+	}
+	elapsed = NowNs() - start;
+	for (i = 0; i < Packets; ++i) checksum += reports[i].Rotation;
+
+	total = (double)Packets * (double)Iterations;
+	printf("batch %s\n", SbcBatchPathName(Path));
+	printf("  packets:      %.0f\n", total);
+	printf("  elapsed:      %.3f ms\n", (double)elapsed / 1e6);
+	printf("  packets/sec:  %.0f\n", total * 1e9 / (double)elapsed);
+	printf("  ns/packet:    %.3f\n", (double)elapsed / total);
+	printf("  checksum:     %08x\n", checksum);
+
+	free(reports);
+}
+
+int main(int argc, char **argv)
+{
+	size_t packets = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_PACKETS;
+	size_t iterations = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+	SBC_U8 *data;
+	SBC_U32 seed = 0x5bc0ffee;
+	size_t i;
+
+	if (packets == 0 || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [packets] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	data = malloc(packets * SBC_INPUT_PACKET_SIZE);
+	if (data == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < packets * SBC_INPUT_PACKET_SIZE; ++i)
+	{
+		data[i] = (SBC_U8)XorShift(&seed);
+	}
+
+	Run(SbcReportMode8Bit, "8 bit axes", data, packets, iterations);
+	Run(SbcReportMode16Bit, "16 bit axes", data, packets, iterations);
+
+	for (i = SbcBatchScalar; i < SbcBatchPathCount; ++i)
+	{
+		if (SbcBatchPathSupported((SBC_BATCH_PATH)i)) RunBatch((SBC_BATCH_PATH)i, data, packets, iterations);
+		else printf("batch %s: not supported\n", SbcBatchPathName((SBC_BATCH_PATH)i));
+	}
+
+	free(data);
+	return 0;
+}
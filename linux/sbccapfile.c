@@ -0,0 +1,172 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sbccapfile.h"
+
+int SbcCaptureFileOpen
+(
+	SBC_CAPTURE_FILE *File,
+	const char *Path
+)
+/*++
+Routine Description:
+    Maps a capture file. A trailing partial record (a capture still being
+    written) is ignored.
+
+Arguments:
+    File - Receives the mapping
+
+    Path - Capture file
+
+Return Value:
+    0 on success, -1 with errno set otherwise (EINVAL for a file that is not
+    a capture).
+--*/
+{
+	struct stat st;
+	int fd;
+
+	memset(File, 0, sizeof(*File));
+
+	fd = open(Path, O_RDONLY);
+	if (fd < 0) return -1;
+
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	if ((size_t)st.st_size < sizeof(SBC_CAPTURE_HEADER))
+	{
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	File->MapSize = (size_t)st.st_size;
+	File->Map = mmap(NULL, File->MapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (File->Map == MAP_FAILED)
+	{
+		File->Map = NULL;
+		return -1;
+	}
+
+	File->Header = (const SBC_CAPTURE_HEADER *)File->Map;
+	if (!SbcCaptureValidHeader(File->Header))
+	{
+		SbcCaptureFileClose(File);
+		errno = EINVAL;
+		return -1;
+	}
+
+	File->Records = (const SBC_U8 *)(File->Header + 1);
+	File->RecordSize = File->Header->RecordSize;
+	File->DataSize = File->RecordSize - (SBC_U32)sizeof(SBC_CAPTURE_RECORD);
+	File->Count = (File->MapSize - sizeof(SBC_CAPTURE_HEADER)) / File->RecordSize;
+	return 0;
+}
+
+void SbcCaptureFileClose(SBC_CAPTURE_FILE *File)
+{
+	if (File->Map != NULL) munmap(File->Map, File->MapSize);
+	memset(File, 0, sizeof(*File));
+}
+
+int SbcCaptureWriterOpen
+(
+	SBC_CAPTURE_WRITER *Writer,
+	const char *Path,
+	SBC_U64 StartTime,
+	SBC_U32 TransferSize
+)
+/*++
+Routine Description:
+    Opens a capture file for appending, writing the header if the file is
+    new or empty. The records of an existing file must have the size the
+    transfer size calls for.
+
+Arguments:
+    Writer - Receives the open file
+
+    Path - Capture file
+
+    StartTime - Start time of a new file
+
+    TransferSize - Largest transfer to be appended
+
+Return Value:
+    0 on success, -1 with errno set otherwise (EINVAL for an existing file
+    that is not a capture or has records of another size).
+--*/
+{
+	SBC_CAPTURE_HEADER header;
+	long size;
+
+	Writer->Sequence = 0;
+	Writer->RecordSize = SbcCaptureRecordSize(TransferSize);
+	Writer->File = fopen(Path, "a+b");
+	if (Writer->File == NULL) return -1;
+
+	if (fseek(Writer->File, 0, SEEK_END) != 0 || (size = ftell(Writer->File)) < 0) goto Error;
+
+	if (size == 0)
+	{
+		SbcCaptureInitHeader(&header, StartTime, Writer->RecordSize);
+		if (fwrite(&header, sizeof(header), 1, Writer->File) != 1) goto Error;
+		return 0;
+	}
+
+	if (fseek(Writer->File, 0, SEEK_SET) != 0) goto Error;
+	if (fread(&header, sizeof(header), 1, Writer->File) != 1 ||
+		!SbcCaptureValidHeader(&header) || header.RecordSize != Writer->RecordSize)
+	{
+		errno = EINVAL;
+		goto Error;
+	}
+
+	// Writes always go to the end, the seek only switches the stream back
+	// from reading
+	if (fseek(Writer->File, 0, SEEK_END) == 0) return 0;
+
+Error:
+	fclose(Writer->File);
+	Writer->File = NULL;
+	return -1;
+}
+
+int SbcCaptureWriterAppend
+(
+	SBC_CAPTURE_WRITER *Writer,
+	SBC_U64 Timestamp,
+	const void *Data,
+	SBC_U32 Length
+)
+{
+	SBC_U8 record[SBC_CAPTURE_MAX_RECORD_SIZE];
+
+	SbcCaptureFillRecord((SBC_CAPTURE_RECORD *)record, Writer->RecordSize, Writer->Sequence++, Timestamp, Data, Length);
+	return fwrite(record, Writer->RecordSize, 1, Writer->File) == 1 ? 0 : -1;
+}
+
+int SbcCaptureWriterClose(SBC_CAPTURE_WRITER *Writer)
+{
+	int result = 0;
+
+	if (Writer->File != NULL) result = fclose(Writer->File);
+	Writer->File = NULL;
+	return result;
+}
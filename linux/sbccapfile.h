@@ -0,0 +1,59 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCCAPFILE_H_
+#define _SBCCAPFILE_H_
+
+//
+// Reading and writing capture files (see sys/sbccapture.h) in user mode.
+// Files are read through a read only memory mapping.
+//
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "sbccapture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _SBC_CAPTURE_FILE
+{
+	const SBC_CAPTURE_HEADER *Header;
+	const SBC_U8 *Records;
+	SBC_U32 RecordSize;
+	SBC_U32 DataSize;           // Data bytes kept per record
+	size_t Count;
+
+	void *Map;
+	size_t MapSize;
+} SBC_CAPTURE_FILE;
+
+int SbcCaptureFileOpen(SBC_CAPTURE_FILE *File, const char *Path);
+void SbcCaptureFileClose(SBC_CAPTURE_FILE *File);
+
+static __inline const SBC_CAPTURE_RECORD *SbcCaptureFileRecord(const SBC_CAPTURE_FILE *File, size_t Index)
+{
+	return (const SBC_CAPTURE_RECORD *)(File->Records + Index * File->RecordSize);
+}
+
+typedef struct _SBC_CAPTURE_WRITER
+{
+	FILE *File;
+	SBC_U32 RecordSize;
+	SBC_U32 Sequence;
+} SBC_CAPTURE_WRITER;
+
+int SbcCaptureWriterOpen(SBC_CAPTURE_WRITER *Writer, const char *Path, SBC_U64 StartTime, SBC_U32 TransferSize);
+int SbcCaptureWriterAppend(SBC_CAPTURE_WRITER *Writer, SBC_U64 Timestamp, const void *Data, SBC_U32 Length);
+int SbcCaptureWriterClose(SBC_CAPTURE_WRITER *Writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCCAPFILE_H_
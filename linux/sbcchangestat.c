@@ -0,0 +1,153 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Replays a packet stream through the translation and the change-only
+// filter and counts how many reports would have been suppressed, i.e. how
+// many read completions (and reader wake ups) the mode saves.
+//
+// Usage: sbcchangestat [-f packets.bin] [-r rate] [-n packets] [-m 8|16]
+//                      [-d deadband] [-k keepalive_ms]
+//
+//   -f  File with raw 26 byte packets back to back. Without it a synthetic
+//       session is generated: a mostly idle cockpit with stick noise, some
+//       pedal and stick movement and the odd button press.
+//   -r  Packet rate in Hz used to timestamp the packets (default 250)
+//   -n  Number of synthetic packets (default 60 seconds worth)
+//   -m  Report mode (default 8)
+//   -d  Deadband applied to every axis, in report units (default 0)
+//   -k  Keep-alive in milliseconds, 0 disables it (default 100)
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbcsynth.h"
+
+static SBC_U64 NowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+static SBC_U8 *Synthesize(size_t Packets, SBC_U32 Rate)
+{
+	SBC_U8 *data = calloc(Packets, SBC_INPUT_PACKET_SIZE);
+	SBC_SYNTH synth;
+	size_t i;
+
+	if (data == NULL) return NULL;
+
+	SbcSynthInit(&synth, Rate, 0x1234567);
+	for (i = 0; i < Packets; ++i) SbcSynthNext(&synth, data + i * SBC_INPUT_PACKET_SIZE);
+	return data;
+}
+
+static SBC_U8 *LoadFile(const char *Path, size_t *Packets)
+{
+	FILE *f = fopen(Path, "rb");
+	SBC_U8 *data;
+	long size;
+
+	if (f == NULL) return NULL;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	*Packets = (size_t)size / SBC_INPUT_PACKET_SIZE;
+	data = malloc(*Packets * SBC_INPUT_PACKET_SIZE + 1);
+	if (data != NULL && fread(data, SBC_INPUT_PACKET_SIZE, *Packets, f) != *Packets)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	SBC_U32 rate = 250;
+	size_t packets = 0;
+	SBC_REPORT_MODE mode = SbcReportMode8Bit;
+	SBC_U32 deadband = 0;
+	SBC_U32 keepAliveMs = 100;
+	SBC_CHANGE_FILTER filter;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 *data;
+	SBC_U64 start, elapsed, duration;
+	double seconds;
+	size_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:r:n:m:d:k:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f': path = optarg; break;
+		case 'r': rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': packets = (size_t)strtoul(optarg, NULL, 10); break;
+		case 'm': mode = atoi(optarg) == 16 ? SbcReportMode16Bit : SbcReportMode8Bit; break;
+		case 'd': deadband = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'k': keepAliveMs = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		default:
+			fprintf(stderr, "usage: %s [-f packets.bin] [-r rate] [-n packets] [-m 8|16] [-d deadband] [-k keepalive_ms]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (rate == 0) rate = 250;
+
+	if (path != NULL)
+	{
+		data = LoadFile(path, &packets);
+		if (data == NULL)
+		{
+			fprintf(stderr, "can't read %s\n", path);
+			return 1;
+		}
+	}
+	else
+	{
+		if (packets == 0) packets = 60 * (size_t)rate;
+		data = Synthesize(packets, rate);
+		if (data == NULL)
+		{
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+	}
+
+	SbcChangeFilterInit(&filter, mode);
+	filter.KeepAliveNs = (SBC_U64)keepAliveMs * 1000000;
+	for (i = 0; i < SbcAxisCount; ++i) filter.Deadband[i] = (SBC_U16)deadband;
+
+	start = NowNs();
+	for (i = 0; i < packets; ++i)
+	{
+		SBC_U64 timestamp = (SBC_U64)i * 1000000000ull / rate;
+		SbcBuildInputReport(mode, data + i * SBC_INPUT_PACKET_SIZE, report);
+		SbcChangeFilterCheck(&filter, report, timestamp);
+	}
+	elapsed = NowNs() - start;
+
+	duration = (SBC_U64)packets * 1000000000ull / rate;
+	seconds = (double)duration / 1e9;
+	printf("packets:                %zu (%.1f s at %u Hz)\n", packets, seconds, rate);
+	printf("delivered:              %llu\n", (unsigned long long)filter.Passed);
+	printf("suppressed:             %llu (%.1f%%)\n", (unsigned long long)filter.Suppressed, packets ? 100.0 * (double)filter.Suppressed / (double)packets : 0.0);
+	printf("read completions/sec:   %.1f (was %.1f)\n", seconds > 0 ? (double)filter.Passed / seconds : 0.0, seconds > 0 ? (double)packets / seconds : 0.0);
+	printf("translate+filter:       %.2f ns/packet\n", packets ? (double)elapsed / (double)packets : 0.0);
+
+	free(data);
+	return 0;
+}
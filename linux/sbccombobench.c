@@ -0,0 +1,211 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Cost of the combo engine per report, on top of the translation, with
+// no combos, with every virtual button driven by a chord and with every
+// one driven by an 8 step sequence. Reports are timed in batches of 32 as
+// in sbcremapbench, at 250 Hz of simulated time so holds, timeouts and
+// pulses run. The max column is the slowest batch, which on a busy machine
+// is mostly preemption: the cost of one report is bounded by the 8 bit
+// masks of the worst case, random buttons through 8 sequences.
+//
+// Usage: sbccombobench [packets] [iterations]
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sbccombo.h"
+
+#define DEFAULT_PACKETS     4096
+#define DEFAULT_ITERATIONS  500
+#define BATCH               32
+#define PACKET_INTERVAL_NS  4000000ull
+
+static SBC_COMBO_TABLES noCombos;
+static SBC_COMBO_TABLES chords;
+static SBC_COMBO_TABLES sequences;
+
+static SBC_U64 NowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+static SBC_U32 XorShift(SBC_U32 *State)
+{
+	SBC_U32 x = *State;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*State = x;
+	return x;
+}
+
+static int CompareU64(const void *A, const void *B)
+{
+	SBC_U64 a = *(const SBC_U64 *)A, b = *(const SBC_U64 *)B;
+	return a < b ? -1 : a > b;
+}
+
+static void Run(const char *Name, const SBC_COMBO_TABLES *Tables, SBC_REPORT_MODE Mode, const SBC_U8 *Data, size_t Packets, size_t Iterations)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_COMBO_STATE state;
+	SBC_U32 size = SbcInputReportSize(Mode);
+	SBC_U32 checksum = 0;
+	SBC_U64 matches = 0;
+	SBC_U64 start, elapsed = 0, now = 0;
+	SBC_U64 *batches;
+	size_t count = 0;
+	double total;
+	size_t i, j, k;
+
+	batches = malloc((Packets / BATCH) * Iterations * sizeof(SBC_U64));
+	if (batches == NULL) return;
+
+	SbcComboReset(&state);
+
+	for (j = 0; j < Iterations; ++j)
+	{
+		for (i = 0; i + BATCH <= Packets; i += BATCH)
+		{
+			SBC_U64 batch;
+
+			start = NowNs();
+			for (k = i; k < i + BATCH; ++k)
+			{
+				SbcBuildInputReport(Mode, Data + k * SBC_INPUT_PACKET_SIZE, report);
+				if (Tables != NULL) matches += SbcComboUpdate(Tables, &state, Mode, report, now);
+				checksum += report[0] ^ report[size - 1];
+				now += PACKET_INTERVAL_NS;
+			}
+			batch = NowNs() - start;
+
+			elapsed += batch;
+			batches[count++] = batch;
+		}
+	}
+
+	qsort(batches, count, sizeof(SBC_U64), CompareU64);
+
+	total = (double)(count * BATCH);
+	printf("%-20s %s  ns/report: %7.2f  p99: %7.2f  max: %7.2f  matches: %8llu  checksum: %08x\n",
+		Name, Mode == SbcReportMode16Bit ? "16 bit" : " 8 bit", (double)elapsed / total,
+		(double)batches[count * 99 / 100] / BATCH, (double)batches[count - 1] / BATCH,
+		(unsigned long long)matches, checksum);
+
+	free(batches);
+}
+
+static void RunAll(const char *Inputs, const SBC_U8 *Data, size_t Packets, size_t Iterations)
+{
+	int mode;
+
+	printf("%s\n", Inputs);
+	for (mode = SbcReportMode8Bit; mode <= SbcReportMode16Bit; ++mode)
+	{
+		SBC_REPORT_MODE m = (SBC_REPORT_MODE)mode;
+
+		Run("translation only", NULL, m, Data, Packets, Iterations);
+		Run("no combos", &noCombos, m, Data, Packets, Iterations);
+		Run("8 chords", &chords, m, Data, Packets, Iterations);
+		Run("8 sequences", &sequences, m, Data, Packets, Iterations);
+	}
+}
+
+static void BuildCombos(void)
+{
+	SBC_COMBO_SETTINGS settings;
+	SBC_U32 combo, step;
+
+	memset(&settings, 0, sizeof(settings));
+	SbcComboCompile(&noCombos, &settings);
+
+	// Pairs of buttons, half of them held 100 ms, one exclusive
+	for (combo = 0; combo < SBC_COMBO_MAX; ++combo)
+	{
+		SBC_COMBO_DEFINITION *definition = &settings.Combos[combo];
+
+		definition->Type = SBC_COMBO_CHORD;
+		definition->StepCount = 1;
+		definition->HoldMs = (combo & 1) ? 100 : 0;
+		definition->Flags = combo == 0 ? SBC_COMBO_EXCLUSIVE : 0;
+		SbcStoreButtonMask(definition->Steps[0].Buttons, (1ull << combo) | (1ull << (combo + 20)));
+	}
+	SbcComboCompile(&chords, &settings);
+
+	// Eight steps each, 500 ms between them, 50 ms pulses
+	for (combo = 0; combo < SBC_COMBO_MAX; ++combo)
+	{
+		SBC_COMBO_DEFINITION *definition = &settings.Combos[combo];
+
+		memset(definition, 0, sizeof(*definition));
+		definition->Type = SBC_COMBO_SEQUENCE;
+		definition->StepCount = SBC_COMBO_MAX_STEPS;
+		definition->PulseMs = 50;
+		for (step = 0; step < SBC_COMBO_MAX_STEPS; ++step)
+		{
+			SbcStoreButtonMask(definition->Steps[step].Buttons, 1ull << ((combo * 5 + step * 3) % SBC_BUTTON_COUNT));
+			definition->Steps[step].TimeoutMs = 500;
+		}
+	}
+	if (!SbcComboValidate(&settings)) fprintf(stderr, "sequence settings not valid\n");
+	SbcComboCompile(&sequences, &settings);
+}
+
+int main(int argc, char **argv)
+{
+	size_t packets = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_PACKETS;
+	size_t iterations = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+	SBC_U8 *data;
+	SBC_U32 seed = 0x5bc0ffee;
+	size_t i;
+
+	if (packets < BATCH || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [packets, at least %d] [iterations]\n", argv[0], BATCH);
+		return 1;
+	}
+
+	data = malloc(packets * SBC_INPUT_PACKET_SIZE);
+	if (data == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	BuildCombos();
+
+	// Random buttons, every report goes through every combo
+	for (i = 0; i < packets * SBC_INPUT_PACKET_SIZE; ++i)
+	{
+		data[i] = (SBC_U8)XorShift(&seed);
+	}
+	RunAll("random buttons", data, packets, iterations);
+
+	// A button pressed or released every 16 reports, the other reports take
+	// the early exit
+	for (i = 0; i < packets; ++i)
+	{
+		SBC_U8 *p = data + i * SBC_INPUT_PACKET_SIZE;
+		SBC_U32 held = XorShift(&seed);
+
+		memset(p + SBC_OFFSET_BUTTONS0, 0, SBC_REPORT_BUTTON_BYTES);
+		if (i % 32 < 16) p[SBC_OFFSET_BUTTONS0 + held % SBC_REPORT_BUTTON_BYTES] = (SBC_U8)(1u << ((held >> 8) % 7));
+		if (i % 16 != 0) memcpy(p + SBC_OFFSET_BUTTONS0, p - SBC_INPUT_PACKET_SIZE + SBC_OFFSET_BUTTONS0, SBC_REPORT_BUTTON_BYTES);
+	}
+	RunAll("one button at a time", data, packets, iterations);
+
+	free(data);
+	return 0;
+}
@@ -0,0 +1,305 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// User mode driver for the controller on Linux. Reads the interrupt pipe
+// with libusb, keeping several transfers in flight like the continuous
+// reader of the Windows driver, and translates the packets into the same
+// reports. With -M it runs against the mock transport instead, which
+// needs no hardware and doubles as a benchmark of the whole path. With -u
+// the reports drive a uinput game pad (see sbcuinput.h). With -S the
+// latest state is published in shared memory (see sbcshm.h), with -E the
+// button events (see sys/sbcevents.h). With -C the combos of a file set the
+// virtual buttons (see sys/sbccombo.h).
+//
+// Usage: sbcd [-M] [-r rate] [-n packets] [-x seed] [-f capture] [-F]
+//             [-z zero_permille] [-s short_permille]
+//             [-q depth] [-t transfer_size] [-m 8|16] [-c] [-d deadband]
+//             [-k keepalive_ms] [-u] [-S name] [-E name] [-C combos] [-v]
+//
+//   -M  Mock transport
+//   -r  Mock packet rate in Hz (default 250)
+//   -n  Mock packets, 0 runs until interrupted (default 0)
+//   -x  Mock random seed (default 1)
+//   -f  Mock replays this capture file instead of synthetic packets
+//   -F  Mock produces packets as fast as possible instead of at their rate
+//   -z  Mock zero length transfers, in 1/1000 (default 0)
+//   -s  Mock short transfers, in 1/1000 (default 0)
+//   -q  Transfers in flight (default 2)
+//   -t  Transfer size in bytes (default 32)
+//   -m  Report mode (default 8)
+//   -c  Change-only mode
+//   -d  Deadband applied to every axis with -c, in report units (default 0)
+//   -k  Keep-alive in milliseconds with -c, 0 disables it (default 100)
+//   -u  Create a uinput game pad and send it the reports
+//   -S  Publish the state in this shared memory object (e.g. /sbc-state)
+//   -E  Keep the button events in this shared memory object (e.g. /sbc-events)
+//   -C  Evaluate the combos of this file, an SBC_COMBO_SETTINGS like the
+//       ButtonCombos registry value
+//   -v  Print every report
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbccapfile.h"
+#include "sbcdaemon.h"
+#include "sbcshm.h"
+#include "sbcuinput.h"
+
+static volatile int stop = 0;
+
+static void OnSignal(int Signal)
+{
+	(void)Signal;
+	stop = 1;
+}
+
+static void PrintReport(void *Context, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Timestamp)
+{
+	SBC_U32 i;
+
+	(void)Context;
+	printf("%14llu ", (unsigned long long)Timestamp);
+	for (i = 0; i < Size; ++i) printf("%02x", Report[i]);
+	printf("\n");
+}
+
+static int LoadCombos(const char *Path, SBC_COMBO_TABLES *Tables)
+{
+	SBC_COMBO_SETTINGS settings;
+	FILE *file = fopen(Path, "rb");
+	size_t got;
+
+	if (file == NULL) return -1;
+	got = fread(&settings, 1, sizeof(settings), file);
+	if (got != sizeof(settings) || fgetc(file) != EOF || !SbcComboValidate(&settings))
+	{
+		fclose(file);
+		errno = EINVAL;
+		return -1;
+	}
+	fclose(file);
+
+	SbcComboCompile(Tables, &settings);
+	return 0;
+}
+
+typedef struct _SINKS
+{
+	SBC_UINPUT *Uinput;
+	int Verbose;
+} SINKS;
+
+static void Dispatch(void *Context, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Timestamp)
+{
+	SINKS *sinks = Context;
+
+	if (sinks->Uinput != NULL) SbcUinputSink(sinks->Uinput, Report, Size, Timestamp);
+	if (sinks->Verbose) PrintReport(NULL, Report, Size, Timestamp);
+}
+
+int main(int argc, char **argv)
+{
+	SBC_MOCK_CONFIG mock;
+	SBC_CAPTURE_FILE capture;
+	SBC_DAEMON daemon;
+	SBC_UINPUT uinput;
+	SINKS sinks;
+	SBC_SNAPSHOT_STATE state;
+	SBC_COMBO_TABLES combos;
+	SBC_TRANSPORT *transport;
+	SBC_REPORT_MODE mode = SbcReportMode8Bit;
+	const char *capturePath = NULL;
+	const char *shmName = NULL;
+	const char *eventsName = NULL;
+	const char *combosPath = NULL;
+	SBC_U32 depth = 2;
+	SBC_U32 transferSize = 32;
+	SBC_U32 deadband = 0;
+	SBC_U32 keepAliveMs = 100;
+	int useMock = 0;
+	int changeOnly = 0;
+	int useUinput = 0;
+	int verbose = 0;
+	SBC_U64 start, elapsed;
+	struct sigaction action;
+	int result;
+	int i;
+	int opt;
+
+	memset(&mock, 0, sizeof(mock));
+	mock.Rate = 250;
+	mock.Seed = 1;
+	mock.Paced = 1;
+
+	while ((opt = getopt(argc, argv, "Mr:n:x:f:Fz:s:q:t:m:cd:k:uS:E:C:v")) != -1)
+	{
+		switch (opt)
+		{
+		case 'M': useMock = 1; break;
+		case 'r': mock.Rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': mock.Count = strtoull(optarg, NULL, 10); break;
+		case 'x': mock.Seed = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'f': capturePath = optarg; break;
+		case 'F': mock.Paced = 0; break;
+		case 'z': mock.ZeroPermille = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 's': mock.ShortPermille = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'q': depth = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 't': transferSize = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'm': mode = atoi(optarg) == 16 ? SbcReportMode16Bit : SbcReportMode8Bit; break;
+		case 'c': changeOnly = 1; break;
+		case 'd': deadband = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'k': keepAliveMs = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'u': useUinput = 1; break;
+		case 'S': shmName = optarg; break;
+		case 'E': eventsName = optarg; break;
+		case 'C': combosPath = optarg; break;
+		case 'v': verbose = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-M] [-r rate] [-n packets] [-x seed] [-f capture] [-F] [-z zero_permille] [-s short_permille] "
+				"[-q depth] [-t transfer_size] [-m 8|16] [-c] [-d deadband] [-k keepalive_ms] [-u] [-S name] [-E name] [-C combos] [-v]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (depth == 0) depth = 1;
+	if (transferSize == 0) transferSize = 32;
+
+	if (combosPath != NULL && LoadCombos(combosPath, &combos) != 0)
+	{
+		fprintf(stderr, "can't load %s: %s\n", combosPath, errno == EINVAL ? "not valid combo settings" : strerror(errno));
+		return 1;
+	}
+
+	memset(&capture, 0, sizeof(capture));
+	if (capturePath != NULL)
+	{
+		if (SbcCaptureFileOpen(&capture, capturePath) != 0)
+		{
+			fprintf(stderr, "can't open %s: %s\n", capturePath, errno == EINVAL ? "not a capture file" : strerror(errno));
+			return 1;
+		}
+		mock.Capture = &capture;
+		useMock = 1;
+	}
+
+	transport = useMock ? SbcMockTransportCreate(&mock) : SbcUsbTransportCreate(SBC_USB_VENDOR_ID, SBC_USB_PRODUCT_ID);
+	if (transport == NULL)
+	{
+		fprintf(stderr, "can't create the %s transport\n", useMock ? "mock" : "libusb");
+		SbcCaptureFileClose(&capture);
+		return 1;
+	}
+	transport->Depth = depth;
+	transport->TransferSize = transferSize;
+
+	SbcDaemonInit(&daemon, mode);
+	daemon.ChangeOnly = changeOnly;
+	daemon.ChangeFilter.KeepAliveNs = (SBC_U64)keepAliveMs * 1000000;
+	for (i = 0; i < SbcAxisCount; ++i) daemon.ChangeFilter.Deadband[i] = (SBC_U16)deadband;
+	if (combosPath != NULL) daemon.Combos = &combos;
+
+	memset(&sinks, 0, sizeof(sinks));
+	sinks.Verbose = verbose;
+	if (useUinput)
+	{
+		if (SbcUinputOpen(&uinput, mode, "Steel Battalion Controller") != 0)
+		{
+			fprintf(stderr, "can't create the uinput device: %s\n", strerror(errno));
+			SbcTransportDestroy(transport);
+			SbcCaptureFileClose(&capture);
+			return 1;
+		}
+		sinks.Uinput = &uinput;
+	}
+	if (shmName != NULL)
+	{
+		daemon.Snapshot = SbcShmCreate(shmName);
+		if (daemon.Snapshot == NULL)
+		{
+			fprintf(stderr, "can't create the shared memory object %s: %s\n", shmName, strerror(errno));
+			if (useUinput) SbcUinputClose(&uinput);
+			SbcTransportDestroy(transport);
+			SbcCaptureFileClose(&capture);
+			return 1;
+		}
+	}
+	if (eventsName != NULL)
+	{
+		daemon.Events = SbcShmCreateEvents(eventsName);
+		if (daemon.Events == NULL)
+		{
+			fprintf(stderr, "can't create the shared memory object %s: %s\n", eventsName, strerror(errno));
+			if (daemon.Snapshot != NULL)
+			{
+				SbcShmClose(daemon.Snapshot);
+				SbcShmRemove(shmName);
+			}
+			if (useUinput) SbcUinputClose(&uinput);
+			SbcTransportDestroy(transport);
+			SbcCaptureFileClose(&capture);
+			return 1;
+		}
+	}
+	if (useUinput || verbose)
+	{
+		daemon.Sink = Dispatch;
+		daemon.SinkContext = &sinks;
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = OnSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	start = SbcTransportNow();
+	result = SbcDaemonRun(&daemon, transport, &stop);
+	elapsed = SbcTransportNow() - start;
+
+	fprintf(stderr, "transport:              %s, %u transfers of %u bytes in flight\n", transport->Ops->Name, depth, transferSize);
+	fprintf(stderr, "transfers:              %llu\n", (unsigned long long)daemon.PacketsReceived);
+	fprintf(stderr, "zero length:            %llu\n", (unsigned long long)daemon.ZeroLengthReads);
+	fprintf(stderr, "short:                  %llu\n", (unsigned long long)daemon.ShortReads);
+	fprintf(stderr, "reports:                %llu\n", (unsigned long long)daemon.Reports);
+	if (changeOnly) fprintf(stderr, "suppressed:             %llu\n", (unsigned long long)daemon.ChangeFilter.Suppressed);
+	if (combosPath != NULL) fprintf(stderr, "combo matches:          %llu\n", (unsigned long long)daemon.ComboMatches);
+	fprintf(stderr, "transfers/sec:          %.0f\n", elapsed ? (double)daemon.PacketsReceived * 1e9 / (double)elapsed : 0.0);
+	fprintf(stderr, "latency p50/p99/max:    %llu / %llu / %llu ns\n",
+		(unsigned long long)SbcLatencyPercentile(&daemon.Latency, 500),
+		(unsigned long long)SbcLatencyPercentile(&daemon.Latency, 990),
+		(unsigned long long)daemon.Latency.Max);
+	if (useUinput)
+	{
+		fprintf(stderr, "uinput frames:          %llu\n", (unsigned long long)uinput.Frames);
+		fprintf(stderr, "uinput events/frame:    %.2f\n", uinput.Frames ? (double)uinput.Events / (double)uinput.Frames : 0.0);
+		fprintf(stderr, "uinput write errors:    %llu\n", (unsigned long long)uinput.Errors);
+		SbcUinputClose(&uinput);
+	}
+
+	if (daemon.Snapshot != NULL)
+	{
+		SbcSnapshotRead(daemon.Snapshot, &state);
+		fprintf(stderr, "published:              %llu\n", (unsigned long long)state.Published);
+		SbcShmClose(daemon.Snapshot);
+		SbcShmRemove(shmName);
+	}
+	if (daemon.Events != NULL)
+	{
+		fprintf(stderr, "button events:          %u\n", daemon.Events->Head);
+		SbcShmCloseEvents(daemon.Events);
+		SbcShmRemove(eventsName);
+	}
+
+	SbcTransportDestroy(transport);
+	SbcCaptureFileClose(&capture);
+	return result == 0 ? 0 : 1;
+}
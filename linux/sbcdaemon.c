@@ -0,0 +1,118 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <string.h>
+
+#include "sbcdaemon.h"
+
+void SbcDaemonInit(SBC_DAEMON *Daemon, SBC_REPORT_MODE Mode)
+{
+	memset(Daemon, 0, sizeof(*Daemon));
+	Daemon->Mode = Mode;
+	SbcChangeFilterInit(&Daemon->ChangeFilter, Mode);
+	SbcLatencyInit(&Daemon->Latency);
+}
+
+void SbcDaemonTransferComplete
+(
+	void *Context,
+	const SBC_U8 *Data,
+	SBC_U32 Length,
+	SBC_U64 Timestamp
+)
+/*++
+Routine Description:
+    Transport completion callback, the equivalent of
+    HidSteelBattalionEvtUsbInterruptPipeReadComplete.
+
+Arguments:
+    Context - SBC_DAEMON
+
+    Data - Transferred bytes
+
+    Length - Number of bytes transferred
+
+    Timestamp - When the transfer completed
+
+Return Value:
+    None
+--*/
+{
+	SBC_DAEMON *daemon = Context;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 size;
+
+	++daemon->PacketsReceived;
+
+	if (Length == 0)
+	{
+		++daemon->ZeroLengthReads;
+		return;
+	}
+	if (Length < SBC_INPUT_PACKET_SIZE)
+	{
+		++daemon->ShortReads;
+		return;
+	}
+
+	size = SbcBuildInputReport(daemon->Mode, Data, report);
+	if (daemon->Combos != NULL) daemon->ComboMatches += SbcComboUpdate(daemon->Combos, &daemon->ComboState, daemon->Mode, report, Timestamp);
+	if (daemon->Snapshot != NULL) SbcSnapshotPublish(daemon->Snapshot, daemon->Mode, report, size, Timestamp);
+	if (daemon->Events != NULL) SbcEventRingUpdate(daemon->Events, report, Timestamp);
+	if (daemon->ChangeOnly && !SbcChangeFilterCheck(&daemon->ChangeFilter, report, Timestamp)) return;
+
+	memcpy(daemon->Latest, report, size);
+	daemon->LatestSize = size;
+	++daemon->Reports;
+
+	if (daemon->Sink != NULL) daemon->Sink(daemon->SinkContext, report, size, Timestamp);
+	SbcLatencyRecord(&daemon->Latency, SbcTransportNow() - Timestamp);
+}
+
+int SbcDaemonRun
+(
+	SBC_DAEMON *Daemon,
+	SBC_TRANSPORT *Transport,
+	volatile int *Stop
+)
+/*++
+Routine Description:
+    Starts the transport and processes its transfers until it ends or Stop
+    is set.
+
+Arguments:
+    Daemon - Daemon state, configured
+
+    Transport - Transfer source, Depth and TransferSize set
+
+    Stop - Polled between completions, may be set from a signal handler
+
+Return Value:
+    0 when stopped or the transport ended, SBC_TRANSPORT_ERROR otherwise
+--*/
+{
+	int result = 0;
+
+	Transport->Completion = SbcDaemonTransferComplete;
+	Transport->Context = Daemon;
+
+	if (SbcTransportStart(Transport) != 0)
+	{
+		SbcTransportStop(Transport);
+		return SBC_TRANSPORT_ERROR;
+	}
+
+	while (Stop == NULL || !*Stop)
+	{
+		result = SbcTransportRun(Transport, 100);
+		if (result < 0) break;
+	}
+
+	SbcTransportStop(Transport);
+	return result == SBC_TRANSPORT_ERROR ? SBC_TRANSPORT_ERROR : 0;
+}
@@ -0,0 +1,75 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCDAEMON_H_
+#define _SBCDAEMON_H_
+
+//
+// User mode counterpart of the driver's read completion path. Transfers
+// from a transport (see sbctransport.h) are validated, translated and
+// filtered exactly like in sys/usb.c and the resulting reports are handed
+// to a sink.
+//
+
+#include "sbccore.h"
+#include "sbccombo.h"
+#include "sbcevents.h"
+#include "sbclatency.h"
+#include "sbcsnapshot.h"
+#include "sbctransport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void SBC_REPORT_SINK(void *Context, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Timestamp);
+
+typedef struct _SBC_DAEMON
+{
+	// Configuration, set after SbcDaemonInit
+	SBC_REPORT_MODE Mode;
+	int ChangeOnly;
+	SBC_CHANGE_FILTER ChangeFilter;
+	SBC_REPORT_SINK *Sink;
+	void *SinkContext;
+
+	// Every translated report is published here, also the ones the change
+	// filter holds back. NULL if not published.
+	SBC_STATE_SNAPSHOT *Snapshot;
+
+	// Button edges of every translated report go here, before the change
+	// filter too. NULL if not kept.
+	SBC_EVENT_RING *Events;
+
+	// Combos setting the virtual buttons of every translated report, before
+	// the snapshot, the events and the change filter. NULL if none.
+	const SBC_COMBO_TABLES *Combos;
+	SBC_COMBO_STATE ComboState;
+
+	// Latest report
+	SBC_U8 Latest[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 LatestSize;
+
+	// Same counters as the driver
+	SBC_U64 PacketsReceived;
+	SBC_U64 ZeroLengthReads;
+	SBC_U64 ShortReads;
+	SBC_U64 Reports;
+	SBC_U64 ComboMatches;
+
+	// From the transfer completing to the sink returning
+	SBC_LATENCY_HISTOGRAM Latency;
+} SBC_DAEMON;
+
+void SbcDaemonInit(SBC_DAEMON *Daemon, SBC_REPORT_MODE Mode);
+SBC_TRANSPORT_COMPLETION SbcDaemonTransferComplete;
+int SbcDaemonRun(SBC_DAEMON *Daemon, SBC_TRANSPORT *Transport, volatile int *Stop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCDAEMON_H_
@@ -0,0 +1,297 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Latency and ordering of the button event stream (see sys/sbcevents.h).
+//
+// Replays a capture file, or a synthetic session, through the daemon on
+// the mock transport with the events kept in a ring, while reader threads
+// follow the ring like applications would. Every reader checks that the
+// events come one number after the other unless reported lost, that their
+// timestamps never go back and that applying them to an all-released state
+// ends on the buttons of the last report. The sink of the daemon counts the
+// edges of the reports on its own to check that none went missing. The
+// latency of an event is from the completion of its transfer to a reader
+// copying it.
+//
+// Usage: sbceventbench [-f capture] [-p pattern] [-n packets] [-r rate]
+//                      [-x seed] [-F] [-m 8|16] [-t readers] [-i interval_us]
+//
+//   -f  Replay this capture file instead of synthetic packets
+//   -p  Record a capture of this synthetic pattern (see sbcsynth.h) and
+//       replay it. The session has few button edges, chatter and stress
+//       have about twenty per packet. (default session)
+//   -n  Packets, with -f the whole file if 0 (default 5000)
+//   -r  Synthetic packet rate in Hz (default 1000)
+//   -x  Synthetic random seed (default 1)
+//   -F  Replay as fast as possible instead of at the packet timestamps
+//   -m  Report mode (default 8)
+//   -t  Reader threads (default 2)
+//   -i  Time a reader sleeps when the ring is empty, 0 spins (default 0)
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbccapfile.h"
+#include "sbcdaemon.h"
+#include "sbcsynth.h"
+
+#define MAX_READERS     64
+
+typedef struct _SHARED
+{
+	SBC_EVENT_RING Ring;
+	SBC_U32 IntervalUs;
+	volatile int Stop;
+} SHARED;
+
+typedef struct _READER
+{
+	SHARED *Shared;
+	pthread_t Thread;
+	SBC_U64 Events;
+	SBC_U64 Lost;
+	SBC_U64 Errors;
+	SBC_U64 Buttons;
+	SBC_LATENCY_HISTOGRAM Latency;
+} READER;
+
+typedef struct _EDGES
+{
+	SBC_U64 Buttons;
+	SBC_U64 Edges;
+} EDGES;
+
+static void *Reader(void *Context)
+{
+	READER *reader = Context;
+	SHARED *shared = reader->Shared;
+	SBC_BUTTON_EVENT events[64];
+	SBC_U64 lastTimestamp = 0, now;
+	SBC_U32 next = 0, expected = 0, count, lost, i;
+	struct timespec interval;
+	int last = 0;
+
+	interval.tv_sec = shared->IntervalUs / 1000000;
+	interval.tv_nsec = (long)(shared->IntervalUs % 1000000) * 1000;
+
+	for (;;)
+	{
+		count = SbcEventRingRead(&shared->Ring, &next, events, sizeof(events) / sizeof(events[0]), &lost);
+		now = SbcTransportNow();
+		reader->Lost += lost;
+		expected += lost;
+
+		for (i = 0; i < count; ++i)
+		{
+			if (events[i].Sequence != expected || events[i].Timestamp < lastTimestamp) ++reader->Errors;
+			expected = events[i].Sequence + 1;
+			lastTimestamp = events[i].Timestamp;
+
+			if (events[i].Pressed) reader->Buttons |= 1ull << events[i].Button;
+			else reader->Buttons &= ~(1ull << events[i].Button);
+
+			SbcLatencyRecord(&reader->Latency, now - events[i].Timestamp);
+		}
+		reader->Events += count;
+
+		if (count != 0) continue;
+
+		// One more pass once the writer is done for the last events
+		if (last) break;
+		last = __atomic_load_n(&shared->Stop, __ATOMIC_ACQUIRE);
+		if (!last && shared->IntervalUs != 0) nanosleep(&interval, NULL);
+	}
+	return NULL;
+}
+
+static void CountEdges(void *Context, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Timestamp)
+{
+	EDGES *edges = Context;
+	SBC_U64 buttons = 0;
+	SBC_U32 i;
+
+	(void)Size;
+	(void)Timestamp;
+
+	for (i = 0; i < SBC_REPORT_BUTTON_BYTES; ++i) buttons |= (SBC_U64)Report[i] << (8 * i);
+	buttons &= (1ull << SBC_BUTTON_COUNT) - 1;
+	edges->Edges += (SBC_U64)__builtin_popcountll(buttons ^ edges->Buttons);
+	edges->Buttons = buttons;
+}
+
+static int RecordPattern(const char *Path, SBC_SYNTH_PATTERN Pattern, const SBC_MOCK_CONFIG *Mock)
+{
+	SBC_CAPTURE_WRITER writer;
+	SBC_SYNTH synth;
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U64 i;
+
+	if (SbcCaptureWriterOpen(&writer, Path, 0, SBC_INPUT_PACKET_SIZE) != 0) return -1;
+
+	SbcSynthInitPattern(&synth, Mock->Rate, Mock->Seed, Pattern);
+	for (i = 0; i < Mock->Count; ++i)
+	{
+		SbcSynthNext(&synth, packet);
+		if (SbcCaptureWriterAppend(&writer, i * 1000000000ull / Mock->Rate, packet, sizeof(packet)) != 0)
+		{
+			SbcCaptureWriterClose(&writer);
+			return -1;
+		}
+	}
+	return SbcCaptureWriterClose(&writer);
+}
+
+int main(int argc, char **argv)
+{
+	SBC_MOCK_CONFIG mock;
+	SBC_CAPTURE_FILE capture;
+	SBC_TRANSPORT *transport;
+	SBC_DAEMON daemon;
+	SHARED *shared;
+	READER readers[MAX_READERS];
+	EDGES edges;
+	SBC_REPORT_MODE mode = SbcReportMode8Bit;
+	SBC_SYNTH_PATTERN pattern = SbcSynthSession;
+	const char *capturePath = NULL;
+	char recorded[64];
+	SBC_U32 threads = 2;
+	SBC_U32 intervalUs = 0;
+	SBC_U64 start, elapsed;
+	int failed = 0;
+	SBC_U32 i;
+	int opt;
+
+	memset(&mock, 0, sizeof(mock));
+	mock.Rate = 1000;
+	mock.Count = 5000;
+	mock.Seed = 1;
+	mock.Paced = 1;
+
+	while ((opt = getopt(argc, argv, "f:p:n:r:x:Fm:t:i:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f': capturePath = optarg; break;
+		case 'p':
+			for (pattern = 0; pattern < SbcSynthPatternCount; ++pattern)
+			{
+				if (strcmp(optarg, SbcSynthPatternName(pattern)) == 0) break;
+			}
+			if (pattern == SbcSynthPatternCount)
+			{
+				fprintf(stderr, "unknown pattern %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'n': mock.Count = strtoull(optarg, NULL, 10); break;
+		case 'r': mock.Rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'x': mock.Seed = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'F': mock.Paced = 0; break;
+		case 'm': mode = atoi(optarg) == 16 ? SbcReportMode16Bit : SbcReportMode8Bit; break;
+		case 't': threads = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'i': intervalUs = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		default:
+			fprintf(stderr, "usage: %s [-f capture] [-p pattern] [-n packets] [-r rate] [-x seed] [-F] [-m 8|16] [-t readers] [-i interval_us]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (threads == 0) threads = 1;
+	if (threads > MAX_READERS) threads = MAX_READERS;
+	if (mock.Rate == 0) mock.Rate = 1000;
+
+	if (capturePath == NULL && mock.Count == 0) mock.Count = 5000;
+	if (capturePath == NULL && pattern != SbcSynthSession)
+	{
+		snprintf(recorded, sizeof(recorded), "/tmp/sbceventbench-%ld.sbc", (long)getpid());
+		if (RecordPattern(recorded, pattern, &mock) != 0)
+		{
+			fprintf(stderr, "can't record %s: %s\n", recorded, strerror(errno));
+			unlink(recorded);
+			return 1;
+		}
+		capturePath = recorded;
+	}
+
+	memset(&capture, 0, sizeof(capture));
+	if (capturePath != NULL)
+	{
+		int opened = SbcCaptureFileOpen(&capture, capturePath);
+		if (capturePath == recorded) unlink(recorded);
+		if (opened != 0)
+		{
+			fprintf(stderr, "can't open %s: %s\n", capturePath, errno == EINVAL ? "not a capture file" : strerror(errno));
+			return 1;
+		}
+		mock.Capture = &capture;
+	}
+
+	transport = SbcMockTransportCreate(&mock);
+	shared = calloc(1, sizeof(*shared));
+	if (transport == NULL || shared == NULL)
+	{
+		fprintf(stderr, "can't create the mock transport\n");
+		if (transport != NULL) SbcTransportDestroy(transport);
+		SbcCaptureFileClose(&capture);
+		return 1;
+	}
+
+	SbcEventRingInit(&shared->Ring);
+	shared->IntervalUs = intervalUs;
+
+	memset(&edges, 0, sizeof(edges));
+	SbcDaemonInit(&daemon, mode);
+	daemon.Events = &shared->Ring;
+	daemon.Sink = CountEdges;
+	daemon.SinkContext = &edges;
+
+	memset(readers, 0, sizeof(readers));
+	for (i = 0; i < threads; ++i)
+	{
+		readers[i].Shared = shared;
+		SbcLatencyInit(&readers[i].Latency);
+		pthread_create(&readers[i].Thread, NULL, Reader, &readers[i]);
+	}
+
+	start = SbcTransportNow();
+	if (SbcDaemonRun(&daemon, transport, NULL) != 0) failed = 1;
+	elapsed = SbcTransportNow() - start;
+
+	__atomic_store_n(&shared->Stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < threads; ++i) pthread_join(readers[i].Thread, NULL);
+
+	printf("%s, %llu reports in %.3f s, %llu button edges\n", capturePath == recorded ? SbcSynthPatternName(pattern) :
+		capturePath != NULL ? capturePath : "synthetic session",
+		(unsigned long long)daemon.Reports, (double)elapsed / 1e9, (unsigned long long)edges.Edges);
+	printf("%6s %10s %8s %7s %6s %12s %12s %12s\n", "reader", "events", "lost", "errors", "state", "p50 ns", "p99 ns", "max ns");
+
+	for (i = 0; i < threads; ++i)
+	{
+		READER *reader = &readers[i];
+		int consistent = reader->Events + reader->Lost == edges.Edges && reader->Errors == 0 &&
+			(reader->Lost != 0 || reader->Buttons == edges.Buttons);
+
+		printf("%6u %10llu %8llu %7llu %6s %12llu %12llu %12llu\n", i, (unsigned long long)reader->Events,
+			(unsigned long long)reader->Lost, (unsigned long long)reader->Errors, consistent ? "ok" : "BAD",
+			(unsigned long long)SbcLatencyPercentile(&reader->Latency, 500),
+			(unsigned long long)SbcLatencyPercentile(&reader->Latency, 990),
+			(unsigned long long)reader->Latency.Max);
+		if (!consistent) failed = 1;
+	}
+
+	free(shared);
+	SbcTransportDestroy(transport);
+	SbcCaptureFileClose(&capture);
+	return failed;
+}
@@ -0,0 +1,136 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Follows the button events kept by sbcd -E (see sys/sbcevents.h and
+// sbcshm.h) and prints them as they come, with how long after the transfer
+// completed they were seen. Events must come in order, one number after
+// the other unless the ring reports them lost, with timestamps that never
+// go back; anything else is counted as an ordering error. With a capture
+// replayed by sbcd -M -f this checks the whole path end to end.
+//
+// Usage: sbceventtail [-i interval_us] [-n events] [-q] [name]
+//
+//   -i  Time between polls of the ring (default 1000 us, 0 spins)
+//   -n  Events before exiting, 0 runs until interrupted (default 0)
+//   -q  Only print the summary
+//   name  Shared memory object (default /sbc-events)
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbclatency.h"
+#include "sbcshm.h"
+#include "sbctransport.h"
+
+static volatile int stop = 0;
+
+static void OnSignal(int Signal)
+{
+	(void)Signal;
+	stop = 1;
+}
+
+int main(int argc, char **argv)
+{
+	const SBC_EVENT_RING *ring;
+	SBC_BUTTON_EVENT events[64];
+	SBC_LATENCY_HISTOGRAM latency;
+	const char *name = SBC_SHM_EVENTS_NAME;
+	SBC_U32 intervalUs = 1000;
+	SBC_U64 limit = 0, seen = 0, lost = 0, errors = 0;
+	SBC_U64 lastTimestamp = 0;
+	SBC_U32 next, expected, count, dropped, i;
+	SBC_U64 now;
+	struct timespec interval;
+	struct sigaction action;
+	int quiet = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:n:q")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i': intervalUs = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': limit = strtoull(optarg, NULL, 10); break;
+		case 'q': quiet = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-i interval_us] [-n events] [-q] [name]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc - 1)
+	{
+		fprintf(stderr, "usage: %s [-i interval_us] [-n events] [-q] [name]\n", argv[0]);
+		return 1;
+	}
+	if (optind == argc - 1) name = argv[optind];
+
+	ring = SbcShmOpenEvents(name);
+	if (ring == NULL)
+	{
+		fprintf(stderr, "can't open %s: %s\n", name, errno == EINVAL ? "not a button event ring" : strerror(errno));
+		return 1;
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = OnSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	interval.tv_sec = intervalUs / 1000000;
+	interval.tv_nsec = (long)(intervalUs % 1000000) * 1000;
+	SbcLatencyInit(&latency);
+
+	// Only what happens from now on
+	next = ring->Head;
+
+	while (!stop && (limit == 0 || seen < limit))
+	{
+		expected = next;
+		count = SbcEventRingRead(ring, &next, events, sizeof(events) / sizeof(events[0]), &dropped);
+		now = SbcTransportNow();
+		lost += dropped;
+
+		for (i = 0; i < count; ++i)
+		{
+			if (i == 0) expected += dropped;
+			if (events[i].Sequence != expected || events[i].Timestamp < lastTimestamp) ++errors;
+			expected = events[i].Sequence + 1;
+			lastTimestamp = events[i].Timestamp;
+
+			SbcLatencyRecord(&latency, now - events[i].Timestamp);
+			if (!quiet)
+			{
+				printf("%10u %14llu  button %2u %-8s %8.3f ms\n", events[i].Sequence, (unsigned long long)events[i].Timestamp,
+					events[i].Button, events[i].Pressed ? "pressed" : "released", (double)(now - events[i].Timestamp) / 1e6);
+			}
+		}
+		if (count != 0 && !quiet) fflush(stdout);
+		seen += count;
+
+		if (count == 0 && intervalUs != 0) nanosleep(&interval, NULL);
+	}
+
+	fprintf(stderr, "events:                 %llu\n", (unsigned long long)seen);
+	fprintf(stderr, "lost:                   %llu\n", (unsigned long long)lost);
+	fprintf(stderr, "ordering errors:        %llu\n", (unsigned long long)errors);
+	fprintf(stderr, "latency p50/p99/max:    %llu / %llu / %llu ns\n",
+		(unsigned long long)SbcLatencyPercentile(&latency, 500),
+		(unsigned long long)SbcLatencyPercentile(&latency, 990),
+		(unsigned long long)latency.Max);
+
+	SbcShmCloseEvents(ring);
+	return errors == 0 ? 0 : 1;
+}
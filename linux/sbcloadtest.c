@@ -0,0 +1,392 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Load test of the translation and delivery path with synthetic packets at
+// rates and patterns the controller doesn't produce (see sbcsynth.h), with
+// bursts and malformed transfers mixed in.
+//
+// Every transfer goes through the same steps as the read completion routine
+// in sys/usb.c: the length checks, the translation, the change filter with
+// -c, and either a pending read or the report cache. Reads are modelled
+// like the ones hidclass keeps pending: each completed read comes back
+// after the consumer time. Arrivals and reads run in simulated time so the
+// counters, the delivery latency and the checksum of the delivered reports
+// only depend on the options and the seed, and can be compared across
+// commits. The processing cost is measured for real, in batches of 32
+// transfers.
+//
+// Malformed transfers are zero length ones, short ones (1 to 25 bytes,
+// dropped by the driver), long ones (27 bytes up to the transfer size,
+// accepted) and packets of random bytes.
+//
+// Usage: sbcloadtest [-r rate] [-n seconds] [-p pattern] [-x seed]
+//                    [-b burst] [-g gap_us] [-q reads] [-w consumer_us]
+//                    [-z zero_permille] [-s short_permille]
+//                    [-l long_permille] [-j junk_permille] [-m 8|16] [-c]
+//
+//   -r  Only this packet rate in Hz (default 1000, 2000, 4000 and 8000)
+//   -n  Simulated seconds per rate (default 10)
+//   -p  session, chatter, sweep or stress (default stress)
+//   -x  Random seed (default 1)
+//   -b  Packets per burst (default 1, no bursts)
+//   -g  Time between the packets of a burst (default 0 us)
+//   -q  Reads kept pending by the consumer (default 2)
+//   -w  Time for the consumer to send a completed read again (default 100 us)
+//   -z  Zero length transfers, in 1/1000 (default 0)
+//   -s  Short transfers, in 1/1000 (default 0)
+//   -l  Long transfers, in 1/1000 (default 0)
+//   -j  Random packets, in 1/1000 (default 0)
+//   -m  Report mode (default 8)
+//   -c  Change-only mode
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbclatency.h"
+#include "sbcsynth.h"
+
+#define MAX_READS       16
+#define TRANSFER_SIZE   32
+#define BATCH           32
+
+typedef struct _LOAD_CONFIG
+{
+	SBC_U32 Rate;
+	SBC_U64 Duration;
+	SBC_SYNTH_PATTERN Pattern;
+	SBC_U32 Seed;
+	SBC_U32 Burst;
+	SBC_U64 Gap;
+	SBC_U32 Reads;
+	SBC_U64 Consumer;
+	SBC_U32 ZeroPermille;
+	SBC_U32 ShortPermille;
+	SBC_U32 LongPermille;
+	SBC_U32 JunkPermille;
+	SBC_REPORT_MODE Mode;
+	int ChangeOnly;
+} LOAD_CONFIG;
+
+typedef struct _LOAD_RESULT
+{
+	SBC_U64 Transfers;
+	SBC_U64 ZeroLength;
+	SBC_U64 Short;
+	SBC_U64 Long;
+	SBC_U64 Junk;
+	SBC_U64 Suppressed;         // By the change filter
+	SBC_U64 Delivered;
+	SBC_U64 Dropped;            // Overwritten in the cache before a read took them
+	SBC_U32 Checksum;           // FNV-1a of the delivered reports
+	SBC_U64 ProcessNs;
+	SBC_LATENCY_HISTOGRAM Process;  // Per transfer, averaged over a batch
+	SBC_LATENCY_HISTOGRAM Delivery; // Simulated, from arrival to read completion
+} LOAD_RESULT;
+
+//
+// Read requests of the consumer and the report cache, as in the driver
+//
+typedef struct _LOAD_PATH
+{
+	const LOAD_CONFIG *Config;
+	LOAD_RESULT *Result;
+	SBC_U64 ReadReady[MAX_READS];   // When each read is pending again
+	SBC_REPORT_CACHE Cache;
+	SBC_U64 CacheTime;              // Arrival of the report in the cache
+	SBC_CHANGE_FILTER Filter;
+} LOAD_PATH;
+
+static SBC_U64 NowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+static SBC_U32 XorShift(SBC_U32 *State)
+{
+	SBC_U32 x = *State;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*State = x;
+	return x;
+}
+
+static SBC_U32 Fnv1a(SBC_U32 Hash, const SBC_U8 *Data, SBC_U32 Length)
+{
+	SBC_U32 i;
+	for (i = 0; i < Length; ++i) Hash = (Hash ^ Data[i]) * 16777619u;
+	return Hash;
+}
+
+static void Deliver(LOAD_PATH *Path, SBC_U32 Read, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Arrival, SBC_U64 Now)
+{
+	Path->Result->Checksum = Fnv1a(Path->Result->Checksum, Report, Size);
+	++Path->Result->Delivered;
+	SbcLatencyRecord(&Path->Result->Delivery, Now - Arrival);
+	Path->ReadReady[Read] = Now + Path->Config->Consumer;
+}
+
+// First read pending at Now, or Config->Reads if there is none
+static SBC_U32 PendingRead(const LOAD_PATH *Path, SBC_U64 Now)
+{
+	SBC_U32 read;
+	for (read = 0; read < Path->Config->Reads; ++read)
+	{
+		if (Path->ReadReady[read] <= Now) return read;
+	}
+	return read;
+}
+
+//
+// Reads sent again before Now complete straight away with the cached report,
+// like IOCTL_HID_READ_REPORT does
+//
+static void ServeReads(LOAD_PATH *Path, SBC_U64 Now)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+
+	while (Path->Cache.Dirty)
+	{
+		SBC_U32 read, first = Path->Config->Reads;
+		SBC_U32 size;
+
+		for (read = 0; read < Path->Config->Reads; ++read)
+		{
+			if (Path->ReadReady[read] <= Now && (first == Path->Config->Reads || Path->ReadReady[read] < Path->ReadReady[first])) first = read;
+		}
+		if (first == Path->Config->Reads) return;
+
+		size = SbcReportCacheTake(&Path->Cache, report);
+		if (size == 0) return;
+
+		// The read arrived after the report, it waited for the read
+		Deliver(Path, first, report, size, Path->CacheTime, Path->ReadReady[first] > Path->CacheTime ? Path->ReadReady[first] : Path->CacheTime);
+	}
+}
+
+//
+// The read completion routine
+//
+static void Transfer(LOAD_PATH *Path, const SBC_U8 *Data, SBC_U32 Length, SBC_U64 Arrival)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 size, read;
+
+	++Path->Result->Transfers;
+
+	if (Length == 0)
+	{
+		++Path->Result->ZeroLength;
+		return;
+	}
+	if (Length < SBC_INPUT_PACKET_SIZE)
+	{
+		++Path->Result->Short;
+		return;
+	}
+
+	size = SbcBuildInputReport(Path->Config->Mode, Data, report);
+
+	if (Path->Config->ChangeOnly && !SbcChangeFilterCheck(&Path->Filter, report, Arrival))
+	{
+		++Path->Result->Suppressed;
+		return;
+	}
+
+	read = PendingRead(Path, Arrival);
+	SbcReportCacheStore(&Path->Cache, report, size, read < Path->Config->Reads);
+	Path->CacheTime = Arrival;
+	if (read < Path->Config->Reads) Deliver(Path, read, report, size, Arrival, Arrival);
+}
+
+static void Run(const LOAD_CONFIG *Config, LOAD_RESULT *Result)
+{
+	LOAD_PATH path;
+	SBC_SYNTH synth;
+	SBC_U32 faults = Config->Seed * 2654435761u + Config->Rate;
+	SBC_U64 period = 1000000000ull / Config->Rate;
+	SBC_U64 count = Config->Duration / period;
+	SBC_U8 (*packets)[TRANSFER_SIZE];
+	SBC_U32 *lengths;
+	SBC_U64 *arrivals;
+	SBC_U64 i;
+
+	memset(Result, 0, sizeof(*Result));
+	SbcLatencyInit(&Result->Process);
+	SbcLatencyInit(&Result->Delivery);
+	Result->Checksum = 2166136261u;
+
+	memset(&path, 0, sizeof(path));
+	path.Config = Config;
+	path.Result = Result;
+	SbcReportCacheInit(&path.Cache);
+	SbcChangeFilterInit(&path.Filter, Config->Mode);
+
+	count -= count % BATCH;
+	packets = malloc((size_t)count * TRANSFER_SIZE);
+	lengths = malloc((size_t)count * sizeof(SBC_U32));
+	arrivals = malloc((size_t)count * sizeof(SBC_U64));
+	if (packets == NULL || lengths == NULL || arrivals == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	// The whole stream is generated up front so only the path is timed
+	SbcSynthInitPattern(&synth, Config->Rate, Config->Seed, Config->Pattern);
+	for (i = 0; i < count; ++i)
+	{
+		SBC_U32 dice = XorShift(&faults) % 1000;
+		SBC_U32 limit = Config->ZeroPermille;
+
+		memset(packets[i], 0, TRANSFER_SIZE);
+		SbcSynthNext(&synth, packets[i]);
+		lengths[i] = SBC_INPUT_PACKET_SIZE;
+
+		if (dice < limit) lengths[i] = 0;
+		else if (dice < (limit += Config->ShortPermille)) lengths[i] = 1 + XorShift(&faults) % (SBC_INPUT_PACKET_SIZE - 1);
+		else if (dice < (limit += Config->LongPermille)) lengths[i] = SBC_INPUT_PACKET_SIZE + 1 + XorShift(&faults) % (TRANSFER_SIZE - SBC_INPUT_PACKET_SIZE);
+		else if (dice < (limit += Config->JunkPermille))
+		{
+			SBC_U32 j;
+			for (j = 0; j < SBC_INPUT_PACKET_SIZE; ++j) packets[i][j] = (SBC_U8)XorShift(&faults);
+			++Result->Junk;
+		}
+		if (lengths[i] > SBC_INPUT_PACKET_SIZE) ++Result->Long;
+
+		// Bursts keep the average rate
+		arrivals[i] = (i / Config->Burst) * Config->Burst * period + (i % Config->Burst) * Config->Gap;
+	}
+
+	for (i = 0; i < count; i += BATCH)
+	{
+		SBC_U64 start = NowNs(), elapsed;
+		SBC_U64 j;
+
+		for (j = i; j < i + BATCH; ++j)
+		{
+			ServeReads(&path, arrivals[j]);
+			Transfer(&path, packets[j], lengths[j], arrivals[j]);
+		}
+
+		elapsed = NowNs() - start;
+		Result->ProcessNs += elapsed;
+		SbcLatencyRecord(&Result->Process, elapsed / BATCH);
+	}
+	ServeReads(&path, (SBC_U64)-1 / 2);
+	Result->Dropped = path.Cache.Dropped;
+
+	free(packets);
+	free(lengths);
+	free(arrivals);
+}
+
+static void Print(const LOAD_CONFIG *Config, const LOAD_RESULT *Result)
+{
+	printf("%5u Hz  transfers %9llu  zero %7llu  short %7llu  long %7llu  junk %7llu  suppressed %9llu\n",
+		Config->Rate, (unsigned long long)Result->Transfers, (unsigned long long)Result->ZeroLength,
+		(unsigned long long)Result->Short, (unsigned long long)Result->Long, (unsigned long long)Result->Junk,
+		(unsigned long long)Result->Suppressed);
+	printf("          delivered %9llu  dropped %9llu  checksum %08x\n",
+		(unsigned long long)Result->Delivered, (unsigned long long)Result->Dropped, Result->Checksum);
+	printf("          delivery p50 %8llu ns  p99 %8llu ns  max %8llu ns\n",
+		(unsigned long long)SbcLatencyPercentile(&Result->Delivery, 500),
+		(unsigned long long)SbcLatencyPercentile(&Result->Delivery, 990),
+		(unsigned long long)Result->Delivery.Max);
+	printf("          processing %6.1f ns/transfer  p99 <= %llu ns  throughput %.0f transfers/s\n",
+		Result->Transfers != 0 ? (double)Result->ProcessNs / (double)Result->Transfers : 0.0,
+		(unsigned long long)SbcLatencyPercentile(&Result->Process, 990),
+		Result->ProcessNs != 0 ? (double)Result->Transfers * 1e9 / (double)Result->ProcessNs : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	static const SBC_U32 rates[] = { 1000, 2000, 4000, 8000 };
+	LOAD_CONFIG config;
+	LOAD_RESULT result;
+	SBC_U32 rate = 0, seconds = 10;
+	SBC_U32 r;
+	int opt;
+
+	memset(&config, 0, sizeof(config));
+	config.Pattern = SbcSynthStress;
+	config.Seed = 1;
+	config.Burst = 1;
+	config.Reads = 2;
+	config.Consumer = 100000;
+	config.Mode = SbcReportMode8Bit;
+
+	while ((opt = getopt(argc, argv, "r:n:p:x:b:g:q:w:z:s:l:j:m:c")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r': rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': seconds = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'p':
+			for (config.Pattern = 0; config.Pattern < SbcSynthPatternCount; ++config.Pattern)
+			{
+				if (strcmp(optarg, SbcSynthPatternName(config.Pattern)) == 0) break;
+			}
+			if (config.Pattern == SbcSynthPatternCount)
+			{
+				fprintf(stderr, "unknown pattern %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'x': config.Seed = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'b': config.Burst = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'g': config.Gap = strtoull(optarg, NULL, 10) * 1000; break;
+		case 'q': config.Reads = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'w': config.Consumer = strtoull(optarg, NULL, 10) * 1000; break;
+		case 'z': config.ZeroPermille = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 's': config.ShortPermille = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'l': config.LongPermille = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'j': config.JunkPermille = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'm': config.Mode = atoi(optarg) == 16 ? SbcReportMode16Bit : SbcReportMode8Bit; break;
+		case 'c': config.ChangeOnly = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-r rate] [-n seconds] [-p pattern] [-x seed] [-b burst] [-g gap_us] [-q reads] [-w consumer_us] [-z zero_permille] [-s short_permille] [-l long_permille] [-j junk_permille] [-m 8|16] [-c]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (seconds == 0) seconds = 1;
+	if (config.Burst == 0) config.Burst = 1;
+	if (config.Reads == 0) config.Reads = 1;
+	if (config.Reads > MAX_READS) config.Reads = MAX_READS;
+	if (config.ZeroPermille + config.ShortPermille + config.LongPermille + config.JunkPermille > 1000)
+	{
+		fprintf(stderr, "malformed transfers add up to more than 1000 permille\n");
+		return 1;
+	}
+	config.Duration = (SBC_U64)seconds * 1000000000ull;
+
+	printf("pattern %s, seed %u, %u s, bursts of %u packets %llu us apart, %u reads, consumer %llu us, %d bit reports%s\n",
+		SbcSynthPatternName(config.Pattern), config.Seed, seconds, config.Burst, (unsigned long long)(config.Gap / 1000),
+		config.Reads, (unsigned long long)(config.Consumer / 1000), config.Mode == SbcReportMode16Bit ? 16 : 8,
+		config.ChangeOnly ? ", change only" : "");
+
+	for (r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r)
+	{
+		config.Rate = rate != 0 ? rate : rates[r];
+		if (config.Rate > 1000000) config.Rate = 1000000;
+
+		// A burst can't last longer than the packets it bunches up
+		if (config.Gap > 1000000000ull / config.Rate) config.Gap = 1000000000ull / config.Rate;
+		Run(&config, &result);
+		Print(&config, &result);
+		if (rate != 0) break;
+	}
+	return 0;
+}
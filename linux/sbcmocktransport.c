@@ -0,0 +1,194 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbccapfile.h"
+#include "sbcsynth.h"
+#include "sbctransport.h"
+
+// Completions run per call when not paced
+#define MOCK_BATCH 64
+
+typedef struct _MOCK_TRANSPORT
+{
+	SBC_TRANSPORT Transport;
+	SBC_MOCK_CONFIG Config;
+	SBC_SYNTH Synth;
+	SBC_U32 Seed;               // Fault injection
+	SBC_U64 Index;
+	SBC_U64 Start;
+	int Running;
+} MOCK_TRANSPORT;
+
+static SBC_U32 MockRandom(MOCK_TRANSPORT *Mock)
+{
+	SBC_U32 x = Mock->Seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	Mock->Seed = x;
+	return x;
+}
+
+static SBC_U64 MockCount(const MOCK_TRANSPORT *Mock)
+{
+	if (Mock->Config.Capture != NULL)
+	{
+		SBC_U64 records = Mock->Config.Capture->Count;
+		return Mock->Config.Count != 0 && Mock->Config.Count < records ? Mock->Config.Count : records;
+	}
+	return Mock->Config.Count;
+}
+
+// Offset of a packet from the start of the session
+static SBC_U64 MockDue(const MOCK_TRANSPORT *Mock, SBC_U64 Index)
+{
+	const SBC_CAPTURE_FILE *capture = Mock->Config.Capture;
+
+	if (capture != NULL)
+	{
+		SBC_U64 first = SbcCaptureFileRecord(capture, 0)->Timestamp;
+		SBC_U64 timestamp = SbcCaptureFileRecord(capture, (size_t)Index)->Timestamp;
+		return timestamp > first ? timestamp - first : 0;
+	}
+	return Index * 1000000000ull / Mock->Config.Rate;
+}
+
+static void MockSleepUntil(SBC_U64 Deadline)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t)(Deadline / 1000000000ull);
+	ts.tv_nsec = (long)(Deadline % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+static void MockComplete(MOCK_TRANSPORT *Mock)
+{
+	SBC_TRANSPORT *transport = &Mock->Transport;
+	SBC_U8 packet[SBC_CAPTURE_MAX_DATA_SIZE];
+	SBC_U32 length = SBC_INPUT_PACKET_SIZE;
+	SBC_U32 dice;
+
+	memset(packet, 0, sizeof(packet));
+
+	if (Mock->Config.Capture != NULL)
+	{
+		const SBC_CAPTURE_RECORD *record = SbcCaptureFileRecord(Mock->Config.Capture, (size_t)Mock->Index);
+		length = record->Length < Mock->Config.Capture->DataSize ? record->Length : Mock->Config.Capture->DataSize;
+		memcpy(packet, SbcCaptureRecordData(record), length);
+	}
+	else
+	{
+		SbcSynthNext(&Mock->Synth, packet);
+	}
+	++Mock->Index;
+
+	dice = MockRandom(Mock) % 1000;
+	if (dice < Mock->Config.ZeroPermille) length = 0;
+	else if (dice < Mock->Config.ZeroPermille + Mock->Config.ShortPermille) length = 1 + MockRandom(Mock) % (SBC_INPUT_PACKET_SIZE - 1);
+
+	if (length > transport->TransferSize) length = transport->TransferSize;
+	transport->Completion(transport->Context, packet, length, SbcTransportNow());
+}
+
+static int MockStart(SBC_TRANSPORT *Transport)
+{
+	MOCK_TRANSPORT *mock = (MOCK_TRANSPORT *)Transport;
+
+	if (Transport->Completion == NULL || Transport->Depth == 0) return SBC_TRANSPORT_ERROR;
+
+	SbcSynthInit(&mock->Synth, mock->Config.Rate, mock->Config.Seed);
+	mock->Seed = mock->Config.Seed * 2654435761u + 1;
+	mock->Index = 0;
+	mock->Start = SbcTransportNow();
+	mock->Running = 1;
+	return 0;
+}
+
+static int MockRun(SBC_TRANSPORT *Transport, int TimeoutMs)
+{
+	MOCK_TRANSPORT *mock = (MOCK_TRANSPORT *)Transport;
+	SBC_U64 count = MockCount(mock);
+	int completed = 0;
+
+	if (!mock->Running) return SBC_TRANSPORT_ERROR;
+	if (count != 0 && mock->Index >= count) return SBC_TRANSPORT_END;
+
+	if (!mock->Config.Paced)
+	{
+		while (completed < MOCK_BATCH && (count == 0 || mock->Index < count))
+		{
+			MockComplete(mock);
+			++completed;
+		}
+		return completed;
+	}
+
+	// Everything due by now, or wait for the next one up to the timeout
+	for (;;)
+	{
+		SBC_U64 due = mock->Start + MockDue(mock, mock->Index);
+		SBC_U64 now = SbcTransportNow();
+
+		if (due > now)
+		{
+			SBC_U64 limit = now + (SBC_U64)TimeoutMs * 1000000;
+			if (completed != 0) break;
+			if (due > limit)
+			{
+				MockSleepUntil(limit);
+				break;
+			}
+			MockSleepUntil(due);
+		}
+
+		MockComplete(mock);
+		++completed;
+		if (count != 0 && mock->Index >= count) break;
+	}
+	return completed;
+}
+
+static void MockStop(SBC_TRANSPORT *Transport)
+{
+	((MOCK_TRANSPORT *)Transport)->Running = 0;
+}
+
+static void MockDestroy(SBC_TRANSPORT *Transport)
+{
+	free(Transport);
+}
+
+static const SBC_TRANSPORT_OPS MockOps =
+{
+	"mock",
+	MockStart,
+	MockRun,
+	MockStop,
+	MockDestroy,
+};
+
+SBC_TRANSPORT *SbcMockTransportCreate(const SBC_MOCK_CONFIG *Config)
+{
+	MOCK_TRANSPORT *mock;
+
+	if (Config->Capture != NULL && Config->Capture->Count == 0) return NULL;
+
+	mock = calloc(1, sizeof(*mock));
+	if (mock == NULL) return NULL;
+
+	mock->Transport.Ops = &MockOps;
+	mock->Transport.Depth = 2;
+	mock->Transport.TransferSize = 32;
+	mock->Config = *Config;
+	if (mock->Config.Rate == 0) mock->Config.Rate = 250;
+	return &mock->Transport;
+}
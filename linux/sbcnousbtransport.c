@@ -0,0 +1,21 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Stands in for sbcusbtransport.c when libusb-1.0 is not available.
+//
+
+#include <stdio.h>
+
+#include "sbctransport.h"
+
+SBC_TRANSPORT *SbcUsbTransportCreate(SBC_U16 VendorId, SBC_U16 ProductId)
+{
+	(void)VendorId;
+	(void)ProductId;
+	fprintf(stderr, "built without libusb-1.0, only the mock transport is available\n");
+	return NULL;
+}
@@ -0,0 +1,248 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Cost and consistency of IOCTL_HID_GET_INPUT_REPORT polls, served from
+// the latest-state cache (see HidSteelBattalionGetInputReport in sys/hid.c).
+//
+// A writer thread plays the read completion routine: it translates a packet
+// and stores the report in the cache under a spin lock, like StateLock in
+// the driver, at the packet rate of the controller or as fast as it can.
+// Poller threads play the applications calling HidD_GetInputReport once per
+// tick, as fast as they can: they take the lock and peek at the cache.
+//
+// Every packet has all its bytes equal to the low byte of its sequence
+// number, so each poll must return one of 256 known reports. A report
+// mixing two of them was torn by a poll racing an update. With -u the lock
+// is left out to show that the check catches it.
+//
+// Usage: sbcpollbench [-t pollers] [-n seconds] [-r rate] [-m 8|16] [-u]
+//
+//   -t  Poller threads (default 1)
+//   -n  Seconds of concurrent polling (default 2)
+//   -r  Writer packet rate in Hz, 0 for as fast as possible (default 1000)
+//   -m  Report mode (default 8)
+//   -u  Unlocked: no lock around the cache, polls may be torn
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbccore.h"
+
+#define MAX_POLLERS     16
+#define BATCH           64
+#define SINGLE_POLLS    10000000
+
+typedef struct _SHARED
+{
+	SBC_REPORT_CACHE Cache;
+	pthread_spinlock_t Lock;
+	SBC_REPORT_MODE Mode;
+	SBC_U32 Rate;
+	int Unlocked;
+	volatile int Stop;
+
+	// Reports of the packets with every byte equal to the index
+	SBC_U8 Expected[256][SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 Size;
+
+	SBC_U64 Writes;
+} SHARED;
+
+typedef struct _POLLER
+{
+	SHARED *Shared;
+	pthread_t Thread;
+	SBC_U64 Polls;
+	SBC_U64 Torn;
+	SBC_U64 Changes;
+	double Seconds;
+} POLLER;
+
+static double Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static SBC_U32 Poll(SHARED *Shared, SBC_U8 *Report)
+{
+	SBC_U32 size;
+
+	if (!Shared->Unlocked) pthread_spin_lock(&Shared->Lock);
+	size = SbcReportCachePeek(&Shared->Cache, Report);
+	if (!Shared->Unlocked) pthread_spin_unlock(&Shared->Lock);
+	return size;
+}
+
+static int Consistent(const SHARED *Shared, const SBC_U8 *Report)
+{
+	SBC_U32 i;
+
+	for (i = 0; i < 256; ++i)
+	{
+		if (Shared->Expected[i][0] == Report[0] && memcmp(Shared->Expected[i], Report, Shared->Size) == 0) return 1;
+	}
+	return 0;
+}
+
+static void *Writer(void *Context)
+{
+	SHARED *shared = Context;
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	struct timespec next;
+	SBC_U32 size;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!__atomic_load_n(&shared->Stop, __ATOMIC_RELAXED))
+	{
+		memset(packet, (int)(shared->Writes & 0xff), sizeof(packet));
+		size = SbcBuildInputReport(shared->Mode, packet, report);
+
+		if (!shared->Unlocked) pthread_spin_lock(&shared->Lock);
+		SbcReportCacheStore(&shared->Cache, report, size, 0);
+		if (!shared->Unlocked) pthread_spin_unlock(&shared->Lock);
+		++shared->Writes;
+
+		if (shared->Rate != 0)
+		{
+			next.tv_nsec += 1000000000 / shared->Rate;
+			if (next.tv_nsec >= 1000000000)
+			{
+				next.tv_nsec -= 1000000000;
+				++next.tv_sec;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	}
+	return NULL;
+}
+
+//
+// Polls in batches, only the polls are timed, the reports are checked
+// after each batch
+//
+static void *Poller(void *Context)
+{
+	POLLER *poller = Context;
+	SHARED *shared = poller->Shared;
+	static __thread SBC_U8 reports[BATCH][SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 last = 0;
+	SBC_U32 i;
+
+	while (!__atomic_load_n(&shared->Stop, __ATOMIC_RELAXED))
+	{
+		double start = Now();
+		for (i = 0; i < BATCH; ++i) Poll(shared, reports[i]);
+		poller->Seconds += Now() - start;
+		poller->Polls += BATCH;
+
+		for (i = 0; i < BATCH; ++i)
+		{
+			if (!Consistent(shared, reports[i])) ++poller->Torn;
+			else if (reports[i][0] != last) ++poller->Changes;
+			last = reports[i][0];
+		}
+	}
+	return NULL;
+}
+
+static void Usage(const char *Program)
+{
+	fprintf(stderr, "usage: %s [-t pollers] [-n seconds] [-r rate] [-m 8|16] [-u]\n", Program);
+}
+
+int main(int argc, char **argv)
+{
+	static SHARED shared;
+	static POLLER pollers[MAX_POLLERS];
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 threads = 1, seconds = 2, i;
+	SBC_U64 polls = 0, torn = 0, changes = 0;
+	double start, elapsed, polling = 0.0;
+	pthread_t writer;
+	int opt;
+
+	shared.Rate = 1000;
+	shared.Mode = SbcReportMode8Bit;
+
+	while ((opt = getopt(argc, argv, "t:n:r:m:u")) != -1)
+	{
+		switch (opt)
+		{
+		case 't': threads = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': seconds = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'r': shared.Rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'm': shared.Mode = atoi(optarg) == 16 ? SbcReportMode16Bit : SbcReportMode8Bit; break;
+		case 'u': shared.Unlocked = 1; break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc || threads == 0 || threads > MAX_POLLERS || seconds == 0)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < 256; ++i)
+	{
+		memset(packet, (int)i, sizeof(packet));
+		shared.Size = SbcBuildInputReport(shared.Mode, packet, shared.Expected[i]);
+	}
+	SbcReportCacheInit(&shared.Cache);
+	SbcReportCacheStore(&shared.Cache, shared.Expected[0], shared.Size, 0);
+	pthread_spin_init(&shared.Lock, PTHREAD_PROCESS_PRIVATE);
+
+	// Uncontended: the cost of a poll on its own
+	start = Now();
+	for (i = 0; i < SINGLE_POLLS; ++i) Poll(&shared, report);
+	elapsed = Now() - start;
+	printf("%s, %u byte reports, uncontended: %.1f ns/poll\n", shared.Unlocked ? "unlocked" : "locked",
+		shared.Size, elapsed * 1e9 / SINGLE_POLLS);
+
+	// Concurrent with the writer
+	start = Now();
+	pthread_create(&writer, NULL, Writer, &shared);
+	for (i = 0; i < threads; ++i)
+	{
+		pollers[i].Shared = &shared;
+		pthread_create(&pollers[i].Thread, NULL, Poller, &pollers[i]);
+	}
+	while (Now() - start < seconds) sleep(1);
+	__atomic_store_n(&shared.Stop, 1, __ATOMIC_RELAXED);
+	pthread_join(writer, NULL);
+	for (i = 0; i < threads; ++i)
+	{
+		pthread_join(pollers[i].Thread, NULL);
+		polls += pollers[i].Polls;
+		torn += pollers[i].Torn;
+		changes += pollers[i].Changes;
+		polling += pollers[i].Seconds;
+	}
+	elapsed = Now() - start;
+
+	printf("%u pollers, writer at %s: %llu writes, %llu polls, %.1f ns/poll, %.1f M polls/s, %llu changes seen, %llu torn\n",
+		threads, shared.Rate != 0 ? "a fixed rate" : "full speed", (unsigned long long)shared.Writes,
+		(unsigned long long)polls, polls != 0 ? polling * 1e9 / (double)polls : 0.0, (double)polls / elapsed / 1e6,
+		(unsigned long long)changes, (unsigned long long)torn);
+
+	pthread_spin_destroy(&shared.Lock);
+
+	// Torn reports are expected without the lock
+	return torn != 0 && !shared.Unlocked ? 1 : 0;
+}
@@ -0,0 +1,262 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Simulates the continuous reader on the interrupt pipe to choose the
+// ReaderDepth setting. Sweeps the number of pending reads against the
+// packet rate and reports how many packets are lost and how late the
+// received ones are delivered.
+//
+// Model: the host controller polls the endpoint once per packet period. If
+// no read is pending at that moment the packet is lost, the controller
+// only ever sends its current state. A completed read is processed by the
+// completion routine, serialized on one processor like the USB DPCs, and
+// is sent again by the framework a little after the routine returns. The
+// processor occasionally stalls for a while, standing in for other DPCs
+// and busy hubs. Latency is from the poll to the end of the completion
+// routine.
+//
+// Usage: sbcreadersim [-r rate] [-q depth] [-n seconds] [-s service_us]
+//                     [-j jitter_us] [-e resubmit_us] [-p stall_permille]
+//                     [-d stall_us] [-S short_permille] [-x seed]
+//
+//   -r  Only this packet rate in Hz (default sweeps 125 to 8000)
+//   -q  Only this depth (default sweeps 1 to 10)
+//   -n  Simulated seconds per configuration (default 60)
+//   -s  Completion routine time (default 15 us)
+//   -j  Mean of the exponential extra completion time (default 5 us)
+//   -e  Time to send a read again after its completion (default 10 us)
+//   -p  Probability of a stall before a completion, in 1/1000 (default 2)
+//   -d  Maximum stall duration, uniform from a quarter of it (default 2000 us)
+//   -S  Probability of a short packet, in 1/1000 (default 0)
+//   -x  Random seed (default 1)
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbccore.h"
+
+#define MAX_DEPTH 10
+
+typedef struct _SIM_CONFIG
+{
+	SBC_U32 Rate;
+	SBC_U32 Depth;
+	SBC_U64 Duration;
+	SBC_U64 Service;
+	SBC_U64 Jitter;
+	SBC_U64 Resubmit;
+	SBC_U32 StallPermille;
+	SBC_U64 Stall;
+	SBC_U32 ShortPermille;
+	SBC_U64 Seed;
+} SIM_CONFIG;
+
+typedef struct _SIM_RESULT
+{
+	SBC_U64 Polls;
+	SBC_U64 Lost;
+	SBC_U64 Short;
+	SBC_U64 P50;
+	SBC_U64 P99;
+	SBC_U64 Max;
+} SIM_RESULT;
+
+// Latencies of the current configuration, one per poll at most
+static SBC_U64 *latencies;
+
+static SBC_U64 XorShift64(SBC_U64 *State)
+{
+	SBC_U64 x = *State;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*State = x;
+	return x;
+}
+
+// Uniform in [0, 1)
+static double Uniform(SBC_U64 *State)
+{
+	return (double)(XorShift64(State) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int CompareU64(const void *A, const void *B)
+{
+	SBC_U64 a = *(const SBC_U64 *)A;
+	SBC_U64 b = *(const SBC_U64 *)B;
+	return a < b ? -1 : a > b;
+}
+
+static void Simulate(const SIM_CONFIG *Config, SIM_RESULT *Result)
+{
+	SBC_U64 available[MAX_DEPTH];
+	SBC_U64 count = 0;
+	SBC_U64 seed = Config->Seed * 0x9e3779b97f4a7c15ull + Config->Rate * 31 + Config->Depth;
+	SBC_U64 period = 1000000000ull / Config->Rate;
+	SBC_U64 cpuFree = 0;
+	SBC_U64 t;
+	SBC_U32 i;
+
+	memset(Result, 0, sizeof(*Result));
+
+	// When each read is pending at the host controller again
+	for (i = 0; i < Config->Depth; ++i) available[i] = 0;
+
+	for (t = 0; t < Config->Duration; t += period)
+	{
+		SBC_U32 read = Config->Depth;
+		SBC_U64 start, end;
+
+		++Result->Polls;
+
+		for (i = 0; i < Config->Depth; ++i)
+		{
+			if (available[i] <= t && (read == Config->Depth || available[i] < available[read])) read = i;
+		}
+		if (read == Config->Depth)
+		{
+			++Result->Lost;
+			continue;
+		}
+
+		start = t > cpuFree ? t : cpuFree;
+		if (XorShift64(&seed) % 1000 < Config->StallPermille)
+		{
+			start += Config->Stall / 4 + (SBC_U64)(Uniform(&seed) * (double)(Config->Stall - Config->Stall / 4));
+		}
+		end = start + Config->Service + (SBC_U64)(-log(1.0 - Uniform(&seed)) * (double)Config->Jitter);
+		cpuFree = end;
+		available[read] = end + Config->Resubmit;
+
+		if (XorShift64(&seed) % 1000 < Config->ShortPermille)
+		{
+			++Result->Short;
+			continue;
+		}
+		latencies[count++] = end - t;
+	}
+
+	if (count != 0)
+	{
+		qsort(latencies, (size_t)count, sizeof(SBC_U64), CompareU64);
+		Result->P50 = latencies[(count - 1) / 2];
+		Result->P99 = latencies[(count * 99 + 99) / 100 - 1];
+		Result->Max = latencies[count - 1];
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const SBC_U32 rates[] = { 125, 250, 500, 1000, 2000, 4000, 8000 };
+	SIM_RESULT results[MAX_DEPTH][sizeof(rates) / sizeof(rates[0])];
+	SIM_CONFIG config;
+	SBC_U32 rate = 0, depth = 0;
+	SBC_U32 seconds = 60;
+	SBC_U32 r, q, r0, r1, q0, q1;
+	int opt;
+
+	memset(&config, 0, sizeof(config));
+	config.Service = 15000;
+	config.Jitter = 5000;
+	config.Resubmit = 10000;
+	config.StallPermille = 2;
+	config.Stall = 2000000;
+	config.Seed = 1;
+
+	while ((opt = getopt(argc, argv, "r:q:n:s:j:e:p:d:S:x:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r': rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'q': depth = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': seconds = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 's': config.Service = strtoull(optarg, NULL, 10) * 1000; break;
+		case 'j': config.Jitter = strtoull(optarg, NULL, 10) * 1000; break;
+		case 'e': config.Resubmit = strtoull(optarg, NULL, 10) * 1000; break;
+		case 'p': config.StallPermille = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'd': config.Stall = strtoull(optarg, NULL, 10) * 1000; break;
+		case 'S': config.ShortPermille = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'x': config.Seed = strtoull(optarg, NULL, 10); break;
+		default:
+			fprintf(stderr, "usage: %s [-r rate] [-q depth] [-n seconds] [-s service_us] [-j jitter_us] [-e resubmit_us] [-p stall_permille] [-d stall_us] [-S short_permille] [-x seed]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (depth > MAX_DEPTH) depth = MAX_DEPTH;
+	if (seconds == 0) seconds = 1;
+	config.Duration = (SBC_U64)seconds * 1000000000ull;
+
+	latencies = malloc(((size_t)seconds + 1) * (rate > 8000 ? rate : 8000) * sizeof(SBC_U64));
+	if (latencies == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	r0 = 0;
+	r1 = sizeof(rates) / sizeof(rates[0]);
+	q0 = depth != 0 ? depth - 1 : 0;
+	q1 = depth != 0 ? depth : MAX_DEPTH;
+
+	if (rate != 0)
+	{
+		SIM_RESULT result;
+
+		printf("depth     lost%%    short    p50 us    p99 us    max us\n");
+		for (q = q0; q < q1; ++q)
+		{
+			config.Rate = rate;
+			config.Depth = q + 1;
+			Simulate(&config, &result);
+			printf("%5u %9.4f %8llu %9.1f %9.1f %9.1f\n", q + 1,
+				100.0 * (double)result.Lost / (double)result.Polls,
+				(unsigned long long)result.Short,
+				(double)result.P50 / 1e3,
+				(double)result.P99 / 1e3,
+				(double)result.Max / 1e3);
+		}
+		free(latencies);
+		return 0;
+	}
+
+	for (q = q0; q < q1; ++q)
+	{
+		for (r = r0; r < r1; ++r)
+		{
+			config.Rate = rates[r];
+			config.Depth = q + 1;
+			Simulate(&config, &results[q][r]);
+		}
+	}
+
+	printf("Lost packets (%%), %u s per configuration\n\ndepth", seconds);
+	for (r = r0; r < r1; ++r) printf(" %7u Hz", rates[r]);
+	printf("\n");
+	for (q = q0; q < q1; ++q)
+	{
+		printf("%5u", q + 1);
+		for (r = r0; r < r1; ++r) printf(" %10.4f", 100.0 * (double)results[q][r].Lost / (double)results[q][r].Polls);
+		printf("\n");
+	}
+
+	printf("\np99 latency (us)\n\ndepth");
+	for (r = r0; r < r1; ++r) printf(" %7u Hz", rates[r]);
+	printf("\n");
+	for (q = q0; q < q1; ++q)
+	{
+		printf("%5u", q + 1);
+		for (r = r0; r < r1; ++r) printf(" %10.1f", (double)results[q][r].P99 / 1e3);
+		printf("\n");
+	}
+
+	free(latencies);
+	return 0;
+}
@@ -0,0 +1,183 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Cost of remapping the buttons of a translated report with the compiled
+// tables, against a loop over the 39 buttons and against translation only.
+// Reports are timed in batches of 32 as in sbcresponsebench.
+//
+// Usage: sbcremapbench [packets] [iterations]
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sbcremap.h"
+
+#define DEFAULT_PACKETS     4096
+#define DEFAULT_ITERATIONS  500
+#define BATCH               32
+
+typedef enum _REMAP_METHOD
+{
+	RemapNone = 0,
+	RemapTables,
+	RemapLoop
+} REMAP_METHOD;
+
+static SBC_U8 targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+static SBC_REMAP_TABLES tables;
+
+static SBC_U64 NowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+static SBC_U32 XorShift(SBC_U32 *State)
+{
+	SBC_U32 x = *State;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*State = x;
+	return x;
+}
+
+static int CompareU64(const void *A, const void *B)
+{
+	SBC_U64 a = *(const SBC_U64 *)A, b = *(const SBC_U64 *)B;
+	return a < b ? -1 : a > b;
+}
+
+static void RemapButtonsLoop(SBC_U8 *Report)
+{
+	SBC_U64 buttons = SbcLoadButtonMask(Report);
+	SBC_U64 mask = 0;
+	SBC_U32 button;
+
+	for (button = 0; button < SBC_BUTTON_COUNT; ++button)
+	{
+		if (buttons & (1ull << button)) mask |= SbcLoadButtonMask(targets[button]);
+	}
+	SbcStoreButtonMask(Report, mask);
+}
+
+static void Run(const char *Name, REMAP_METHOD Method, SBC_REPORT_MODE Mode, const SBC_U8 *Data, size_t Packets, size_t Iterations)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 checksum = 0;
+	SBC_U64 start, elapsed = 0;
+	SBC_U64 *batches;
+	size_t count = 0;
+	double total;
+	size_t i, j, k;
+
+	batches = malloc((Packets / BATCH) * Iterations * sizeof(SBC_U64));
+	if (batches == NULL) return;
+
+	for (j = 0; j < Iterations; ++j)
+	{
+		for (i = 0; i + BATCH <= Packets; i += BATCH)
+		{
+			SBC_U64 batch;
+
+			start = NowNs();
+			for (k = i; k < i + BATCH; ++k)
+			{
+				SbcBuildInputReport(Mode, Data + k * SBC_INPUT_PACKET_SIZE, report);
+				if (Method == RemapTables) SbcRemapButtons(&tables, report);
+				else if (Method == RemapLoop) RemapButtonsLoop(report);
+				checksum += report[0] ^ report[2] ^ report[4];
+			}
+			batch = NowNs() - start;
+
+			elapsed += batch;
+			batches[count++] = batch;
+		}
+	}
+
+	qsort(batches, count, sizeof(SBC_U64), CompareU64);
+
+	total = (double)(count * BATCH);
+	printf("%-24s %s  ns/report: %7.2f  p99: %7.2f  checksum: %08x\n",
+		Name, Mode == SbcReportMode16Bit ? "16 bit" : " 8 bit", (double)elapsed / total, (double)batches[count * 99 / 100] / BATCH, checksum);
+
+	free(batches);
+}
+
+static void RunAll(const char *Inputs, const SBC_U8 *Data, size_t Packets, size_t Iterations)
+{
+	int mode;
+
+	printf("%s\n", Inputs);
+	for (mode = SbcReportMode8Bit; mode <= SbcReportMode16Bit; ++mode)
+	{
+		SBC_REPORT_MODE m = (SBC_REPORT_MODE)mode;
+
+		Run("translation only", RemapNone, m, Data, Packets, Iterations);
+		Run("remap tables", RemapTables, m, Data, Packets, Iterations);
+		Run("remap loop", RemapLoop, m, Data, Packets, Iterations);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	size_t packets = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_PACKETS;
+	size_t iterations = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+	SBC_U8 *data;
+	SBC_U32 seed = 0x5bc0ffee;
+	SBC_U32 button;
+	size_t i;
+
+	if (packets < BATCH || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [packets, at least %d] [iterations]\n", argv[0], BATCH);
+		return 1;
+	}
+
+	data = malloc(packets * SBC_INPUT_PACKET_SIZE);
+	if (data == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	// A permutation with one button duplicated and one disabled
+	for (button = 0; button < SBC_BUTTON_COUNT; ++button)
+	{
+		SbcStoreButtonMask(targets[button], 1ull << ((button * 7) % SBC_BUTTON_COUNT));
+	}
+	SbcStoreButtonMask(targets[1], (1ull << 7) | (1ull << 38));
+	SbcStoreButtonMask(targets[2], 0);
+	SbcRemapCompile(&tables, targets);
+
+	// Random buttons, the loop mispredicts on about half of them
+	for (i = 0; i < packets * SBC_INPUT_PACKET_SIZE; ++i)
+	{
+		data[i] = (SBC_U8)XorShift(&seed);
+	}
+	RunAll("random buttons", data, packets, iterations);
+
+	// One button held, as in normal play
+	for (i = 0; i < packets; ++i)
+	{
+		SBC_U8 *p = data + i * SBC_INPUT_PACKET_SIZE;
+		SBC_U32 held = XorShift(&seed);
+
+		memset(p + SBC_OFFSET_BUTTONS0, 0, SBC_REPORT_BUTTON_BYTES);
+		p[SBC_OFFSET_BUTTONS0 + held % SBC_REPORT_BUTTON_BYTES] = (SBC_U8)(1u << ((held >> 8) & 7));
+	}
+	RunAll("one button held", data, packets, iterations);
+
+	free(data);
+	return 0;
+}
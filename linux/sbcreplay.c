@@ -0,0 +1,209 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Streams a capture file (see sys/sbccapture.h) through the same
+// translation path the read completion routine uses, so field captures can
+// be replayed without the controller.
+//
+// Usage: sbcreplay [-s] [-x speed] [-l loops] [-m 8|16] [-c] [-d deadband]
+//                  [-k keepalive_ms] [-v] capture.sbc
+//
+//   -s  Pace the records at their original timestamps. Without it the file
+//       is replayed as fast as possible.
+//   -x  Speed factor for -s (default 1.0)
+//   -l  Replay the file this many times (default 1)
+//   -m  Report mode (default 8)
+//   -c  Run the change-only filter on the reports
+//   -d  Deadband applied to every axis with -c, in report units (default 0)
+//   -k  Keep-alive in milliseconds with -c, 0 disables it (default 100)
+//   -v  Print every translated report
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbccapfile.h"
+
+static SBC_U64 NowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+static void SleepUntil(SBC_U64 Deadline)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t)(Deadline / 1000000000ull);
+	ts.tv_nsec = (long)(Deadline % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+static int CompareU64(const void *A, const void *B)
+{
+	SBC_U64 a = *(const SBC_U64 *)A;
+	SBC_U64 b = *(const SBC_U64 *)B;
+	return a < b ? -1 : a > b;
+}
+
+static void PrintReport(const SBC_CAPTURE_RECORD *Record, const SBC_U8 *Report, SBC_U32 Size)
+{
+	SBC_U32 i;
+
+	printf("%10u %14llu ", Record->Sequence, (unsigned long long)Record->Timestamp);
+	for (i = 0; i < Size; ++i) printf("%02x", Report[i]);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	SBC_CAPTURE_FILE file;
+	SBC_CHANGE_FILTER filter;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_REPORT_MODE mode = SbcReportMode8Bit;
+	SBC_U32 deadband = 0;
+	SBC_U32 keepAliveMs = 100;
+	SBC_U32 loops = 1;
+	double speed = 1.0;
+	int paced = 0;
+	int changeOnly = 0;
+	int verbose = 0;
+	SBC_U64 *lateness = NULL;
+	SBC_U64 zeroLength = 0, shortReads = 0, translated = 0, gaps = 0;
+	SBC_U64 start, elapsed, late = 0, processed = 0;
+	SBC_U64 loopTime = 0, filterTime = 0;
+	SBC_U32 loop;
+	size_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "sx:l:m:cd:k:v")) != -1)
+	{
+		switch (opt)
+		{
+		case 's': paced = 1; break;
+		case 'x': speed = atof(optarg); break;
+		case 'l': loops = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'm': mode = atoi(optarg) == 16 ? SbcReportMode16Bit : SbcReportMode8Bit; break;
+		case 'c': changeOnly = 1; break;
+		case 'd': deadband = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'k': keepAliveMs = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'v': verbose = 1; break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "usage: %s [-s] [-x speed] [-l loops] [-m 8|16] [-c] [-d deadband] [-k keepalive_ms] [-v] capture.sbc\n", argv[0]);
+		return 1;
+	}
+	if (speed <= 0.0) speed = 1.0;
+	if (loops == 0) loops = 1;
+
+	if (SbcCaptureFileOpen(&file, argv[optind]) != 0)
+	{
+		fprintf(stderr, "can't open %s: %s\n", argv[optind], errno == EINVAL ? "not a capture file" : strerror(errno));
+		return 1;
+	}
+
+	if (paced && file.Count > 0)
+	{
+		lateness = malloc(file.Count * loops * sizeof(SBC_U64));
+		if (lateness == NULL)
+		{
+			fprintf(stderr, "out of memory\n");
+			SbcCaptureFileClose(&file);
+			return 1;
+		}
+	}
+
+	SbcChangeFilterInit(&filter, mode);
+	filter.KeepAliveNs = (SBC_U64)keepAliveMs * 1000000;
+	for (i = 0; i < SbcAxisCount; ++i) filter.Deadband[i] = (SBC_U16)deadband;
+
+	start = NowNs();
+	for (loop = 0; loop < loops; ++loop)
+	{
+		SBC_U64 loopStart = NowNs();
+		SBC_U64 base = file.Count > 0 ? SbcCaptureFileRecord(&file, 0)->Timestamp : 0;
+		SBC_U64 offset = 0;
+
+		for (i = 0; i < file.Count; ++i)
+		{
+			const SBC_CAPTURE_RECORD *record = SbcCaptureFileRecord(&file, i);
+			SBC_U32 size;
+
+			if (i > 0 && record->Sequence != SbcCaptureFileRecord(&file, i - 1)->Sequence + 1 && loop == 0) ++gaps;
+
+			// Captures appended across device restarts go back in time
+			if (record->Timestamp >= base) offset = record->Timestamp - base;
+
+			// The filter sees one continuous timeline across the loops
+			filterTime = loopTime + offset;
+
+			if (paced)
+			{
+				SBC_U64 target = loopStart + (SBC_U64)((double)offset / speed);
+				SleepUntil(target);
+				lateness[processed] = NowNs() - target;
+				if (lateness[processed] > late) late = lateness[processed];
+				++processed;
+			}
+
+			if (record->Length == 0)
+			{
+				++zeroLength;
+				continue;
+			}
+			if (record->Length < SBC_INPUT_PACKET_SIZE)
+			{
+				++shortReads;
+				continue;
+			}
+
+			size = SbcBuildInputReport(mode, SbcCaptureRecordData(record), report);
+			++translated;
+
+			if (changeOnly && !SbcChangeFilterCheck(&filter, report, filterTime)) continue;
+			if (verbose) PrintReport(record, report, size);
+		}
+		loopTime = filterTime + 1;
+	}
+	elapsed = NowNs() - start;
+
+	printf("records:                %zu x %u\n", file.Count, loops);
+	printf("zero length:            %llu\n", (unsigned long long)zeroLength);
+	printf("short:                  %llu\n", (unsigned long long)shortReads);
+	printf("sequence gaps:          %llu\n", (unsigned long long)gaps);
+	printf("translated:             %llu\n", (unsigned long long)translated);
+	if (changeOnly)
+	{
+		printf("delivered:              %llu\n", (unsigned long long)filter.Passed);
+		printf("suppressed:             %llu\n", (unsigned long long)filter.Suppressed);
+	}
+	printf("elapsed:                %.3f ms\n", (double)elapsed / 1e6);
+	printf("records/sec:            %.0f\n", elapsed ? (double)file.Count * loops * 1e9 / (double)elapsed : 0.0);
+
+	if (paced && processed > 0)
+	{
+		qsort(lateness, (size_t)processed, sizeof(SBC_U64), CompareU64);
+		printf("lateness p50:           %.1f us\n", (double)lateness[processed / 2] / 1e3);
+		printf("lateness p99:           %.1f us\n", (double)lateness[(processed * 99) / 100] / 1e3);
+		printf("lateness max:           %.1f us\n", (double)late / 1e3);
+	}
+
+	free(lateness);
+	SbcCaptureFileClose(&file);
+	return 0;
+}
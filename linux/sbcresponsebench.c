@@ -0,0 +1,229 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Cost of the response curves on top of the translation, per report like
+// the read completion routine. Every configuration is run on random packets
+// and on packets that take the longest path through it: every axis at full
+// deflection, past the deadzones, in the last piecewise segment and with
+// both radial pairs outside their circle. Reports are timed in batches of
+// 32; the 99th percentile batch bounds the cost of a single report without
+// counting the times the benchmark was preempted.
+//
+// Usage: sbcresponsebench [packets] [iterations]
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sbcresponse.h"
+
+#define DEFAULT_PACKETS     4096
+#define DEFAULT_ITERATIONS  500
+#define BATCH               32
+
+static SBC_U64 NowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+static SBC_U32 XorShift(SBC_U32 *State)
+{
+	SBC_U32 x = *State;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*State = x;
+	return x;
+}
+
+static int CompareU64(const void *A, const void *B)
+{
+	SBC_U64 a = *(const SBC_U64 *)A, b = *(const SBC_U64 *)B;
+	return a < b ? -1 : a > b;
+}
+
+static void AllAxes(SBC_RESPONSE_SETTINGS *Settings, SBC_U8 Type, SBC_U16 Strength)
+{
+	static const SBC_U16 x[SBC_RESPONSE_MAX_POINTS] = { 6000, 15000, 26000, 38000, 50000, 60000 };
+	static const SBC_U16 y[SBC_RESPONSE_MAX_POINTS] = { 1000, 6000, 16000, 30000, 47000, 58000 };
+	SBC_U32 axis;
+
+	memset(Settings, 0, sizeof(*Settings));
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		SBC_AXIS_RESPONSE_SETTINGS *a = &Settings->Axes[axis];
+		a->Type = Type;
+		a->Strength = Strength;
+		a->Deadzone = 2000;
+		a->Saturation = 63000;
+		if (Type == SBC_RESPONSE_PIECEWISE)
+		{
+			a->PointCount = SBC_RESPONSE_MAX_POINTS;
+			memcpy(a->PointX, x, sizeof(x));
+			memcpy(a->PointY, y, sizeof(y));
+		}
+	}
+}
+
+static void Radial(SBC_RESPONSE_SETTINGS *Settings)
+{
+	SBC_U32 pair;
+	for (pair = 0; pair < SbcResponsePairCount; ++pair)
+	{
+		Settings->RadialDeadzone[pair] = 3000;
+		Settings->RadialSaturation[pair] = 62000;
+	}
+}
+
+static void Run
+(
+	const char *Name,
+	const SBC_RESPONSE_SETTINGS *Settings,
+	SBC_REPORT_MODE Mode,
+	const SBC_U8 *Data,
+	size_t Packets,
+	size_t Iterations
+)
+{
+	SBC_RESPONSE response;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 checksum = 0;
+	SBC_U64 start, elapsed = 0;
+	SBC_U64 *batches;
+	size_t count = 0;
+	double total;
+	size_t i, j, k;
+
+	if (!SbcResponseValidate(Settings))
+	{
+		printf("%s: invalid settings\n", Name);
+		return;
+	}
+	SbcResponsePrepare(&response, Settings);
+
+	batches = malloc((Packets / BATCH) * Iterations * sizeof(SBC_U64));
+	if (batches == NULL) return;
+
+	for (j = 0; j < Iterations; ++j)
+	{
+		for (i = 0; i + BATCH <= Packets; i += BATCH)
+		{
+			SBC_U64 batch;
+
+			start = NowNs();
+			for (k = i; k < i + BATCH; ++k)
+			{
+				SBC_U32 size = SbcBuildInputReport(Mode, Data + k * SBC_INPUT_PACKET_SIZE, report);
+				SbcResponseApplyReport(&response, Mode, report);
+				checksum += report[5] ^ report[size - 3];
+			}
+			batch = NowNs() - start;
+
+			elapsed += batch;
+			batches[count++] = batch;
+		}
+	}
+
+	qsort(batches, count, sizeof(SBC_U64), CompareU64);
+
+	total = (double)(count * BATCH);
+	printf("%-24s %s  ns/report: %7.2f  p99: %7.2f  checksum: %08x\n",
+		Name, Mode == SbcReportMode16Bit ? "16 bit" : " 8 bit", (double)elapsed / total, (double)batches[count * 99 / 100] / BATCH, checksum);
+
+	free(batches);
+}
+
+static void RunAll(const char *Inputs, const SBC_U8 *Data, size_t Packets, size_t Iterations)
+{
+	SBC_RESPONSE_SETTINGS settings;
+	int mode;
+
+	printf("%s\n", Inputs);
+	for (mode = SbcReportMode8Bit; mode <= SbcReportMode16Bit; ++mode)
+	{
+		SBC_REPORT_MODE m = (SBC_REPORT_MODE)mode;
+
+		memset(&settings, 0, sizeof(settings));
+		Run("off (translation only)", &settings, m, Data, Packets, Iterations);
+
+		AllAxes(&settings, SBC_RESPONSE_LINEAR, 0);
+		Run("axial deadzones", &settings, m, Data, Packets, Iterations);
+
+		AllAxes(&settings, SBC_RESPONSE_EXPONENTIAL, 3 * 256);
+		Run("exponential", &settings, m, Data, Packets, Iterations);
+
+		AllAxes(&settings, SBC_RESPONSE_SCURVE, 50000);
+		Run("s-curve", &settings, m, Data, Packets, Iterations);
+
+		AllAxes(&settings, SBC_RESPONSE_PIECEWISE, 0);
+		Run("piecewise, 6 points", &settings, m, Data, Packets, Iterations);
+
+		AllAxes(&settings, SBC_RESPONSE_PIECEWISE, 0);
+		Radial(&settings);
+		Run("radial + piecewise", &settings, m, Data, Packets, Iterations);
+
+		AllAxes(&settings, SBC_RESPONSE_EXPONENTIAL, 8 * 256);
+		Radial(&settings);
+		Run("radial + exponential", &settings, m, Data, Packets, Iterations);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	size_t packets = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_PACKETS;
+	size_t iterations = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+	SBC_U8 *data;
+	SBC_U32 seed = 0x5bc0ffee;
+	size_t i;
+
+	if (packets < BATCH || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [packets, at least %d] [iterations]\n", argv[0], BATCH);
+		return 1;
+	}
+
+	data = malloc(packets * SBC_INPUT_PACKET_SIZE);
+	if (data == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < packets * SBC_INPUT_PACKET_SIZE; ++i)
+	{
+		data[i] = (SBC_U8)XorShift(&seed);
+	}
+	RunAll("random packets", data, packets, iterations);
+
+	// Full deflection in alternating directions: unsigned axes at 0xFFxx or
+	// 0x00xx, signed ones at 0x7Fxx or 0x80xx, pedals pressed all the way
+	for (i = 0; i < packets; ++i)
+	{
+		SBC_U8 *p = data + i * SBC_INPUT_PACKET_SIZE;
+		SBC_U8 high = (i & 1) ? 0xFF : 0x00;
+		SBC_U8 signedHigh = (i & 2) ? 0x7F : 0x80;
+
+		p[SBC_OFFSET_AIMX + 1] = high;
+		p[SBC_OFFSET_AIMY + 1] = (SBC_U8)~high;
+		p[SBC_OFFSET_ROTATION + 1] = signedHigh;
+		p[SBC_OFFSET_SIGHTX + 1] = signedHigh;
+		p[SBC_OFFSET_SIGHTY + 1] = (SBC_U8)(signedHigh ^ 0xFF);
+		p[SBC_OFFSET_CLUTCH + 1] = 0xFF;
+		p[SBC_OFFSET_BRAKE + 1] = 0xFF;
+		p[SBC_OFFSET_THROTTLE + 1] = 0xFF;
+	}
+	RunAll("longest path packets", data, packets, iterations);
+
+	free(data);
+	return 0;
+}
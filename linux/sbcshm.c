@@ -0,0 +1,115 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sbcshm.h"
+
+static void *ShmCreate(const char *Name, size_t Size)
+{
+	void *map;
+	int fd;
+
+	fd = shm_open(Name, O_CREAT | O_RDWR, 0644);
+	if (fd < 0) return NULL;
+
+	if (ftruncate(fd, (off_t)Size) != 0)
+	{
+		int error = errno;
+		close(fd);
+		errno = error;
+		return NULL;
+	}
+
+	map = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return map == MAP_FAILED ? NULL : map;
+}
+
+static const void *ShmOpen(const char *Name, size_t Size)
+{
+	void *map;
+	struct stat st;
+	int fd;
+
+	fd = shm_open(Name, O_RDONLY, 0);
+	if (fd < 0) return NULL;
+
+	// A writer that has only just created it may not have sized it yet
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)Size)
+	{
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	map = mmap(NULL, Size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	return map == MAP_FAILED ? NULL : map;
+}
+
+SBC_STATE_SNAPSHOT *SbcShmCreate(const char *Name)
+{
+	SBC_STATE_SNAPSHOT *snapshot = ShmCreate(Name, sizeof(SBC_STATE_SNAPSHOT));
+
+	if (snapshot != NULL) SbcSnapshotInit(snapshot);
+	return snapshot;
+}
+
+const SBC_STATE_SNAPSHOT *SbcShmOpen(const char *Name)
+{
+	const SBC_STATE_SNAPSHOT *snapshot = ShmOpen(Name, sizeof(SBC_STATE_SNAPSHOT));
+
+	if (snapshot != NULL && !SbcSnapshotValid(snapshot))
+	{
+		SbcShmClose(snapshot);
+		errno = EINVAL;
+		return NULL;
+	}
+	return snapshot;
+}
+
+void SbcShmClose(const SBC_STATE_SNAPSHOT *Snapshot)
+{
+	if (Snapshot != NULL) munmap((void *)Snapshot, sizeof(SBC_STATE_SNAPSHOT));
+}
+
+SBC_EVENT_RING *SbcShmCreateEvents(const char *Name)
+{
+	SBC_EVENT_RING *ring = ShmCreate(Name, sizeof(SBC_EVENT_RING));
+
+	if (ring != NULL) SbcEventRingInit(ring);
+	return ring;
+}
+
+const SBC_EVENT_RING *SbcShmOpenEvents(const char *Name)
+{
+	const SBC_EVENT_RING *ring = ShmOpen(Name, sizeof(SBC_EVENT_RING));
+
+	if (ring != NULL && !SbcEventRingValid(ring))
+	{
+		SbcShmCloseEvents(ring);
+		errno = EINVAL;
+		return NULL;
+	}
+	return ring;
+}
+
+void SbcShmCloseEvents(const SBC_EVENT_RING *Ring)
+{
+	if (Ring != NULL) munmap((void *)Ring, sizeof(SBC_EVENT_RING));
+}
+
+int SbcShmRemove(const char *Name)
+{
+	return shm_unlink(Name);
+}
@@ -0,0 +1,49 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCSHM_H_
+#define _SBCSHM_H_
+
+//
+// The published state of the controller (see sys/sbcsnapshot.h) in a POSIX
+// shared memory object. sbcd -S creates it and is the only writer, any
+// number of processes map it read only and copy the state without locks
+// and without talking to the daemon. The button event ring (see
+// sys/sbcevents.h) is shared the same way by sbcd -E.
+//
+
+#include "sbcevents.h"
+#include "sbcsnapshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default object names, /dev/shm/sbc-state and /dev/shm/sbc-events
+#define SBC_SHM_DEFAULT_NAME    "/sbc-state"
+#define SBC_SHM_EVENTS_NAME     "/sbc-events"
+
+// Writer side. Creates or replaces the object. NULL on failure, errno set.
+SBC_STATE_SNAPSHOT *SbcShmCreate(const char *Name);
+
+// Reader side. NULL on failure, errno set, EINVAL if it isn't a snapshot.
+const SBC_STATE_SNAPSHOT *SbcShmOpen(const char *Name);
+
+void SbcShmClose(const SBC_STATE_SNAPSHOT *Snapshot);
+
+// Same for the button event ring, EINVAL if it isn't one
+SBC_EVENT_RING *SbcShmCreateEvents(const char *Name);
+const SBC_EVENT_RING *SbcShmOpenEvents(const char *Name);
+void SbcShmCloseEvents(const SBC_EVENT_RING *Ring);
+
+// Writer side, once it stops publishing
+int SbcShmRemove(const char *Name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCSHM_H_
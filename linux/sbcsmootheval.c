@@ -0,0 +1,385 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Evaluates the axis smoothing (see sys/sbcsmooth.h) on a capture file or
+// on a synthetic session, to choose the AxisSmoothing settings. For every
+// filtered axis it reports, against the unfiltered stream:
+//
+//   - jitter at rest: RMS of the change between packets and how often the
+//     8 bit report value changes, while the axis stays within the rest
+//     span over the last 16 packets
+//   - lag while moving: the delay that best lines the filtered axis up with
+//     the unfiltered one, from the squared error at whole packet delays
+//     refined with a parabola, and the p99 error once realigned
+//
+// Usage: sbcsmootheval [-c cutoff_hz] [-b beta] [-d dcutoff_hz]
+//                      [-s axis=cutoff,beta[,dcutoff]] [-t rest]
+//                      [-r rate] [-n packets] [-w settings.bin] [capture.sbc]
+//
+//   -c  Cutoff at rest of every axis in Hz (default 1.0)
+//   -b  Cutoff increase in Hz per full travel per second (default 20)
+//   -d  Cutoff of the speed estimate in Hz (default 1.0)
+//   -s  Settings of one axis by name (e.g. AimX=0.8,2), repeatable. With
+//       any -s only the axes given are filtered.
+//   -t  Rest span in raw units (default 1024, 4 report units)
+//   -r  Packet rate of the synthetic session (default 250)
+//   -n  Number of synthetic packets (default 60 seconds worth)
+//   -w  Write the settings, as stored in the AxisSmoothing registry value
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "sbccapfile.h"
+#include "sbcsmooth.h"
+#include "sbcsynth.h"
+
+#define REST_WINDOW     (16)
+#define MAX_LAG         (64)
+
+#define AXIS_NAME(Name, Offset, Signed, Page, Usage)   #Name,
+
+static const char *AxisNames[SbcAxisCount] = { SBC_LAYOUT_AXES(AXIS_NAME) };
+
+typedef struct _STREAM
+{
+	size_t Count;
+	SBC_U64 *Time;
+	SBC_U16 *Raw[SbcAxisCount];
+	SBC_U16 *Filtered[SbcAxisCount];
+} STREAM;
+
+static int Allocate(STREAM *Stream, size_t Count)
+{
+	SBC_U32 axis;
+
+	memset(Stream, 0, sizeof(*Stream));
+	Stream->Time = malloc(Count * sizeof(SBC_U64));
+	if (Stream->Time == NULL) return 0;
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		Stream->Raw[axis] = malloc(Count * sizeof(SBC_U16));
+		Stream->Filtered[axis] = malloc(Count * sizeof(SBC_U16));
+		if (Stream->Raw[axis] == NULL || Stream->Filtered[axis] == NULL) return 0;
+	}
+	return 1;
+}
+
+static void Free(STREAM *Stream)
+{
+	SBC_U32 axis;
+
+	free(Stream->Time);
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		free(Stream->Raw[axis]);
+		free(Stream->Filtered[axis]);
+	}
+}
+
+static void Add(STREAM *Stream, SBC_SMOOTH *Smooth, const SBC_U8 *Data, SBC_U64 Time)
+{
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	size_t i = Stream->Count++;
+	SBC_U32 axis;
+
+	memcpy(packet, Data, SBC_INPUT_PACKET_SIZE);
+	SbcSmoothPacket(Smooth, packet, Time);
+
+	Stream->Time[i] = Time;
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		Stream->Raw[axis][i] = (SBC_U16)SbcSmoothLoadAxis(Data, axis);
+		Stream->Filtered[axis][i] = (SBC_U16)SbcSmoothLoadAxis(packet, axis);
+	}
+}
+
+static int CompareDouble(const void *A, const void *B)
+{
+	double a = *(const double *)A;
+	double b = *(const double *)B;
+	return a < b ? -1 : a > b;
+}
+
+//
+// Whether the unfiltered axis spans less than Rest over the last packets
+//
+static int AtRest(const SBC_U16 *Raw, size_t Index, SBC_U32 Rest)
+{
+	SBC_U32 lo = Raw[Index], hi = Raw[Index];
+	size_t i;
+
+	if (Index < REST_WINDOW) return 0;
+	for (i = Index - REST_WINDOW; i < Index; ++i)
+	{
+		if (Raw[i] < lo) lo = Raw[i];
+		if (Raw[i] > hi) hi = Raw[i];
+	}
+	return hi - lo <= Rest;
+}
+
+static void Evaluate(const STREAM *Stream, SBC_U32 Axis, SBC_U32 Rest)
+{
+	const SBC_U16 *raw = Stream->Raw[Axis];
+	const SBC_U16 *filtered = Stream->Filtered[Axis];
+	double rawSquares = 0.0, filteredSquares = 0.0;
+	double error[MAX_LAG + 1];
+	SBC_U64 restTime = 0;
+	size_t rest = 0, moving = 0, rawChanges = 0, filteredChanges = 0;
+	size_t counted[MAX_LAG + 1];
+	double lag = 0.0, interval, p99 = 0.0;
+	double *errors;
+	size_t i, best = 0;
+	SBC_U32 d;
+
+	interval = Stream->Count > 1 ? (double)(Stream->Time[Stream->Count - 1] - Stream->Time[0]) / (double)(Stream->Count - 1) : 0.0;
+	memset(error, 0, sizeof(error));
+	memset(counted, 0, sizeof(counted));
+
+	// The first packets have no history to tell
+	for (i = REST_WINDOW; i < Stream->Count; ++i)
+	{
+		if (AtRest(raw, i, Rest))
+		{
+			double r = ((double)raw[i] - (double)raw[i - 1]) / 256.0;
+			double f = ((double)filtered[i] - (double)filtered[i - 1]) / 256.0;
+
+			rawSquares += r * r;
+			filteredSquares += f * f;
+			if ((raw[i] >> 8) != (raw[i - 1] >> 8)) ++rawChanges;
+			if ((filtered[i] >> 8) != (filtered[i - 1] >> 8)) ++filteredChanges;
+			restTime += Stream->Time[i] - Stream->Time[i - 1];
+			++rest;
+			continue;
+		}
+
+		++moving;
+		for (d = 0; d <= MAX_LAG && d <= i; ++d)
+		{
+			double e = (double)filtered[i] - (double)raw[i - d];
+			error[d] += e * e;
+			++counted[d];
+		}
+	}
+
+	if (moving > 0)
+	{
+		for (d = 0; d <= MAX_LAG; ++d)
+		{
+			if (counted[d] == 0) break;
+			error[d] /= (double)counted[d];
+			if (error[d] < error[best]) best = d;
+		}
+
+		// Parabola through the best delay and its neighbours
+		lag = (double)best;
+		if (best > 0 && best < MAX_LAG && counted[best + 1] != 0)
+		{
+			double denominator = error[best - 1] - 2.0 * error[best] + error[best + 1];
+			if (denominator > 0.0) lag += 0.5 * (error[best - 1] - error[best + 1]) / denominator;
+		}
+
+		// Error left once realigned, in report units
+		errors = malloc(moving * sizeof(double));
+		if (errors != NULL)
+		{
+			size_t n = 0;
+			for (i = REST_WINDOW; i < Stream->Count; ++i)
+			{
+				if (i < best || AtRest(raw, i, Rest)) continue;
+				errors[n++] = fabs((double)filtered[i] - (double)raw[i - best]) / 256.0;
+			}
+			if (n > 0)
+			{
+				qsort(errors, n, sizeof(double), CompareDouble);
+				p99 = errors[(n - 1) * 99 / 100];
+			}
+			free(errors);
+		}
+	}
+
+	printf("%-9s %7zu %8.3f %8.3f %6.1f%% %8.1f %8.1f %7zu %8.2f %8.2f\n",
+		AxisNames[Axis], rest,
+		rest ? sqrt(rawSquares / (double)rest) : 0.0,
+		rest ? sqrt(filteredSquares / (double)rest) : 0.0,
+		rawSquares > 0.0 ? 100.0 * (1.0 - sqrt(filteredSquares / rawSquares)) : 0.0,
+		restTime ? (double)rawChanges * 1e9 / (double)restTime : 0.0,
+		restTime ? (double)filteredChanges * 1e9 / (double)restTime : 0.0,
+		moving, lag * interval / 1e6, p99);
+}
+
+// Settings are stored in 1/100 Hz in 16 bits
+static int ValidCutoffs(double Cutoff, double Beta, double DerivativeCutoff)
+{
+	return Cutoff > 0.0 && Cutoff <= 655.0 && Beta >= 0.0 && Beta <= 655.0 && DerivativeCutoff >= 0.0 && DerivativeCutoff <= 655.0;
+}
+
+static int ParseAxis(const char *Arg, SBC_SMOOTH_SETTINGS *Settings)
+{
+	const char *equals = strchr(Arg, '=');
+	double cutoff, beta, dcutoff = 0.0;
+	SBC_U32 axis;
+	int fields;
+
+	if (equals == NULL) return 0;
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		if (strlen(AxisNames[axis]) == (size_t)(equals - Arg) && strncasecmp(Arg, AxisNames[axis], (size_t)(equals - Arg)) == 0) break;
+	}
+	if (axis == SbcAxisCount) return 0;
+
+	fields = sscanf(equals + 1, "%lf,%lf,%lf", &cutoff, &beta, &dcutoff);
+	if (fields < 2 || !ValidCutoffs(cutoff, beta, dcutoff)) return 0;
+
+	Settings->Axes[axis].MinCutoff = (SBC_U16)(cutoff * 100.0 + 0.5);
+	Settings->Axes[axis].Beta = (SBC_U16)(beta * 100.0 + 0.5);
+	Settings->Axes[axis].DerivativeCutoff = (SBC_U16)(dcutoff * 100.0 + 0.5);
+	return 1;
+}
+
+static void Usage(const char *Name)
+{
+	fprintf(stderr, "usage: %s [-c cutoff_hz] [-b beta] [-d dcutoff_hz] [-s axis=cutoff,beta[,dcutoff]] [-t rest]\n"
+		"       [-r rate] [-n packets] [-w settings.bin] [capture.sbc]\n", Name);
+}
+
+int main(int argc, char **argv)
+{
+	SBC_SMOOTH_SETTINGS settings, perAxis;
+	SBC_SMOOTH smooth;
+	SBC_CAPTURE_FILE file;
+	STREAM stream;
+	const char *output = NULL;
+	double cutoff = 1.0, beta = 20.0, dcutoff = 1.0;
+	SBC_U32 rest = 1024;
+	SBC_U32 rate = 250;
+	size_t packets = 0;
+	int haveAxes = 0;
+	SBC_U32 axis;
+	size_t i;
+	int opt;
+
+	memset(&perAxis, 0, sizeof(perAxis));
+	while ((opt = getopt(argc, argv, "c:b:d:s:t:r:n:w:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c': cutoff = atof(optarg); break;
+		case 'b': beta = atof(optarg); break;
+		case 'd': dcutoff = atof(optarg); break;
+		case 's':
+			if (!ParseAxis(optarg, &perAxis))
+			{
+				fprintf(stderr, "bad axis settings %s\n", optarg);
+				return 1;
+			}
+			haveAxes = 1;
+			break;
+		case 't': rest = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'r': rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': packets = (size_t)strtoul(optarg, NULL, 10); break;
+		case 'w': output = optarg; break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc - 1 || !ValidCutoffs(cutoff, beta, dcutoff))
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+	if (rate == 0) rate = 250;
+
+	if (haveAxes)
+	{
+		settings = perAxis;
+	}
+	else
+	{
+		memset(&settings, 0, sizeof(settings));
+		for (axis = 0; axis < SbcAxisCount; ++axis)
+		{
+			settings.Axes[axis].MinCutoff = (SBC_U16)(cutoff * 100.0 + 0.5);
+			settings.Axes[axis].Beta = (SBC_U16)(beta * 100.0 + 0.5);
+			settings.Axes[axis].DerivativeCutoff = (SBC_U16)(dcutoff * 100.0 + 0.5);
+		}
+	}
+	SbcSmoothPrepare(&smooth, &settings);
+
+	if (output != NULL)
+	{
+		FILE *f = fopen(output, "wb");
+		if (f == NULL || fwrite(&settings, sizeof(settings), 1, f) != 1)
+		{
+			perror(output);
+			if (f != NULL) fclose(f);
+			return 1;
+		}
+		fclose(f);
+	}
+
+	if (optind == argc - 1)
+	{
+		if (SbcCaptureFileOpen(&file, argv[optind]) != 0)
+		{
+			fprintf(stderr, "can't open %s: %s\n", argv[optind], errno == EINVAL ? "not a capture file" : strerror(errno));
+			return 1;
+		}
+		if (!Allocate(&stream, file.Count > 0 ? file.Count : 1))
+		{
+			fprintf(stderr, "out of memory\n");
+			SbcCaptureFileClose(&file);
+			return 1;
+		}
+		for (i = 0; i < file.Count; ++i)
+		{
+			const SBC_CAPTURE_RECORD *record = SbcCaptureFileRecord(&file, i);
+			if (record->Length < SBC_INPUT_PACKET_SIZE) continue;
+			Add(&stream, &smooth, SbcCaptureRecordData(record), record->Timestamp);
+		}
+		SbcCaptureFileClose(&file);
+	}
+	else
+	{
+		SBC_SYNTH synth;
+		SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+
+		if (packets == 0) packets = 60 * (size_t)rate;
+		if (!Allocate(&stream, packets))
+		{
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		SbcSynthInit(&synth, rate, 0x1234567);
+		for (i = 0; i < packets; ++i)
+		{
+			SbcSynthNext(&synth, packet);
+			Add(&stream, &smooth, packet, (SBC_U64)i * 1000000000ull / rate);
+		}
+	}
+
+	printf("packets:  %zu, rest span %u raw units\n", stream.Count, rest);
+	printf("%-9s %7s %8s %8s %7s %8s %8s %7s %8s %8s\n", "", "rest", "jitter", "jitter", "", "changes", "changes", "moving", "lag", "p99");
+	printf("%-9s %7s %8s %8s %7s %8s %8s %7s %8s %8s\n", "axis", "packets", "raw", "smooth", "less", "raw/s", "smooth/s", "packets", "ms", "error");
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		if (!(smooth.EnabledMask & (1u << axis))) continue;
+		Evaluate(&stream, axis, rest);
+	}
+	printf("jitter and error in 8 bit report units\n");
+
+	Free(&stream);
+	return 0;
+}
@@ -0,0 +1,232 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Reader scaling of the published state (see sys/sbcsnapshot.h) against the
+// same state behind a spin lock, like the report cache behind StateLock.
+//
+// A writer thread publishes translated reports at the packet rate of the
+// controller or as fast as it can, and 1, 2, 4... reader threads up to the
+// number of processors copy the state in a loop. Every copy is checked, a
+// torn one fails the run. For each number of readers the total and per
+// reader copies per second are printed, with the copies the sequence lock
+// had to retry. Readers of a sequence lock only read the shared cache line,
+// so they should scale with the processors, where the spin lock has every
+// reader write the lock's line.
+//
+// Usage: sbcsnapshotbench [-t readers] [-n seconds] [-r rate]
+//
+//   -t  Most reader threads (default the number of processors)
+//   -n  Seconds per run (default 1)
+//   -r  Writer rate in Hz, 0 for as fast as possible (default 1000)
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbcsnapshot.h"
+
+#define MAX_READERS     64
+#define BATCH           256
+
+typedef struct _SHARED
+{
+	SBC_STATE_SNAPSHOT Snapshot;
+	SBC_U8 Pad[64];             // Keeps the lock off the line of the snapshot
+
+	// The spin lock variant
+	pthread_spinlock_t Lock;
+	SBC_SNAPSHOT_STATE Locked;
+
+	int UseLock;
+	SBC_U32 Rate;
+	volatile int Stop;
+} SHARED;
+
+typedef struct _READER
+{
+	SHARED *Shared;
+	pthread_t Thread;
+	SBC_U64 Reads;
+	SBC_U64 Retries;
+	SBC_U64 Torn;
+	SBC_U8 Pad[64];             // Readers don't share lines
+} READER;
+
+static void MakeReport(SBC_U64 Sequence, SBC_U8 *Report)
+{
+	SBC_U32 i;
+
+	for (i = 0; i < SBC_MAX_INPUT_REPORT_SIZE; ++i) Report[i] = (SBC_U8)(Sequence * 131 + i * 7);
+}
+
+static int Consistent(const SBC_SNAPSHOT_STATE *State)
+{
+	SBC_U8 expected[SBC_MAX_INPUT_REPORT_SIZE];
+
+	if (State->Size == 0) return 1;
+	MakeReport(State->Timestamp, expected);
+	return State->Published == State->Timestamp + 1 && memcmp(State->Report, expected, State->Size) == 0;
+}
+
+static void *Writer(void *Context)
+{
+	SHARED *shared = Context;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	struct timespec next;
+	SBC_U64 i;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (i = 0; !__atomic_load_n(&shared->Stop, __ATOMIC_RELAXED); ++i)
+	{
+		MakeReport(i, report);
+		if (shared->UseLock)
+		{
+			pthread_spin_lock(&shared->Lock);
+			shared->Locked.Timestamp = i;
+			shared->Locked.Published = i + 1;
+			shared->Locked.Size = sizeof(report);
+			memcpy(shared->Locked.Report, report, sizeof(report));
+			pthread_spin_unlock(&shared->Lock);
+		}
+		else
+		{
+			SbcSnapshotPublish(&shared->Snapshot, SbcReportMode16Bit, report, sizeof(report), i);
+		}
+
+		if (shared->Rate != 0)
+		{
+			next.tv_nsec += 1000000000 / shared->Rate;
+			if (next.tv_nsec >= 1000000000)
+			{
+				next.tv_nsec -= 1000000000;
+				++next.tv_sec;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	}
+	return NULL;
+}
+
+static void *Reader(void *Context)
+{
+	READER *reader = Context;
+	SHARED *shared = reader->Shared;
+	SBC_SNAPSHOT_STATE state;
+	SBC_U32 i;
+
+	while (!__atomic_load_n(&shared->Stop, __ATOMIC_RELAXED))
+	{
+		for (i = 0; i < BATCH; ++i)
+		{
+			if (shared->UseLock)
+			{
+				pthread_spin_lock(&shared->Lock);
+				state = shared->Locked;
+				pthread_spin_unlock(&shared->Lock);
+			}
+			else
+			{
+				reader->Retries += SbcSnapshotRead(&shared->Snapshot, &state);
+			}
+			if (!Consistent(&state)) ++reader->Torn;
+		}
+		reader->Reads += BATCH;
+	}
+	return NULL;
+}
+
+static SBC_U64 Run(SHARED *Shared, SBC_U32 Readers, SBC_U32 Seconds, int UseLock)
+{
+	static READER readers[MAX_READERS];
+	struct timespec duration;
+	pthread_t writer;
+	SBC_U64 reads = 0, retries = 0, torn = 0;
+	SBC_U32 i;
+
+	SbcSnapshotInit(&Shared->Snapshot);
+	memset(&Shared->Locked, 0, sizeof(Shared->Locked));
+	Shared->UseLock = UseLock;
+	Shared->Stop = 0;
+	memset(readers, 0, sizeof(readers));
+
+	pthread_create(&writer, NULL, Writer, Shared);
+	for (i = 0; i < Readers; ++i)
+	{
+		readers[i].Shared = Shared;
+		pthread_create(&readers[i].Thread, NULL, Reader, &readers[i]);
+	}
+
+	duration.tv_sec = Seconds;
+	duration.tv_nsec = 0;
+	nanosleep(&duration, NULL);
+	__atomic_store_n(&Shared->Stop, 1, __ATOMIC_RELAXED);
+
+	pthread_join(writer, NULL);
+	for (i = 0; i < Readers; ++i)
+	{
+		pthread_join(readers[i].Thread, NULL);
+		reads += readers[i].Reads;
+		retries += readers[i].Retries;
+		torn += readers[i].Torn;
+	}
+
+	printf("%-8s %7u %14.2f %14.2f %12llu %8llu\n", UseLock ? "spinlock" : "seqlock", Readers,
+		(double)reads / Seconds / 1e6, (double)reads / Seconds / Readers / 1e6,
+		(unsigned long long)retries, (unsigned long long)torn);
+	return torn;
+}
+
+int main(int argc, char **argv)
+{
+	static SHARED shared;
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	SBC_U32 maxReaders = processors > 0 ? (SBC_U32)processors : 1;
+	SBC_U32 seconds = 1, readers;
+	SBC_U64 torn = 0;
+	int opt;
+
+	shared.Rate = 1000;
+
+	while ((opt = getopt(argc, argv, "t:n:r:")) != -1)
+	{
+		switch (opt)
+		{
+		case 't': maxReaders = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': seconds = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'r': shared.Rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		default:
+			fprintf(stderr, "usage: %s [-t readers] [-n seconds] [-r rate]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (maxReaders == 0 || maxReaders > MAX_READERS || seconds == 0)
+	{
+		fprintf(stderr, "usage: %s [-t readers] [-n seconds] [-r rate]\n", argv[0]);
+		return 1;
+	}
+
+	pthread_spin_init(&shared.Lock, PTHREAD_PROCESS_PRIVATE);
+
+	printf("%ld processors, writer at %s\n", processors, shared.Rate != 0 ? "a fixed rate" : "full speed");
+	printf("%-8s %7s %14s %14s %12s %8s\n", "", "readers", "M reads/s", "M/s/reader", "retries", "torn");
+	for (readers = 1; ; readers *= 2)
+	{
+		if (readers > maxReaders) readers = maxReaders;
+		torn += Run(&shared, readers, seconds, 0);
+		torn += Run(&shared, readers, seconds, 1);
+		if (readers == maxReaders) break;
+	}
+
+	pthread_spin_destroy(&shared.Lock);
+	return torn != 0 ? 1 : 0;
+}
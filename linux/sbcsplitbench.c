@@ -0,0 +1,366 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// What the split reports (see sys/sbcsplit.h) save. Replays a capture file
+// or a synthetic session through the translation and, with -c, the
+// change-only filter, then delivers every report twice: as the single
+// input report and as the parts that changed, with a read always pending
+// like hidclass keeps one. For each the reports, the bytes including the
+// report IDs and the fields a consumer parses are counted, and both the
+// delivery and a consumer that decodes every report into its own copy of
+// the state (what HidP_GetUsages and HidP_GetUsageValue do) are timed. The
+// two copies must end up the same.
+//
+// Usage: sbcsplitbench [-f capture.sbc] [-r rate] [-n packets] [-m 8|16]
+//                      [-c] [-d deadband] [-k keepalive_ms] [-l loops]
+//
+//   -f  Capture file to replay. Without it a synthetic session is
+//       generated (see linux/sbcsynth.h).
+//   -r  Packet rate in Hz of the synthetic session (default 250)
+//   -n  Number of synthetic packets (default 60 seconds worth)
+//   -m  Report mode (default 8)
+//   -c  Run the change-only filter on the reports
+//   -d  Deadband applied to every axis with -c, in report units (default 0)
+//   -k  Keep-alive in milliseconds with -c, 0 disables it (default 100)
+//   -l  Timed passes over the stream, the fastest one is kept (default 10)
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbccapfile.h"
+#include "sbcsplit.h"
+#include "sbcsynth.h"
+
+typedef struct _STREAM
+{
+	SBC_U8 *Packets;
+	SBC_U64 *Timestamps;
+	size_t Count;
+} STREAM;
+
+//
+// State as a consumer keeps it
+//
+typedef struct _APP_STATE
+{
+	SBC_U8 Buttons[SBC_BUTTON_COUNT];
+	SBC_U32 Axes[SbcAxisCount];
+	SBC_S32 Tuner;
+	SBC_S32 Gear;
+} APP_STATE;
+
+typedef struct _RESULT
+{
+	SBC_U64 Reports;
+	SBC_U64 Bytes;
+	SBC_U64 Fields;
+	SBC_U64 DeliverNs;
+	SBC_U64 ParseNs;
+	APP_STATE State;
+} RESULT;
+
+static SBC_U64 NowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+static int LoadCapture(const char *Path, STREAM *Stream)
+{
+	SBC_CAPTURE_FILE file;
+	size_t i;
+
+	if (SbcCaptureFileOpen(&file, Path) != 0)
+	{
+		fprintf(stderr, "can't open %s: %s\n", Path, errno == EINVAL ? "not a capture file" : strerror(errno));
+		return -1;
+	}
+
+	Stream->Packets = malloc(file.Count * SBC_INPUT_PACKET_SIZE + 1);
+	Stream->Timestamps = malloc(file.Count * sizeof(SBC_U64) + 1);
+	Stream->Count = 0;
+	if (Stream->Packets == NULL || Stream->Timestamps == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		SbcCaptureFileClose(&file);
+		return -1;
+	}
+
+	// Only the transfers the driver translates
+	for (i = 0; i < file.Count; ++i)
+	{
+		const SBC_CAPTURE_RECORD *record = SbcCaptureFileRecord(&file, i);
+		if (record->Length < SBC_INPUT_PACKET_SIZE) continue;
+		memcpy(Stream->Packets + Stream->Count * SBC_INPUT_PACKET_SIZE, SbcCaptureRecordData(record), SBC_INPUT_PACKET_SIZE);
+		Stream->Timestamps[Stream->Count++] = record->Timestamp;
+	}
+
+	SbcCaptureFileClose(&file);
+	return 0;
+}
+
+static int Synthesize(size_t Packets, SBC_U32 Rate, STREAM *Stream)
+{
+	SBC_SYNTH synth;
+	size_t i;
+
+	Stream->Packets = malloc(Packets * SBC_INPUT_PACKET_SIZE + 1);
+	Stream->Timestamps = malloc(Packets * sizeof(SBC_U64) + 1);
+	Stream->Count = Packets;
+	if (Stream->Packets == NULL || Stream->Timestamps == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+
+	SbcSynthInit(&synth, Rate, 0x1234567);
+	for (i = 0; i < Packets; ++i)
+	{
+		SbcSynthNext(&synth, Stream->Packets + i * SBC_INPUT_PACKET_SIZE);
+		Stream->Timestamps[i] = (SBC_U64)i * 1000000000ull / Rate;
+	}
+	return 0;
+}
+
+//
+// Delivery. Appends every report, its ID first, to Out and returns the
+// bytes written.
+//
+static size_t Deliver(const STREAM *Stream, SBC_REPORT_MODE Mode, const SBC_CHANGE_FILTER *Filter, int ChangeOnly, int Split, SBC_U8 *Out)
+{
+	SBC_CHANGE_FILTER filter = *Filter;
+	SBC_REPORT_CACHE cache;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 *out = Out;
+	SBC_U32 size;
+	size_t i;
+
+	SbcReportCacheInit(&cache);
+
+	for (i = 0; i < Stream->Count; ++i)
+	{
+		size = SbcBuildInputReport(Mode, Stream->Packets + i * SBC_INPUT_PACKET_SIZE, report);
+		if (ChangeOnly && !SbcChangeFilterCheck(&filter, report, Stream->Timestamps[i])) continue;
+
+		if (Split)
+		{
+			SbcSplitCacheStore(&cache, Mode, report, size, 1);
+			while ((size = SbcSplitCacheTake(&cache, Mode, out, out + 1)) != 0) out += 1 + size;
+		}
+		else
+		{
+			*out = SBC_REPORT_ID_INPUT;
+			memcpy(out + 1, report, size);
+			out += 1 + size;
+		}
+	}
+	return (size_t)(out - Out);
+}
+
+static SBC_U32 ParseButtons(APP_STATE *State, const SBC_U8 *Data)
+{
+	SBC_U32 i;
+
+	for (i = 0; i < SBC_BUTTON_COUNT; ++i) State->Buttons[i] = (Data[i / 8] >> (i % 8)) & 1;
+	return SBC_BUTTON_COUNT;
+}
+
+static SBC_U32 ParseAxes(APP_STATE *State, const SBC_U8 *Data, SBC_U32 First, SBC_U32 Count, SBC_U32 AxisBytes)
+{
+	SBC_U32 i;
+
+	for (i = 0; i < Count; ++i)
+	{
+		State->Axes[First + i] = AxisBytes == 2 ? SbcLoadU16(Data + i * 2) : Data[i];
+	}
+	return Count;
+}
+
+static SBC_U32 ParseControls(APP_STATE *State, const SBC_U8 *Data, SBC_U32 AxisBytes)
+{
+	SBC_U32 others = SbcAxisCount - SBC_POINTER_AXIS_COUNT;
+
+	ParseAxes(State, Data, SBC_POINTER_AXIS_COUNT, others, AxisBytes);
+	State->Tuner = Data[others * AxisBytes];
+	State->Gear = (SBC_S8)Data[others * AxisBytes + 1];
+	return others + 2;
+}
+
+//
+// Consumer. Decodes every report into State, returns the fields parsed.
+//
+static SBC_U64 Parse(const SBC_U8 *Reports, size_t Bytes, SBC_REPORT_MODE Mode, APP_STATE *State, SBC_U64 *Count)
+{
+	SBC_U32 axisBytes = Mode == SbcReportMode16Bit ? 2 : 1;
+	SBC_U32 sticks, controls;
+	SBC_U64 fields = 0;
+	size_t i = 0;
+
+	SbcSplitSlice(Mode, SbcSplitSticks, &sticks);
+	SbcSplitSlice(Mode, SbcSplitControls, &controls);
+
+	*Count = 0;
+	while (i < Bytes)
+	{
+		const SBC_U8 *data = Reports + i + 1;
+		SBC_U32 offset, size;
+
+		switch (Reports[i])
+		{
+		case SBC_REPORT_ID_INPUT:
+			fields += ParseButtons(State, data);
+			fields += ParseAxes(State, data + sticks, 0, SBC_POINTER_AXIS_COUNT, axisBytes);
+			fields += ParseControls(State, data + controls, axisBytes);
+			size = SbcInputReportSize(Mode);
+			break;
+		case SBC_REPORT_ID_BUTTONS:
+			fields += ParseButtons(State, data);
+			size = SbcSplitSlice(Mode, SbcSplitButtons, &offset);
+			break;
+		case SBC_REPORT_ID_STICKS:
+			fields += ParseAxes(State, data, 0, SBC_POINTER_AXIS_COUNT, axisBytes);
+			size = SbcSplitSlice(Mode, SbcSplitSticks, &offset);
+			break;
+		default:
+			fields += ParseControls(State, data, axisBytes);
+			size = SbcSplitSlice(Mode, SbcSplitControls, &offset);
+			break;
+		}
+		i += 1 + size;
+		++*Count;
+	}
+	return fields;
+}
+
+static void Run(const STREAM *Stream, SBC_REPORT_MODE Mode, const SBC_CHANGE_FILTER *Filter, int ChangeOnly, int Split, SBC_U32 Loops, SBC_U8 *Out, RESULT *Result)
+{
+	size_t bytes = 0;
+	SBC_U64 start, elapsed;
+	SBC_U32 loop;
+
+	memset(Result, 0, sizeof(*Result));
+	Result->DeliverNs = Result->ParseNs = ~0ull;
+
+	for (loop = 0; loop < Loops; ++loop)
+	{
+		start = NowNs();
+		bytes = Deliver(Stream, Mode, Filter, ChangeOnly, Split, Out);
+		elapsed = NowNs() - start;
+		if (elapsed < Result->DeliverNs) Result->DeliverNs = elapsed;
+
+		memset(&Result->State, 0, sizeof(Result->State));
+		start = NowNs();
+		Result->Fields = Parse(Out, bytes, Mode, &Result->State, &Result->Reports);
+		elapsed = NowNs() - start;
+		if (elapsed < Result->ParseNs) Result->ParseNs = elapsed;
+	}
+	Result->Bytes = bytes;
+}
+
+static void PrintRow(const char *Name, double Single, double Split, const char *Format)
+{
+	char single[32], split[32];
+
+	snprintf(single, sizeof(single), Format, Single);
+	snprintf(split, sizeof(split), Format, Split);
+	printf("%-20s %14s %14s %9.1f%%\n", Name, single, split, Single > 0 ? 100.0 * (Single - Split) / Single : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	SBC_U32 rate = 250;
+	size_t packets = 0;
+	SBC_REPORT_MODE mode = SbcReportMode8Bit;
+	SBC_U32 deadband = 0;
+	SBC_U32 keepAliveMs = 100;
+	SBC_U32 loops = 10;
+	int changeOnly = 0;
+	SBC_CHANGE_FILTER filter;
+	STREAM stream;
+	RESULT single, split;
+	SBC_U8 *out;
+	double n;
+	size_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:r:n:m:cd:k:l:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f': path = optarg; break;
+		case 'r': rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': packets = (size_t)strtoul(optarg, NULL, 10); break;
+		case 'm': mode = atoi(optarg) == 16 ? SbcReportMode16Bit : SbcReportMode8Bit; break;
+		case 'c': changeOnly = 1; break;
+		case 'd': deadband = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'k': keepAliveMs = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'l': loops = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		default:
+			fprintf(stderr, "usage: %s [-f capture.sbc] [-r rate] [-n packets] [-m 8|16] [-c] [-d deadband] [-k keepalive_ms] [-l loops]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (rate == 0) rate = 250;
+	if (loops == 0) loops = 1;
+
+	memset(&stream, 0, sizeof(stream));
+	if (path != NULL ? LoadCapture(path, &stream) : Synthesize(packets != 0 ? packets : 60 * (size_t)rate, rate, &stream))
+	{
+		free(stream.Packets);
+		free(stream.Timestamps);
+		return 1;
+	}
+
+	// Every part of every packet at worst
+	out = malloc(stream.Count * (SBC_MAX_INPUT_REPORT_SIZE + SbcSplitCount) + 1);
+	if (out == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		free(stream.Packets);
+		free(stream.Timestamps);
+		return 1;
+	}
+
+	// Every pass runs a copy of the filter
+	SbcChangeFilterInit(&filter, mode);
+	filter.KeepAliveNs = (SBC_U64)keepAliveMs * 1000000;
+	for (i = 0; i < SbcAxisCount; ++i) filter.Deadband[i] = (SBC_U16)deadband;
+
+	Run(&stream, mode, &filter, changeOnly, 0, loops, out, &single);
+	Run(&stream, mode, &filter, changeOnly, 1, loops, out, &split);
+
+	n = stream.Count > 0 ? (double)stream.Count : 1.0;
+	printf("packets:             %zu, %d bit axes%s\n", stream.Count, mode == SbcReportMode16Bit ? 16 : 8, changeOnly ? ", change only" : "");
+	printf("%-20s %14s %14s %10s\n", "", "single", "split", "saved");
+	PrintRow("reports", (double)single.Reports, (double)split.Reports, "%.0f");
+	PrintRow("bytes", (double)single.Bytes, (double)split.Bytes, "%.0f");
+	PrintRow("bytes/report", single.Reports ? (double)single.Bytes / (double)single.Reports : 0.0,
+		split.Reports ? (double)split.Bytes / (double)split.Reports : 0.0, "%.2f");
+	PrintRow("fields parsed", (double)single.Fields, (double)split.Fields, "%.0f");
+	PrintRow("deliver ns/packet", (double)single.DeliverNs / n, (double)split.DeliverNs / n, "%.2f");
+	PrintRow("parse ns/packet", (double)single.ParseNs / n, (double)split.ParseNs / n, "%.2f");
+
+	free(out);
+	free(stream.Packets);
+	free(stream.Timestamps);
+
+	if (memcmp(&single.State, &split.State, sizeof(single.State)) != 0)
+	{
+		fprintf(stderr, "the consumer state differs between single and split reports\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Reader of the state published by sbcd -S (see sbcshm.h). Maps the shared
+// memory object read only and prints the latest report at an interval, the
+// way a telemetry logger or an LED bridge would follow the controller
+// without taking reports away from the game.
+//
+// Usage: sbcstate [-i interval_ms] [-n count] [name]
+//
+//   -i  Time between prints (default 100 ms)
+//   -n  Prints before exiting, 0 runs until interrupted (default 0)
+//   name  Shared memory object (default /sbc-state)
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbcshm.h"
+#include "sbctransport.h"
+
+int main(int argc, char **argv)
+{
+	const SBC_STATE_SNAPSHOT *snapshot;
+	SBC_SNAPSHOT_STATE state;
+	const char *name = SBC_SHM_DEFAULT_NAME;
+	SBC_U32 intervalMs = 100;
+	SBC_U64 count = 0, printed = 0, retries = 0, last = 0;
+	struct timespec interval;
+	SBC_U32 i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:n:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i': intervalMs = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'n': count = strtoull(optarg, NULL, 10); break;
+		default:
+			fprintf(stderr, "usage: %s [-i interval_ms] [-n count] [name]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc - 1)
+	{
+		fprintf(stderr, "usage: %s [-i interval_ms] [-n count] [name]\n", argv[0]);
+		return 1;
+	}
+	if (optind == argc - 1) name = argv[optind];
+
+	snapshot = SbcShmOpen(name);
+	if (snapshot == NULL)
+	{
+		fprintf(stderr, "can't open %s: %s\n", name, errno == EINVAL ? "not a published state" : strerror(errno));
+		return 1;
+	}
+
+	interval.tv_sec = intervalMs / 1000;
+	interval.tv_nsec = (long)(intervalMs % 1000) * 1000000;
+
+	while (count == 0 || printed < count)
+	{
+		retries += SbcSnapshotRead(snapshot, &state);
+
+		if (state.Size == 0)
+		{
+			printf("nothing published yet\n");
+		}
+		else
+		{
+			printf("%12llu  +%-6llu %8.3f ms old  %2u bit  ", (unsigned long long)state.Published,
+				(unsigned long long)(state.Published - last), (double)(SbcTransportNow() - state.Timestamp) / 1e6,
+				state.Mode == SbcReportMode16Bit ? 16 : 8);
+			for (i = 0; i < state.Size && i < sizeof(state.Report); ++i) printf("%02x", state.Report[i]);
+			printf("\n");
+			last = state.Published;
+		}
+		fflush(stdout);
+
+		++printed;
+		if (count == 0 || printed < count) nanosleep(&interval, NULL);
+	}
+
+	fprintf(stderr, "%llu reads retried\n", (unsigned long long)retries);
+	SbcShmClose(snapshot);
+	return 0;
+}
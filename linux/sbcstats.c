@@ -0,0 +1,189 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Decodes snapshots of the driver's statistics feature report (see
+// sys/sbcstats.h) and, given two snapshots of the same device, prints the
+// increments of every counter and their rate over the interval.
+//
+// A snapshot is the feature report as returned by HidD_GetFeature, report
+// ID first, either as the raw 216 bytes or as hex text (bytes separated by
+// spaces, commas or new lines, with or without 0x).
+//
+// Usage: sbcstats [-a] snapshot [later-snapshot]
+//
+//   -a  Also list the counters that are 0, or didn't change
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbcstats.h"
+
+#define MAX_FILE_SIZE       (4096)
+
+static int HexDigit(int C)
+{
+	if (C >= '0' && C <= '9') return C - '0';
+	if (C >= 'a' && C <= 'f') return C - 'a' + 10;
+	if (C >= 'A' && C <= 'F') return C - 'A' + 10;
+	return -1;
+}
+
+//
+// Hex text to bytes. Returns the number of bytes, or -1 if the text isn't
+// hex or has more than Size bytes.
+//
+static int ParseHex(const char *Text, size_t Length, SBC_U8 *Bytes, size_t Size)
+{
+	size_t i = 0, count = 0;
+
+	while (i < Length)
+	{
+		int high, low;
+
+		if (isspace((unsigned char)Text[i]) || Text[i] == ',' || Text[i] == ':' || Text[i] == '-')
+		{
+			++i;
+			continue;
+		}
+		if (Text[i] == '0' && i + 1 < Length && (Text[i + 1] == 'x' || Text[i + 1] == 'X')) i += 2;
+
+		if (i + 1 >= Length) return -1;
+		high = HexDigit(Text[i]);
+		low = HexDigit(Text[i + 1]);
+		if (high < 0 || low < 0 || count == Size) return -1;
+		Bytes[count++] = (SBC_U8)(high << 4 | low);
+		i += 2;
+	}
+	return (int)count;
+}
+
+static int ReadSnapshot(const char *Path, SBC_STATS_FEATURE_REPORT *Report)
+{
+	static char data[MAX_FILE_SIZE];
+	size_t length;
+	FILE *in;
+
+	in = fopen(Path, "rb");
+	if (in == NULL)
+	{
+		perror(Path);
+		return 0;
+	}
+	length = fread(data, 1, sizeof(data), in);
+	fclose(in);
+
+	if (length != sizeof(*Report) && ParseHex(data, length, (SBC_U8 *)Report, sizeof(*Report)) != (int)sizeof(*Report))
+	{
+		fprintf(stderr, "%s: not a statistics snapshot, expected %u bytes\n", Path, (unsigned)sizeof(*Report));
+		return 0;
+	}
+	if (length == sizeof(*Report)) memcpy(Report, data, sizeof(*Report));
+
+	if (!SbcStatsValidReport(Report))
+	{
+		fprintf(stderr, "%s: not a statistics snapshot (report ID %u, version %u)\n", Path, Report->ReportId, Report->Version);
+		return 0;
+	}
+	return 1;
+}
+
+static const char *CounterName(SBC_U32 Id, char *Buffer, size_t Size)
+{
+	const SBC_STAT_INFO *info = SbcStatInfo(Id);
+
+	if (info != NULL) return info->Name;
+	snprintf(Buffer, Size, "counter_%u", Id);
+	return Buffer;
+}
+
+static void PrintSnapshot(const SBC_STATS_FEATURE_REPORT *Report, int All)
+{
+	double uptime = (double)(Report->Timestamp - Report->Started) * 1e-9;
+	char name[32];
+	SBC_U32 i;
+
+	printf("%u counters, device up for %.3f s\n", Report->Count, uptime);
+	for (i = 0; i < Report->Count; ++i)
+	{
+		const SBC_STAT_INFO *info = SbcStatInfo(i);
+
+		if (!All && Report->Counters[i] == 0) continue;
+		printf("%-22s %20llu  %12.1f/s  %s\n", CounterName(i, name, sizeof(name)), (unsigned long long)Report->Counters[i],
+			uptime > 0.0 ? (double)Report->Counters[i] / uptime : 0.0, info != NULL ? info->Description : "");
+	}
+}
+
+static void PrintDelta(const SBC_STATS_FEATURE_REPORT *Before, const SBC_STATS_FEATURE_REPORT *After, const SBC_U64 *Deltas, SBC_U64 Interval, int All)
+{
+	double seconds = (double)Interval * 1e-9;
+	SBC_U32 count = Before->Count < After->Count ? Before->Count : After->Count;
+	char name[32];
+	SBC_U32 i;
+
+	printf("%.3f s between the snapshots\n", seconds);
+	for (i = 0; i < count; ++i)
+	{
+		if (!All && Deltas[i] == 0) continue;
+		printf("%-22s %20llu  %12.1f/s\n", CounterName(i, name, sizeof(name)), (unsigned long long)Deltas[i],
+			seconds > 0.0 ? (double)Deltas[i] / seconds : 0.0);
+	}
+
+	// Counters of a newer driver in only one of the snapshots
+	if (Before->Count != After->Count)
+	{
+		printf("%u counters only in the %s snapshot\n", (Before->Count > After->Count ? Before->Count : After->Count) - count,
+			Before->Count > After->Count ? "first" : "second");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	SBC_STATS_FEATURE_REPORT before, after;
+	SBC_U64 deltas[SBC_STATS_MAX_COUNTERS];
+	SBC_U64 interval;
+	int all = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "a")) != -1)
+	{
+		switch (opt)
+		{
+		case 'a': all = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-a] snapshot [later-snapshot]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1 && optind != argc - 2)
+	{
+		fprintf(stderr, "usage: %s [-a] snapshot [later-snapshot]\n", argv[0]);
+		return 1;
+	}
+
+	if (!ReadSnapshot(argv[optind], &before)) return 1;
+	if (optind == argc - 1)
+	{
+		PrintSnapshot(&before, all);
+		return 0;
+	}
+
+	if (!ReadSnapshot(argv[optind + 1], &after)) return 1;
+	if (!SbcStatsDelta(&before, &after, deltas, &interval))
+	{
+		fprintf(stderr, "The snapshots are from different device instances or out of order\n");
+		return 1;
+	}
+	PrintDelta(&before, &after, deltas, interval, all);
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <string.h>
+
+#include "sbcsynth.h"
+
+static SBC_U32 XorShift(SBC_U32 *State)
+{
+	SBC_U32 x = *State;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*State = x;
+	return x;
+}
+
+static void Store16(SBC_U8 *Data, int Value)
+{
+	Data[0] = (SBC_U8)(Value & 0xff);
+	Data[1] = (SBC_U8)((Value >> 8) & 0xff);
+}
+
+static int Noise(SBC_U32 *Seed, int Amplitude)
+{
+	return (int)(XorShift(Seed) % (SBC_U32)(2 * Amplitude + 1)) - Amplitude;
+}
+
+void SbcSynthInit(SBC_SYNTH *Synth, SBC_U32 Rate, SBC_U32 Seed)
+{
+	SbcSynthInitPattern(Synth, Rate, Seed, SbcSynthSession);
+}
+
+void SbcSynthInitPattern(SBC_SYNTH *Synth, SBC_U32 Rate, SBC_U32 Seed, SBC_SYNTH_PATTERN Pattern)
+{
+	Synth->Rate = Rate != 0 ? Rate : 250;
+	Synth->Seed = Seed != 0 ? Seed : 1;
+	Synth->Index = 0;
+	Synth->Pattern = Pattern < SbcSynthPatternCount ? Pattern : SbcSynthSession;
+	Synth->Buttons = 0;
+}
+
+const char *SbcSynthPatternName(SBC_SYNTH_PATTERN Pattern)
+{
+	static const char *names[SbcSynthPatternCount] = { "session", "chatter", "sweep", "stress" };
+	return Pattern < SbcSynthPatternCount ? names[Pattern] : "unknown";
+}
+
+//
+// Triangle wave over the full 16 bit scale, one period per second and a
+// different phase for every axis so they don't all peak together
+//
+static int Sweep(const SBC_SYNTH *Synth, SBC_U32 Axis)
+{
+	SBC_U64 period = Synth->Rate >= 2 ? Synth->Rate : 2;
+	SBC_U64 phase = (Synth->Index + Axis * period / SbcAxisCount) % period;
+	SBC_U64 half = period / 2;
+	SBC_U64 value = phase < half ? phase * 0xffff / half : (period - phase) * 0xffff / (period - half);
+	return (int)(value > 0xffff ? 0xffff : value);
+}
+
+static void SbcSynthStressNext(SBC_SYNTH *Synth, SBC_U8 *Packet)
+{
+	int chatter = Synth->Pattern == SbcSynthChatter || Synth->Pattern == SbcSynthStress;
+	int sweep = Synth->Pattern == SbcSynthSweep || Synth->Pattern == SbcSynthStress;
+	SBC_U32 axis, i;
+
+	memset(Packet, 0, SBC_INPUT_PACKET_SIZE);
+
+	// About half of the buttons change in every packet
+	if (chatter)
+	{
+		Synth->Buttons ^= ((SBC_U64)XorShift(&Synth->Seed) << 32 | XorShift(&Synth->Seed)) & ((1ull << SBC_BUTTON_COUNT) - 1);
+		for (i = 0; i < SBC_REPORT_BUTTON_BYTES; ++i)
+		{
+			Packet[SBC_OFFSET_BUTTONS0 + i] = (SBC_U8)(Synth->Buttons >> (8 * i));
+		}
+	}
+
+	// Signed axes rest at 0, unsigned ones at 0 (pedals) or 0x8000 (aim stick)
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		int value;
+		if (sweep) value = Sweep(Synth, axis);
+		else value = SbcAxisLayout[axis].Centered ? 0x8000 : 0;
+		if (SbcAxisLayout[axis].Signed) value ^= 0x8000;
+		Store16(Packet + SbcAxisLayout[axis].PacketOffset, value);
+	}
+
+	// Tuner 1 to 15, gear lever from reverse (-2) to 5
+	Packet[SBC_OFFSET_TUNER] = Synth->Pattern == SbcSynthStress ? (SBC_U8)(1 + Synth->Index / 16 % 15) : 3;
+	Packet[SBC_OFFSET_GEAR] = Synth->Pattern == SbcSynthStress ? (SBC_U8)(SBC_S8)((int)(Synth->Index / 64 % 8) - 2) : 1;
+
+	++Synth->Index;
+}
+
+void SbcSynthNext
+(
+	SBC_SYNTH *Synth,
+	SBC_U8 *Packet
+)
+/*++
+Routine Description:
+    Generates the next packet of the session.
+
+Arguments:
+    Synth - Generator state
+
+    Packet - Receives SBC_INPUT_PACKET_SIZE bytes
+
+Return Value:
+    None
+--*/
+{
+	SBC_U32 rate = Synth->Rate;
+	SBC_U64 second = Synth->Index / rate;
+	SBC_U64 phase = Synth->Index % rate;
+	int throttle = 0;
+	int aimX = 0x8000;
+
+	if (Synth->Pattern != SbcSynthSession)
+	{
+		SbcSynthStressNext(Synth, Packet);
+		return;
+	}
+
+	memset(Packet, 0, SBC_INPUT_PACKET_SIZE);
+
+	// One button pressed for 100ms every two seconds
+	if (second % 2 == 0 && phase < rate / 10) Packet[SBC_OFFSET_BUTTONS0] = 0x02;
+
+	// Throttle ramp for one second out of every five
+	if (second % 5 == 0) throttle = (int)(phase * 0xffff / rate);
+
+	// Aim stick sweep for half a second out of every three
+	if (second % 3 == 1 && rate >= 2 && phase < rate / 2) aimX = 0x8000 + (int)(phase * 0x7fff / (rate / 2));
+
+	Store16(Packet + SBC_OFFSET_AIMX, aimX + Noise(&Synth->Seed, 96));
+	Store16(Packet + SBC_OFFSET_AIMY, 0x8000 + Noise(&Synth->Seed, 96));
+	Store16(Packet + SBC_OFFSET_ROTATION, Noise(&Synth->Seed, 64));
+	Store16(Packet + SBC_OFFSET_SIGHTX, Noise(&Synth->Seed, 64));
+	Store16(Packet + SBC_OFFSET_SIGHTY, Noise(&Synth->Seed, 64));
+	Store16(Packet + SBC_OFFSET_THROTTLE, throttle);
+	Packet[SBC_OFFSET_TUNER] = 3;
+	Packet[SBC_OFFSET_GEAR] = 1;
+
+	++Synth->Index;
+}
@@ -0,0 +1,53 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCSYNTH_H_
+#define _SBCSYNTH_H_
+
+//
+// Synthetic controller packets. Generates a deterministic session from a
+// seed: a mostly idle cockpit with stick noise, some pedal and stick
+// movement and the odd button press.
+//
+// The other patterns are for load tests and produce what the controller
+// rarely does: every button chattering, every axis sweeping its full scale,
+// or both at once with the tuner and the gear lever cycling too.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum _SBC_SYNTH_PATTERN
+{
+	SbcSynthSession = 0,        // Realistic session
+	SbcSynthChatter,            // Every button toggles at random, axes at rest
+	SbcSynthSweep,              // Every axis sweeps its full scale, no buttons
+	SbcSynthStress,             // Chatter and sweep, tuner and gear cycling
+	SbcSynthPatternCount
+} SBC_SYNTH_PATTERN;
+
+typedef struct _SBC_SYNTH
+{
+	SBC_U32 Rate;               // Packets per second
+	SBC_U32 Seed;
+	SBC_U64 Index;              // Next packet
+	SBC_SYNTH_PATTERN Pattern;
+	SBC_U64 Buttons;            // Chatter: current button state
+} SBC_SYNTH;
+
+void SbcSynthInit(SBC_SYNTH *Synth, SBC_U32 Rate, SBC_U32 Seed);
+void SbcSynthInitPattern(SBC_SYNTH *Synth, SBC_U32 Rate, SBC_U32 Seed, SBC_SYNTH_PATTERN Pattern);
+const char *SbcSynthPatternName(SBC_SYNTH_PATTERN Pattern);
+void SbcSynthNext(SBC_SYNTH *Synth, SBC_U8 *Packet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCSYNTH_H_
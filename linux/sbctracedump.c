@@ -0,0 +1,233 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Decodes a dump of the driver's trace ring (see sys/sbctrace.h), written
+// when the trace feature report is set, into text or into the Chrome trace
+// event format for chrome://tracing or Perfetto.
+//
+// In the Chrome trace every processor is a thread. Events with a duration
+// argument (ending in _ns, e.g. the latency of a delivered report) become
+// complete events that end at the event, the others are instant events.
+//
+// Usage: sbctracedump [-j] [-o output] trace.file
+//
+//   -j  Write a Chrome trace instead of text
+//   -o  Output file (default standard output)
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbctrace.h"
+
+//
+// IOCTL codes recorded by the Ioctl event. The HID ones are CTL_CODE with
+// FILE_DEVICE_KEYBOARD, the function and the method.
+//
+static const char *IoctlName(SBC_U32 Code)
+{
+	if ((Code >> 16) != 0x000b) return NULL;
+
+	switch ((Code >> 2) & 0xfff)
+	{
+	case 0: return "IOCTL_HID_GET_DEVICE_DESCRIPTOR";
+	case 1: return "IOCTL_HID_GET_REPORT_DESCRIPTOR";
+	case 2: return "IOCTL_HID_READ_REPORT";
+	case 3: return "IOCTL_HID_WRITE_REPORT";
+	case 4: return "IOCTL_HID_GET_STRING";
+	case 7: return "IOCTL_HID_ACTIVATE_DEVICE";
+	case 8: return "IOCTL_HID_DEACTIVATE_DEVICE";
+	case 9: return "IOCTL_HID_GET_DEVICE_ATTRIBUTES";
+	case 10: return "IOCTL_HID_SEND_IDLE_NOTIFICATION_REQUEST";
+	case 100: return (Code & 3) == 2 ? "IOCTL_HID_GET_FEATURE" : "IOCTL_HID_SET_FEATURE";
+	case 101: return "IOCTL_HID_SET_OUTPUT_REPORT";
+	case 104: return "IOCTL_HID_GET_INPUT_REPORT";
+	default: return NULL;
+	}
+}
+
+static int IsDuration(const char *Arg)
+{
+	size_t length = strlen(Arg);
+	return length > 3 && strcmp(Arg + length - 3, "_ns") == 0;
+}
+
+static void PrintArg(FILE *Out, const char *Arg, SBC_U32 Value, int Json)
+{
+	const char *ioctl = strcmp(Arg, "code") == 0 ? IoctlName(Value) : NULL;
+
+	if (Json)
+	{
+		if (ioctl != NULL) fprintf(Out, "\"%s\":\"%s\"", Arg, ioctl);
+		else if (strcmp(Arg, "status") == 0 || strcmp(Arg, "code") == 0) fprintf(Out, "\"%s\":\"0x%08x\"", Arg, Value);
+		else fprintf(Out, "\"%s\":%u", Arg, Value);
+	}
+	else
+	{
+		if (ioctl != NULL) fprintf(Out, "  %s=%s", Arg, ioctl);
+		else if (strcmp(Arg, "status") == 0 || strcmp(Arg, "code") == 0) fprintf(Out, "  %s=0x%08x", Arg, Value);
+		else fprintf(Out, "  %s=%u", Arg, Value);
+	}
+}
+
+static void WriteText(FILE *Out, const SBC_TRACE_HEADER *Header, const SBC_TRACE_EVENT *Events)
+{
+	SBC_U32 i, j;
+
+	fprintf(Out, "%u events, %u recorded, %u overwritten or skipped, %u dropped, trace level %u\n",
+		Header->Count, Header->Written, Header->Written - Header->Count, Header->Dropped, Header->Level);
+
+	for (i = 0; i < Header->Count; ++i)
+	{
+		const SBC_TRACE_EVENT *event = &Events[i];
+		const SBC_TRACE_EVENT_INFO *info = SbcTraceEventInfo(event->Id);
+
+		if (i != 0 && event->Sequence != Events[i - 1].Sequence + 1)
+		{
+			fprintf(Out, "  ... %u events missing\n", event->Sequence - Events[i - 1].Sequence - 1);
+		}
+
+		fprintf(Out, "%10u %14.3f us  cpu %2u  ", event->Sequence,
+			(double)(event->Timestamp - Events[0].Timestamp) / 1000.0, event->Processor);
+		if (info == NULL)
+		{
+			fprintf(Out, "%-16s  id=%u  arg0=%u  arg1=%u\n", "Unknown", event->Id, event->Args[0], event->Args[1]);
+			continue;
+		}
+
+		fprintf(Out, "%-16s", info->Name);
+		for (j = 0; j < 2; ++j)
+		{
+			if (info->Args[j] != NULL) PrintArg(Out, info->Args[j], event->Args[j], 0);
+		}
+		fprintf(Out, "\n");
+	}
+}
+
+static void WriteChrome(FILE *Out, const SBC_TRACE_HEADER *Header, const SBC_TRACE_EVENT *Events)
+{
+	SBC_U32 i, j;
+
+	fprintf(Out, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"recorded\":%u,\"dropped\":%u,\"level\":%u},\"traceEvents\":[\n",
+		Header->Written, Header->Dropped, Header->Level);
+	fprintf(Out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"hidsteelbattalion\"}}");
+
+	for (i = 0; i < Header->Count; ++i)
+	{
+		const SBC_TRACE_EVENT *event = &Events[i];
+		const SBC_TRACE_EVENT_INFO *info = SbcTraceEventInfo(event->Id);
+		SBC_U64 start = event->Timestamp;
+		SBC_U64 duration = 0;
+
+		if (info != NULL)
+		{
+			for (j = 0; j < 2; ++j)
+			{
+				if (info->Args[j] != NULL && IsDuration(info->Args[j]) && event->Args[j] <= start)
+				{
+					duration = event->Args[j];
+					start -= duration;
+				}
+			}
+		}
+
+		fprintf(Out, ",\n{\"name\":\"%s\",\"cat\":\"driver\",", info != NULL ? info->Name : "Unknown");
+		if (duration != 0) fprintf(Out, "\"ph\":\"X\",\"dur\":%.3f,", (double)duration / 1000.0);
+		else fprintf(Out, "\"ph\":\"i\",\"s\":\"t\",");
+		fprintf(Out, "\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{", (double)start / 1000.0, event->Processor);
+
+		fprintf(Out, "\"sequence\":%u", event->Sequence);
+		for (j = 0; j < 2; ++j)
+		{
+			const char *arg = info != NULL ? info->Args[j] : (j == 0 ? "arg0" : "arg1");
+			if (arg == NULL) continue;
+			fprintf(Out, ",");
+			PrintArg(Out, arg, event->Args[j], 1);
+		}
+		fprintf(Out, "}}");
+	}
+
+	fprintf(Out, "\n]}\n");
+}
+
+int main(int argc, char **argv)
+{
+	SBC_TRACE_HEADER header;
+	SBC_TRACE_EVENT *events;
+	const char *output = NULL;
+	FILE *in, *out;
+	int json = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "jo:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'j': json = 1; break;
+		case 'o': output = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-j] [-o output] trace.file\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "usage: %s [-j] [-o output] trace.file\n", argv[0]);
+		return 1;
+	}
+
+	in = fopen(argv[optind], "rb");
+	if (in == NULL)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	if (fread(&header, sizeof(header), 1, in) != 1 || !SbcTraceValidHeader(&header))
+	{
+		fprintf(stderr, "%s: not a trace dump\n", argv[optind]);
+		fclose(in);
+		return 1;
+	}
+
+	events = malloc(SBC_TRACE_RING_SIZE * sizeof(SBC_TRACE_EVENT));
+	if (events == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		fclose(in);
+		return 1;
+	}
+
+	if (fread(events, sizeof(SBC_TRACE_EVENT), header.Count, in) != header.Count)
+	{
+		fprintf(stderr, "%s: truncated, %u events expected\n", argv[optind], header.Count);
+		free(events);
+		fclose(in);
+		return 1;
+	}
+	fclose(in);
+
+	out = output != NULL ? fopen(output, "w") : stdout;
+	if (out == NULL)
+	{
+		perror(output);
+		free(events);
+		return 1;
+	}
+
+	if (json) WriteChrome(out, &header, events);
+	else WriteText(out, &header, events);
+
+	if (out != stdout) fclose(out);
+	free(events);
+	return 0;
+}
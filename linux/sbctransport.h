@@ -0,0 +1,120 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCTRANSPORT_H_
+#define _SBCTRANSPORT_H_
+
+//
+// Source of interrupt pipe transfers for the user mode daemon.
+//
+// A transport mirrors the continuous reader in sys/usb.c: once started it
+// keeps Depth reads of TransferSize bytes in flight and calls Completion
+// for every completed one, zero length and short ones included, sending
+// the read again after Completion returns. Completions only run from
+// inside SbcTransportRun, on the calling thread.
+//
+
+#include <time.h>
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_TRANSPORT_ERROR     (-1)
+#define SBC_TRANSPORT_END       (-2)    // Device gone or mock exhausted
+
+typedef void SBC_TRANSPORT_COMPLETION(void *Context, const SBC_U8 *Data, SBC_U32 Length, SBC_U64 Timestamp);
+
+typedef struct _SBC_TRANSPORT SBC_TRANSPORT;
+
+typedef struct _SBC_TRANSPORT_OPS
+{
+	const char *Name;
+	int (*Start)(SBC_TRANSPORT *Transport);
+	int (*Run)(SBC_TRANSPORT *Transport, int TimeoutMs);
+	void (*Stop)(SBC_TRANSPORT *Transport);
+	void (*Destroy)(SBC_TRANSPORT *Transport);
+} SBC_TRANSPORT_OPS;
+
+struct _SBC_TRANSPORT
+{
+	const SBC_TRANSPORT_OPS *Ops;
+
+	// Set by the owner before Start
+	SBC_U32 Depth;
+	SBC_U32 TransferSize;
+	SBC_TRANSPORT_COMPLETION *Completion;
+	void *Context;
+};
+
+//
+// Timestamps passed to Completion, CLOCK_MONOTONIC in nanoseconds
+//
+static __inline SBC_U64 SbcTransportNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SBC_U64)ts.tv_sec * 1000000000ull + (SBC_U64)ts.tv_nsec;
+}
+
+// Returns 0 or SBC_TRANSPORT_ERROR
+static __inline int SbcTransportStart(SBC_TRANSPORT *Transport)
+{
+	return Transport->Ops->Start(Transport);
+}
+
+// Waits up to TimeoutMs for completions and runs them. Returns how many
+// ran, SBC_TRANSPORT_END or SBC_TRANSPORT_ERROR.
+static __inline int SbcTransportRun(SBC_TRANSPORT *Transport, int TimeoutMs)
+{
+	return Transport->Ops->Run(Transport, TimeoutMs);
+}
+
+// Cancels the reads in flight and waits for them
+static __inline void SbcTransportStop(SBC_TRANSPORT *Transport)
+{
+	Transport->Ops->Stop(Transport);
+}
+
+static __inline void SbcTransportDestroy(SBC_TRANSPORT *Transport)
+{
+	Transport->Ops->Destroy(Transport);
+}
+
+//
+// Mock transport. Produces synthetic packets (see sbcsynth.h) or the
+// records of a capture file at their rate, or as fast as possible. There
+// is always a read pending, reads are sent again synchronously.
+//
+typedef struct _SBC_MOCK_CONFIG
+{
+	SBC_U32 Rate;               // Packets per second of the synthetic session
+	SBC_U64 Count;              // Packets to produce, 0 for no limit
+	SBC_U32 Seed;
+	int Paced;                  // Real time instead of as fast as possible
+	SBC_U32 ZeroPermille;       // Transfers turned into zero length ones
+	SBC_U32 ShortPermille;      // Transfers cut short
+	const struct _SBC_CAPTURE_FILE *Capture;   // Replay this instead, optional
+} SBC_MOCK_CONFIG;
+
+SBC_TRANSPORT *SbcMockTransportCreate(const SBC_MOCK_CONFIG *Config);
+
+//
+// libusb transport for the real controller. Returns NULL when built
+// without libusb-1.0.
+//
+#define SBC_USB_VENDOR_ID       (0x0A7B)
+#define SBC_USB_PRODUCT_ID      (0xD000)
+
+SBC_TRANSPORT *SbcUsbTransportCreate(SBC_U16 VendorId, SBC_U16 ProductId);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCTRANSPORT_H_
@@ -0,0 +1,317 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/uinput.h>
+
+#include "sbctransport.h"
+#include "sbcuinput.h"
+
+#define BUTTON_MASK ((1ull << SBC_EVDEV_BUTTON_COUNT) - 1)
+
+const SBC_U16 SbcEvdevButtonCodes[SBC_EVDEV_BUTTON_COUNT] =
+{
+	BTN_GAMEPAD + 0x0, BTN_GAMEPAD + 0x1, BTN_GAMEPAD + 0x2, BTN_GAMEPAD + 0x3,
+	BTN_GAMEPAD + 0x4, BTN_GAMEPAD + 0x5, BTN_GAMEPAD + 0x6, BTN_GAMEPAD + 0x7,
+	BTN_GAMEPAD + 0x8, BTN_GAMEPAD + 0x9, BTN_GAMEPAD + 0xa, BTN_GAMEPAD + 0xb,
+	BTN_GAMEPAD + 0xc, BTN_GAMEPAD + 0xd, BTN_GAMEPAD + 0xe, BTN_GAMEPAD + 0xf,
+	BTN_TRIGGER_HAPPY1,  BTN_TRIGGER_HAPPY2,  BTN_TRIGGER_HAPPY3,  BTN_TRIGGER_HAPPY4,
+	BTN_TRIGGER_HAPPY5,  BTN_TRIGGER_HAPPY6,  BTN_TRIGGER_HAPPY7,  BTN_TRIGGER_HAPPY8,
+	BTN_TRIGGER_HAPPY9,  BTN_TRIGGER_HAPPY10, BTN_TRIGGER_HAPPY11, BTN_TRIGGER_HAPPY12,
+	BTN_TRIGGER_HAPPY13, BTN_TRIGGER_HAPPY14, BTN_TRIGGER_HAPPY15, BTN_TRIGGER_HAPPY16,
+	BTN_TRIGGER_HAPPY17, BTN_TRIGGER_HAPPY18, BTN_TRIGGER_HAPPY19, BTN_TRIGGER_HAPPY20,
+	BTN_TRIGGER_HAPPY21, BTN_TRIGGER_HAPPY22, BTN_TRIGGER_HAPPY23, BTN_TRIGGER_HAPPY24,
+	BTN_TRIGGER_HAPPY25, BTN_TRIGGER_HAPPY26, BTN_TRIGGER_HAPPY27, BTN_TRIGGER_HAPPY28,
+	BTN_TRIGGER_HAPPY29, BTN_TRIGGER_HAPPY30, BTN_TRIGGER_HAPPY31,
+};
+
+const SBC_U16 SbcEvdevAbsCodes[SBC_EVDEV_ABS_COUNT] =
+{
+	ABS_X, ABS_Y, ABS_Z, ABS_RX, ABS_RY, ABS_THROTTLE, ABS_BRAKE, ABS_GAS, ABS_MISC, ABS_MISC + 1,
+};
+
+void SbcEvdevDecodeReport
+(
+	SBC_REPORT_MODE Mode,
+	const SBC_U8 *Report,
+	SBC_U64 *Buttons,
+	SBC_S32 *Abs
+)
+/*++
+Routine Description:
+    Unpacks an input report into the button mask and the evdev axis values.
+
+Arguments:
+    Mode - Report layout
+
+    Report - Input report, without the report ID
+
+    Buttons - Receives the 39 buttons and the virtual buttons, bit n is
+              Button n + 1
+
+    Abs - Receives SBC_EVDEV_ABS_COUNT values in SbcEvdevAbsCodes order
+
+Return Value:
+    None
+--*/
+{
+	const SBC_U8 *axes = Report + SBC_REPORT_BUTTON_BYTES;
+	int i;
+
+	SBC_U64 buttons = (SBC_U64)Report[0] | ((SBC_U64)Report[1] << 8) | ((SBC_U64)Report[2] << 16) |
+		((SBC_U64)Report[3] << 24) | ((SBC_U64)Report[4] << 32);
+
+	if (Mode == SbcReportMode16Bit)
+	{
+		for (i = 0; i < SbcAxisCount; ++i) Abs[i] = SbcLoadU16(axes + 2 * i);
+		axes += 2 * SbcAxisCount;
+	}
+	else
+	{
+		for (i = 0; i < SbcAxisCount; ++i) Abs[i] = axes[i];
+		axes += SbcAxisCount;
+	}
+
+	Abs[SBC_EVDEV_ABS_TUNER] = axes[0];
+	Abs[SBC_EVDEV_ABS_GEAR] = (SBC_S8)axes[1];
+
+	// The padding bit dropped, the virtual buttons after the last button
+	*Buttons = (buttons & ((1ull << SBC_BUTTON_COUNT) - 1)) | ((SBC_U64)axes[2] << SBC_BUTTON_COUNT);
+}
+
+static __inline void SetEvent(struct input_event *Event, SBC_U16 Type, SBC_U16 Code, SBC_S32 Value)
+{
+	// The input core stamps the events written to uinput
+	memset(Event, 0, sizeof(*Event));
+	Event->type = Type;
+	Event->code = Code;
+	Event->value = Value;
+}
+
+SBC_U32 SbcEvdevBuildFrame
+(
+	SBC_EVDEV_STATE *State,
+	SBC_REPORT_MODE Mode,
+	const SBC_U8 *Report,
+	struct input_event *Events
+)
+/*++
+Routine Description:
+    Builds the events that take the device from the last state to the one in
+    the report. The buttons are diffed with a single XOR of the 39 bit masks
+    and only the set bits of the result are visited. The first frame, or the
+    first after a failed write, carries every button and axis.
+
+Arguments:
+    State - Last state sent, updated to the report
+
+    Mode - Report layout
+
+    Report - Input report, without the report ID
+
+    Events - Receives up to SBC_EVDEV_MAX_EVENTS events
+
+Return Value:
+    Number of events including the closing SYN_REPORT, zero if nothing
+    changed.
+--*/
+{
+	SBC_U64 buttons, changed;
+	SBC_S32 abs[SBC_EVDEV_ABS_COUNT];
+	SBC_U32 count = 0;
+	int i;
+
+	SbcEvdevDecodeReport(Mode, Report, &buttons, abs);
+
+	changed = State->Valid ? buttons ^ State->Buttons : BUTTON_MASK;
+	while (changed != 0)
+	{
+		int bit = __builtin_ctzll(changed);
+		SetEvent(&Events[count++], EV_KEY, SbcEvdevButtonCodes[bit], (SBC_S32)((buttons >> bit) & 1));
+		changed &= changed - 1;
+	}
+
+	for (i = 0; i < SBC_EVDEV_ABS_COUNT; ++i)
+	{
+		if (State->Valid && abs[i] == State->Abs[i]) continue;
+		SetEvent(&Events[count++], EV_ABS, SbcEvdevAbsCodes[i], abs[i]);
+		State->Abs[i] = abs[i];
+	}
+
+	State->Buttons = buttons;
+	State->Valid = 1;
+
+	if (count == 0) return 0;
+	SetEvent(&Events[count++], EV_SYN, SYN_REPORT, 0);
+	return count;
+}
+
+static int AbsSetup(int Fd, SBC_U16 Code, SBC_S32 Minimum, SBC_S32 Maximum)
+{
+	struct uinput_abs_setup setup;
+
+	memset(&setup, 0, sizeof(setup));
+	setup.code = Code;
+	setup.absinfo.minimum = Minimum;
+	setup.absinfo.maximum = Maximum;
+	if (ioctl(Fd, UI_SET_ABSBIT, Code) < 0) return -1;
+	return ioctl(Fd, UI_ABS_SETUP, &setup);
+}
+
+int SbcUinputOpen
+(
+	SBC_UINPUT *Uinput,
+	SBC_REPORT_MODE Mode,
+	const char *Name
+)
+/*++
+Routine Description:
+    Creates the virtual game pad.
+
+Arguments:
+    Uinput - Sink to initialize
+
+    Mode - Layout of the reports that will be written, selects the range of
+           the 8 main axes
+
+    Name - Device name
+
+Return Value:
+    Zero on success, -1 with errno set on failure
+--*/
+{
+	struct uinput_setup setup;
+	SBC_S32 axisMax = Mode == SbcReportMode16Bit ? 65535 : 255;
+	int fd;
+	int i;
+	int error;
+
+	fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+	if (fd < 0) return -1;
+
+	if (ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0 || ioctl(fd, UI_SET_EVBIT, EV_ABS) < 0) goto fail;
+	for (i = 0; i < SBC_EVDEV_BUTTON_COUNT; ++i)
+	{
+		if (ioctl(fd, UI_SET_KEYBIT, SbcEvdevButtonCodes[i]) < 0) goto fail;
+	}
+	for (i = 0; i < SbcAxisCount; ++i)
+	{
+		if (AbsSetup(fd, SbcEvdevAbsCodes[i], 0, axisMax) < 0) goto fail;
+	}
+	if (AbsSetup(fd, SbcEvdevAbsCodes[SBC_EVDEV_ABS_TUNER], 0, 255) < 0) goto fail;
+	if (AbsSetup(fd, SbcEvdevAbsCodes[SBC_EVDEV_ABS_GEAR], -128, 127) < 0) goto fail;
+
+	memset(&setup, 0, sizeof(setup));
+	setup.id.bustype = BUS_USB;
+	setup.id.vendor = SBC_USB_VENDOR_ID;
+	setup.id.product = SBC_USB_PRODUCT_ID;
+	strncpy(setup.name, Name, UINPUT_MAX_NAME_SIZE - 1);
+	if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) goto fail;
+
+	SbcUinputAttach(Uinput, fd, Mode);
+	Uinput->Created = 1;
+	return 0;
+
+fail:
+	error = errno;
+	close(fd);
+	errno = error;
+	return -1;
+}
+
+void SbcUinputAttach(SBC_UINPUT *Uinput, int Fd, SBC_REPORT_MODE Mode)
+{
+	memset(Uinput, 0, sizeof(*Uinput));
+	Uinput->Fd = Fd;
+	Uinput->Mode = Mode;
+}
+
+int SbcUinputWriteReport
+(
+	SBC_UINPUT *Uinput,
+	const SBC_U8 *Report,
+	SBC_U32 Size
+)
+/*++
+Routine Description:
+    Sends the changes in a report to the device, the whole frame in one
+    write unless PerEventWrites is set.
+
+Arguments:
+    Uinput - Sink
+
+    Report - Input report, without the report ID
+
+    Size - Size of the report, must match the mode
+
+Return Value:
+    Zero on success, -1 with errno set on failure
+--*/
+{
+	struct input_event events[SBC_EVDEV_MAX_EVENTS];
+	SBC_U32 count, i;
+	ssize_t written;
+
+	if (Size != SbcInputReportSize(Uinput->Mode))
+	{
+		++Uinput->Errors;
+		errno = EINVAL;
+		return -1;
+	}
+
+	count = SbcEvdevBuildFrame(&Uinput->State, Uinput->Mode, Report, events);
+	if (count == 0) return 0;
+
+	++Uinput->Frames;
+	Uinput->Events += count;
+
+	if (!Uinput->PerEventWrites)
+	{
+		++Uinput->Writes;
+		written = write(Uinput->Fd, events, count * sizeof(events[0]));
+		if (written == (ssize_t)(count * sizeof(events[0]))) return 0;
+	}
+	else
+	{
+		for (i = 0; i < count; ++i)
+		{
+			++Uinput->Writes;
+			written = write(Uinput->Fd, &events[i], sizeof(events[i]));
+			if (written != (ssize_t)sizeof(events[i])) break;
+		}
+		if (i == count) return 0;
+	}
+
+	// The device now holds a state we don't know, resend everything next time
+	Uinput->State.Valid = 0;
+	++Uinput->Errors;
+	if (written >= 0) errno = EIO;
+	return -1;
+}
+
+void SbcUinputSink(void *Context, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Timestamp)
+{
+	(void)Timestamp;
+	SbcUinputWriteReport((SBC_UINPUT *)Context, Report, Size);
+}
+
+void SbcUinputClose(SBC_UINPUT *Uinput)
+{
+	if (Uinput->Fd < 0) return;
+
+	if (Uinput->Created)
+	{
+		ioctl(Uinput->Fd, UI_DEV_DESTROY);
+		close(Uinput->Fd);
+	}
+	Uinput->Fd = -1;
+}
@@ -0,0 +1,94 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCUINPUT_H_
+#define _SBCUINPUT_H_
+
+//
+// uinput sink for sbcd. Creates an evdev game pad with the buttons and axes
+// of G_DefaultReportDescriptor and turns every report into the events that
+// changed since the previous one. The frame, SYN_REPORT included, goes to
+// the kernel in a single write.
+//
+// Buttons are numbered like hid-input numbers the buttons of a game pad
+// application collection: Button 1 to 16 are BTN_GAMEPAD to BTN_THUMBR,
+// Button 17 to 39 are BTN_TRIGGER_HAPPY1 to BTN_TRIGGER_HAPPY23 and the
+// virtual buttons of the combo engine, Button 40 to 47, BTN_TRIGGER_HAPPY24
+// to BTN_TRIGGER_HAPPY31. The axes:
+//
+//  Report     Usage            evdev
+//  AimX       X                ABS_X
+//  AimY       Y                ABS_Y
+//  Rotation   Z                ABS_Z
+//  SightX     Rx               ABS_RX
+//  SightY     Ry               ABS_RY
+//  Clutch     Slider           ABS_THROTTLE
+//  Brake      Brake            ABS_BRAKE
+//  Throttle   Throttle         ABS_GAS
+//  Tuner      Weapons Select   ABS_MISC
+//  Gear       Shifter          ABS_MISC + 1
+//
+
+#include <linux/input.h>
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_EVDEV_BUTTON_COUNT      (SBC_BUTTON_COUNT + SBC_VIRTUAL_BUTTON_COUNT)
+#define SBC_EVDEV_ABS_COUNT         (SbcAxisCount + 2)
+#define SBC_EVDEV_ABS_TUNER         (SbcAxisCount)
+#define SBC_EVDEV_ABS_GEAR          (SbcAxisCount + 1)
+
+// Every button and axis changing plus the SYN_REPORT
+#define SBC_EVDEV_MAX_EVENTS        (SBC_EVDEV_BUTTON_COUNT + SBC_EVDEV_ABS_COUNT + 1)
+
+extern const SBC_U16 SbcEvdevButtonCodes[SBC_EVDEV_BUTTON_COUNT];
+extern const SBC_U16 SbcEvdevAbsCodes[SBC_EVDEV_ABS_COUNT];
+
+//
+// Last state sent to the device
+//
+typedef struct _SBC_EVDEV_STATE
+{
+	SBC_U64 Buttons;            // Bit n is Button n + 1
+	SBC_S32 Abs[SBC_EVDEV_ABS_COUNT];
+	int Valid;                  // Zero sends every button and axis in the next frame
+} SBC_EVDEV_STATE;
+
+void SbcEvdevDecodeReport(SBC_REPORT_MODE Mode, const SBC_U8 *Report, SBC_U64 *Buttons, SBC_S32 *Abs);
+SBC_U32 SbcEvdevBuildFrame(SBC_EVDEV_STATE *State, SBC_REPORT_MODE Mode, const SBC_U8 *Report, struct input_event *Events);
+
+typedef struct _SBC_UINPUT
+{
+	int Fd;
+	int Created;                // Fd is a uinput device created by SbcUinputOpen
+	SBC_REPORT_MODE Mode;
+	SBC_EVDEV_STATE State;
+
+	// One write per event instead of per frame, for comparison
+	int PerEventWrites;
+
+	// Counters
+	SBC_U64 Frames;             // Reports that changed something
+	SBC_U64 Events;             // Including the SYN_REPORTs
+	SBC_U64 Writes;
+	SBC_U64 Errors;
+} SBC_UINPUT;
+
+int SbcUinputOpen(SBC_UINPUT *Uinput, SBC_REPORT_MODE Mode, const char *Name);
+void SbcUinputAttach(SBC_UINPUT *Uinput, int Fd, SBC_REPORT_MODE Mode);
+int SbcUinputWriteReport(SBC_UINPUT *Uinput, const SBC_U8 *Report, SBC_U32 Size);
+void SbcUinputSink(void *Context, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Timestamp);
+void SbcUinputClose(SBC_UINPUT *Uinput);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCUINPUT_H_
@@ -0,0 +1,198 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Benchmark for the uinput sink. Feeds a synthetic session through the
+// frame builder alone, then through the sink writing each frame in one
+// write and writing one event at a time, and reports the syscalls and the
+// time per frame. Frames go to /dev/null unless -u is given, in which case
+// they go to a real uinput device (needs write access to /dev/uinput).
+//
+// Usage: sbcuinputbench [-n packets] [-r rate] [-x seed] [-m 8|16] [-u]
+//
+//   -n  Packets in the session (default 200000)
+//   -r  Packet rate of the session in Hz, shapes how much changes between
+//       packets (default 1000)
+//   -x  Random seed (default 1)
+//   -m  Report mode (default 8)
+//   -u  Write to a uinput device instead of /dev/null
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbcsynth.h"
+#include "sbctransport.h"
+#include "sbcuinput.h"
+
+static void RunBuild(SBC_REPORT_MODE Mode, const SBC_U8 *Reports, SBC_U32 Size, size_t Count)
+{
+	struct input_event events[SBC_EVDEV_MAX_EVENTS];
+	SBC_EVDEV_STATE state;
+	SBC_U64 frames = 0, total = 0;
+	SBC_U64 start, elapsed;
+	size_t i;
+
+	memset(&state, 0, sizeof(state));
+
+	start = SbcTransportNow();
+	for (i = 0; i < Count; ++i)
+	{
+		SBC_U32 count = SbcEvdevBuildFrame(&state, Mode, Reports + i * Size, events);
+		if (count != 0)
+		{
+			++frames;
+			total += count;
+		}
+	}
+	elapsed = SbcTransportNow() - start;
+
+	printf("frame build only\n");
+	printf("  reports:          %llu\n", (unsigned long long)Count);
+	printf("  frames:           %llu\n", (unsigned long long)frames);
+	printf("  events/frame:     %.2f\n", frames ? (double)total / (double)frames : 0.0);
+	printf("  us/frame:         %.3f\n", frames ? (double)elapsed / 1e3 / (double)frames : 0.0);
+}
+
+static int RunSink(const char *Name, SBC_UINPUT *Uinput, const SBC_U8 *Reports, SBC_U32 Size, size_t Count)
+{
+	SBC_U64 start, elapsed;
+	size_t i;
+
+	start = SbcTransportNow();
+	for (i = 0; i < Count; ++i)
+	{
+		if (SbcUinputWriteReport(Uinput, Reports + i * Size, Size) != 0)
+		{
+			fprintf(stderr, "write failed: %s\n", strerror(errno));
+			return -1;
+		}
+	}
+	elapsed = SbcTransportNow() - start;
+
+	printf("%s\n", Name);
+	printf("  frames:           %llu\n", (unsigned long long)Uinput->Frames);
+	printf("  events/frame:     %.2f\n", Uinput->Frames ? (double)Uinput->Events / (double)Uinput->Frames : 0.0);
+	printf("  syscalls/frame:   %.2f\n", Uinput->Frames ? (double)Uinput->Writes / (double)Uinput->Frames : 0.0);
+	printf("  us/frame:         %.3f\n", Uinput->Frames ? (double)elapsed / 1e3 / (double)Uinput->Frames : 0.0);
+	return 0;
+}
+
+static int Open(SBC_UINPUT *Uinput, SBC_REPORT_MODE Mode, int UseUinput)
+{
+	int fd;
+
+	if (UseUinput)
+	{
+		if (SbcUinputOpen(Uinput, Mode, "Steel Battalion Controller (benchmark)") != 0)
+		{
+			fprintf(stderr, "can't create the uinput device: %s\n", strerror(errno));
+			return -1;
+		}
+		return 0;
+	}
+
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "can't open /dev/null: %s\n", strerror(errno));
+		return -1;
+	}
+	SbcUinputAttach(Uinput, fd, Mode);
+	return 0;
+}
+
+static void Close(SBC_UINPUT *Uinput)
+{
+	int fd = Uinput->Fd;
+
+	if (Uinput->Created) SbcUinputClose(Uinput);
+	else close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	SBC_SYNTH synth;
+	SBC_UINPUT uinput;
+	SBC_REPORT_MODE mode = SbcReportMode8Bit;
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U8 *reports;
+	SBC_U32 size;
+	size_t count = 200000;
+	SBC_U32 rate = 1000;
+	SBC_U32 seed = 1;
+	int useUinput = 0;
+	int result = 0;
+	size_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:x:m:u")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': count = (size_t)strtoull(optarg, NULL, 10); break;
+		case 'r': rate = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'x': seed = (SBC_U32)strtoul(optarg, NULL, 10); break;
+		case 'm': mode = atoi(optarg) == 16 ? SbcReportMode16Bit : SbcReportMode8Bit; break;
+		case 'u': useUinput = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-n packets] [-r rate] [-x seed] [-m 8|16] [-u]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (count == 0 || rate == 0)
+	{
+		fprintf(stderr, "packets and rate must not be zero\n");
+		return 1;
+	}
+
+	size = SbcInputReportSize(mode);
+	reports = malloc(count * size);
+	if (reports == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	SbcSynthInit(&synth, rate, seed);
+	for (i = 0; i < count; ++i)
+	{
+		SbcSynthNext(&synth, packet);
+		SbcBuildInputReport(mode, packet, reports + i * size);
+	}
+
+	printf("%s axes, %s\n", mode == SbcReportMode16Bit ? "16 bit" : "8 bit", useUinput ? "/dev/uinput" : "/dev/null");
+	RunBuild(mode, reports, size, count);
+
+	if (Open(&uinput, mode, useUinput) != 0)
+	{
+		free(reports);
+		return 1;
+	}
+	result = RunSink("one write per frame", &uinput, reports, size, count);
+	Close(&uinput);
+
+	if (result == 0)
+	{
+		if (Open(&uinput, mode, useUinput) != 0)
+		{
+			free(reports);
+			return 1;
+		}
+		uinput.PerEventWrites = 1;
+		result = RunSink("one write per event", &uinput, reports, size, count);
+		Close(&uinput);
+	}
+
+	free(reports);
+	return result == 0 ? 0 : 1;
+}
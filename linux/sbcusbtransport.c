@@ -0,0 +1,246 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libusb.h>
+
+#include "sbctransport.h"
+
+#define USB_INTERFACE_NUMBER    (0)
+#define USB_MAX_DEPTH           (16)
+
+typedef struct _USB_TRANSPORT
+{
+	SBC_TRANSPORT Transport;
+	SBC_U16 VendorId;
+	SBC_U16 ProductId;
+
+	libusb_context *Usb;
+	libusb_device_handle *Handle;
+	unsigned char Endpoint;
+
+	struct libusb_transfer *Transfers[USB_MAX_DEPTH];
+	SBC_U32 Count;
+	SBC_U32 Active;             // Transfers submitted and not completed
+	int Completed;              // Completions in the current Run
+	int Stopping;
+	int Gone;
+} USB_TRANSPORT;
+
+static void LIBUSB_CALL UsbTransferComplete(struct libusb_transfer *Transfer)
+{
+	USB_TRANSPORT *usb = Transfer->user_data;
+	SBC_TRANSPORT *transport = &usb->Transport;
+
+	--usb->Active;
+
+	switch (Transfer->status)
+	{
+	case LIBUSB_TRANSFER_COMPLETED:
+		transport->Completion(transport->Context, Transfer->buffer, (SBC_U32)Transfer->actual_length, SbcTransportNow());
+		++usb->Completed;
+		break;
+
+	case LIBUSB_TRANSFER_CANCELLED:
+		return;
+
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		usb->Gone = 1;
+		return;
+
+	default:
+		// Stall, overflow or a transient error: keep reading like the
+		// continuous reader does
+		fprintf(stderr, "interrupt transfer failed: %s\n", libusb_error_name(Transfer->status));
+		break;
+	}
+
+	if (usb->Stopping) return;
+
+	if (libusb_submit_transfer(Transfer) == 0) ++usb->Active;
+	else usb->Gone = 1;
+}
+
+static int UsbFindEndpoint(USB_TRANSPORT *Usb)
+{
+	struct libusb_config_descriptor *config;
+	const struct libusb_interface_descriptor *interface;
+	int i;
+
+	if (libusb_get_active_config_descriptor(libusb_get_device(Usb->Handle), &config) != 0) return 0;
+
+	if (config->bNumInterfaces <= USB_INTERFACE_NUMBER || config->interface[USB_INTERFACE_NUMBER].num_altsetting == 0)
+	{
+		libusb_free_config_descriptor(config);
+		return 0;
+	}
+
+	interface = &config->interface[USB_INTERFACE_NUMBER].altsetting[0];
+	for (i = 0; i < interface->bNumEndpoints; ++i)
+	{
+		const struct libusb_endpoint_descriptor *endpoint = &interface->endpoint[i];
+		if ((endpoint->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == LIBUSB_TRANSFER_TYPE_INTERRUPT &&
+			(endpoint->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN)
+		{
+			Usb->Endpoint = endpoint->bEndpointAddress;
+			libusb_free_config_descriptor(config);
+			return 1;
+		}
+	}
+
+	libusb_free_config_descriptor(config);
+	return 0;
+}
+
+static int UsbStart(SBC_TRANSPORT *Transport)
+{
+	USB_TRANSPORT *usb = (USB_TRANSPORT *)Transport;
+	SBC_U32 i;
+	int result;
+
+	if (Transport->Completion == NULL || Transport->Depth == 0 || Transport->Depth > USB_MAX_DEPTH) return SBC_TRANSPORT_ERROR;
+
+	result = libusb_init(&usb->Usb);
+	if (result != 0)
+	{
+		fprintf(stderr, "libusb_init failed: %s\n", libusb_error_name(result));
+		return SBC_TRANSPORT_ERROR;
+	}
+
+	usb->Handle = libusb_open_device_with_vid_pid(usb->Usb, usb->VendorId, usb->ProductId);
+	if (usb->Handle == NULL)
+	{
+		fprintf(stderr, "controller %04x:%04x not found or not accessible\n", usb->VendorId, usb->ProductId);
+		return SBC_TRANSPORT_ERROR;
+	}
+
+	libusb_set_auto_detach_kernel_driver(usb->Handle, 1);
+	result = libusb_claim_interface(usb->Handle, USB_INTERFACE_NUMBER);
+	if (result != 0)
+	{
+		fprintf(stderr, "libusb_claim_interface failed: %s\n", libusb_error_name(result));
+		return SBC_TRANSPORT_ERROR;
+	}
+
+	if (!UsbFindEndpoint(usb))
+	{
+		fprintf(stderr, "no interrupt IN endpoint on interface %d\n", USB_INTERFACE_NUMBER);
+		return SBC_TRANSPORT_ERROR;
+	}
+
+	// Same as WdfUsbTargetPipeConfigContinuousReader: Depth reads in flight
+	for (i = 0; i < Transport->Depth; ++i)
+	{
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+		unsigned char *buffer = malloc(Transport->TransferSize);
+
+		if (transfer == NULL || buffer == NULL)
+		{
+			libusb_free_transfer(transfer);
+			free(buffer);
+			return SBC_TRANSPORT_ERROR;
+		}
+
+		libusb_fill_interrupt_transfer(transfer, usb->Handle, usb->Endpoint, buffer, (int)Transport->TransferSize, UsbTransferComplete, usb, 0);
+		transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+		usb->Transfers[usb->Count++] = transfer;
+
+		result = libusb_submit_transfer(transfer);
+		if (result != 0)
+		{
+			fprintf(stderr, "libusb_submit_transfer failed: %s\n", libusb_error_name(result));
+			return SBC_TRANSPORT_ERROR;
+		}
+		++usb->Active;
+	}
+	return 0;
+}
+
+static int UsbRun(SBC_TRANSPORT *Transport, int TimeoutMs)
+{
+	USB_TRANSPORT *usb = (USB_TRANSPORT *)Transport;
+	struct timeval tv;
+	int result;
+
+	if (usb->Gone) return SBC_TRANSPORT_END;
+
+	tv.tv_sec = TimeoutMs / 1000;
+	tv.tv_usec = (TimeoutMs % 1000) * 1000;
+
+	usb->Completed = 0;
+	result = libusb_handle_events_timeout_completed(usb->Usb, &tv, NULL);
+	if (result != 0 && result != LIBUSB_ERROR_INTERRUPTED)
+	{
+		fprintf(stderr, "libusb_handle_events failed: %s\n", libusb_error_name(result));
+		return SBC_TRANSPORT_ERROR;
+	}
+	if (usb->Completed == 0 && usb->Gone) return SBC_TRANSPORT_END;
+	return usb->Completed;
+}
+
+static void UsbStop(SBC_TRANSPORT *Transport)
+{
+	USB_TRANSPORT *usb = (USB_TRANSPORT *)Transport;
+	SBC_U32 i;
+
+	usb->Stopping = 1;
+	if (usb->Active == 0) return;
+
+	for (i = 0; i < usb->Count; ++i) libusb_cancel_transfer(usb->Transfers[i]);
+
+	while (usb->Active != 0 && !usb->Gone)
+	{
+		if (libusb_handle_events(usb->Usb) != 0) break;
+	}
+}
+
+static void UsbDestroy(SBC_TRANSPORT *Transport)
+{
+	USB_TRANSPORT *usb = (USB_TRANSPORT *)Transport;
+	SBC_U32 i;
+
+	// Transfers still active can't be freed, they are leaked
+	if (usb->Active == 0)
+	{
+		for (i = 0; i < usb->Count; ++i) libusb_free_transfer(usb->Transfers[i]);
+	}
+
+	if (usb->Handle != NULL)
+	{
+		libusb_release_interface(usb->Handle, USB_INTERFACE_NUMBER);
+		libusb_close(usb->Handle);
+	}
+	if (usb->Usb != NULL) libusb_exit(usb->Usb);
+	free(usb);
+}
+
+static const SBC_TRANSPORT_OPS UsbOps =
+{
+	"libusb",
+	UsbStart,
+	UsbRun,
+	UsbStop,
+	UsbDestroy,
+};
+
+SBC_TRANSPORT *SbcUsbTransportCreate(SBC_U16 VendorId, SBC_U16 ProductId)
+{
+	USB_TRANSPORT *usb = calloc(1, sizeof(*usb));
+
+	if (usb == NULL) return NULL;
+
+	usb->Transport.Ops = &UsbOps;
+	usb->Transport.Depth = 2;
+	usb->Transport.TransferSize = 32;
+	usb->VendorId = VendorId;
+	usb->ProductId = ProductId;
+	return &usb->Transport;
+}
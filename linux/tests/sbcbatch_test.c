@@ -0,0 +1,107 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Checks that every batch kernel supported by this CPU is bit exact with
+// SbcTranslateReport, for random packets, the edge values of every axis
+// and every batch length up to a few vector widths.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbcbatch.h"
+
+#define PACKETS 4099
+
+static SBC_U32 XorShift(SBC_U32 *State)
+{
+	SBC_U32 x = *State;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*State = x;
+	return x;
+}
+
+static void Store16(SBC_U8 *Data, SBC_U16 Value)
+{
+	Data[0] = (SBC_U8)(Value & 0xff);
+	Data[1] = (SBC_U8)(Value >> 8);
+}
+
+int main(void)
+{
+	static const SBC_U16 edges[] = { 0x0000, 0x0001, 0x00ff, 0x0100, 0x0101, 0x7fff, 0x8000, 0x8001, 0xfeff, 0xff00, 0xff01, 0xffff };
+	static SBC_U8 packets[PACKETS * SBC_INPUT_PACKET_SIZE];
+	static HIDFX2_INPUT_REPORT expected[PACKETS];
+	static HIDFX2_INPUT_REPORT actual[PACKETS + 1];
+	SBC_U32 seed = 0xdeadbeef;
+	int failures = 0;
+	int path;
+	size_t i, count;
+
+	for (i = 0; i < sizeof(packets); ++i) packets[i] = (SBC_U8)XorShift(&seed);
+
+	// The first packets walk all the edge values through every axis and
+	// every gear value
+	for (i = 0; i < 256; ++i)
+	{
+		SBC_U8 *p = packets + i * SBC_INPUT_PACKET_SIZE;
+		int axis;
+		for (axis = 0; axis < SbcAxisCount; ++axis)
+		{
+			Store16(p + SBC_OFFSET_AIMX + 2 * axis, edges[(i + (size_t)axis) % (sizeof(edges) / sizeof(edges[0]))]);
+		}
+		p[SBC_OFFSET_GEAR] = (SBC_U8)i;
+	}
+
+	for (i = 0; i < PACKETS; ++i) SbcTranslateReport(packets + i * SBC_INPUT_PACKET_SIZE, expected + i);
+
+	for (path = SbcBatchScalar; path < SbcBatchPathCount; ++path)
+	{
+		if (!SbcBatchPathSupported((SBC_BATCH_PATH)path))
+		{
+			printf("%s: not supported, skipped\n", SbcBatchPathName((SBC_BATCH_PATH)path));
+			continue;
+		}
+
+		for (count = 0; count <= PACKETS; count = count < 70 ? count + 1 : count + 1009)
+		{
+			memset(actual, 0xcc, sizeof(actual));
+			SbcTranslateBatchPath((SBC_BATCH_PATH)path, packets, count, actual);
+
+			if (memcmp(actual, expected, count * sizeof(HIDFX2_INPUT_REPORT)) != 0)
+			{
+				fprintf(stderr, "%s: mismatch with %zu packets\n", SbcBatchPathName((SBC_BATCH_PATH)path), count);
+				++failures;
+			}
+
+			// The virtual buttons are left released for the combo engine,
+			// whatever the packet
+			for (i = 0; i < count; ++i)
+			{
+				if (actual[i].VirtualButtons != 0)
+				{
+					fprintf(stderr, "%s: virtual buttons set in report %zu of %zu\n", SbcBatchPathName((SBC_BATCH_PATH)path), i, count);
+					++failures;
+					break;
+				}
+			}
+
+			// Nothing written past the last report
+			if (((SBC_U8 *)actual)[count * sizeof(HIDFX2_INPUT_REPORT)] != 0xcc)
+			{
+				fprintf(stderr, "%s: wrote past the end with %zu packets\n", SbcBatchPathName((SBC_BATCH_PATH)path), count);
+				++failures;
+			}
+		}
+		printf("%s: ok\n", SbcBatchPathName((SBC_BATCH_PATH)path));
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Simulates the interaction between the continuous reader and the
+// IOCTL_HID_READ_REPORT dispatch with interleaved packets and reads. The
+// driver logic is mirrored here: a packet completes the oldest pending read
+// or goes to the latest-state cache, a read completes from the cache if the
+// state changed since the last completed read or is parked otherwise.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sbccore.h"
+
+#define MAX_PENDING 64
+
+typedef struct _SIM
+{
+	SBC_REPORT_CACHE Cache;
+	int Pending[MAX_PENDING];
+	int PendingCount;
+	int NextRead;
+
+	// Last completion
+	int CompletedRead;
+	HIDFX2_INPUT_REPORT CompletedReport;
+	int Completions;
+} SIM;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static void Complete(SIM *Sim, int Read, const HIDFX2_INPUT_REPORT *Report)
+{
+	Sim->CompletedRead = Read;
+	Sim->CompletedReport = *Report;
+	++Sim->Completions;
+}
+
+static void SimPacket(SIM *Sim, const HIDFX2_INPUT_REPORT *Report)
+{
+	int delivered = Sim->PendingCount > 0;
+	SbcReportCacheStore(&Sim->Cache, Report, sizeof(*Report), delivered);
+	if (delivered)
+	{
+		int read = Sim->Pending[0];
+		memmove(Sim->Pending, Sim->Pending + 1, sizeof(int) * (size_t)(--Sim->PendingCount));
+		Complete(Sim, read, Report);
+	}
+}
+
+// Returns the read id
+static int SimRead(SIM *Sim)
+{
+	HIDFX2_INPUT_REPORT report;
+	SBC_U8 buffer[SBC_MAX_INPUT_REPORT_SIZE];
+	int read = Sim->NextRead++;
+	if (SbcReportCacheTake(&Sim->Cache, buffer) == sizeof(report))
+	{
+		memcpy(&report, buffer, sizeof(report));
+		Complete(Sim, read, &report);
+	}
+	else
+	{
+		Sim->Pending[Sim->PendingCount++] = read;
+	}
+	return read;
+}
+
+static void SimInit(SIM *Sim)
+{
+	memset(Sim, 0, sizeof(*Sim));
+	SbcReportCacheInit(&Sim->Cache);
+	Sim->CompletedRead = -1;
+}
+
+static HIDFX2_INPUT_REPORT MakeReport(SBC_U8 Value)
+{
+	HIDFX2_INPUT_REPORT r;
+	memset(&r, 0, sizeof(r));
+	r.Buttons0 = Value;
+	r.AimX = (SBC_U8)(Value * 3);
+	return r;
+}
+
+static int SameReport(const HIDFX2_INPUT_REPORT *A, const HIDFX2_INPUT_REPORT *B)
+{
+	return memcmp(A, B, sizeof(*A)) == 0;
+}
+
+static void TestPacketBeforeRead(void)
+{
+	SIM sim;
+	HIDFX2_INPUT_REPORT a = MakeReport(1);
+	int read;
+
+	SimInit(&sim);
+	SimPacket(&sim, &a);
+	CHECK(sim.Completions == 0);
+
+	read = SimRead(&sim);
+	CHECK(sim.Completions == 1);
+	CHECK(sim.CompletedRead == read);
+	CHECK(SameReport(&sim.CompletedReport, &a));
+	CHECK(sim.PendingCount == 0);
+
+	// Nothing changed since, the next read waits
+	SimRead(&sim);
+	CHECK(sim.Completions == 1);
+	CHECK(sim.PendingCount == 1);
+	CHECK(sim.Cache.Dropped == 0);
+}
+
+static void TestReadBeforePacket(void)
+{
+	SIM sim;
+	HIDFX2_INPUT_REPORT a = MakeReport(1);
+	int read;
+
+	SimInit(&sim);
+	read = SimRead(&sim);
+	CHECK(sim.Completions == 0);
+	SimPacket(&sim, &a);
+	CHECK(sim.Completions == 1);
+	CHECK(sim.CompletedRead == read);
+
+	// Same state again with no read pending does not mark the cache dirty
+	SimPacket(&sim, &a);
+	SimRead(&sim);
+	CHECK(sim.Completions == 1);
+	CHECK(sim.PendingCount == 1);
+	CHECK(sim.Cache.Dropped == 0);
+}
+
+static void TestLatestWins(void)
+{
+	SIM sim;
+	HIDFX2_INPUT_REPORT a = MakeReport(1);
+	HIDFX2_INPUT_REPORT b = MakeReport(2);
+
+	SimInit(&sim);
+	SimPacket(&sim, &a);
+	SimPacket(&sim, &b);
+	SimRead(&sim);
+	CHECK(sim.Completions == 1);
+	CHECK(SameReport(&sim.CompletedReport, &b));
+
+	// a never reached a read
+	CHECK(sim.Cache.Dropped == 1);
+}
+
+static void TestReturnToDelivered(void)
+{
+	SIM sim;
+	HIDFX2_INPUT_REPORT a = MakeReport(1);
+	HIDFX2_INPUT_REPORT b = MakeReport(2);
+
+	// a delivered, then b and back to a while nobody reads: the consumer
+	// already has a, so the next read waits.
+	SimInit(&sim);
+	SimRead(&sim);
+	SimPacket(&sim, &a);
+	SimPacket(&sim, &b);
+	SimPacket(&sim, &a);
+	SimRead(&sim);
+	CHECK(sim.Completions == 1);
+	CHECK(sim.PendingCount == 1);
+	CHECK(sim.Cache.Dropped == 1);
+}
+
+static void TestPoll(void)
+{
+	SIM sim;
+	HIDFX2_INPUT_REPORT a = MakeReport(1);
+	HIDFX2_INPUT_REPORT b = MakeReport(2);
+	SBC_U8 buffer[SBC_MAX_INPUT_REPORT_SIZE];
+
+	// Nothing to poll before the first packet
+	SimInit(&sim);
+	CHECK(SbcReportCachePeek(&sim.Cache, buffer) == 0);
+
+	// A poll gets the undelivered state and leaves it for the next read
+	SimPacket(&sim, &a);
+	CHECK(SbcReportCachePeek(&sim.Cache, buffer) == sizeof(a));
+	CHECK(memcmp(buffer, &a, sizeof(a)) == 0);
+	CHECK(SbcReportCachePeek(&sim.Cache, buffer) == sizeof(a));
+	SimRead(&sim);
+	CHECK(sim.Completions == 1);
+	CHECK(SameReport(&sim.CompletedReport, &a));
+
+	// Once delivered it can still be polled, and a parked read still waits
+	SimRead(&sim);
+	CHECK(SbcReportCachePeek(&sim.Cache, buffer) == sizeof(a));
+	CHECK(memcmp(buffer, &a, sizeof(a)) == 0);
+	CHECK(sim.Completions == 1);
+
+	SimPacket(&sim, &b);
+	CHECK(sim.Completions == 2);
+	CHECK(SbcReportCachePeek(&sim.Cache, buffer) == sizeof(b));
+	CHECK(memcmp(buffer, &b, sizeof(b)) == 0);
+	CHECK(sim.Cache.Dropped == 0);
+}
+
+static void TestRandomInterleaving(void)
+{
+	SIM sim;
+	HIDFX2_INPUT_REPORT latest, lastDelivered;
+	SBC_U32 seed = 12345;
+	int i;
+
+	SimInit(&sim);
+	memset(&latest, 0, sizeof(latest));
+	memset(&lastDelivered, 0, sizeof(lastDelivered));
+
+	for (i = 0; i < 100000; ++i)
+	{
+		int before = sim.Completions;
+		seed = seed * 1103515245u + 12345u;
+
+		if ((seed >> 16) & 1)
+		{
+			latest = MakeReport((SBC_U8)((seed >> 20) & 3));
+			SimPacket(&sim, &latest);
+		}
+		else if (sim.PendingCount < MAX_PENDING)
+		{
+			int parkedBefore = sim.PendingCount;
+			int changed = !SameReport(&latest, &lastDelivered);
+			SimRead(&sim);
+
+			// A read is completed immediately exactly when no other read is
+			// parked and the state changed since the last completed read.
+			CHECK(sim.Completions == before + (parkedBefore == 0 && changed));
+		}
+
+		if (sim.Completions != before)
+		{
+			// Every completion carries the latest translated state
+			CHECK(SameReport(&sim.CompletedReport, &latest));
+			lastDelivered = latest;
+		}
+	}
+}
+
+int main(void)
+{
+	TestPacketBeforeRead();
+	TestReadBeforePacket();
+	TestLatestWins();
+	TestReturnToDelivered();
+	TestPoll();
+	TestRandomInterleaving();
+
+	if (failures)
+	{
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("sbccache_test passed\n");
+	return 0;
+}
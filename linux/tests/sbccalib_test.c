@@ -0,0 +1,248 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Calibration mapping and compiled tables against the reference
+// SbcCalibrateAxis, and the untouched axes against SbcBuildInputReport.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbccalib.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static SBC_CALIBRATION_TABLES tables;
+
+static SBC_AXIS_CALIBRATION Axis(SBC_U16 Min, SBC_U16 Center, SBC_U16 Max, SBC_U16 Deadzone, SBC_U8 Curve, SBC_U8 Flags)
+{
+	SBC_AXIS_CALIBRATION axis;
+	axis.Min = Min;
+	axis.Center = Center;
+	axis.Max = Max;
+	axis.Deadzone = Deadzone;
+	axis.Curve = Curve;
+	axis.Flags = Flags;
+	return axis;
+}
+
+static void RandomPacket(SBC_U8 *Packet, SBC_U32 *State)
+{
+	int i;
+	for (i = 0; i < SBC_INPUT_PACKET_SIZE; ++i)
+	{
+		*State = *State * 1103515245 + 12345;
+		Packet[i] = (SBC_U8)(*State >> 16);
+	}
+	Packet[0] = 0;
+	Packet[1] = SBC_INPUT_PACKET_SIZE;
+}
+
+static SBC_U16 ReportAxis(SBC_REPORT_MODE Mode, const SBC_U8 *Report, SBC_U32 Axis)
+{
+	const SBC_U8 *axes = Report + SBC_REPORT_BUTTON_BYTES;
+	return Mode == SbcReportMode16Bit ? (SBC_U16)(axes[2 * Axis] | (axes[2 * Axis + 1] << 8)) : axes[Axis];
+}
+
+static void TestValidate(void)
+{
+	SBC_AXIS_CALIBRATION axis;
+
+	axis = Axis(0, 0, 0, 0, 0, 0);
+	CHECK(SbcCalibrationValidate(&axis));
+	axis = Axis(100, 30000, 60000, 500, 50, SBC_CALIBRATION_ENABLED | SBC_CALIBRATION_INVERT);
+	CHECK(SbcCalibrationValidate(&axis));
+	axis = Axis(100, 100, 60000, 500, 0, SBC_CALIBRATION_ENABLED);
+	CHECK(SbcCalibrationValidate(&axis));
+
+	axis = Axis(60000, 30000, 100, 0, 0, SBC_CALIBRATION_ENABLED);
+	CHECK(!SbcCalibrationValidate(&axis));
+	axis = Axis(100, 60000, 60000, 0, 0, SBC_CALIBRATION_ENABLED);
+	CHECK(!SbcCalibrationValidate(&axis));
+	axis = Axis(100, 50, 60000, 0, 0, SBC_CALIBRATION_ENABLED);
+	CHECK(!SbcCalibrationValidate(&axis));
+	axis = Axis(100, 30000, 60000, 29900, 0, SBC_CALIBRATION_ENABLED);
+	CHECK(!SbcCalibrationValidate(&axis));
+	axis = Axis(100, 30000, 60000, 0, 101, SBC_CALIBRATION_ENABLED);
+	CHECK(!SbcCalibrationValidate(&axis));
+	axis = Axis(100, 30000, 60000, 0, 0, SBC_CALIBRATION_ENABLED | 0x80);
+	CHECK(!SbcCalibrationValidate(&axis));
+}
+
+static void TestMapping(void)
+{
+	SBC_AXIS_CALIBRATION axis;
+	SBC_U32 raw;
+	SBC_U16 last;
+
+	// Centered axis with a deadzone
+	axis = Axis(1000, 32000, 64000, 800, 0, SBC_CALIBRATION_ENABLED);
+	CHECK(SbcCalibrateAxis(&axis, 32000) == 32768);
+	CHECK(SbcCalibrateAxis(&axis, 32800) == 32768);
+	CHECK(SbcCalibrateAxis(&axis, 31200) == 32768);
+	CHECK(SbcCalibrateAxis(&axis, 32810) > 32768);
+	CHECK(SbcCalibrateAxis(&axis, 31190) < 32768);
+	CHECK(SbcCalibrateAxis(&axis, 64000) == 65535);
+	CHECK(SbcCalibrateAxis(&axis, 1000) == 0);
+
+	// Beyond the calibrated range clamps
+	CHECK(SbcCalibrateAxis(&axis, 65535) == 65535);
+	CHECK(SbcCalibrateAxis(&axis, 0) == 0);
+
+	// Inverted
+	axis.Flags |= SBC_CALIBRATION_INVERT;
+	CHECK(SbcCalibrateAxis(&axis, 64000) == 0);
+	CHECK(SbcCalibrateAxis(&axis, 1000) == 65535);
+	CHECK(SbcCalibrateAxis(&axis, 32000) == 32768);
+
+	// One-sided pedal
+	axis = Axis(2000, 2000, 50000, 1000, 0, SBC_CALIBRATION_ENABLED);
+	CHECK(SbcCalibrateAxis(&axis, 0) == 0);
+	CHECK(SbcCalibrateAxis(&axis, 3000) == 0);
+	CHECK(SbcCalibrateAxis(&axis, 50000) == 65535);
+	CHECK(SbcCalibrateAxis(&axis, 26500) > 32000 && SbcCalibrateAxis(&axis, 26500) < 33500);
+	axis.Flags |= SBC_CALIBRATION_INVERT;
+	CHECK(SbcCalibrateAxis(&axis, 0) == 65535);
+	CHECK(SbcCalibrateAxis(&axis, 50000) == 0);
+
+	// The curve keeps the end points and is monotonic, fully cubic halfway
+	// is an eighth of the travel
+	axis = Axis(0, 32768, 65535, 0, 100, SBC_CALIBRATION_ENABLED);
+	CHECK(SbcCalibrateAxis(&axis, 65535) == 65535);
+	CHECK(SbcCalibrateAxis(&axis, 0) == 0);
+	CHECK(abs((int)SbcCalibrateAxis(&axis, 49152) - (32768 + 32767 / 8)) < 4);
+	last = 0;
+	for (raw = 0; raw < 65536; ++raw)
+	{
+		SBC_U16 value = SbcCalibrateAxis(&axis, (SBC_U16)raw);
+		CHECK(value >= last);
+		last = value;
+	}
+}
+
+static void TestTables(SBC_REPORT_MODE Mode)
+{
+	SBC_AXIS_CALIBRATION axes[SbcAxisCount];
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U8 expected[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 state = 7;
+	SBC_U32 axis;
+	int i;
+
+	// Nothing enabled is the default translation
+	memset(axes, 0, sizeof(axes));
+	SbcCalibrationCompile(&tables, Mode, axes);
+	CHECK(tables.EnabledMask == 0);
+	for (i = 0; i < 1000; ++i)
+	{
+		RandomPacket(packet, &state);
+		CHECK(SbcBuildCalibratedReport(&tables, packet, report) == SbcBuildInputReport(Mode, packet, expected));
+		CHECK(memcmp(report, expected, SbcInputReportSize(Mode)) == 0);
+	}
+
+	// Every other axis calibrated
+	axes[SbcAxisAimX] = Axis(4000, 30000, 61000, 1500, 40, SBC_CALIBRATION_ENABLED);
+	axes[SbcAxisRotation] = Axis(0, 32768, 65535, 0, 0, SBC_CALIBRATION_ENABLED | SBC_CALIBRATION_INVERT);
+	axes[SbcAxisSightY] = Axis(10000, 33000, 50000, 200, 100, SBC_CALIBRATION_ENABLED);
+	axes[SbcAxisBrake] = Axis(1000, 1000, 40000, 500, 20, SBC_CALIBRATION_ENABLED);
+	SbcCalibrationCompile(&tables, Mode, axes);
+	CHECK(tables.EnabledMask == ((1u << SbcAxisAimX) | (1u << SbcAxisRotation) | (1u << SbcAxisSightY) | (1u << SbcAxisBrake)));
+
+	for (i = 0; i < 20000; ++i)
+	{
+		RandomPacket(packet, &state);
+		SbcBuildInputReport(Mode, packet, expected);
+		SbcBuildCalibratedReport(&tables, packet, report);
+
+		// Buttons and uncalibrated axes are untouched
+		CHECK(memcmp(report, expected, SBC_REPORT_BUTTON_BYTES) == 0);
+		for (axis = 0; axis < SbcAxisCount; ++axis)
+		{
+			SBC_U16 raw = SbcRawAxis(packet, axis);
+			SBC_U16 value = ReportAxis(Mode, report, axis);
+
+			if (!(axes[axis].Flags & SBC_CALIBRATION_ENABLED))
+			{
+				CHECK(value == ReportAxis(Mode, expected, axis));
+				continue;
+			}
+
+			// The tables interpolate between the calibration of the start
+			// of the bucket the raw value falls in and the next one
+			{
+				SBC_U32 start = raw & ~((1u << SBC_CALIBRATION_LUT_SHIFT) - 1);
+				SBC_U32 end = start + (1u << SBC_CALIBRATION_LUT_SHIFT);
+				SBC_U16 a = SbcCalibrateAxis(&axes[axis], (SBC_U16)start);
+				SBC_U16 b = SbcCalibrateAxis(&axes[axis], (SBC_U16)(end > 65535 ? 65535 : end));
+				SBC_U16 lo = a < b ? a : b;
+				SBC_U16 hi = a < b ? b : a;
+
+				if (Mode == SbcReportMode8Bit)
+				{
+					lo >>= 8;
+					hi >>= 8;
+				}
+				CHECK(value >= lo && value <= hi);
+				if (Mode == SbcReportMode16Bit && raw == start) CHECK(value == a);
+			}
+		}
+	}
+}
+
+static void TestResolution(void)
+{
+	SBC_AXIS_CALIBRATION axes[SbcAxisCount];
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 raw;
+	SBC_U32 steps = 0;
+	SBC_U16 last = 0;
+
+	// A linear axis keeps every raw step in the 16 bit report
+	memset(axes, 0, sizeof(axes));
+	memset(packet, 0, sizeof(packet));
+	axes[SbcAxisAimX] = Axis(0, 32768, 65535, 0, 0, SBC_CALIBRATION_ENABLED);
+	SbcCalibrationCompile(&tables, SbcReportMode16Bit, axes);
+
+	for (raw = 0; raw < 65536; ++raw)
+	{
+		SBC_U16 value;
+
+		packet[SBC_OFFSET_AIMX] = (SBC_U8)raw;
+		packet[SBC_OFFSET_AIMX + 1] = (SBC_U8)(raw >> 8);
+		SbcBuildCalibratedReport(&tables, packet, report);
+		value = ReportAxis(SbcReportMode16Bit, report, SbcAxisAimX);
+
+		CHECK(abs((int)value - (int)SbcCalibrateAxis(&axes[SbcAxisAimX], (SBC_U16)raw)) <= 1);
+		CHECK(value >= last);
+		if (value != last) ++steps;
+		last = value;
+	}
+	CHECK(steps > 65000);
+}
+
+int main(void)
+{
+	TestValidate();
+	TestMapping();
+	TestTables(SbcReportMode8Bit);
+	TestTables(SbcReportMode16Bit);
+	TestResolution();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbccalib_test passed\n");
+	return 0;
+}
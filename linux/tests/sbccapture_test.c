@@ -0,0 +1,214 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Capture ring and capture file round trip: records of every length,
+// including zero length and short reads, are written and read back, and a
+// full ring drops records leaving a sequence gap. Records are sized for the
+// transfer size, so long transfers come back whole.
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbccapfile.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static void FillData(SBC_U8 *Data, SBC_U32 Seed)
+{
+	SBC_U32 i;
+	for (i = 0; i < SBC_CAPTURE_MAX_DATA_SIZE; ++i) Data[i] = (SBC_U8)(Seed * 31 + i);
+}
+
+static const SBC_CAPTURE_RECORD *RecordAt(const SBC_U8 *Records, SBC_U32 RecordSize, SBC_U32 Index)
+{
+	return (const SBC_CAPTURE_RECORD *)(Records + Index * RecordSize);
+}
+
+static void TestRecordSize(void)
+{
+	SBC_CAPTURE_HEADER header;
+
+	CHECK(SbcCaptureRecordSize(SBC_INPUT_PACKET_SIZE) == 16 + SBC_CAPTURE_MIN_DATA_SIZE);
+	CHECK(SbcCaptureRecordSize(32) == 48);
+	CHECK(SbcCaptureRecordSize(33) == 64);
+	CHECK(SbcCaptureRecordSize(512) == 16 + 512);
+	CHECK(SbcCaptureRecordSize(4096) == SBC_CAPTURE_MAX_RECORD_SIZE);
+
+	SbcCaptureInitHeader(&header, 0, SbcCaptureRecordSize(200));
+	CHECK(SbcCaptureValidHeader(&header));
+	header.RecordSize = 50;
+	CHECK(!SbcCaptureValidHeader(&header));
+	header.RecordSize = 8;
+	CHECK(!SbcCaptureValidHeader(&header));
+}
+
+static void TestRing(SBC_U32 TransferSize)
+{
+	static SBC_U8 storage[SBC_CAPTURE_RING_SIZE * SBC_CAPTURE_MAX_RECORD_SIZE];
+	static SBC_U8 out[SBC_CAPTURE_RING_SIZE * SBC_CAPTURE_MAX_RECORD_SIZE];
+	SBC_U32 recordSize = SbcCaptureRecordSize(TransferSize);
+	SBC_CAPTURE_RING ring;
+	SBC_U8 data[SBC_CAPTURE_MAX_DATA_SIZE];
+	const SBC_CAPTURE_RECORD *record;
+	SBC_U32 i, count;
+
+	SbcCaptureRingInit(&ring, storage, recordSize);
+	CHECK(SbcCaptureRingPop(&ring, out, SBC_CAPTURE_RING_SIZE) == 0);
+
+	// Fill it up, then two more that have to be dropped
+	for (i = 0; i < SBC_CAPTURE_RING_SIZE; ++i)
+	{
+		FillData(data, i);
+		CHECK(SbcCaptureRingPush(&ring, 1000 + i, data, i % (TransferSize + 1)));
+	}
+	CHECK(!SbcCaptureRingPush(&ring, 0, data, 26));
+	CHECK(!SbcCaptureRingPush(&ring, 0, data, 26));
+	CHECK(ring.Dropped == 2);
+
+	// Partial pop frees room for one more
+	count = SbcCaptureRingPop(&ring, out, 10);
+	CHECK(count == 10);
+	CHECK(RecordAt(out, recordSize, 0)->Sequence == 0 && RecordAt(out, recordSize, 9)->Sequence == 9);
+	CHECK(SbcCaptureRingPush(&ring, 5000, NULL, 0));
+
+	count = SbcCaptureRingPop(&ring, out, SBC_CAPTURE_RING_SIZE);
+	CHECK(count == SBC_CAPTURE_RING_SIZE - 9);
+	CHECK(RecordAt(out, recordSize, 0)->Sequence == 10);
+	CHECK(RecordAt(out, recordSize, count - 2)->Sequence == SBC_CAPTURE_RING_SIZE - 1);
+
+	// The dropped records consumed their sequence numbers
+	record = RecordAt(out, recordSize, count - 1);
+	CHECK(record->Sequence == SBC_CAPTURE_RING_SIZE + 2);
+	CHECK(record->Length == 0);
+	CHECK(record->Timestamp == 5000);
+
+	for (i = 0; i + 1 < count; ++i)
+	{
+		SBC_U32 seq, length;
+
+		record = RecordAt(out, recordSize, i);
+		seq = record->Sequence;
+		length = seq % (TransferSize + 1);
+		FillData(data, seq);
+		CHECK(record->Length == length);
+		CHECK(record->Timestamp == 1000 + seq);
+		CHECK(memcmp(SbcCaptureRecordData(record), data, length) == 0);
+	}
+}
+
+static void TestFile(void)
+{
+	char path[] = "/tmp/sbccapture_testXXXXXX";
+	SBC_CAPTURE_WRITER writer;
+	SBC_CAPTURE_FILE file;
+	SBC_U8 data[SBC_CAPTURE_MAX_DATA_SIZE];
+	SBC_U8 zero[SBC_CAPTURE_MAX_DATA_SIZE];
+	int fd = mkstemp(path);
+	size_t i;
+
+	CHECK(fd >= 0);
+	if (fd < 0) return;
+	close(fd);
+
+	memset(zero, 0, sizeof(zero));
+
+	// Two sessions appended to the same file, only one header
+	CHECK(SbcCaptureWriterOpen(&writer, path, 100, 32) == 0);
+	for (i = 0; i < 40; ++i)
+	{
+		FillData(data, (SBC_U32)i);
+		CHECK(SbcCaptureWriterAppend(&writer, 100 + i * 4000000, i % 5 == 0 ? NULL : data, (SBC_U32)(i % 5 == 0 ? 0 : i % 27)) == 0);
+	}
+	CHECK(SbcCaptureWriterClose(&writer) == 0);
+
+	CHECK(SbcCaptureWriterOpen(&writer, path, 0, 32) == 0);
+	FillData(data, 99);
+	CHECK(SbcCaptureWriterAppend(&writer, 7, data, SBC_INPUT_PACKET_SIZE) == 0);
+	CHECK(SbcCaptureWriterClose(&writer) == 0);
+
+	CHECK(SbcCaptureFileOpen(&file, path) == 0);
+	CHECK(file.Count == 41);
+	CHECK(file.Header->StartTime == 100);
+	CHECK(file.Header->RecordSize == 48);
+	CHECK(file.DataSize == 32);
+
+	for (i = 0; i < 40 && i < file.Count; ++i)
+	{
+		const SBC_CAPTURE_RECORD *record = SbcCaptureFileRecord(&file, i);
+		SBC_U32 length = (SBC_U32)(i % 5 == 0 ? 0 : i % 27);
+
+		FillData(data, (SBC_U32)i);
+		CHECK(record->Sequence == i);
+		CHECK(record->Timestamp == 100 + i * 4000000);
+		CHECK(record->Length == length);
+		CHECK(memcmp(SbcCaptureRecordData(record), data, length) == 0);
+		CHECK(memcmp(SbcCaptureRecordData(record) + length, zero, file.DataSize - length) == 0);
+	}
+	if (file.Count == 41)
+	{
+		CHECK(SbcCaptureFileRecord(&file, 40)->Sequence == 0);
+		CHECK(SbcCaptureFileRecord(&file, 40)->Length == SBC_INPUT_PACKET_SIZE);
+	}
+	SbcCaptureFileClose(&file);
+
+	// Records of another size can't be appended
+	CHECK(SbcCaptureWriterOpen(&writer, path, 0, 512) != 0);
+
+	// Records sized for 512 byte transfers keep them whole
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd >= 0) close(fd);
+	CHECK(SbcCaptureWriterOpen(&writer, path, 0, 512) == 0);
+	FillData(data, 7);
+	CHECK(SbcCaptureWriterAppend(&writer, 1, data, 512) == 0);
+	CHECK(SbcCaptureWriterAppend(&writer, 2, data, 300) == 0);
+	CHECK(SbcCaptureWriterClose(&writer) == 0);
+
+	CHECK(SbcCaptureFileOpen(&file, path) == 0);
+	CHECK(file.Count == 2 && file.DataSize == 512);
+	if (file.Count == 2)
+	{
+		CHECK(SbcCaptureFileRecord(&file, 0)->Length == 512);
+		CHECK(memcmp(SbcCaptureRecordData(SbcCaptureFileRecord(&file, 0)), data, 512) == 0);
+		CHECK(SbcCaptureFileRecord(&file, 1)->Length == 300);
+		CHECK(memcmp(SbcCaptureRecordData(SbcCaptureFileRecord(&file, 1)), data, 300) == 0);
+		CHECK(memcmp(SbcCaptureRecordData(SbcCaptureFileRecord(&file, 1)) + 300, zero, 212) == 0);
+	}
+	SbcCaptureFileClose(&file);
+
+	// Not a capture
+	fd = open(path, O_WRONLY | O_TRUNC);
+	CHECK(fd >= 0 && write(fd, "hello, this is not a capture file", 33) == 33);
+	if (fd >= 0) close(fd);
+	CHECK(SbcCaptureFileOpen(&file, path) != 0);
+
+	unlink(path);
+}
+
+int main(void)
+{
+	TestRecordSize();
+	TestRing(SBC_CAPTURE_MIN_DATA_SIZE);
+	TestRing(SBC_CAPTURE_MAX_DATA_SIZE);
+	TestFile();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbccapture_test passed\n");
+	return 0;
+}
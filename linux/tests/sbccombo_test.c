@@ -0,0 +1,332 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Combo engine: validation of the settings, chords with and without a
+// hold, exclusive chords, sequences with timeouts, aborts and pulses, the
+// early exit, and the virtual buttons going through the daemon in both
+// report modes.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbccombo.h"
+#include "sbcdaemon.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+#define MS                  (1000000ull)
+
+#define IGNITION            (1ull << 5)
+#define START               (1ull << 6)
+#define EJECT               (1ull << 3)
+#define COMM1               (1ull << 28)
+#define COMM2               (1ull << 29)
+#define COMM3               (1ull << 30)
+
+static void SetChord(SBC_COMBO_DEFINITION *Definition, SBC_U64 Buttons, SBC_U16 HoldMs, SBC_U8 Flags)
+{
+	memset(Definition, 0, sizeof(*Definition));
+	Definition->Type = SBC_COMBO_CHORD;
+	Definition->StepCount = 1;
+	Definition->HoldMs = HoldMs;
+	Definition->Flags = Flags;
+	SbcStoreButtonMask(Definition->Steps[0].Buttons, Buttons);
+}
+
+static void SetSequence(SBC_COMBO_DEFINITION *Definition, const SBC_U64 *Steps, SBC_U32 Count, SBC_U16 TimeoutMs, SBC_U16 PulseMs, SBC_U8 Flags)
+{
+	SBC_U32 i;
+
+	memset(Definition, 0, sizeof(*Definition));
+	Definition->Type = SBC_COMBO_SEQUENCE;
+	Definition->StepCount = (SBC_U8)Count;
+	Definition->PulseMs = PulseMs;
+	Definition->Flags = Flags;
+	for (i = 0; i < Count; ++i)
+	{
+		SbcStoreButtonMask(Definition->Steps[i].Buttons, Steps[i]);
+		Definition->Steps[i].TimeoutMs = TimeoutMs;
+	}
+}
+
+static void Compile(SBC_COMBO_TABLES *Tables, SBC_COMBO_STATE *State, const SBC_COMBO_SETTINGS *Settings)
+{
+	CHECK(SbcComboValidate(Settings));
+	SbcComboCompile(Tables, Settings);
+	SbcComboReset(State);
+}
+
+// Evaluates a report with these buttons and returns its virtual buttons
+static SBC_U8 Update(const SBC_COMBO_TABLES *Tables, SBC_COMBO_STATE *State, SBC_U64 Buttons, SBC_U64 Now, SBC_U32 *Matches)
+{
+	HIDFX2_INPUT_REPORT report;
+	SBC_U32 matches;
+
+	memset(&report, 0, sizeof(report));
+	SbcStoreButtonMask(&report.Buttons0, Buttons);
+	matches = SbcComboUpdate(Tables, State, SbcReportMode8Bit, &report, Now);
+	if (Matches != NULL) *Matches = matches;
+	CHECK(SbcLoadButtonMask(&report.Buttons0) == Buttons);
+	return report.VirtualButtons;
+}
+
+static void TestValidate(void)
+{
+	SBC_COMBO_SETTINGS settings;
+	SBC_COMBO_TABLES tables;
+	SBC_U64 steps[2] = { COMM1, COMM2 };
+
+	memset(&settings, 0, sizeof(settings));
+	CHECK(SbcComboValidate(&settings));
+	SbcComboCompile(&tables, &settings);
+	CHECK(tables.ChordCount == 0 && tables.SequenceCount == 0 && tables.Watch == 0);
+
+	SetChord(&settings.Combos[0], IGNITION | START, 0, 0);
+	SetSequence(&settings.Combos[3], steps, 2, 0, 0, SBC_COMBO_EXCLUSIVE);
+	CHECK(SbcComboValidate(&settings));
+	SbcComboCompile(&tables, &settings);
+	CHECK(tables.ChordCount == 1 && tables.SequenceCount == 1);
+	CHECK(tables.Chords[0].Bit == 1 && tables.Sequences[0].Bit == 8);
+	CHECK(tables.Watch == SBC_BUTTON_MASK);
+	CHECK(tables.Sequences[0].Steps[0].TimeoutNs == SBC_COMBO_NO_TIMEOUT);
+	CHECK(tables.Sequences[0].Steps[1].Abort == (SBC_BUTTON_MASK & ~COMM2));
+
+	settings.Combos[1].Type = SBC_COMBO_TYPE_COUNT;
+	CHECK(!SbcComboValidate(&settings));
+
+	SetChord(&settings.Combos[1], IGNITION, 0, 0);
+	settings.Combos[1].StepCount = 2;
+	CHECK(!SbcComboValidate(&settings));
+
+	SetChord(&settings.Combos[1], 0, 0, 0);
+	CHECK(!SbcComboValidate(&settings));
+
+	SetChord(&settings.Combos[1], 1ull << SBC_BUTTON_COUNT, 0, 0);
+	CHECK(!SbcComboValidate(&settings));
+
+	SetChord(&settings.Combos[1], IGNITION, 0, 0x80);
+	CHECK(!SbcComboValidate(&settings));
+
+	SetSequence(&settings.Combos[1], steps, 2, 0, 0, 0);
+	settings.Combos[1].StepCount = SBC_COMBO_MAX_STEPS + 1;
+	CHECK(!SbcComboValidate(&settings));
+
+	SetSequence(&settings.Combos[1], steps, 2, 0, 0, 0);
+	settings.Combos[1].Steps[1].Reserved = 1;
+	CHECK(!SbcComboValidate(&settings));
+
+	settings.Combos[1].Type = SBC_COMBO_OFF;
+	CHECK(SbcComboValidate(&settings));
+}
+
+static void TestChord(void)
+{
+	SBC_COMBO_SETTINGS settings;
+	SBC_COMBO_TABLES tables;
+	SBC_COMBO_STATE state;
+	SBC_U32 matches;
+
+	memset(&settings, 0, sizeof(settings));
+	SetChord(&settings.Combos[2], IGNITION | START, 0, 0);
+	SetChord(&settings.Combos[5], IGNITION | START, 100, 0);
+	SetChord(&settings.Combos[6], EJECT, 0, SBC_COMBO_EXCLUSIVE);
+	Compile(&tables, &state, &settings);
+
+	CHECK(Update(&tables, &state, IGNITION, 0, &matches) == 0 && matches == 0);
+	CHECK(Update(&tables, &state, IGNITION | START, 10 * MS, &matches) == 0x04 && matches == 1);
+
+	// Still held, the hold is counted from the chord and doesn't need a change
+	CHECK(Update(&tables, &state, IGNITION | START, 60 * MS, &matches) == 0x04 && matches == 0);
+	CHECK(Update(&tables, &state, IGNITION | START, 109 * MS, &matches) == 0x04);
+	CHECK(Update(&tables, &state, IGNITION | START, 110 * MS, &matches) == 0x24 && matches == 1);
+
+	// Other buttons don't break a chord that isn't exclusive
+	CHECK(Update(&tables, &state, IGNITION | START | COMM1, 120 * MS, &matches) == 0x24 && matches == 0);
+	CHECK(Update(&tables, &state, START | COMM1, 130 * MS, &matches) == 0);
+
+	// Held again, the hold starts over
+	CHECK(Update(&tables, &state, IGNITION | START, 140 * MS, NULL) == 0x04);
+	CHECK(Update(&tables, &state, IGNITION | START, 200 * MS, NULL) == 0x04);
+	CHECK(Update(&tables, &state, IGNITION | START, 240 * MS, NULL) == 0x24);
+	CHECK(Update(&tables, &state, 0, 250 * MS, NULL) == 0);
+
+	// Exclusive, only with nothing else held
+	CHECK(Update(&tables, &state, EJECT, 300 * MS, &matches) == 0x40 && matches == 1);
+	CHECK(Update(&tables, &state, EJECT | COMM3, 310 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, EJECT, 320 * MS, &matches) == 0x40 && matches == 1);
+}
+
+static void TestSequence(void)
+{
+	SBC_COMBO_SETTINGS settings;
+	SBC_COMBO_TABLES tables;
+	SBC_COMBO_STATE state;
+	SBC_U64 steps[3] = { COMM1, COMM2, COMM3 };
+	SBC_U32 matches;
+
+	memset(&settings, 0, sizeof(settings));
+	SetSequence(&settings.Combos[0], steps, 3, 300, 0, 0);
+	Compile(&tables, &state, &settings);
+
+	// In order, pressed while the last step is held
+	CHECK(Update(&tables, &state, COMM1, 0, NULL) == 0);
+	CHECK(Update(&tables, &state, 0, 50 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM2, 100 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, 0, 150 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM3, 200 * MS, &matches) == 1 && matches == 1);
+	CHECK(Update(&tables, &state, COMM3, 900 * MS, &matches) == 1 && matches == 0);
+	CHECK(Update(&tables, &state, 0, 950 * MS, NULL) == 0);
+
+	// Buttons outside the sequence don't matter
+	CHECK(Update(&tables, &state, COMM1, 1000 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, EJECT, 1050 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM2, 1100 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM3, 1200 * MS, NULL) == 1);
+	CHECK(Update(&tables, &state, 0, 1250 * MS, NULL) == 0);
+
+	// Out of order starts over
+	CHECK(Update(&tables, &state, COMM1, 2000 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM3, 2100 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM2, 2200 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM3, 2300 * MS, NULL) == 0);
+
+	// Starting over on the first step counts as the first step
+	CHECK(Update(&tables, &state, COMM1, 3000 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, 0, 3050 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM1, 3100 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM2, 3200 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM3, 3300 * MS, NULL) == 1);
+	CHECK(Update(&tables, &state, 0, 3350 * MS, NULL) == 0);
+
+	// Too slow
+	CHECK(Update(&tables, &state, COMM1, 4000 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM2, 4301 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM3, 4400 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, 0, 4500 * MS, NULL) == 0);
+
+	// Exactly on the timeout is still in time
+	CHECK(Update(&tables, &state, COMM1, 5000 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM2, 5300 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM3, 5600 * MS, NULL) == 1);
+}
+
+static void TestPulse(void)
+{
+	SBC_COMBO_SETTINGS settings;
+	SBC_COMBO_TABLES tables;
+	SBC_COMBO_STATE state;
+	SBC_U64 tap[2] = { EJECT, EJECT };
+	SBC_U64 exclusive[2] = { COMM1, COMM2 };
+
+	// Double tap, pressed for 50 ms
+	memset(&settings, 0, sizeof(settings));
+	SetSequence(&settings.Combos[7], tap, 2, 200, 50, 0);
+	SetSequence(&settings.Combos[1], exclusive, 2, 0, 50, SBC_COMBO_EXCLUSIVE);
+	Compile(&tables, &state, &settings);
+
+	CHECK(Update(&tables, &state, EJECT, 0, NULL) == 0);
+	CHECK(Update(&tables, &state, EJECT, 20 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, 0, 40 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, EJECT, 100 * MS, NULL) == 0x80);
+	CHECK(Update(&tables, &state, EJECT, 149 * MS, NULL) == 0x80);
+	CHECK(Update(&tables, &state, EJECT, 150 * MS, NULL) == 0);
+	CHECK(state.Timers == 0);
+	CHECK(Update(&tables, &state, 0, 200 * MS, NULL) == 0);
+
+	// Exclusive, any other button starts over
+	CHECK(Update(&tables, &state, COMM1, 1000 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM1 | IGNITION, 1010 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM1 | IGNITION | COMM2, 1020 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, 0, 1030 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM1, 1040 * MS, NULL) == 0);
+	CHECK(Update(&tables, &state, COMM1 | COMM2, 5000 * MS, NULL) == 0x02);
+}
+
+static void TestEarlyExit(void)
+{
+	SBC_COMBO_SETTINGS settings;
+	SBC_COMBO_TABLES tables;
+	SBC_COMBO_STATE state;
+	HIDFX2_INPUT_REPORT_16 report;
+
+	memset(&settings, 0, sizeof(settings));
+	SetChord(&settings.Combos[4], IGNITION | START, 0, 0);
+	Compile(&tables, &state, &settings);
+	CHECK(tables.Watch == (IGNITION | START));
+
+	CHECK(Update(&tables, &state, IGNITION | START, 0, NULL) == 0x10);
+	CHECK(state.Timers == 0);
+
+	// Unwatched buttons only store the virtual buttons, in the last byte
+	// of either report
+	memset(&report, 0, sizeof(report));
+	SbcStoreButtonMask(&report.Buttons0, IGNITION | START | COMM2);
+	report.Gear = -1;
+	CHECK(SbcComboUpdate(&tables, &state, SbcReportMode16Bit, &report, 10 * MS) == 0);
+	CHECK(report.VirtualButtons == 0x10 && report.Gear == -1);
+
+	// No combos, the report is left alone
+	memset(&settings, 0, sizeof(settings));
+	Compile(&tables, &state, &settings);
+	report.VirtualButtons = 0;
+	CHECK(SbcComboUpdate(&tables, &state, SbcReportMode16Bit, &report, 20 * MS) == 0);
+	CHECK(report.VirtualButtons == 0);
+}
+
+static void TestDaemon(SBC_REPORT_MODE Mode)
+{
+	SBC_COMBO_SETTINGS settings;
+	SBC_COMBO_TABLES tables;
+	SBC_DAEMON daemon;
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U32 size = SbcInputReportSize(Mode);
+	SBC_U64 buttons[4] = { 0, IGNITION, IGNITION | START, IGNITION };
+	SBC_U8 expected[4] = { 0, 0, 0x01, 0 };
+	SBC_U32 i;
+
+	memset(&settings, 0, sizeof(settings));
+	SetChord(&settings.Combos[0], IGNITION | START, 0, 0);
+	CHECK(SbcComboValidate(&settings));
+	SbcComboCompile(&tables, &settings);
+
+	SbcDaemonInit(&daemon, Mode);
+	daemon.Combos = &tables;
+
+	memset(packet, 0, sizeof(packet));
+	for (i = 0; i < 4; ++i)
+	{
+		SbcStoreButtonMask(packet + SBC_OFFSET_BUTTONS0, buttons[i]);
+		SbcDaemonTransferComplete(&daemon, packet, sizeof(packet), (i + 1) * 4 * MS);
+		CHECK(daemon.LatestSize == size);
+		CHECK(daemon.Latest[size - 1] == expected[i]);
+	}
+	CHECK(daemon.ComboMatches == 1);
+}
+
+int main(void)
+{
+	TestValidate();
+	TestChord();
+	TestSequence();
+	TestPulse();
+	TestEarlyExit();
+	TestDaemon(SbcReportMode8Bit);
+	TestDaemon(SbcReportMode16Bit);
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbccombo_test passed\n");
+	return 0;
+}
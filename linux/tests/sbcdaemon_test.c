@@ -0,0 +1,150 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Runs the daemon against the mock transport: every synthetic packet that
+// is not turned into a zero length or short transfer comes out as its
+// translated report, in order, and the counters add up.
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sbcdaemon.h"
+#include "sbcsynth.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+typedef struct _EXPECT
+{
+	SBC_SYNTH Synth;
+	SBC_REPORT_MODE Mode;
+	SBC_U64 Reports;
+	SBC_U64 Skipped;
+	int Mismatch;
+} EXPECT;
+
+static void CheckReport(void *Context, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Timestamp)
+{
+	EXPECT *expect = Context;
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U8 expected[SBC_MAX_INPUT_REPORT_SIZE];
+	int tries;
+
+	(void)Timestamp;
+
+	// Packets lost to fault injection are skipped. A report equal to the one
+	// of the next packet may match early, the order is still checked.
+	for (tries = 0; tries < 64; ++tries)
+	{
+		SbcSynthNext(&expect->Synth, packet);
+		if (SbcBuildInputReport(expect->Mode, packet, expected) == Size && memcmp(expected, Report, Size) == 0) break;
+		++expect->Skipped;
+	}
+	if (tries == 64) expect->Mismatch = 1;
+	++expect->Reports;
+}
+
+static void RunMock(SBC_REPORT_MODE Mode, SBC_U32 ZeroPermille, SBC_U32 ShortPermille)
+{
+	SBC_MOCK_CONFIG config;
+	SBC_TRANSPORT *transport;
+	SBC_DAEMON daemon;
+	SBC_STATE_SNAPSHOT snapshot;
+	SBC_SNAPSHOT_STATE state;
+	EXPECT expect;
+
+	memset(&config, 0, sizeof(config));
+	config.Rate = 1000;
+	config.Count = 20000;
+	config.Seed = 7;
+	config.ZeroPermille = ZeroPermille;
+	config.ShortPermille = ShortPermille;
+
+	transport = SbcMockTransportCreate(&config);
+	CHECK(transport != NULL);
+	if (transport == NULL) return;
+
+	memset(&expect, 0, sizeof(expect));
+	SbcSynthInit(&expect.Synth, config.Rate, config.Seed);
+	expect.Mode = Mode;
+
+	SbcDaemonInit(&daemon, Mode);
+	daemon.Sink = CheckReport;
+	daemon.SinkContext = &expect;
+	SbcSnapshotInit(&snapshot);
+	daemon.Snapshot = &snapshot;
+
+	CHECK(SbcDaemonRun(&daemon, transport, NULL) == 0);
+	CHECK(!expect.Mismatch);
+	CHECK(daemon.PacketsReceived == config.Count);
+	CHECK(daemon.Reports == expect.Reports);
+	CHECK(daemon.ZeroLengthReads + daemon.ShortReads + daemon.Reports == config.Count);
+	CHECK(expect.Skipped + expect.Reports <= config.Count);
+	CHECK(daemon.ZeroLengthReads + daemon.ShortReads >= expect.Skipped);
+	if (ZeroPermille != 0) CHECK(daemon.ZeroLengthReads > 0);
+	if (ShortPermille != 0) CHECK(daemon.ShortReads > 0);
+	if (ZeroPermille == 0 && ShortPermille == 0) CHECK(daemon.Reports == config.Count);
+	CHECK(daemon.Latency.Count == daemon.Reports);
+
+	// Every report was published, the last one is the latest
+	SbcSnapshotRead(&snapshot, &state);
+	CHECK(state.Published == daemon.Reports);
+	CHECK(state.Mode == (SBC_U32)Mode && state.Size == daemon.LatestSize);
+	CHECK(memcmp(state.Report, daemon.Latest, daemon.LatestSize) == 0);
+
+	SbcTransportDestroy(transport);
+}
+
+static void TestPaced(void)
+{
+	SBC_MOCK_CONFIG config;
+	SBC_TRANSPORT *transport;
+	SBC_DAEMON daemon;
+	SBC_U64 start, elapsed;
+
+	memset(&config, 0, sizeof(config));
+	config.Rate = 1000;
+	config.Count = 50;
+	config.Paced = 1;
+
+	transport = SbcMockTransportCreate(&config);
+	CHECK(transport != NULL);
+	if (transport == NULL) return;
+
+	SbcDaemonInit(&daemon, SbcReportMode8Bit);
+	start = SbcTransportNow();
+	CHECK(SbcDaemonRun(&daemon, transport, NULL) == 0);
+	elapsed = SbcTransportNow() - start;
+
+	// 50 packets at 1 kHz, the first one at time 0
+	CHECK(daemon.Reports == 50);
+	CHECK(elapsed >= 49000000ull);
+
+	SbcTransportDestroy(transport);
+}
+
+int main(void)
+{
+	RunMock(SbcReportMode8Bit, 0, 0);
+	RunMock(SbcReportMode16Bit, 0, 0);
+	RunMock(SbcReportMode8Bit, 20, 30);
+	RunMock(SbcReportMode16Bit, 50, 0);
+	TestPaced();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcdaemon_test passed\n");
+	return 0;
+}
@@ -0,0 +1,323 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Parses the generated report descriptors like hidclass would and checks
+// them against the report structures: the size of every report, the usage
+// and logical range of every input field in order, and the collections.
+// The split descriptors must have the same fields cut in the parts of
+// sbcsplit.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbcdescriptor.h"
+#include "sbcsplit.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static const SBC_U8 descriptor8[] = { SBC_REPORT_DESCRIPTOR(SBC_HID_AXES_8) };
+static const SBC_U8 descriptor16[] = { SBC_REPORT_DESCRIPTOR(SBC_HID_AXES_16) };
+static const SBC_U8 split8[] = { SBC_SPLIT_REPORT_DESCRIPTOR(SBC_HID_AXES_8) };
+static const SBC_U8 split16[] = { SBC_SPLIT_REPORT_DESCRIPTOR(SBC_HID_AXES_16) };
+
+#define MAX_FIELDS 64
+#define MAX_REPORT_ID 16
+
+typedef struct _FIELD
+{
+	SBC_U32 Usage;              // Page << 16 | usage, 0 for padding
+	SBC_S32 Minimum;
+	SBC_S32 Maximum;
+	SBC_U32 Bits;
+	SBC_U32 ReportId;
+} FIELD;
+
+typedef struct _PARSED
+{
+	SBC_U32 InputBits[MAX_REPORT_ID];
+	SBC_U32 OutputBits[MAX_REPORT_ID];
+	SBC_U32 FeatureBits[MAX_REPORT_ID];
+	FIELD Inputs[MAX_FIELDS];       // Input report fields, one per element
+	SBC_U32 InputCount;
+	SBC_U32 Collections;
+	int Valid;
+} PARSED;
+
+static SBC_S32 ItemSigned(const SBC_U8 *Data, SBC_U32 Size)
+{
+	switch (Size)
+	{
+	case 1: return (SBC_S8)Data[0];
+	case 2: return (SBC_S16)(Data[0] | (Data[1] << 8));
+	case 4: return (SBC_S32)(Data[0] | (Data[1] << 8) | (Data[2] << 16) | ((SBC_U32)Data[3] << 24));
+	default: return 0;
+	}
+}
+
+static SBC_U32 ItemUnsigned(const SBC_U8 *Data, SBC_U32 Size)
+{
+	switch (Size)
+	{
+	case 1: return Data[0];
+	case 2: return (SBC_U32)(Data[0] | (Data[1] << 8));
+	case 4: return (SBC_U32)(Data[0] | (Data[1] << 8) | (Data[2] << 16) | ((SBC_U32)Data[3] << 24));
+	default: return 0;
+	}
+}
+
+static void Parse(const SBC_U8 *Descriptor, size_t Length, PARSED *Parsed)
+{
+	SBC_U32 page = 0, reportId = 0, reportSize = 0, reportCount = 0;
+	SBC_S32 minimum = 0, maximum = 0;
+	SBC_U32 usages[MAX_FIELDS], usageCount = 0, usageMinimum = 0, usageMaximum = 0;
+	SBC_U32 depth = 0;
+	size_t i = 0;
+
+	memset(Parsed, 0, sizeof(*Parsed));
+	Parsed->Valid = 1;
+
+	while (i < Length)
+	{
+		SBC_U8 prefix = Descriptor[i];
+		SBC_U32 size = (prefix & 3) == 3 ? 4 : (prefix & 3);
+		const SBC_U8 *data = Descriptor + i + 1;
+		SBC_U32 value;
+		SBC_U32 j, elements;
+
+		if (i + 1 + size > Length)
+		{
+			Parsed->Valid = 0;
+			return;
+		}
+		value = ItemUnsigned(data, size);
+
+		switch (prefix & 0xfc)
+		{
+		case 0x04: page = value; break;
+		case 0x14: minimum = ItemSigned(data, size); break;
+		case 0x24: maximum = ItemSigned(data, size); break;
+		case 0x74: reportSize = value; break;
+		case 0x84: reportId = value; break;
+		case 0x94: reportCount = value; break;
+		case 0x08: if (usageCount < MAX_FIELDS) usages[usageCount++] = page << 16 | value; break;
+		case 0x18: usageMinimum = page << 16 | value; break;
+		case 0x28: usageMaximum = page << 16 | value; break;
+		case 0xa0: ++depth; ++Parsed->Collections; usageCount = 0; break;
+		case 0xc0: if (depth == 0) Parsed->Valid = 0; else --depth; break;
+
+		case 0x80:
+		case 0x90:
+		case 0xb0:
+			if (reportId >= MAX_REPORT_ID)
+			{
+				Parsed->Valid = 0;
+				return;
+			}
+			elements = reportSize * reportCount;
+			if ((prefix & 0xfc) == 0x90) Parsed->OutputBits[reportId] += elements;
+			else if ((prefix & 0xfc) == 0xb0) Parsed->FeatureBits[reportId] += elements;
+			else
+			{
+				Parsed->InputBits[reportId] += elements;
+				for (j = 0; j < reportCount && Parsed->InputCount < MAX_FIELDS; ++j)
+				{
+					FIELD *field = &Parsed->Inputs[Parsed->InputCount++];
+					if (value & 1) field->Usage = 0;
+					else if (usageMinimum != 0) field->Usage = usageMinimum + j;
+					else field->Usage = usages[j < usageCount ? j : usageCount - 1];
+					field->Minimum = minimum;
+					field->Maximum = maximum;
+					field->Bits = reportSize;
+					field->ReportId = reportId;
+				}
+				if (usageMinimum != 0) CHECK(usageMinimum + reportCount - 1 == usageMaximum);
+			}
+
+			// Local items only apply to the next main item
+			usageCount = 0;
+			usageMinimum = 0;
+			usageMaximum = 0;
+			break;
+
+		default:
+			break;
+		}
+
+		i += 1 + size;
+	}
+
+	if (depth != 0) Parsed->Valid = 0;
+}
+
+static int IsInput(SBC_U32 ReportId, int Split)
+{
+	return Split ? SbcSplitPartOf((SBC_U8)ReportId) >= 0 : ReportId == SBC_REPORT_ID_INPUT;
+}
+
+static void TestDescriptor(const SBC_U8 *Descriptor, size_t Length, SBC_REPORT_MODE Mode, int Split)
+{
+	static const SBC_U32 axisUsages[SbcAxisCount] =
+	{
+		0x00010030, 0x00010031, 0x00010032, 0x00010033, 0x00010034,     // X, Y, Z, Rx, Ry
+		0x00010036, 0x000200c5, 0x000200bb                              // Slider, Brake, Throttle
+	};
+	SBC_U32 axisBits = Mode == SbcReportMode16Bit ? 16 : 8;
+	PARSED parsed;
+	SBC_U32 i, field, offset;
+
+	Parse(Descriptor, Length, &parsed);
+	CHECK(parsed.Valid);
+	CHECK(parsed.Collections == 3);
+
+	if (Split)
+	{
+		for (i = 0; i < SbcSplitCount; ++i)
+		{
+			CHECK(parsed.InputBits[SbcSplitReportId((SBC_SPLIT_PART)i)] == SbcSplitSlice(Mode, (SBC_SPLIT_PART)i, &offset) * 8);
+		}
+	}
+	else
+	{
+		CHECK(parsed.InputBits[SBC_REPORT_ID_INPUT] == SbcInputReportSize(Mode) * 8);
+	}
+	CHECK(parsed.FeatureBits[SBC_REPORT_ID_LATENCY] == (sizeof(SBC_LATENCY_FEATURE_REPORT) - 1) * 8);
+	CHECK(parsed.OutputBits[SBC_REPORT_ID_LED] == SBC_LED_PACKET_SIZE * 8);
+	CHECK(parsed.FeatureBits[SBC_REPORT_ID_CALIBRATION] == (sizeof(SBC_CALIBRATION_FEATURE_REPORT) - 1) * 8);
+	CHECK(parsed.FeatureBits[SBC_REPORT_ID_REMAP] == (sizeof(SBC_REMAP_FEATURE_REPORT) - 1) * 8);
+	CHECK(parsed.FeatureBits[SBC_REPORT_ID_TRACE] == (sizeof(SBC_TRACE_FEATURE_REPORT) - 1) * 8);
+	CHECK(parsed.FeatureBits[SBC_REPORT_ID_STATS] == (sizeof(SBC_STATS_FEATURE_REPORT) - 1) * 8);
+
+	// Only the input reports are inputs, only the LEDs are an output
+	for (i = 0; i < MAX_REPORT_ID; ++i)
+	{
+		if (!IsInput(i, Split)) CHECK(parsed.InputBits[i] == 0);
+		if (i != SBC_REPORT_ID_LED) CHECK(parsed.OutputBits[i] == 0);
+		if (IsInput(i, Split) || i == SBC_REPORT_ID_LED) CHECK(parsed.FeatureBits[i] == 0);
+	}
+
+	// Buttons 1 to 39, one padding bit, 8 axes, tuner, gear and the virtual
+	// buttons
+	CHECK(parsed.InputCount == SBC_BUTTON_COUNT + 1 + SbcAxisCount + 2 + SBC_VIRTUAL_BUTTON_COUNT);
+	if (parsed.InputCount != SBC_BUTTON_COUNT + 1 + SbcAxisCount + 2 + SBC_VIRTUAL_BUTTON_COUNT) return;
+
+	// Split, the buttons and the padding, then the pointer axes, then the rest
+	for (field = 0; field < parsed.InputCount; ++field)
+	{
+		SBC_U32 expected = SBC_REPORT_ID_INPUT;
+		if (Split && field < SBC_BUTTON_COUNT + 1) expected = SBC_REPORT_ID_BUTTONS;
+		else if (Split && field < SBC_BUTTON_COUNT + 1 + SBC_POINTER_AXIS_COUNT) expected = SBC_REPORT_ID_STICKS;
+		else if (Split) expected = SBC_REPORT_ID_CONTROLS;
+		CHECK(parsed.Inputs[field].ReportId == expected);
+	}
+
+	for (field = 0; field < SBC_BUTTON_COUNT; ++field)
+	{
+		CHECK(parsed.Inputs[field].Usage == (0x00090000 | (field + 1)));
+		CHECK(parsed.Inputs[field].Bits == 1);
+		CHECK(parsed.Inputs[field].Minimum == 0 && parsed.Inputs[field].Maximum == 1);
+	}
+	CHECK(parsed.Inputs[field].Usage == 0 && parsed.Inputs[field].Bits == 1);
+	++field;
+
+	for (i = 0; i < SbcAxisCount; ++i, ++field)
+	{
+		CHECK(parsed.Inputs[field].Usage == axisUsages[i]);
+		CHECK(parsed.Inputs[field].Bits == axisBits);
+		CHECK(parsed.Inputs[field].Minimum == 0);
+		CHECK(parsed.Inputs[field].Maximum == (Mode == SbcReportMode16Bit ? 65535 : 255));
+	}
+
+	CHECK(parsed.Inputs[field].Usage == 0x000200c2);        // Weapons Select
+	CHECK(parsed.Inputs[field].Minimum == 0 && parsed.Inputs[field].Maximum == 255);
+	CHECK(parsed.Inputs[field].Bits == 8);
+	++field;
+
+	CHECK(parsed.Inputs[field].Usage == 0x000200c7);        // Shifter
+	CHECK(parsed.Inputs[field].Minimum == -128 && parsed.Inputs[field].Maximum == 127);
+	CHECK(parsed.Inputs[field].Bits == 8);
+	++field;
+
+	for (i = 0; i < SBC_VIRTUAL_BUTTON_COUNT; ++i, ++field)
+	{
+		CHECK(parsed.Inputs[field].Usage == (0x00090000 | (SBC_BUTTON_COUNT + 1 + i)));
+		CHECK(parsed.Inputs[field].Bits == 1);
+		CHECK(parsed.Inputs[field].Minimum == 0 && parsed.Inputs[field].Maximum == 1);
+	}
+}
+
+static void TestLayout(void)
+{
+	HIDFX2_INPUT_REPORT report;
+	HIDFX2_INPUT_REPORT_16 report16;
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+
+	CHECK(SBC_REPORT_BUTTON_BYTES == 5);
+	CHECK(SBC_POINTER_AXIS_COUNT == 5);
+	CHECK(SbcAxisCount == 8);
+	CHECK(SbcAxisThrottle == 7);
+
+	// The axis table agrees with the generated fields
+	CHECK(SbcAxisLayout[SbcAxisAimX].PacketOffset == SBC_OFFSET_AIMX);
+	CHECK(SbcAxisLayout[SbcAxisRotation].PacketOffset == SBC_OFFSET_ROTATION && SbcAxisLayout[SbcAxisRotation].Signed);
+	CHECK(!SbcAxisLayout[SbcAxisAimY].Signed && SbcAxisLayout[SbcAxisAimY].Centered);
+	CHECK(SbcAxisLayout[SbcAxisSightY].Centered && !SbcAxisLayout[SbcAxisClutch].Centered);
+	CHECK(SbcAxisLayout[SbcAxisThrottle].PacketOffset == SBC_OFFSET_THROTTLE && !SbcAxisLayout[SbcAxisThrottle].Signed);
+	CHECK(SbcAxisLayout[SbcAxisAimX].ReportOffset[SbcReportMode8Bit] == 5);
+	CHECK(SbcAxisLayout[SbcAxisThrottle].ReportOffset[SbcReportMode8Bit] == 12);
+	CHECK(SbcAxisLayout[SbcAxisThrottle].ReportOffset[SbcReportMode16Bit] == 19);
+
+	// Fields in the order of the descriptor
+	memset(packet, 0, sizeof(packet));
+	packet[SBC_OFFSET_BUTTONS0] = 0x11;
+	packet[SBC_OFFSET_BUTTONS4] = 0x44;
+	packet[SBC_OFFSET_AIMX + 1] = 0xAB;
+	packet[SBC_OFFSET_ROTATION + 1] = 0x80;
+	packet[SBC_OFFSET_THROTTLE] = 0x34;
+	packet[SBC_OFFSET_THROTTLE + 1] = 0x12;
+	packet[SBC_OFFSET_TUNER] = 7;
+	packet[SBC_OFFSET_GEAR] = (SBC_U8)-2;
+
+	SbcTranslateReport(packet, &report);
+	CHECK(((SBC_U8 *)&report)[0] == 0x11);
+	CHECK(((SBC_U8 *)&report)[4] == 0x44);
+	CHECK(((SBC_U8 *)&report)[5] == 0xAB);
+	CHECK(((SBC_U8 *)&report)[7] == 0x00);
+	CHECK(((SBC_U8 *)&report)[12] == 0x12);
+	CHECK(((SBC_U8 *)&report)[13] == 7);
+	CHECK(((SBC_S8 *)&report)[14] == -1);
+	CHECK(((SBC_U8 *)&report)[15] == 0);
+
+	SbcTranslateReport16(packet, &report16);
+	CHECK(((SBC_U8 *)&report16)[6] == 0xAB);
+	CHECK(((SBC_U8 *)&report16)[10] == 0x00);
+	CHECK(((SBC_U8 *)&report16)[19] == 0x34 && ((SBC_U8 *)&report16)[20] == 0x12);
+	CHECK(((SBC_U8 *)&report16)[21] == 7);
+	CHECK(((SBC_S8 *)&report16)[22] == -1);
+	CHECK(((SBC_U8 *)&report16)[23] == 0);
+}
+
+int main(void)
+{
+	TestLayout();
+	TestDescriptor(descriptor8, sizeof(descriptor8), SbcReportMode8Bit, 0);
+	TestDescriptor(descriptor16, sizeof(descriptor16), SbcReportMode16Bit, 0);
+	TestDescriptor(split8, sizeof(split8), SbcReportMode8Bit, 1);
+	TestDescriptor(split16, sizeof(split16), SbcReportMode16Bit, 1);
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcdescriptor_test passed (%u and %u bytes)\n", (unsigned)sizeof(descriptor8), (unsigned)sizeof(descriptor16));
+	return 0;
+}
@@ -0,0 +1,432 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Button event stream: the edges of consecutive reports in button order,
+// readers that fall behind, a writer at full speed under readers on other
+// threads that must see every event intact and in order, and a capture
+// replayed through the daemon whose events must match the edges of the
+// recorded packets one for one.
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbccapfile.h"
+#include "sbcdaemon.h"
+#include "sbcshm.h"
+#include "sbcsynth.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static void SetButtons(SBC_U8 *Report, SBC_U64 Buttons)
+{
+	SBC_U32 i;
+
+	for (i = 0; i < SBC_REPORT_BUTTON_BYTES; ++i) Report[i] = (SBC_U8)(Buttons >> (8 * i));
+}
+
+static void TestEdges(void)
+{
+	static SBC_EVENT_RING ring;
+	SBC_BUTTON_EVENT events[SBC_EVENT_RING_SIZE];
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 next = 0, lost = 1;
+
+	CHECK(SbcLowestBit(1) == 0);
+	CHECK(SbcLowestBit(0x80) == 7);
+	CHECK(SbcLowestBit(1ull << 38) == 38);
+	CHECK(SbcLowestBit(0xF000000000000000ull) == 60);
+
+	SbcEventRingInit(&ring);
+	CHECK(SbcEventRingValid(&ring));
+	CHECK(SbcEventRingRead(&ring, &next, events, SBC_EVENT_RING_SIZE, &lost) == 0);
+	CHECK(next == 0 && lost == 0);
+
+	// The first report presses what is already down, the axes don't count
+	memset(report, 0xA5, sizeof(report));
+	SetButtons(report, (1ull << 3) | (1ull << 20));
+	CHECK(SbcEventRingUpdate(&ring, report, 100) == 2);
+	CHECK(SbcEventRingRead(&ring, &next, events, SBC_EVENT_RING_SIZE, &lost) == 2);
+	CHECK(next == 2 && lost == 0);
+	CHECK(events[0].Sequence == 0 && events[0].Button == 3 && events[0].Pressed == 1 && events[0].Timestamp == 100);
+	CHECK(events[1].Sequence == 1 && events[1].Button == 20 && events[1].Pressed == 1 && events[1].Timestamp == 100);
+
+	// Same buttons, other axes: nothing
+	memset(report + SBC_REPORT_BUTTON_BYTES, 0x11, sizeof(report) - SBC_REPORT_BUTTON_BYTES);
+	CHECK(SbcEventRingUpdate(&ring, report, 200) == 0);
+
+	// A release and two presses in the same report, lowest button first.
+	// The bit past the last button is ignored.
+	SetButtons(report, (1ull << 0) | (1ull << 20) | (1ull << 38) | (1ull << 39));
+	CHECK(SbcEventRingUpdate(&ring, report, 300) == 3);
+	CHECK(SbcEventRingRead(&ring, &next, events, 2, &lost) == 2);
+	CHECK(events[0].Button == 0 && events[0].Pressed == 1);
+	CHECK(events[1].Button == 3 && events[1].Pressed == 0);
+	CHECK(SbcEventRingRead(&ring, &next, events, 2, &lost) == 1);
+	CHECK(events[0].Sequence == 4 && events[0].Button == 38 && events[0].Pressed == 1 && events[0].Timestamp == 300);
+	CHECK(next == 5 && ring.Head == 5);
+
+	ring.Magic = 0;
+	CHECK(!SbcEventRingValid(&ring));
+}
+
+static void TestLapped(void)
+{
+	static SBC_EVENT_RING ring;
+	SBC_BUTTON_EVENT events[SBC_EVENT_RING_SIZE];
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 next = 0, lost = 0, i;
+
+	SbcEventRingInit(&ring);
+	memset(report, 0, sizeof(report));
+
+	// 300 events, one per report
+	for (i = 0; i < 300; ++i)
+	{
+		report[0] ^= 1;
+		SbcEventRingUpdate(&ring, report, i);
+	}
+
+	// The oldest 44 are gone
+	CHECK(SbcEventRingRead(&ring, &next, events, SBC_EVENT_RING_SIZE, &lost) == SBC_EVENT_RING_SIZE);
+	CHECK(lost == 300 - SBC_EVENT_RING_SIZE);
+	CHECK(events[0].Sequence == 300 - SBC_EVENT_RING_SIZE && events[0].Timestamp == 300 - SBC_EVENT_RING_SIZE);
+	CHECK(events[SBC_EVENT_RING_SIZE - 1].Sequence == 299);
+	CHECK(next == 300);
+
+	// A reader from a ring that was created again is ahead of the writer
+	// and starts over at the oldest event
+	next = 1000;
+	CHECK(SbcEventRingRead(&ring, &next, events, SBC_EVENT_RING_SIZE, &lost) == SBC_EVENT_RING_SIZE);
+	CHECK(lost == 0 && events[0].Sequence == 300 - SBC_EVENT_RING_SIZE && next == 300);
+
+	// The numbering wraps around
+	SbcEventRingInit(&ring);
+	ring.Head = ring.Oldest = 0xFFFFFFF0u;
+	next = ring.Head;
+	for (i = 0; i < 32; ++i)
+	{
+		report[0] ^= 1;
+		SbcEventRingUpdate(&ring, report, i);
+	}
+	CHECK(SbcEventRingRead(&ring, &next, events, SBC_EVENT_RING_SIZE, &lost) == 32);
+	CHECK(lost == 0 && next == 16);
+	for (i = 0; i < 32; ++i) CHECK(events[i].Sequence == 0xFFFFFFF0u + i && events[i].Timestamp == i);
+
+	// Lapped across the wrap, the events before the oldest one still count
+	// as lost
+	SbcEventRingInit(&ring);
+	ring.Head = ring.Oldest = 0xFFFFFF00u;
+	next = ring.Head;
+	for (i = 0; i < 300; ++i)
+	{
+		report[0] ^= 1;
+		SbcEventRingUpdate(&ring, report, i);
+	}
+	CHECK(ring.Head == 44 && ring.Oldest == 0xFFFFFF00u + 44);
+	CHECK(SbcEventRingRead(&ring, &next, events, 16, &lost) == 16);
+	CHECK(lost == 44 && events[0].Sequence == 0xFFFFFF00u + 44 && events[0].Timestamp == 44);
+	CHECK(SbcEventRingRead(&ring, &next, events, SBC_EVENT_RING_SIZE, &lost) == SBC_EVENT_RING_SIZE - 16);
+	CHECK(lost == 0 && next == 44 && events[SBC_EVENT_RING_SIZE - 17].Timestamp == 299);
+
+	// Ahead of the writer across the wrap
+	next = 0x1000;
+	CHECK(SbcEventRingRead(&ring, &next, events, 1, &lost) == 1);
+	CHECK(lost == 0 && events[0].Sequence == 0xFFFFFF00u + 44);
+}
+
+//
+// The buttons of report N of the stress test, so a reader can tell whether
+// an event really is an edge of the report its timestamp names. They change
+// every fourth report, a few at a time.
+//
+static SBC_U64 StressButtons(SBC_U64 Index)
+{
+	SBC_U64 x = (Index >> 2) * 0x9E3779B97F4A7C15ull;
+
+	x ^= x >> 29;
+	return (x & (x >> 7) & (x >> 13)) & ((1ull << SBC_BUTTON_COUNT) - 1);
+}
+
+#define READERS             (4)
+#define REPORTS             (500000)
+
+static SBC_EVENT_RING shared;
+static volatile int done;
+
+typedef struct _READER
+{
+	pthread_t Thread;
+	SBC_U64 Events;
+	SBC_U64 Lost;
+	SBC_U64 Torn;
+	SBC_U64 Disordered;
+} READER;
+
+static void *Writer(void *Context)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U64 i;
+
+	(void)Context;
+	memset(report, 0, sizeof(report));
+	for (i = 1; i <= REPORTS; ++i)
+	{
+		SetButtons(report, StressButtons(i));
+		SbcEventRingUpdate(&shared, report, i);
+		if ((i & 255) == 0) sched_yield();
+	}
+	__atomic_store_n(&done, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static void *Reader(void *Context)
+{
+	READER *reader = Context;
+	SBC_BUTTON_EVENT events[32];
+	SBC_U64 previous, current, lastTimestamp = 0;
+	SBC_U32 next = 0, expected = 0, count, lost, i;
+	int last = 0;
+
+	for (;;)
+	{
+		count = SbcEventRingRead(&shared, &next, events, 32, &lost);
+		reader->Lost += lost;
+		expected += lost;
+
+		for (i = 0; i < count; ++i)
+		{
+			const SBC_BUTTON_EVENT *event = &events[i];
+
+			previous = event->Timestamp > 1 ? StressButtons(event->Timestamp - 1) : 0;
+			current = StressButtons(event->Timestamp);
+			if (event->Timestamp == 0 || event->Timestamp > REPORTS || event->Button >= SBC_BUTTON_COUNT ||
+				((previous ^ current) >> event->Button & 1) == 0 || (current >> event->Button & 1) != event->Pressed)
+			{
+				++reader->Torn;
+			}
+			if (event->Sequence != expected || event->Timestamp < lastTimestamp) ++reader->Disordered;
+			expected = event->Sequence + 1;
+			lastTimestamp = event->Timestamp;
+		}
+		reader->Events += count;
+
+		if (count != 0)
+		{
+			if ((reader->Events & 1023) < count) sched_yield();
+			continue;
+		}
+		if (last) break;
+		last = __atomic_load_n(&done, __ATOMIC_SEQ_CST);
+	}
+	return NULL;
+}
+
+static void TestStress(void)
+{
+	READER readers[READERS];
+	SBC_U64 events = 0, lost = 0;
+	pthread_t writer;
+	SBC_U32 i;
+
+	SbcEventRingInit(&shared);
+	memset(readers, 0, sizeof(readers));
+	for (i = 0; i < READERS; ++i) pthread_create(&readers[i].Thread, NULL, Reader, &readers[i]);
+	pthread_create(&writer, NULL, Writer, NULL);
+
+	pthread_join(writer, NULL);
+	for (i = 0; i < READERS; ++i)
+	{
+		pthread_join(readers[i].Thread, NULL);
+		CHECK(readers[i].Torn == 0);
+		CHECK(readers[i].Disordered == 0);
+		CHECK(readers[i].Events + readers[i].Lost == shared.Head);
+		events += readers[i].Events;
+		lost += readers[i].Lost;
+	}
+	printf("%u readers: %llu intact events, %llu lost to the writer lapping them, out of %u\n", READERS,
+		(unsigned long long)events, (unsigned long long)lost, shared.Head);
+}
+
+//
+// Replay: the sink runs right after the daemon pushed the events of a
+// report, so the events it reads must be exactly the edges between the
+// report of the previous packet and this one, with the completion time of
+// the transfer
+//
+typedef struct _REPLAY
+{
+	const SBC_CAPTURE_FILE *Capture;
+	const SBC_EVENT_RING *Ring;
+	SBC_REPORT_MODE Mode;
+	SBC_U64 Record;
+	SBC_U64 Buttons;
+	SBC_U32 Next;
+	SBC_U64 Events;
+	SBC_U64 Mismatches;
+} REPLAY;
+
+static void CheckEvents(void *Context, const SBC_U8 *Report, SBC_U32 Size, SBC_U64 Timestamp)
+{
+	REPLAY *replay = Context;
+	SBC_BUTTON_EVENT events[SBC_BUTTON_COUNT + 1];
+	SBC_U8 expected[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U64 buttons = 0, changed;
+	SBC_U32 count, lost, i;
+
+	SbcBuildInputReport(replay->Mode, SbcCaptureRecordData(SbcCaptureFileRecord(replay->Capture, replay->Record)), expected);
+	++replay->Record;
+	if (memcmp(expected, Report, Size) != 0) ++replay->Mismatches;
+
+	for (i = 0; i < SBC_REPORT_BUTTON_BYTES; ++i) buttons |= (SBC_U64)expected[i] << (8 * i);
+	buttons &= (1ull << SBC_BUTTON_COUNT) - 1;
+	changed = buttons ^ replay->Buttons;
+	replay->Buttons = buttons;
+
+	count = SbcEventRingRead(replay->Ring, &replay->Next, events, SBC_BUTTON_COUNT + 1, &lost);
+	if (lost != 0) ++replay->Mismatches;
+	for (i = 0; i < count; ++i)
+	{
+		if (changed == 0 || events[i].Button != SbcLowestBit(changed) || events[i].Timestamp != Timestamp ||
+			events[i].Pressed != ((buttons >> events[i].Button) & 1))
+		{
+			++replay->Mismatches;
+			break;
+		}
+		changed &= changed - 1;
+	}
+	if (changed != 0) ++replay->Mismatches;
+	replay->Events += count;
+}
+
+static void TestReplay(SBC_REPORT_MODE Mode)
+{
+	SBC_CAPTURE_WRITER writer;
+	SBC_CAPTURE_FILE capture;
+	SBC_SYNTH synth;
+	SBC_MOCK_CONFIG config;
+	SBC_TRANSPORT *transport;
+	SBC_DAEMON daemon;
+	REPLAY replay;
+	SBC_EVENT_RING *ring;
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	char path[64];
+	SBC_U32 i;
+
+	snprintf(path, sizeof(path), "/tmp/sbcevents_test-%ld.sbc", (long)getpid());
+
+	CHECK(SbcCaptureWriterOpen(&writer, path, 0, sizeof(packet)) == 0);
+	SbcSynthInit(&synth, 250, 11);
+	for (i = 0; i < 20000; ++i)
+	{
+		SbcSynthNext(&synth, packet);
+		SbcCaptureWriterAppend(&writer, (SBC_U64)i * 4000000, packet, sizeof(packet));
+	}
+	CHECK(SbcCaptureWriterClose(&writer) == 0);
+	CHECK(SbcCaptureFileOpen(&capture, path) == 0);
+	unlink(path);
+	if (capture.Count == 0) return;
+
+	memset(&config, 0, sizeof(config));
+	config.Capture = &capture;
+	transport = SbcMockTransportCreate(&config);
+	ring = calloc(1, sizeof(*ring));
+	CHECK(transport != NULL && ring != NULL);
+
+	if (transport != NULL && ring != NULL)
+	{
+		SbcEventRingInit(ring);
+
+		memset(&replay, 0, sizeof(replay));
+		replay.Capture = &capture;
+		replay.Ring = ring;
+		replay.Mode = Mode;
+
+		SbcDaemonInit(&daemon, Mode);
+		daemon.Events = ring;
+		daemon.Sink = CheckEvents;
+		daemon.SinkContext = &replay;
+
+		CHECK(SbcDaemonRun(&daemon, transport, NULL) == 0);
+		CHECK(replay.Record == capture.Count);
+		CHECK(replay.Mismatches == 0);
+		CHECK(replay.Events == ring->Head);
+		
+		// One button pressed for 100 ms every two seconds
+		CHECK(replay.Events == 80);
+	}
+
+	if (transport != NULL) SbcTransportDestroy(transport);
+	free(ring);
+	SbcCaptureFileClose(&capture);
+}
+
+static void TestShm(void)
+{
+	SBC_EVENT_RING *writer;
+	const SBC_EVENT_RING *reader;
+	SBC_BUTTON_EVENT events[4];
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 next = 0;
+	char name[64];
+
+	snprintf(name, sizeof(name), "/sbcevents_test-%ld", (long)getpid());
+
+	CHECK(SbcShmOpenEvents(name) == NULL && errno == ENOENT);
+
+	writer = SbcShmCreateEvents(name);
+	CHECK(writer != NULL);
+	if (writer == NULL) return;
+
+	reader = SbcShmOpenEvents(name);
+	CHECK(reader != NULL);
+	if (reader != NULL)
+	{
+		memset(report, 0, sizeof(report));
+		SetButtons(report, 1ull << 9);
+		SbcEventRingUpdate(writer, report, 42);
+		CHECK(SbcEventRingRead(reader, &next, events, 4, NULL) == 1);
+		CHECK(events[0].Button == 9 && events[0].Pressed == 1 && events[0].Timestamp == 42);
+		SbcShmCloseEvents(reader);
+	}
+
+	// A published state isn't an event ring
+	CHECK(SbcShmOpen(name) == NULL && errno == EINVAL);
+	writer->Magic = 0;
+	CHECK(SbcShmOpenEvents(name) == NULL && errno == EINVAL);
+
+	SbcShmCloseEvents(writer);
+	CHECK(SbcShmRemove(name) == 0);
+}
+
+int main(void)
+{
+	TestEdges();
+	TestLapped();
+	TestStress();
+	TestReplay(SbcReportMode8Bit);
+	TestReplay(SbcReportMode16Bit);
+	TestShm();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcevents_test passed\n");
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Latency histograms: bucket boundaries, percentiles against the exact
+// values of a sorted sample set, and the feature report.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbclatency.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static SBC_U64 XorShift64(SBC_U64 *State)
+{
+	SBC_U64 x = *State;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*State = x;
+	return x;
+}
+
+static int CompareU64(const void *A, const void *B)
+{
+	SBC_U64 a = *(const SBC_U64 *)A;
+	SBC_U64 b = *(const SBC_U64 *)B;
+	return a < b ? -1 : a > b;
+}
+
+static void TestBuckets(void)
+{
+	SBC_U32 i;
+
+	CHECK(SbcLatencyBucket(0) == 0);
+	CHECK(SbcLatencyBucket(1) == 0);
+	CHECK(SbcLatencyBucket(2) == 1);
+	CHECK(SbcLatencyBucket(3) == 1);
+	CHECK(SbcLatencyBucket(4) == 2);
+	for (i = 1; i < 64; ++i)
+	{
+		SBC_U64 low = 1ull << i;
+		SBC_U32 expected = i < SBC_LATENCY_BUCKETS ? i : SBC_LATENCY_BUCKETS - 1;
+		CHECK(SbcLog2(low) == i);
+		CHECK(SbcLog2(low - 1) == i - 1);
+		CHECK(SbcLatencyBucket(low) == expected);
+	}
+	CHECK(SbcLatencyBucket(~0ull) == SBC_LATENCY_BUCKETS - 1);
+}
+
+static void TestPercentiles(void)
+{
+	static SBC_U64 values[100000];
+	static const SBC_U32 permilles[] = { 1, 100, 500, 900, 990, 999, 1000 };
+	SBC_LATENCY_HISTOGRAM histogram;
+	SBC_U64 seed = 0x9e3779b97f4a7c15ull;
+	size_t count = sizeof(values) / sizeof(values[0]);
+	size_t i, j;
+
+	SbcLatencyInit(&histogram);
+	CHECK(SbcLatencyPercentile(&histogram, 500) == 0);
+
+	// Mostly sub millisecond with a long tail, like the read completions
+	for (i = 0; i < count; ++i)
+	{
+		SBC_U64 r = XorShift64(&seed);
+		values[i] = (r % 8 == 0) ? (r >> 8) % 50000000 : (r >> 8) % 400000;
+		SbcLatencyRecord(&histogram, values[i]);
+	}
+	qsort(values, count, sizeof(values[0]), CompareU64);
+
+	CHECK(histogram.Count == count);
+	CHECK(histogram.Max == values[count - 1]);
+
+	for (j = 0; j < sizeof(permilles) / sizeof(permilles[0]); ++j)
+	{
+		SBC_U64 rank = (count * permilles[j] + 999) / 1000;
+		SBC_U64 exact = values[rank - 1];
+		SBC_U64 estimate = SbcLatencyPercentile(&histogram, permilles[j]);
+
+		// Never under the exact value and within the bucket above it
+		CHECK(estimate >= exact);
+		CHECK(estimate <= 2 * exact + 1);
+	}
+	CHECK(SbcLatencyPercentile(&histogram, 1000) == values[count - 1]);
+
+	// A single value
+	SbcLatencyInit(&histogram);
+	SbcLatencyRecord(&histogram, 1500);
+	CHECK(SbcLatencyPercentile(&histogram, 500) == 1500);
+	CHECK(SbcLatencyPercentile(&histogram, 990) == 1500);
+}
+
+static void TestFeatureReport(void)
+{
+	SBC_LATENCY_HISTOGRAM delivery, wait;
+	SBC_LATENCY_FEATURE_REPORT report;
+	const SBC_U8 *bytes = (const SBC_U8 *)&report;
+	SBC_U32 i;
+
+	SbcLatencyInit(&delivery);
+	SbcLatencyInit(&wait);
+	for (i = 0; i < 99; ++i) SbcLatencyRecord(&delivery, 1000);
+	SbcLatencyRecord(&delivery, 100000);
+	SbcLatencyRecord(&wait, 0);
+	SbcLatencyRecord(&wait, 10000000000ull);    // 10 s saturates
+
+	memset(&report, 0xcc, sizeof(report));
+	SbcLatencyBuildFeatureReport(&delivery, &wait, &report);
+
+	CHECK(sizeof(report) == 289);
+	CHECK(bytes[0] == SBC_REPORT_ID_LATENCY);
+	CHECK(report.Delivery.Count == 100);
+	CHECK(report.Delivery.P50 == 1023);
+	CHECK(report.Delivery.P99 == 1023);
+	CHECK(report.Delivery.Max == 100000);
+	CHECK(report.Delivery.Buckets[9] == 99);
+	CHECK(report.Delivery.Buckets[16] == 1);
+	CHECK(report.ReadWait.Count == 2);
+	CHECK(report.ReadWait.P50 == 1);       // Upper bound of bucket 0
+	CHECK(report.ReadWait.Max == 0xffffffffu);
+	CHECK(report.ReadWait.Buckets[0] == 1);
+	CHECK(report.ReadWait.Buckets[SBC_LATENCY_BUCKETS - 1] == 1);
+
+	// Little endian on the wire
+	CHECK(bytes[1] == 100 && bytes[2] == 0 && bytes[3] == 0 && bytes[4] == 0);
+}
+
+int main(void)
+{
+	TestBuckets();
+	TestPercentiles();
+	TestFeatureReport();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbclatency_test passed\n");
+	return 0;
+}
@@ -0,0 +1,270 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// LED shadow against a mock interrupt OUT pipe. The mock plays the part of
+// sys/led.c: it polls the shadow after every write, when a frame completes
+// and when the rate limit timer expires, and keeps the frames the device
+// received.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sbcled.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+#define MS  (1000000ull)
+
+typedef struct _MOCK_PIPE
+{
+	SBC_LED_SHADOW Shadow;
+	SBC_U64 Now;
+	SBC_U64 TimerDue;               // 0 when the timer is not armed
+	SBC_U8 InFlight[SBC_LED_PACKET_SIZE];
+	int Busy;
+
+	// What the device received
+	SBC_U8 Device[SBC_LED_PACKET_SIZE];
+	SBC_U32 Received;
+} MOCK_PIPE;
+
+static void Kick(MOCK_PIPE *Pipe)
+{
+	SBC_U64 due;
+
+	if (SbcLedShadowPoll(&Pipe->Shadow, Pipe->Now, Pipe->InFlight, &due))
+	{
+		CHECK(!Pipe->Busy);
+		Pipe->Busy = 1;
+	}
+	else if (due != 0)
+	{
+		Pipe->TimerDue = due;
+	}
+}
+
+static void Init(MOCK_PIPE *Pipe, SBC_U64 MinIntervalNs)
+{
+	memset(Pipe, 0, sizeof(*Pipe));
+	SbcLedShadowInit(&Pipe->Shadow, MinIntervalNs);
+}
+
+static void Write(MOCK_PIPE *Pipe, const SBC_U8 *Leds)
+{
+	SbcLedShadowWrite(&Pipe->Shadow, Leds);
+	Kick(Pipe);
+}
+
+static void Complete(MOCK_PIPE *Pipe, int Success)
+{
+	CHECK(Pipe->Busy);
+	Pipe->Busy = 0;
+	if (Success)
+	{
+		memcpy(Pipe->Device, Pipe->InFlight, SBC_LED_PACKET_SIZE);
+		++Pipe->Received;
+	}
+	SbcLedShadowSendComplete(&Pipe->Shadow, Success);
+	if (Success) Kick(Pipe);
+}
+
+static void Advance(MOCK_PIPE *Pipe, SBC_U64 Ns)
+{
+	Pipe->Now += Ns;
+	if (Pipe->TimerDue != 0 && Pipe->Now >= Pipe->TimerDue)
+	{
+		Pipe->TimerDue = 0;
+		Kick(Pipe);
+	}
+}
+
+static void TestNibbles(void)
+{
+	SBC_U8 leds[SBC_LED_PACKET_SIZE];
+
+	memset(leds, 0, sizeof(leds));
+	SbcLedSet(leds, SbcLedEject, 15);
+	SbcLedSet(leds, SbcLedCockpitHatch, 3);
+	SbcLedSet(leds, SbcLedGear5, 99);
+	CHECK(leds[2] == 0x3F);
+	CHECK(leds[20] == 0xF0);
+	CHECK(SbcLedGet(leds, SbcLedEject) == 15);
+	CHECK(SbcLedGet(leds, SbcLedCockpitHatch) == 3);
+	CHECK(SbcLedGet(leds, SbcLedGear5) == 15);
+	CHECK(SbcLedCount == 42);
+
+	SbcLedSet(leds, SbcLedEject, 0);
+	CHECK(leds[2] == 0x30);
+}
+
+static void TestOnlyChanges(void)
+{
+	MOCK_PIPE pipe;
+	SBC_U8 leds[SBC_LED_PACKET_SIZE];
+
+	Init(&pipe, 0);
+	memset(leds, 0, sizeof(leds));
+
+	// The device state is unknown at first, the wanted state goes out
+	Kick(&pipe);
+	CHECK(pipe.Busy);
+	Complete(&pipe, 1);
+	CHECK(pipe.Received == 1);
+
+	// Writing what the device already shows sends nothing
+	Write(&pipe, leds);
+	Write(&pipe, leds);
+	CHECK(!pipe.Busy);
+	CHECK(pipe.Shadow.Unchanged == 2);
+
+	SbcLedSet(leds, SbcLedStart, 9);
+	Write(&pipe, leds);
+	CHECK(pipe.Busy);
+	Complete(&pipe, 1);
+	CHECK(pipe.Received == 2);
+	CHECK(memcmp(pipe.Device, leds, sizeof(leds)) == 0);
+	CHECK(!pipe.Busy);
+}
+
+static void TestInFlight(void)
+{
+	MOCK_PIPE pipe;
+	SBC_U8 leds[SBC_LED_PACKET_SIZE];
+	int i;
+
+	Init(&pipe, 0);
+	memset(leds, 0, sizeof(leds));
+
+	SbcLedSet(leds, SbcLedComm1, 1);
+	Write(&pipe, leds);
+	CHECK(pipe.Busy);
+
+	// Writes while a frame is in flight collapse into the latest one
+	for (i = 2; i <= 10; ++i)
+	{
+		SbcLedSet(leds, SbcLedComm1, (SBC_U32)i);
+		Write(&pipe, leds);
+	}
+	Complete(&pipe, 1);
+	CHECK(pipe.Busy);
+	Complete(&pipe, 1);
+	CHECK(!pipe.Busy);
+	CHECK(pipe.Received == 2);
+	CHECK(SbcLedGet(pipe.Device, SbcLedComm1) == 10);
+	CHECK(pipe.Shadow.Coalesced == 8);
+
+	// A write undoing the frame in flight is still sent after it
+	SbcLedSet(leds, SbcLedComm2, 5);
+	Write(&pipe, leds);
+	SbcLedSet(leds, SbcLedComm2, 0);
+	Write(&pipe, leds);
+	Complete(&pipe, 1);
+	CHECK(pipe.Busy);
+	Complete(&pipe, 1);
+	CHECK(!pipe.Busy);
+	CHECK(pipe.Received == 4);
+	CHECK(SbcLedGet(pipe.Device, SbcLedComm2) == 0);
+}
+
+static void TestRateLimit(void)
+{
+	MOCK_PIPE pipe;
+	SBC_U8 leds[SBC_LED_PACKET_SIZE];
+	SBC_U32 state = 1;
+	int i;
+
+	// 60 frames per second
+	Init(&pipe, 1000000000ull / 60);
+	memset(leds, 0, sizeof(leds));
+
+	Write(&pipe, leds);
+	Complete(&pipe, 1);
+
+	// A burst right after the first frame waits for the interval
+	for (i = 0; i < 100; ++i)
+	{
+		SbcLedSet(leds, SbcLedIgnition, (SBC_U32)i & 15);
+		SbcLedSet(leds, SbcLedGearN, (SBC_U32)(i >> 4) & 15);
+		Write(&pipe, leds);
+		Advance(&pipe, 100000);
+	}
+	CHECK(!pipe.Busy);
+	CHECK(pipe.TimerDue == 1000000000ull / 60);
+
+	Advance(&pipe, 10 * MS);
+	CHECK(pipe.Busy);
+	Complete(&pipe, 1);
+	CHECK(pipe.Received == 2);
+	CHECK(memcmp(pipe.Device, leds, sizeof(leds)) == 0);
+
+	// A game writing every LED at 2 kHz for a second
+	pipe.Received = 0;
+	for (i = 0; i < 2000; ++i)
+	{
+		state = state * 1103515245 + 12345;
+		SbcLedSet(leds, SbcLedEject + (state >> 16) % 38, (state >> 8) & 15);
+		Write(&pipe, leds);
+		if (pipe.Busy) Complete(&pipe, 1);
+		Advance(&pipe, MS / 2);
+	}
+	Advance(&pipe, 20 * MS);
+	if (pipe.Busy) Complete(&pipe, 1);
+
+	CHECK(pipe.Received <= 62);
+	CHECK(pipe.Received >= 55);
+	CHECK(memcmp(pipe.Device, leds, sizeof(leds)) == 0);
+}
+
+static void TestFailure(void)
+{
+	MOCK_PIPE pipe;
+	SBC_U8 leds[SBC_LED_PACKET_SIZE];
+
+	Init(&pipe, 0);
+	memset(leds, 0, sizeof(leds));
+
+	SbcLedSet(leds, SbcLedChaff, 7);
+	Write(&pipe, leds);
+	Complete(&pipe, 0);
+	CHECK(!pipe.Busy);
+	CHECK(pipe.Shadow.Failed == 1);
+
+	// The same state is sent again on the next poll
+	Write(&pipe, leds);
+	CHECK(pipe.Busy);
+	Complete(&pipe, 1);
+	CHECK(SbcLedGet(pipe.Device, SbcLedChaff) == 7);
+
+	// After a power cycle the device shows nothing, resend
+	SbcLedShadowReset(&pipe.Shadow);
+	memset(pipe.Device, 0, sizeof(pipe.Device));
+	Kick(&pipe);
+	CHECK(pipe.Busy);
+	Complete(&pipe, 1);
+	CHECK(SbcLedGet(pipe.Device, SbcLedChaff) == 7);
+}
+
+int main(void)
+{
+	TestNibbles();
+	TestOnlyChanges();
+	TestInFlight();
+	TestRateLimit();
+	TestFailure();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcled_test passed\n");
+	return 0;
+}
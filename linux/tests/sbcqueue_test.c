@@ -0,0 +1,242 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Report queue: capacity rounding, order, wrap around and overflow, and a
+// producer and a consumer thread moving reports through it at full speed.
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sbcqueue.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static SBC_REPORT_QUEUE queue;
+static SBC_QUEUED_REPORT entries[SBC_REPORT_QUEUE_MAX_DEPTH];
+
+//
+// Every report carries its sequence number and bytes derived from it, so a
+// report copied while its slot was being refilled is detected.
+//
+static void MakeReport(SBC_U32 Sequence, SBC_U8 *Report)
+{
+	SBC_U32 i;
+
+	memcpy(Report, &Sequence, sizeof(Sequence));
+	for (i = sizeof(Sequence); i < SBC_MAX_INPUT_REPORT_SIZE; ++i) Report[i] = (SBC_U8)(Sequence * 31 + i);
+}
+
+static int CheckReport(const SBC_QUEUED_REPORT *Entry, SBC_U32 *Sequence)
+{
+	SBC_U8 expected[SBC_MAX_INPUT_REPORT_SIZE];
+
+	memcpy(Sequence, Entry->Report, sizeof(*Sequence));
+	MakeReport(*Sequence, expected);
+	return Entry->Size == SBC_MAX_INPUT_REPORT_SIZE && Entry->Timestamp == *Sequence &&
+		memcmp(Entry->Report, expected, SBC_MAX_INPUT_REPORT_SIZE) == 0;
+}
+
+static void TestCapacity(void)
+{
+	CHECK(SbcReportQueueCapacity(0) == SBC_REPORT_QUEUE_MIN_DEPTH);
+	CHECK(SbcReportQueueCapacity(1) == 2);
+	CHECK(SbcReportQueueCapacity(2) == 2);
+	CHECK(SbcReportQueueCapacity(3) == 4);
+	CHECK(SbcReportQueueCapacity(1000) == 1024);
+	CHECK(SbcReportQueueCapacity(4096) == 4096);
+	CHECK(SbcReportQueueCapacity(100000) == SBC_REPORT_QUEUE_MAX_DEPTH);
+	CHECK(offsetof(SBC_REPORT_QUEUE, Tail) - offsetof(SBC_REPORT_QUEUE, Head) >= 64);
+}
+
+static void TestOrder(void)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_QUEUED_REPORT entry;
+	SBC_U32 i, sequence, next = 0;
+
+	SbcReportQueueInit(&queue, entries, 8);
+	CHECK(SbcReportQueueEmpty(&queue));
+	CHECK(!SbcReportQueuePop(&queue, &entry));
+
+	// Several laps, pushing 5 and taking 3 or 5 at a time
+	for (i = 0; i < 100; ++i)
+	{
+		SBC_U32 j;
+
+		for (j = 0; j < 5; ++j)
+		{
+			SBC_U32 seq = i * 5 + j;
+			MakeReport(seq, report);
+			SbcReportQueuePush(&queue, report, sizeof(report), seq);
+		}
+		for (j = 0; j < ((i & 1) ? 5u : 3u) && SbcReportQueuePop(&queue, &entry); ++j)
+		{
+			CHECK(CheckReport(&entry, &sequence));
+			CHECK(sequence >= next);
+			next = sequence + 1;
+		}
+	}
+	CHECK(queue.Queued + queue.Overflows == 500);
+	CHECK(queue.Overflows != 0);
+	CHECK(queue.HighWater == 8);
+
+	// Full: the new report is dropped, the queued ones are kept
+	while (SbcReportQueuePop(&queue, &entry)) {}
+	SbcReportQueueInit(&queue, entries, 4);
+	for (i = 0; i < 6; ++i)
+	{
+		MakeReport(i, report);
+		CHECK(SbcReportQueuePush(&queue, report, sizeof(report), i) == (i < 4));
+	}
+	CHECK(queue.Overflows == 2);
+	CHECK(SbcReportQueueCount(&queue) == 4);
+	for (i = 0; i < 4; ++i)
+	{
+		CHECK(SbcReportQueuePop(&queue, &entry));
+		CHECK(CheckReport(&entry, &sequence) && sequence == i);
+	}
+	CHECK(SbcReportQueueEmpty(&queue));
+}
+
+//
+// The producer either waits for room (lossless) or pushes regardless and
+// lets the ring count the overflows, giving the consumer a chance to run
+// every few reports even on a single processor. The consumer checks that the reports
+// come out whole and in order, and in the lossless case that none is
+// missing.
+//
+#define THREAD_REPORTS      (2000000)
+
+typedef struct _RUN
+{
+	int Lossless;
+	SBC_U32 Received;
+	SBC_U32 Bad;
+	SBC_U32 Gaps;
+	volatile int Done;
+} RUN;
+
+static void *Producer(void *Context)
+{
+	RUN *run = Context;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 i;
+
+	for (i = 0; i < THREAD_REPORTS; ++i)
+	{
+		MakeReport(i, report);
+		if (run->Lossless)
+		{
+			while (SbcReportQueueCount(&queue) > queue.Mask) sched_yield();
+		}
+		else if ((i & 63) == 0)
+		{
+			sched_yield();
+		}
+		SbcReportQueuePush(&queue, report, sizeof(report), i);
+	}
+	__atomic_store_n(&run->Done, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static void *Consumer(void *Context)
+{
+	RUN *run = Context;
+	SBC_QUEUED_REPORT entry;
+	SBC_U32 sequence, next = 0;
+
+	for (;;)
+	{
+		if (!SbcReportQueuePop(&queue, &entry))
+		{
+			if (__atomic_load_n(&run->Done, __ATOMIC_SEQ_CST) && SbcReportQueueEmpty(&queue)) break;
+			sched_yield();
+			continue;
+		}
+
+		if (!CheckReport(&entry, &sequence) || sequence < next) ++run->Bad;
+		else if (sequence != next) ++run->Gaps;
+		next = sequence + 1;
+		++run->Received;
+	}
+	return NULL;
+}
+
+static double Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void RunThreads(RUN *Run, SBC_U32 Capacity)
+{
+	pthread_t producer, consumer;
+	int lossless = Run->Lossless;
+	double start, elapsed;
+
+	memset(Run, 0, sizeof(*Run));
+	Run->Lossless = lossless;
+	SbcReportQueueInit(&queue, entries, Capacity);
+
+	start = Now();
+	pthread_create(&consumer, NULL, Consumer, Run);
+	pthread_create(&producer, NULL, Producer, Run);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	elapsed = Now() - start;
+
+	printf("%s, %u slots: %u reports received, %llu overflows, %.1f M reports/s pushed, %.1f M reports/s received\n",
+		Run->Lossless ? "lossless" : "overflowing", Capacity, Run->Received, (unsigned long long)queue.Overflows,
+		(double)THREAD_REPORTS / elapsed / 1e6, (double)Run->Received / elapsed / 1e6);
+}
+
+static void TestThreads(void)
+{
+	RUN run;
+
+	run.Lossless = 1;
+	RunThreads(&run, 1024);
+	CHECK(run.Bad == 0);
+	CHECK(run.Gaps == 0);
+	CHECK(run.Received == THREAD_REPORTS);
+	CHECK(queue.Overflows == 0);
+	CHECK(queue.Queued == THREAD_REPORTS);
+
+	run.Lossless = 0;
+	RunThreads(&run, 16);
+	CHECK(run.Bad == 0);
+	CHECK(run.Received == queue.Queued);
+	CHECK(queue.Queued + queue.Overflows == THREAD_REPORTS);
+	CHECK(run.Gaps <= queue.Overflows);
+}
+
+int main(void)
+{
+	TestCapacity();
+	TestOrder();
+	TestThreads();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcqueue_test passed\n");
+	return 0;
+}
@@ -0,0 +1,219 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Compiled remap tables against a bit by bit reference, on every value of
+// every button byte and on whole translated reports.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbcremap.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static SBC_REMAP_TABLES tables;
+
+static SBC_U32 Random(SBC_U32 *State)
+{
+	*State = *State * 1103515245 + 12345;
+	return *State >> 8;
+}
+
+static SBC_U64 Reference(SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES], SBC_U64 Buttons)
+{
+	SBC_U64 mask = 0;
+	SBC_U32 button;
+
+	for (button = 0; button < SBC_BUTTON_COUNT; ++button)
+	{
+		if (Buttons & (1ull << button)) mask |= SbcLoadButtonMask(Targets[button]);
+	}
+	return mask;
+}
+
+static SBC_U64 Remap(SBC_U64 Buttons)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+
+	memset(report, 0xA5, sizeof(report));
+	SbcStoreButtonMask(report, Buttons);
+	SbcRemapButtons(&tables, report);
+	CHECK(report[SBC_REPORT_BUTTON_BYTES] == 0xA5);
+	return SbcLoadButtonMask(report);
+}
+
+static void CheckAllBytes(SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES])
+{
+	SBC_U32 byte, value;
+
+	CHECK(SbcRemapValidate(Targets));
+	SbcRemapCompile(&tables, Targets);
+	for (byte = 0; byte < SBC_REPORT_BUTTON_BYTES; ++byte)
+	{
+		for (value = 0; value < 256; ++value)
+		{
+			SBC_U64 buttons = (SBC_U64)value << (8 * byte);
+			CHECK(Remap(buttons) == Reference(Targets, buttons));
+		}
+	}
+}
+
+static void TestIdentity(void)
+{
+	SBC_U8 targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+	SBC_U32 state = 7;
+	int i;
+
+	SbcRemapIdentity(targets);
+	CheckAllBytes(targets);
+
+	for (i = 0; i < 10000; ++i)
+	{
+		SBC_U64 buttons = ((SBC_U64)Random(&state) << 24) ^ Random(&state);
+		CHECK(Remap(buttons) == (buttons & SBC_BUTTON_MASK));
+	}
+}
+
+static void TestPermutation(void)
+{
+	SBC_U8 targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+	SBC_U32 button;
+
+	// Reverse the order of the buttons
+	for (button = 0; button < SBC_BUTTON_COUNT; ++button)
+	{
+		SbcStoreButtonMask(targets[button], 1ull << (SBC_BUTTON_COUNT - 1 - button));
+	}
+	CheckAllBytes(targets);
+	CHECK(Remap(1) == 1ull << 38);
+	CHECK(Remap(1ull << 38) == 1);
+	CHECK(Remap(SBC_BUTTON_MASK) == SBC_BUTTON_MASK);
+}
+
+static void TestDuplicateAndDisable(void)
+{
+	SBC_U8 targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+
+	SbcRemapIdentity(targets);
+	SbcStoreButtonMask(targets[3], (1ull << 3) | (1ull << 20) | (1ull << 37));
+	SbcStoreButtonMask(targets[10], 0);
+	SbcStoreButtonMask(targets[20], 0);
+	CheckAllBytes(targets);
+
+	CHECK(Remap(1ull << 3) == ((1ull << 3) | (1ull << 20) | (1ull << 37)));
+	CHECK(Remap(1ull << 10) == 0);
+	CHECK(Remap(1ull << 20) == 0);
+	CHECK(Remap((1ull << 10) | (1ull << 11)) == (1ull << 11));
+
+	// Two buttons mapped to the same one are ORed
+	SbcRemapIdentity(targets);
+	SbcStoreButtonMask(targets[0], 1ull << 5);
+	CheckAllBytes(targets);
+	CHECK(Remap(1) == 1ull << 5);
+	CHECK(Remap(1ull << 5) == 1ull << 5);
+	CHECK(Remap(1 | (1ull << 5)) == 1ull << 5);
+}
+
+static void TestRandomMappings(void)
+{
+	SBC_U8 targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+	SBC_U32 state = 12345;
+	SBC_U32 button;
+	int mapping, i;
+
+	for (mapping = 0; mapping < 50; ++mapping)
+	{
+		for (button = 0; button < SBC_BUTTON_COUNT; ++button)
+		{
+			SBC_U64 mask = ((SBC_U64)Random(&state) << 24) ^ Random(&state);
+
+			// Mostly single targets, sometimes several or none
+			if (mapping & 1) mask = (mask & 7) ? 1ull << (mask % SBC_BUTTON_COUNT) : (mask & 8 ? 0 : mask);
+			SbcStoreButtonMask(targets[button], mask & SBC_BUTTON_MASK);
+		}
+		CheckAllBytes(targets);
+
+		for (i = 0; i < 1000; ++i)
+		{
+			SBC_U64 buttons = (((SBC_U64)Random(&state) << 24) ^ Random(&state)) & SBC_BUTTON_MASK;
+			CHECK(Remap(buttons) == Reference(targets, buttons));
+		}
+	}
+}
+
+static void TestReport(void)
+{
+	SBC_U8 targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE];
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 expected[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 state = 99;
+	SBC_U32 button, size, i;
+	int n, mode;
+
+	for (button = 0; button < SBC_BUTTON_COUNT; ++button)
+	{
+		SbcStoreButtonMask(targets[button], 1ull << ((button * 7) % SBC_BUTTON_COUNT));
+	}
+	SbcRemapCompile(&tables, targets);
+
+	for (mode = SbcReportMode8Bit; mode <= SbcReportMode16Bit; ++mode)
+	{
+		for (n = 0; n < 1000; ++n)
+		{
+			for (i = 0; i < SBC_INPUT_PACKET_SIZE; ++i) packet[i] = (SBC_U8)Random(&state);
+
+			size = SbcBuildInputReport((SBC_REPORT_MODE)mode, packet, report);
+			memcpy(expected, report, size);
+			SbcStoreButtonMask(expected, Reference(targets, SbcLoadButtonMask(report)));
+
+			// Only the buttons change
+			SbcRemapButtons(&tables, report);
+			CHECK(memcmp(report, expected, size) == 0);
+		}
+	}
+}
+
+static void TestValidate(void)
+{
+	SBC_U8 targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+
+	SbcRemapIdentity(targets);
+	CHECK(SbcRemapValidate(targets));
+
+	SbcStoreButtonMask(targets[12], 1ull << SBC_BUTTON_COUNT);
+	CHECK(!SbcRemapValidate(targets));
+
+	memset(targets, 0, sizeof(targets));
+	CHECK(SbcRemapValidate(targets));
+
+	memset(targets, 0xFF, sizeof(targets));
+	CHECK(!SbcRemapValidate(targets));
+}
+
+int main(void)
+{
+	TestValidate();
+	TestIdentity();
+	TestPermutation();
+	TestDuplicateAndDisable();
+	TestRandomMappings();
+	TestReport();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcremap_test passed\n");
+	return 0;
+}
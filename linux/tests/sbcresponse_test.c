@@ -0,0 +1,409 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Conformance of the fixed point response curves against a double precision
+// reference of the same formulas. Every curve is checked over all the Q16
+// inputs, the radial pairs and whole reports over random values.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sbcresponse.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+// Largest error allowed, in Q16 units for the curves and in report units
+// for the reports. A report value is only known to half a unit, curves
+// steeper than 1 magnify that.
+#define CURVE_TOLERANCE     (2.0)
+#define REPORT_TOLERANCE    (2.0)
+
+static SBC_U32 state = 12345;
+
+static SBC_U32 Random(void)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static double RefCurve(const SBC_AXIS_RESPONSE_SETTINGS *Axis, double T)
+{
+	switch (Axis->Type)
+	{
+	case SBC_RESPONSE_EXPONENTIAL:
+	{
+		double k = Axis->Strength / 256.0;
+		if (Axis->Strength == 0) return T;
+		return (pow(2.0, k * T) - 1.0) / (pow(2.0, k) - 1.0);
+	}
+
+	case SBC_RESPONSE_SCURVE:
+	{
+		double k = Axis->Strength / 65536.0;
+		return T * (1.0 - k) + (3.0 * T * T - 2.0 * T * T * T) * k;
+	}
+
+	case SBC_RESPONSE_PIECEWISE:
+	{
+		double x0 = 0.0, y0 = 0.0;
+		int i;
+		for (i = 0; i <= Axis->PointCount; ++i)
+		{
+			double x1 = i < Axis->PointCount ? Axis->PointX[i] / 65536.0 : 1.0;
+			double y1 = i < Axis->PointCount ? Axis->PointY[i] / 65536.0 : 1.0;
+			if (T < x1 || i == Axis->PointCount) return y0 + (T - x0) * (y1 - y0) / (x1 - x0);
+			x0 = x1;
+			y0 = y1;
+		}
+		return T;
+	}
+
+	default:
+		return T;
+	}
+}
+
+static double RefAxial(const SBC_AXIS_RESPONSE_SETTINGS *Axis, double T)
+{
+	double deadzone = Axis->Deadzone / 65536.0;
+	double saturation = Axis->Saturation != 0 ? Axis->Saturation / 65536.0 : 1.0;
+	if (T <= deadzone) return 0.0;
+	T = (T - deadzone) / (saturation - deadzone);
+	return RefCurve(Axis, T > 1.0 ? 1.0 : T);
+}
+
+static void RefApply(const SBC_RESPONSE_SETTINGS *Settings, double *Travel)
+{
+	static const int pairs[SbcResponsePairCount][2] = { { SbcAxisAimX, SbcAxisAimY }, { SbcAxisSightX, SbcAxisSightY } };
+	unsigned handled = 0;
+	int pair, axis;
+
+	for (pair = 0; pair < SbcResponsePairCount; ++pair)
+	{
+		int ax = pairs[pair][0], ay = pairs[pair][1];
+		double deadzone = Settings->RadialDeadzone[pair] / 65536.0;
+		double saturation = Settings->RadialSaturation[pair] != 0 ? Settings->RadialSaturation[pair] / 65536.0 : 1.0;
+		double length, t;
+
+		if (Settings->RadialDeadzone[pair] == 0 && Settings->RadialSaturation[pair] == 0) continue;
+		handled |= (1u << ax) | (1u << ay);
+
+		length = sqrt(Travel[ax] * Travel[ax] + Travel[ay] * Travel[ay]);
+		if (length <= deadzone)
+		{
+			Travel[ax] = Travel[ay] = 0.0;
+			continue;
+		}
+		t = (length - deadzone) / (saturation - deadzone);
+		t = RefCurve(&Settings->Axes[ax], t > 1.0 ? 1.0 : t);
+		Travel[ax] *= t / length;
+		Travel[ay] *= t / length;
+	}
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		double m;
+		if (Settings->Axes[axis].Type == SBC_RESPONSE_OFF || (handled & (1u << axis))) continue;
+		m = RefAxial(&Settings->Axes[axis], fabs(Travel[axis]) > 1.0 ? 1.0 : fabs(Travel[axis]));
+		Travel[axis] = Travel[axis] < 0 ? -m : m;
+	}
+}
+
+static void Settings1(SBC_RESPONSE_SETTINGS *Settings, SBC_U32 Axis, SBC_U8 Type, SBC_U16 Strength, SBC_U16 Deadzone, SBC_U16 Saturation)
+{
+	SBC_AXIS_RESPONSE_SETTINGS *a = &Settings->Axes[Axis];
+	a->Type = Type;
+	a->Strength = Strength;
+	a->Deadzone = Deadzone;
+	a->Saturation = Saturation;
+}
+
+static void SetPoints(SBC_RESPONSE_SETTINGS *Settings, SBC_U32 Axis, SBC_U8 Count, const SBC_U16 *X, const SBC_U16 *Y)
+{
+	SBC_AXIS_RESPONSE_SETTINGS *a = &Settings->Axes[Axis];
+	a->Type = SBC_RESPONSE_PIECEWISE;
+	a->PointCount = Count;
+	memcpy(a->PointX, X, Count * sizeof(SBC_U16));
+	memcpy(a->PointY, Y, Count * sizeof(SBC_U16));
+}
+
+static double CheckCurve(const SBC_RESPONSE_SETTINGS *Settings, SBC_U32 Axis)
+{
+	SBC_RESPONSE response;
+	double worst = 0.0;
+	SBC_U32 t;
+
+	CHECK(SbcResponseValidate(Settings));
+	SbcResponsePrepare(&response, Settings);
+
+	for (t = 0; t <= SBC_RESPONSE_ONE; ++t)
+	{
+		double expected = RefAxial(&Settings->Axes[Axis], t / 65536.0) * 65536.0;
+		double error = fabs((double)SbcResponseAxial(&response.Axes[Axis], t) - expected);
+		if (error > worst) worst = error;
+	}
+	CHECK(worst <= CURVE_TOLERANCE);
+	return worst;
+}
+
+static void TestPrimitives(void)
+{
+	SBC_U32 e;
+	int i;
+
+	for (e = 0; e <= 8u << 24; e += 9473)
+	{
+		double expected = pow(2.0, e / 16777216.0);
+		double got = (double)SbcExp2Q30(e) / (double)(1 << 30);
+		CHECK(fabs(got - expected) / expected < 1e-8);
+	}
+
+	for (i = 0; i < 100000; ++i)
+	{
+		SBC_U64 v = ((SBC_U64)Random() << 32 | Random()) >> (Random() % 64);
+		SBC_U64 r = SbcSqrtU64(v);
+		CHECK(r * r <= v && (r + 1) * (r + 1) > v);
+	}
+	CHECK(SbcSqrtU64(0) == 0);
+	CHECK(SbcSqrtU64(2ull * 65536 * 65536) == 92681);
+}
+
+static void TestCurves(void)
+{
+	static const SBC_U16 x[] = { 8000, 20000, 30000, 40000, 52000, 60000 };
+	static const SBC_U16 y[] = { 2000, 9000, 30000, 28000, 50000, 65535 };
+	SBC_RESPONSE_SETTINGS settings;
+	SBC_U32 k;
+
+	memset(&settings, 0, sizeof(settings));
+
+	Settings1(&settings, SbcAxisAimX, SBC_RESPONSE_LINEAR, 0, 0, 0);
+	CHECK(CheckCurve(&settings, SbcAxisAimX) <= 1.0);
+	Settings1(&settings, SbcAxisAimX, SBC_RESPONSE_LINEAR, 0, 3000, 60000);
+	CheckCurve(&settings, SbcAxisAimX);
+
+	for (k = 1; k <= SBC_RESPONSE_MAX_EXPONENT; k += k < 16 ? 1 : 97)
+	{
+		Settings1(&settings, SbcAxisAimX, SBC_RESPONSE_EXPONENTIAL, (SBC_U16)k, 2000, 0);
+		CheckCurve(&settings, SbcAxisAimX);
+	}
+	Settings1(&settings, SbcAxisAimX, SBC_RESPONSE_EXPONENTIAL, SBC_RESPONSE_MAX_EXPONENT, 0, 0);
+	CheckCurve(&settings, SbcAxisAimX);
+
+	for (k = 0; k <= 65535; k += 4369)
+	{
+		Settings1(&settings, SbcAxisClutch, SBC_RESPONSE_SCURVE, (SBC_U16)k, 500, 64000);
+		CheckCurve(&settings, SbcAxisClutch);
+	}
+
+	for (k = 0; k <= SBC_RESPONSE_MAX_POINTS; ++k)
+	{
+		SetPoints(&settings, SbcAxisThrottle, (SBC_U8)k, x, y);
+		CheckCurve(&settings, SbcAxisThrottle);
+	}
+}
+
+static void TestValidate(void)
+{
+	static const SBC_U16 x[] = { 100, 100 };
+	static const SBC_U16 y[] = { 100, 200 };
+	SBC_RESPONSE_SETTINGS settings;
+
+	memset(&settings, 0, sizeof(settings));
+	CHECK(SbcResponseValidate(&settings));
+
+	settings.Axes[0].Type = SBC_RESPONSE_TYPE_COUNT;
+	CHECK(!SbcResponseValidate(&settings));
+
+	Settings1(&settings, 0, SBC_RESPONSE_LINEAR, 0, 5000, 5000);
+	CHECK(!SbcResponseValidate(&settings));
+
+	Settings1(&settings, 0, SBC_RESPONSE_EXPONENTIAL, SBC_RESPONSE_MAX_EXPONENT + 1, 0, 0);
+	CHECK(!SbcResponseValidate(&settings));
+
+	SetPoints(&settings, 0, 2, x, y);
+	CHECK(!SbcResponseValidate(&settings));
+	settings.Axes[0].PointCount = SBC_RESPONSE_MAX_POINTS + 1;
+	CHECK(!SbcResponseValidate(&settings));
+
+	// Radial pairs need both axes
+	memset(&settings, 0, sizeof(settings));
+	settings.RadialDeadzone[SbcResponsePairSight] = 1000;
+	Settings1(&settings, SbcAxisSightX, SBC_RESPONSE_LINEAR, 0, 0, 0);
+	CHECK(!SbcResponseValidate(&settings));
+	Settings1(&settings, SbcAxisSightY, SBC_RESPONSE_LINEAR, 0, 0, 0);
+	CHECK(SbcResponseValidate(&settings));
+	settings.RadialSaturation[SbcResponsePairSight] = 900;
+	CHECK(!SbcResponseValidate(&settings));
+}
+
+static void TestRadial(void)
+{
+	SBC_RESPONSE_SETTINGS settings;
+	SBC_RESPONSE response;
+	double worst = 0.0;
+	int i;
+
+	memset(&settings, 0, sizeof(settings));
+	Settings1(&settings, SbcAxisAimX, SBC_RESPONSE_EXPONENTIAL, 3 * 256, 0, 0);
+	Settings1(&settings, SbcAxisAimY, SBC_RESPONSE_LINEAR, 0, 0, 0);
+	Settings1(&settings, SbcAxisSightX, SBC_RESPONSE_SCURVE, 40000, 0, 0);
+	Settings1(&settings, SbcAxisSightY, SBC_RESPONSE_SCURVE, 40000, 0, 0);
+	settings.RadialDeadzone[SbcResponsePairAim] = 6000;
+	settings.RadialSaturation[SbcResponsePairAim] = 62000;
+	settings.RadialDeadzone[SbcResponsePairSight] = 3000;
+	CHECK(SbcResponseValidate(&settings));
+	SbcResponsePrepare(&response, &settings);
+	CHECK(response.RadialMask == 3);
+
+	// Inside the circle nothing moves, even on a diagonal where each axis
+	// alone is past an axial deadzone of the same size
+	{
+		SBC_S32 travel[SbcAxisCount] = { 4000, -4000, 0, 2000, 2000, 0, 0, 0 };
+		SbcResponseApply(&response, travel);
+		CHECK(travel[SbcAxisAimX] == 0 && travel[SbcAxisAimY] == 0);
+		CHECK(travel[SbcAxisSightX] == 0 && travel[SbcAxisSightY] == 0);
+	}
+
+	for (i = 0; i < 200000; ++i)
+	{
+		SBC_S32 travel[SbcAxisCount];
+		double reference[SbcAxisCount];
+		int axis;
+
+		for (axis = 0; axis < SbcAxisCount; ++axis)
+		{
+			travel[axis] = (SBC_S32)(Random() % (2 * SBC_RESPONSE_ONE + 1)) - SBC_RESPONSE_ONE;
+			if (axis >= SbcAxisClutch) travel[axis] = travel[axis] < 0 ? -travel[axis] : travel[axis];
+			reference[axis] = travel[axis] / 65536.0;
+		}
+
+		SbcResponseApply(&response, travel);
+		RefApply(&settings, reference);
+
+		for (axis = 0; axis < SbcAxisCount; ++axis)
+		{
+			double error = fabs(travel[axis] - reference[axis] * 65536.0);
+			if (error > worst) worst = error;
+		}
+	}
+	CHECK(worst <= CURVE_TOLERANCE);
+}
+
+static void TestReports(SBC_REPORT_MODE Mode)
+{
+	static const SBC_U16 x[] = { 10000, 30000, 50000 };
+	static const SBC_U16 y[] = { 2000, 20000, 60000 };
+	SBC_RESPONSE_SETTINGS settings;
+	SBC_RESPONSE response;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 original[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 *axes = report + SBC_REPORT_BUTTON_BYTES;
+	double half = Mode == SbcReportMode16Bit ? 32768.0 : 128.0;
+	double worst = 0.0;
+	SBC_U32 size = SbcInputReportSize(Mode);
+	SBC_U32 i, j;
+	int axis;
+
+	// Linear without deadzones gives back every report value
+	memset(&settings, 0, sizeof(settings));
+	for (axis = 0; axis < SbcAxisCount; ++axis) Settings1(&settings, (SBC_U32)axis, SBC_RESPONSE_LINEAR, 0, 0, 0);
+	SbcResponsePrepare(&response, &settings);
+	for (i = 0; i < (Mode == SbcReportMode16Bit ? 65536u : 256u); ++i)
+	{
+		memset(report, 0, sizeof(report));
+		for (axis = 0; axis < SbcAxisCount; ++axis)
+		{
+			if (Mode == SbcReportMode16Bit)
+			{
+				axes[2 * axis] = (SBC_U8)i;
+				axes[2 * axis + 1] = (SBC_U8)(i >> 8);
+			}
+			else
+			{
+				axes[axis] = (SBC_U8)i;
+			}
+		}
+		memcpy(original, report, size);
+		SbcResponseApplyReport(&response, Mode, report);
+		CHECK(memcmp(report, original, size) == 0);
+	}
+
+	// One of each on random reports
+	memset(&settings, 0, sizeof(settings));
+	Settings1(&settings, SbcAxisAimX, SBC_RESPONSE_EXPONENTIAL, 2 * 256, 0, 0);
+	Settings1(&settings, SbcAxisAimY, SBC_RESPONSE_LINEAR, 0, 0, 0);
+	settings.RadialDeadzone[SbcResponsePairAim] = 4000;
+	Settings1(&settings, SbcAxisRotation, SBC_RESPONSE_SCURVE, 65535, 2000, 0);
+	Settings1(&settings, SbcAxisSightX, SBC_RESPONSE_EXPONENTIAL, 512, 1500, 63000);
+	SetPoints(&settings, SbcAxisSightY, 3, x, y);
+	Settings1(&settings, SbcAxisBrake, SBC_RESPONSE_LINEAR, 0, 4000, 60000);
+	SetPoints(&settings, SbcAxisThrottle, 3, x, y);
+	CHECK(SbcResponseValidate(&settings));
+	SbcResponsePrepare(&response, &settings);
+
+	for (i = 0; i < 100000; ++i)
+	{
+		double reference[SbcAxisCount];
+
+		for (j = 0; j < size; ++j) report[j] = (SBC_U8)Random();
+		memcpy(original, report, size);
+
+		for (axis = 0; axis < SbcAxisCount; ++axis)
+		{
+			double v = Mode == SbcReportMode16Bit ? (double)(axes[2 * axis] | (axes[2 * axis + 1] << 8)) : (double)axes[axis];
+			reference[axis] = axis <= SbcAxisSightY ? (v - half) / half : v / (2.0 * half - 1.0);
+		}
+		RefApply(&settings, reference);
+
+		SbcResponseApplyReport(&response, Mode, report);
+
+		CHECK(memcmp(report, original, SBC_REPORT_BUTTON_BYTES) == 0);
+		CHECK(memcmp(report + size - 2, original + size - 2, 2) == 0);
+		for (axis = 0; axis < SbcAxisCount; ++axis)
+		{
+			double v = Mode == SbcReportMode16Bit ? (double)(axes[2 * axis] | (axes[2 * axis + 1] << 8)) : (double)axes[axis];
+			double expected;
+
+			if (settings.Axes[axis].Type == SBC_RESPONSE_OFF)
+			{
+				CHECK(Mode == SbcReportMode16Bit ? memcmp(axes + 2 * axis, original + SBC_REPORT_BUTTON_BYTES + 2 * axis, 2) == 0 : axes[axis] == original[SBC_REPORT_BUTTON_BYTES + axis]);
+				continue;
+			}
+
+			expected = axis <= SbcAxisSightY ? half + reference[axis] * half : reference[axis] * (2.0 * half - 1.0);
+			if (expected > 2.0 * half - 1.0) expected = 2.0 * half - 1.0;
+			if (fabs(v - expected) > worst) worst = fabs(v - expected);
+		}
+	}
+	CHECK(worst <= REPORT_TOLERANCE);
+}
+
+int main(void)
+{
+	TestPrimitives();
+	TestCurves();
+	TestValidate();
+	TestRadial();
+	TestReports(SbcReportMode8Bit);
+	TestReports(SbcReportMode16Bit);
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcresponse_test passed\n");
+	return 0;
+}
@@ -0,0 +1,249 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Fixed point axis smoothing against a double precision one euro filter,
+// and the packet level behaviour: disabled axes, restarts after a gap and
+// packets out of order.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sbcsmooth.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+#define PI                  (3.14159265358979323846)
+
+// Largest differences from the reference: smoothing factors in Q24 units,
+// filtered values in raw units (1/256 of an 8 bit report unit). The speed
+// is rounded at every step and the adaptive cutoff magnifies that.
+#define ALPHA_TOLERANCE     (4.0)
+#define STEP_TOLERANCE      (8.0)
+
+static SBC_U32 state = 12345;
+
+static SBC_U32 Random(void)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static double RefAlpha(double Cutoff, double Dt)
+{
+	double a = 2.0 * PI * Cutoff * Dt;
+	return a / (1.0 + a);
+}
+
+typedef struct _REF_FILTER
+{
+	double MinCutoff, Beta, DerivativeCutoff;   // Hz, Hz per full travel per second
+	double Value, Speed;
+} REF_FILTER;
+
+static double RefStep(REF_FILTER *Filter, double X, double Dt)
+{
+	double speed, cutoff;
+
+	if (Dt == 0.0)
+	{
+		Filter->Value = X;
+		Filter->Speed = 0.0;
+		return X;
+	}
+
+	speed = (X - Filter->Value) / Dt;
+	Filter->Speed += RefAlpha(Filter->DerivativeCutoff, Dt) * (speed - Filter->Speed);
+	cutoff = Filter->MinCutoff + Filter->Beta * fabs(Filter->Speed) / 65536.0;
+	if (cutoff > SBC_SMOOTH_MAX_CUTOFF / 100.0) cutoff = SBC_SMOOTH_MAX_CUTOFF / 100.0;
+	Filter->Value += RefAlpha(cutoff, Dt) * (X - Filter->Value);
+	return Filter->Value;
+}
+
+static void TestAlpha(void)
+{
+	static const SBC_U32 cutoffs[] = { 1, 10, 100, 150, 1000, 2500, 10000, SBC_SMOOTH_MAX_CUTOFF };
+	static const SBC_U64 dts[] = { SBC_SMOOTH_MIN_DT_NS, 125000, 1000000, 4000000, 8000000, 33000000, SBC_SMOOTH_MAX_GAP_NS };
+	double worst = 0.0;
+	size_t i, j;
+
+	for (i = 0; i < sizeof(cutoffs) / sizeof(cutoffs[0]); ++i)
+	{
+		for (j = 0; j < sizeof(dts) / sizeof(dts[0]); ++j)
+		{
+			double ref = RefAlpha(cutoffs[i] / 100.0, dts[j] * 1e-9) * (1 << SBC_SMOOTH_ALPHA_BITS);
+			double error = fabs(SbcSmoothAlpha(cutoffs[i], dts[j]) - ref);
+			if (error > worst) worst = error;
+		}
+	}
+	CHECK(worst <= ALPHA_TOLERANCE);
+	printf("alpha: worst error %.2f/%u\n", worst, 1u << SBC_SMOOTH_ALPHA_BITS);
+}
+
+//
+// A stick that rests with noise, moves slowly, flicks and rests again,
+// sampled with jittery intervals
+//
+static void TestStep(SBC_U16 MinCutoff, SBC_U16 Beta, SBC_U16 DerivativeCutoff)
+{
+	SBC_SMOOTH_AXIS axis;
+	REF_FILTER ref;
+	double worst = 0.0;
+	double target = 20000.0;
+	SBC_U32 i;
+
+	memset(&axis, 0, sizeof(axis));
+	axis.MinCutoff = MinCutoff;
+	axis.Beta = Beta;
+	axis.DerivativeCutoff = DerivativeCutoff;
+
+	memset(&ref, 0, sizeof(ref));
+	ref.MinCutoff = MinCutoff / 100.0;
+	ref.Beta = Beta / 100.0;
+	ref.DerivativeCutoff = DerivativeCutoff / 100.0;
+
+	for (i = 0; i < 20000; ++i)
+	{
+		SBC_U64 dt = i == 0 ? 0 : 900000 + Random() % 200000;
+		SBC_U32 raw;
+		double error;
+
+		if (i % 4000 == 1000) target = (double)(Random() % 65536);         // Flick
+		else if (i % 4000 < 2000) target += (i & 1024) ? 3.0 : -3.0;      // Slow move
+		if (target < 0.0) target = 0.0;
+		if (target > 65535.0) target = 65535.0;
+
+		raw = (SBC_U32)target + Random() % 129 - 64;
+		if ((SBC_S32)raw < 0) raw = 0;
+		if (raw > 65535) raw = 65535;
+
+		error = fabs((double)SbcSmoothStep(&axis, raw, dt) - RefStep(&ref, raw, dt * 1e-9));
+		if (error > worst) worst = error;
+	}
+	CHECK(worst <= STEP_TOLERANCE);
+	printf("step %u/%u/%u: worst error %.2f\n", MinCutoff, Beta, DerivativeCutoff, worst);
+}
+
+static void TestJitter(void)
+{
+	SBC_SMOOTH_AXIS axis;
+	SBC_U32 i, last = 0, rawChanges = 0, changes = 0, lastRaw = 0;
+
+	memset(&axis, 0, sizeof(axis));
+	axis.MinCutoff = 100;
+	axis.Beta = 50;
+	axis.DerivativeCutoff = 100;
+
+	// A few LSBs of noise around the center, in 8 bit report units
+	for (i = 0; i < 4000; ++i)
+	{
+		SBC_U32 raw = 0x8000 - 0x40 + Random() % 0x180;
+		SBC_U32 out = SbcSmoothStep(&axis, raw, i == 0 ? 0 : 1000000);
+
+		if (i > 500)
+		{
+			if ((out >> 8) != last) ++changes;
+			if ((raw >> 8) != lastRaw) ++rawChanges;
+		}
+		last = out >> 8;
+		lastRaw = raw >> 8;
+	}
+	CHECK(rawChanges > 1000);
+	CHECK(changes * 20 < rawChanges);
+	printf("jitter: %u changes of the 8 bit value at rest, %u without smoothing\n", changes, rawChanges);
+}
+
+static void TestPacket(void)
+{
+	SBC_SMOOTH_SETTINGS settings;
+	SBC_SMOOTH smooth;
+	SBC_U8 packet[SBC_INPUT_PACKET_SIZE], original[SBC_INPUT_PACKET_SIZE];
+	SBC_U32 i;
+
+	memset(&settings, 0, sizeof(settings));
+	CHECK(SbcSmoothValidate(&settings));
+	settings.Axes[SbcAxisSightX].MinCutoff = 100;
+	settings.Axes[SbcAxisSightX].Beta = 100;
+	settings.Axes[SbcAxisThrottle].MinCutoff = 100;
+	SbcSmoothPrepare(&smooth, &settings);
+	CHECK(smooth.EnabledMask == ((1u << SbcAxisSightX) | (1u << SbcAxisThrottle)));
+	CHECK(smooth.Axes[SbcAxisSightX].DerivativeCutoff == SBC_SMOOTH_DEFAULT_DERIVATIVE_CUTOFF);
+
+	settings.Axes[0].Reserved = 1;
+	CHECK(!SbcSmoothValidate(&settings));
+
+	// The layout round trips, signed axes offset
+	for (i = 0; i < SBC_INPUT_PACKET_SIZE; ++i) packet[i] = (SBC_U8)(Random());
+	for (i = 0; i < SbcAxisCount; ++i)
+	{
+		SBC_U32 v = SbcSmoothLoadAxis(packet, i);
+		memcpy(original, packet, sizeof(packet));
+		SbcSmoothStoreAxis(packet, i, v);
+		CHECK(memcmp(original, packet, sizeof(packet)) == 0);
+	}
+	packet[SBC_OFFSET_SIGHTX] = 0;
+	packet[SBC_OFFSET_SIGHTX + 1] = 0;
+	CHECK(SbcSmoothLoadAxis(packet, SbcAxisSightX) == 0x8000);
+
+	// First packet goes through, then only the enabled axes move
+	memset(packet, 0, sizeof(packet));
+	SbcSmoothPacket(&smooth, packet, 1000000000);
+	CHECK(SbcSmoothLoadAxis(packet, SbcAxisThrottle) == 0);
+
+	memset(packet, 0xff, sizeof(packet));
+	packet[SBC_OFFSET_SIGHTX + 1] = 0x7f;
+	memcpy(original, packet, sizeof(packet));
+	SbcSmoothPacket(&smooth, packet, 1004000000);
+	CHECK(SbcSmoothLoadAxis(packet, SbcAxisThrottle) > 0 && SbcSmoothLoadAxis(packet, SbcAxisThrottle) < 0x8000);
+	CHECK(SbcSmoothLoadAxis(packet, SbcAxisSightX) > 0x8000 && SbcSmoothLoadAxis(packet, SbcAxisSightX) < 0xc000);
+	CHECK(SbcSmoothLoadAxis(packet, SbcAxisAimX) == 0xffff);
+	CHECK(memcmp(packet, original, SBC_OFFSET_SIGHTX) == 0);
+	CHECK(packet[SBC_OFFSET_TUNER] == 0xff && packet[SBC_OFFSET_GEAR] == 0xff);
+
+	// Out of order counts as a very short interval, the clock doesn't go back
+	memcpy(packet, original, sizeof(packet));
+	SbcSmoothPacket(&smooth, packet, 1002000000);
+	CHECK(smooth.LastTime == 1004000000);
+
+	// After a gap the filters restart at the new value
+	memcpy(packet, original, sizeof(packet));
+	SbcSmoothPacket(&smooth, packet, 1004000000 + SBC_SMOOTH_MAX_GAP_NS + 1);
+	CHECK(memcmp(packet, original, sizeof(packet)) == 0);
+
+	// Nothing enabled leaves the packet alone
+	memset(&settings, 0, sizeof(settings));
+	SbcSmoothPrepare(&smooth, &settings);
+	SbcSmoothPacket(&smooth, packet, 2000000000);
+	CHECK(memcmp(packet, original, sizeof(packet)) == 0);
+	CHECK(!smooth.HaveLast);
+}
+
+int main(void)
+{
+	TestAlpha();
+	TestStep(100, 0, 100);
+	TestStep(100, 100, 100);
+	TestStep(50, 1000, 200);
+	TestStep(1000, 5000, 100);
+	TestStep(30000, 65535, 10000);
+	TestJitter();
+	TestPacket();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcsmooth_test passed\n");
+	return 0;
+}
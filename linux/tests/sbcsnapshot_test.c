@@ -0,0 +1,220 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Published state: the sequence lock protocol, a writer publishing at full
+// speed under readers on several threads that must never see a torn copy,
+// and the shared memory object of the daemon.
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbcshm.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+//
+// Every report carries bytes derived from its timestamp, so a copy that
+// mixes two reports is detected
+//
+static void MakeReport(SBC_U64 Timestamp, SBC_U8 *Report)
+{
+	SBC_U32 i;
+
+	for (i = 0; i < SBC_MAX_INPUT_REPORT_SIZE; ++i) Report[i] = (SBC_U8)(Timestamp * 131 + i * 7);
+}
+
+static int CheckState(const SBC_SNAPSHOT_STATE *State)
+{
+	SBC_U8 expected[SBC_MAX_INPUT_REPORT_SIZE];
+
+	MakeReport(State->Timestamp, expected);
+	return State->Size == SBC_MAX_INPUT_REPORT_SIZE && State->Mode == SbcReportMode16Bit &&
+		State->Published == State->Timestamp + 1 && memcmp(State->Report, expected, sizeof(expected)) == 0;
+}
+
+static void TestProtocol(void)
+{
+	SBC_STATE_SNAPSHOT snapshot;
+	SBC_SNAPSHOT_STATE state;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+
+	SbcSnapshotInit(&snapshot);
+	CHECK(SbcSnapshotValid(&snapshot));
+	CHECK(SbcSnapshotRead(&snapshot, &state) == 0);
+	CHECK(state.Size == 0 && state.Published == 0);
+
+	MakeReport(0, report);
+	SbcSnapshotPublish(&snapshot, SbcReportMode16Bit, report, sizeof(report), 0);
+	CHECK(snapshot.Sequence == 2);
+	CHECK(SbcSnapshotTryRead(&snapshot, &state));
+	CHECK(CheckState(&state));
+
+	MakeReport(1, report);
+	SbcSnapshotPublish(&snapshot, SbcReportMode16Bit, report, sizeof(report), 1);
+	CHECK(SbcSnapshotTryRead(&snapshot, &state));
+	CHECK(CheckState(&state) && state.Published == 2);
+
+	// A writer in the middle of an update, or one that got in between the
+	// two loads, makes the reader try again
+	snapshot.Sequence = 5;
+	CHECK(!SbcSnapshotTryRead(&snapshot, &state));
+	snapshot.Sequence = 6;
+	CHECK(SbcSnapshotTryRead(&snapshot, &state));
+
+	snapshot.Magic = 0;
+	CHECK(!SbcSnapshotValid(&snapshot));
+}
+
+#define READERS             (4)
+#define WRITES              (2000000)
+
+static SBC_STATE_SNAPSHOT shared;
+static volatile int done;
+
+typedef struct _READER
+{
+	pthread_t Thread;
+	SBC_U64 Reads;
+	SBC_U64 Retries;
+	SBC_U64 Torn;
+	SBC_U64 Backwards;
+} READER;
+
+static void *Writer(void *Context)
+{
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U64 i;
+
+	(void)Context;
+	for (i = 0; i < WRITES; ++i)
+	{
+		MakeReport(i, report);
+		SbcSnapshotPublish(&shared, SbcReportMode16Bit, report, sizeof(report), i);
+
+		// Let the readers run in the middle of the writes on a single
+		// processor too
+		if ((i & 255) == 0) sched_yield();
+	}
+	__atomic_store_n(&done, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static void *Reader(void *Context)
+{
+	READER *reader = Context;
+	SBC_SNAPSHOT_STATE state;
+	SBC_U64 last = 0;
+
+	while (!__atomic_load_n(&done, __ATOMIC_SEQ_CST))
+	{
+		reader->Retries += SbcSnapshotRead(&shared, &state);
+		++reader->Reads;
+		if (state.Published == 0) continue;
+
+		if (!CheckState(&state)) ++reader->Torn;
+		if (state.Published < last) ++reader->Backwards;
+		last = state.Published;
+
+		if ((reader->Reads & 1023) == 0) sched_yield();
+	}
+	return NULL;
+}
+
+static void TestStress(void)
+{
+	READER readers[READERS];
+	SBC_SNAPSHOT_STATE state;
+	SBC_U64 reads = 0, retries = 0;
+	pthread_t writer;
+	SBC_U32 i;
+
+	SbcSnapshotInit(&shared);
+	memset(readers, 0, sizeof(readers));
+	for (i = 0; i < READERS; ++i) pthread_create(&readers[i].Thread, NULL, Reader, &readers[i]);
+	pthread_create(&writer, NULL, Writer, NULL);
+
+	pthread_join(writer, NULL);
+	for (i = 0; i < READERS; ++i)
+	{
+		pthread_join(readers[i].Thread, NULL);
+		CHECK(readers[i].Torn == 0);
+		CHECK(readers[i].Backwards == 0);
+		reads += readers[i].Reads;
+		retries += readers[i].Retries;
+	}
+
+	CHECK(SbcSnapshotRead(&shared, &state) == 0);
+	CHECK(CheckState(&state) && state.Published == WRITES);
+	printf("%u readers: %llu consistent reads, %llu retried, during %u writes\n", READERS,
+		(unsigned long long)reads, (unsigned long long)retries, WRITES);
+}
+
+static void TestShm(void)
+{
+	SBC_STATE_SNAPSHOT *writer;
+	const SBC_STATE_SNAPSHOT *reader;
+	SBC_SNAPSHOT_STATE state;
+	SBC_U8 report[SBC_MAX_INPUT_REPORT_SIZE];
+	char name[64];
+
+	snprintf(name, sizeof(name), "/sbcsnapshot_test-%ld", (long)getpid());
+
+	CHECK(SbcShmOpen(name) == NULL && errno == ENOENT);
+
+	writer = SbcShmCreate(name);
+	CHECK(writer != NULL);
+	if (writer == NULL) return;
+
+	reader = SbcShmOpen(name);
+	CHECK(reader != NULL);
+	if (reader != NULL)
+	{
+		// Two mappings of the same object
+		CHECK((const void *)reader != (const void *)writer);
+		MakeReport(41, report);
+		SbcSnapshotPublish(writer, SbcReportMode16Bit, report, sizeof(report), 41);
+		MakeReport(42, report);
+		SbcSnapshotPublish(writer, SbcReportMode16Bit, report, sizeof(report), 42);
+		SbcSnapshotRead(reader, &state);
+		CHECK(state.Timestamp == 42 && state.Published == 2);
+		CHECK(memcmp(state.Report, report, sizeof(report)) == 0);
+		SbcShmClose(reader);
+	}
+
+	// Something that isn't a snapshot is refused
+	writer->Magic = 0;
+	CHECK(SbcShmOpen(name) == NULL && errno == EINVAL);
+
+	SbcShmClose(writer);
+	CHECK(SbcShmRemove(name) == 0);
+	CHECK(SbcShmOpen(name) == NULL);
+}
+
+int main(void)
+{
+	TestProtocol();
+	TestStress();
+	TestShm();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcsnapshot_test passed\n");
+	return 0;
+}
@@ -0,0 +1,177 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Split input reports: the parts cover the full report in order in both
+// modes, a change only marks its part, and the cache hands out the pending
+// parts one read at a time so that the parts a reader has put together
+// always match the latest report.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sbcsplit.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static void TestSlices(SBC_REPORT_MODE Mode)
+{
+	SBC_U32 part, offset, size, next = 0;
+
+	for (part = 0; part < SbcSplitCount; ++part)
+	{
+		size = SbcSplitSlice(Mode, (SBC_SPLIT_PART)part, &offset);
+		CHECK(offset == next);
+		CHECK(size > 0);
+		next = offset + size;
+		CHECK(SbcSplitPartOf(SbcSplitReportId((SBC_SPLIT_PART)part)) == (int)part);
+	}
+	CHECK(next == SbcInputReportSize(Mode));
+
+	CHECK(SbcSplitSlice(Mode, SbcSplitButtons, &offset) == SBC_REPORT_BUTTON_BYTES);
+	CHECK(SbcSplitSlice(Mode, SbcSplitSticks, &offset) == (Mode == SbcReportMode16Bit ? 10u : 5u));
+	CHECK(SbcSplitSlice(Mode, SbcSplitControls, &offset) == (Mode == SbcReportMode16Bit ? 9u : 6u));
+
+	CHECK(SbcSplitPartOf(SBC_REPORT_ID_INPUT) == -1);
+	CHECK(SbcSplitPartOf(SBC_REPORT_ID_STATS) == -1);
+}
+
+static void TestChanges(void)
+{
+	HIDFX2_INPUT_REPORT a, b;
+
+	memset(&a, 0, sizeof(a));
+	b = a;
+	CHECK(SbcSplitChanges(SbcReportMode8Bit, &a, &b) == 0);
+
+	b.Buttons4 = 0x40;
+	CHECK(SbcSplitChanges(SbcReportMode8Bit, &a, &b) == 1u << SbcSplitButtons);
+
+	b = a;
+	b.SightY = 1;
+	CHECK(SbcSplitChanges(SbcReportMode8Bit, &a, &b) == 1u << SbcSplitSticks);
+
+	b = a;
+	b.Clutch = 1;
+	CHECK(SbcSplitChanges(SbcReportMode8Bit, &a, &b) == 1u << SbcSplitControls);
+	b.Clutch = 0;
+	b.Gear = -1;
+	CHECK(SbcSplitChanges(SbcReportMode8Bit, &a, &b) == 1u << SbcSplitControls);
+	b.Gear = a.Gear;
+	b.VirtualButtons = 1;
+	CHECK(SbcSplitChanges(SbcReportMode8Bit, &a, &b) == 1u << SbcSplitControls);
+
+	b.Buttons0 = 1;
+	b.AimX = 1;
+	CHECK(SbcSplitChanges(SbcReportMode8Bit, &a, &b) == SBC_SPLIT_ALL);
+}
+
+//
+// Applies the parts taken from the cache to what the reader has, like an
+// application keeping the state from the reports it gets
+//
+static SBC_U32 Drain(SBC_REPORT_CACHE *Cache, SBC_REPORT_MODE Mode, SBC_U8 *Reader, SBC_U32 Reads)
+{
+	SBC_U8 part[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 id = 0;
+	SBC_U32 taken = 0, size, offset;
+	int index;
+
+	while (taken < Reads && (size = SbcSplitCacheTake(Cache, Mode, &id, part)) != 0)
+	{
+		index = SbcSplitPartOf(id);
+		CHECK(index >= 0);
+		if (index < 0) break;
+		CHECK(SbcSplitSlice(Mode, (SBC_SPLIT_PART)index, &offset) == size);
+		memcpy(Reader + offset, part, size);
+		++taken;
+	}
+	return taken;
+}
+
+static void TestCache(void)
+{
+	SBC_REPORT_CACHE cache;
+	HIDFX2_INPUT_REPORT_16 report, reader;
+	SBC_U8 part[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 id = 0;
+	SBC_U32 i, size = sizeof(report);
+
+	SbcReportCacheInit(&cache);
+	memset(&report, 0, sizeof(report));
+	memset(&reader, 0, sizeof(reader));
+
+	// Nothing changed and no read waiting: nothing to send
+	CHECK(SbcSplitCacheStore(&cache, SbcReportMode16Bit, &report, size, 0) == 0);
+	CHECK(SbcSplitCacheTake(&cache, SbcReportMode16Bit, &id, part) == 0);
+	CHECK(!cache.Dirty);
+
+	// Nothing changed with a read waiting: the buttons go again
+	CHECK(SbcSplitCacheStore(&cache, SbcReportMode16Bit, &report, size, 1) == 1u << SbcSplitButtons);
+	CHECK(SbcSplitCacheTake(&cache, SbcReportMode16Bit, &id, part) == SBC_REPORT_BUTTON_BYTES);
+	CHECK(id == SBC_REPORT_ID_BUTTONS);
+	CHECK(!cache.Dirty);
+
+	// A button edge is one small report
+	report.Buttons1 = 0x08;
+	CHECK(SbcSplitCacheStore(&cache, SbcReportMode16Bit, &report, size, 1) == 1u << SbcSplitButtons);
+	CHECK(Drain(&cache, SbcReportMode16Bit, (SBC_U8 *)&reader, 8) == 1);
+	CHECK(memcmp(&reader, &report, size) == 0);
+
+	// Two parts with one read: the other one waits for the next read, and
+	// a newer report in between is merged into it
+	report.AimY = 0x1234;
+	report.Throttle = 0x4321;
+	CHECK(SbcSplitCacheStore(&cache, SbcReportMode16Bit, &report, size, 1) == ((1u << SbcSplitSticks) | (1u << SbcSplitControls)));
+	CHECK(Drain(&cache, SbcReportMode16Bit, (SBC_U8 *)&reader, 1) == 1);
+	CHECK(cache.Dirty && cache.DirtyParts == 1u << SbcSplitControls);
+	report.Throttle = 0x4322;
+	report.Tuner = 3;
+	CHECK(SbcSplitCacheStore(&cache, SbcReportMode16Bit, &report, size, 0) == 1u << SbcSplitControls);
+	CHECK(cache.Dropped == 1);
+	CHECK(Drain(&cache, SbcReportMode16Bit, (SBC_U8 *)&reader, 8) == 1);
+	CHECK(memcmp(&reader, &report, size) == 0);
+
+	// Going back to what the reader has leaves nothing pending
+	report.Buttons0 = 1;
+	SbcSplitCacheStore(&cache, SbcReportMode16Bit, &report, size, 0);
+	report.Buttons0 = 0;
+	CHECK(SbcSplitCacheStore(&cache, SbcReportMode16Bit, &report, size, 0) == 0);
+	CHECK(!cache.Dirty);
+
+	// A long random walk, draining a random number of reads in between,
+	// always ends with the reader up to date
+	for (i = 0; i < 10000; ++i)
+	{
+		SBC_U32 r = i * 2654435761u;
+		((SBC_U8 *)&report)[(r >> 8) % size] ^= (SBC_U8)(1u << ((r >> 16) & 7));
+		SbcSplitCacheStore(&cache, SbcReportMode16Bit, &report, size, (r & 1) != 0);
+		Drain(&cache, SbcReportMode16Bit, (SBC_U8 *)&reader, (r >> 24) % 3);
+	}
+	Drain(&cache, SbcReportMode16Bit, (SBC_U8 *)&reader, SbcSplitCount);
+	CHECK(!cache.Dirty);
+	CHECK(memcmp(&reader, &report, size) == 0);
+}
+
+int main(void)
+{
+	TestSlices(SbcReportMode8Bit);
+	TestSlices(SbcReportMode16Bit);
+	TestChanges();
+	TestCache();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcsplit_test passed\n");
+	return 0;
+}
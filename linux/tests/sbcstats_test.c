@@ -0,0 +1,135 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Statistics feature report: building, validation, the counter table and
+// the differences between snapshots, including snapshots of different
+// driver versions and device instances.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sbcstats.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static void TestInfo(void)
+{
+	SBC_U32 i, j;
+
+	for (i = 0; i < SbcStatCount; ++i)
+	{
+		const SBC_STAT_INFO *info = SbcStatInfo(i);
+		CHECK(info != NULL && info->Name != NULL && info->Description != NULL);
+		for (j = 0; j < i; ++j) CHECK(strcmp(info->Name, SbcStatInfo(j)->Name) != 0);
+	}
+	CHECK(SbcStatInfo(SbcStatCount) == NULL);
+	CHECK(strcmp(SbcStatInfo(SbcStatPacketsReceived)->Name, "packets_received") == 0);
+}
+
+static void TestBuild(void)
+{
+	SBC_U64 counters[SbcStatCount];
+	SBC_STATS_FEATURE_REPORT report;
+	const SBC_U8 *bytes = (const SBC_U8 *)&report;
+	SBC_U32 i;
+
+	for (i = 0; i < SbcStatCount; ++i) counters[i] = 1000 + i;
+	memset(&report, 0xcc, sizeof(report));
+	SbcStatsBuildFeatureReport(counters, 5000, 2000000000, &report);
+
+	CHECK(bytes[0] == SBC_REPORT_ID_STATS);
+	CHECK(report.Version == SBC_STATS_VERSION);
+	CHECK(report.Count == SbcStatCount);
+	CHECK(report.Reserved == 0);
+	CHECK(report.Started == 5000 && report.Timestamp == 2000000000);
+	CHECK(memcmp(report.Counters, counters, sizeof(counters)) == 0);
+	for (i = SbcStatCount; i < SBC_STATS_MAX_COUNTERS; ++i) CHECK(report.Counters[i] == 0);
+	CHECK(SbcStatsValidReport(&report));
+
+	// Counters start after the header, at a fixed offset
+	CHECK(bytes[24] == (SBC_U8)1000);
+
+	report.ReportId = SBC_REPORT_ID_TRACE;
+	CHECK(!SbcStatsValidReport(&report));
+	report.ReportId = SBC_REPORT_ID_STATS;
+	report.Version = SBC_STATS_VERSION + 1;
+	CHECK(!SbcStatsValidReport(&report));
+	report.Version = SBC_STATS_VERSION;
+	report.Count = SBC_STATS_MAX_COUNTERS + 1;
+	CHECK(!SbcStatsValidReport(&report));
+	report.Count = SbcStatCount;
+	report.Timestamp = 1000;
+	CHECK(!SbcStatsValidReport(&report));
+}
+
+static void TestDelta(void)
+{
+	SBC_U64 counters[SbcStatCount];
+	SBC_U64 deltas[SBC_STATS_MAX_COUNTERS];
+	SBC_STATS_FEATURE_REPORT before, after;
+	SBC_U64 interval;
+	SBC_U32 i;
+
+	for (i = 0; i < SbcStatCount; ++i) counters[i] = 100 * i;
+	SbcStatsBuildFeatureReport(counters, 1000, 1000000000, &before);
+
+	// 125 Hz of packets over 2 seconds, nothing else moves
+	counters[SbcStatPacketsReceived] += 250;
+	counters[SbcStatReadsCompleted] += 240;
+	SbcStatsBuildFeatureReport(counters, 1000, 3000000000ull, &after);
+
+	CHECK(SbcStatsDelta(&before, &after, deltas, &interval));
+	CHECK(interval == 2000000000ull);
+	CHECK(deltas[SbcStatPacketsReceived] == 250);
+	CHECK(deltas[SbcStatReadsCompleted] == 240);
+	CHECK(deltas[SbcStatShortReads] == 0);
+	CHECK(deltas[SbcStatPacketsReceived] * 1000000000ull / interval == 125);
+
+	// Counters at the limit of 64 bits still subtract
+	before.Counters[SbcStatD0Entries] = 0xfffffffffffffff0ull;
+	after.Counters[SbcStatD0Entries] = 0xffffffffffffffffull;
+	CHECK(SbcStatsDelta(&before, &after, deltas, &interval));
+	CHECK(deltas[SbcStatD0Entries] == 15);
+	before.Counters[SbcStatD0Entries] = after.Counters[SbcStatD0Entries] = 0;
+
+	// An older driver with fewer counters: only the common ones compare
+	before.Count = 3;
+	after.Counters[5] = before.Counters[5] + 7;
+	CHECK(SbcStatsDelta(&before, &after, deltas, &interval));
+	CHECK(deltas[SbcStatPacketsReceived] == 250);
+	CHECK(deltas[5] == 0);
+	before.Count = SbcStatCount;
+
+	// Different device instances, reversed snapshots and counters going
+	// back don't compare
+	CHECK(!SbcStatsDelta(&after, &before, deltas, &interval));
+	CHECK(interval == 0);
+	after.Started = 2000;
+	CHECK(!SbcStatsDelta(&before, &after, deltas, &interval));
+	after.Started = 1000;
+	after.Counters[SbcStatShortReads] = before.Counters[SbcStatShortReads] - 1;
+	CHECK(!SbcStatsDelta(&before, &after, deltas, &interval));
+}
+
+int main(void)
+{
+	TestInfo();
+	TestBuild();
+	TestDelta();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcstats_test passed\n");
+	return 0;
+}
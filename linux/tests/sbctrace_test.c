@@ -0,0 +1,252 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Trace ring: ordering and wrap around, the compile time level, the dump
+// header, and snapshots taken while several threads record events.
+//
+
+// Record warnings and errors only
+#define SBC_TRACE_LEVEL 3
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbctrace.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static SBC_TRACE_RING ring;
+static SBC_TRACE_EVENT events[SBC_TRACE_RING_SIZE];
+
+static void TestEmpty(void)
+{
+	SbcTraceRingInit(&ring);
+	CHECK(SbcTraceSnapshot(&ring, events) == 0);
+}
+
+static void TestWrap(void)
+{
+	SBC_U32 i, count;
+
+	SbcTraceRingInit(&ring);
+	for (i = 0; i < 10; ++i) SbcTraceWrite(&ring, 1000 + i, i & 1, SbcTracePacket, i, 26);
+
+	count = SbcTraceSnapshot(&ring, events);
+	CHECK(count == 10);
+	for (i = 0; i < count; ++i)
+	{
+		CHECK(events[i].Sequence == i + 1);
+		CHECK(events[i].Timestamp == 1000 + i);
+		CHECK(events[i].Processor == (i & 1));
+		CHECK(events[i].Id == SbcTracePacket);
+		CHECK(events[i].Args[0] == i && events[i].Args[1] == 26);
+	}
+
+	// Only the last SBC_TRACE_RING_SIZE events are kept, oldest first
+	for (i = 10; i < 3 * SBC_TRACE_RING_SIZE + 5; ++i) SbcTraceWrite(&ring, 1000 + i, 0, SbcTraceIoctl, i, 0);
+
+	count = SbcTraceSnapshot(&ring, events);
+	CHECK(count == SBC_TRACE_RING_SIZE);
+	for (i = 0; i < count; ++i)
+	{
+		SBC_U32 index = 2 * SBC_TRACE_RING_SIZE + 5 + i;
+		CHECK(events[i].Sequence == index + 1);
+		CHECK(events[i].Args[0] == index);
+	}
+	CHECK(ring.Dropped == 0);
+}
+
+static void TestBusySlot(void)
+{
+	SBC_U32 count;
+
+	// A writer still filling slot 0 when the next lap gets there
+	SbcTraceRingInit(&ring);
+	SbcTraceWrite(&ring, 1, 0, SbcTracePacket, 0, 0);
+	ring.Events[0].Sequence = SBC_TRACE_BUSY;
+	ring.Head = SBC_TRACE_RING_SIZE;
+	SbcTraceWrite(&ring, 2, 0, SbcTracePacket, 1, 0);
+	CHECK(ring.Dropped == 1);
+	CHECK(ring.Events[0].Sequence == SBC_TRACE_BUSY);
+
+	count = SbcTraceSnapshot(&ring, events);
+	CHECK(count == 0);
+
+	// A writer a lap behind doesn't overwrite the newer event
+	SbcTraceRingInit(&ring);
+	ring.Head = SBC_TRACE_RING_SIZE;
+	SbcTraceWrite(&ring, 2, 0, SbcTracePacket, 2, 0);
+	ring.Head = 0;
+	SbcTraceWrite(&ring, 1, 0, SbcTracePacket, 1, 0);
+	CHECK(ring.Dropped == 1);
+	CHECK(ring.Events[0].Args[0] == 2);
+}
+
+static int evaluated = 0;
+
+static SBC_U32 Evaluate(void)
+{
+	++evaluated;
+	return 7;
+}
+
+static void TestLevel(void)
+{
+	SbcTraceRingInit(&ring);
+
+	SBC_TRACE_VERBOSE(&ring, 1, 0, SbcTracePacket, Evaluate(), 0);
+	SBC_TRACE_INFORMATION(&ring, 2, 0, SbcTraceD0Entry, Evaluate(), 0);
+	CHECK(evaluated == 0);
+	CHECK(ring.Head == 0);
+
+	SBC_TRACE_WARNING(&ring, 3, 0, SbcTracePacketDropped, Evaluate(), 0);
+	SBC_TRACE_ERROR(&ring, 4, 0, SbcTracePacketDropped, Evaluate(), 0);
+	CHECK(evaluated == 2);
+	CHECK(ring.Head == 2);
+}
+
+static void TestDump(void)
+{
+	SBC_TRACE_HEADER header, readBack;
+	SBC_TRACE_FEATURE_REPORT report;
+	SBC_U32 i, count;
+	FILE *file;
+
+	SbcTraceRingInit(&ring);
+	for (i = 0; i < 100; ++i) SbcTraceWrite(&ring, i * 125000, 0, i % SbcTraceEventCount, i, i * 3);
+
+	SbcTraceBuildFeatureReport(&ring, &report);
+	CHECK(report.ReportId == SBC_REPORT_ID_TRACE);
+	CHECK(report.Level == SBC_TRACE_LEVEL_INFORMATION);     // The level sbccore is built with
+	CHECK(report.Capacity == SBC_TRACE_RING_SIZE);
+	CHECK(report.Written == 100 && report.Dropped == 0);
+
+	count = SbcTraceSnapshot(&ring, events);
+	SbcTraceInitHeader(&header, count, ring.Head, ring.Dropped, 12345);
+	CHECK(SbcTraceValidHeader(&header));
+
+	file = tmpfile();
+	CHECK(file != NULL);
+	if (file == NULL) return;
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(events, sizeof(SBC_TRACE_EVENT), count, file);
+	rewind(file);
+
+	memset(events, 0, sizeof(events));
+	CHECK(fread(&readBack, sizeof(readBack), 1, file) == 1);
+	CHECK(SbcTraceValidHeader(&readBack));
+	CHECK(readBack.Count == 100 && readBack.Written == 100 && readBack.DumpTime == 12345);
+	CHECK(fread(events, sizeof(SBC_TRACE_EVENT), readBack.Count, file) == 100);
+	CHECK(events[99].Args[1] == 297);
+	fclose(file);
+
+	readBack.EventSize = 32;
+	CHECK(!SbcTraceValidHeader(&readBack));
+
+	for (i = 0; i < SbcTraceEventCount; ++i) CHECK(SbcTraceEventInfo(i) != NULL && SbcTraceEventInfo(i)->Name != NULL);
+	CHECK(SbcTraceEventInfo(SbcTraceEventCount) == NULL);
+	CHECK(strcmp(SbcTraceEventInfo(SbcTraceReportDelivered)->Args[1], "latency_ns") == 0);
+}
+
+//
+// Writers record events whose fields all derive from the writer and its own
+// counter, so a torn event is detected. A reader keeps taking snapshots.
+//
+#define WRITERS             4
+#define EVENTS_PER_WRITER   200000
+
+static volatile int writersDone = 0;
+
+static void *Writer(void *Context)
+{
+	SBC_U32 writer = (SBC_U32)(size_t)Context;
+	SBC_U32 i;
+
+	for (i = 0; i < EVENTS_PER_WRITER; ++i)
+	{
+		SbcTraceWrite(&ring, ((SBC_U64)writer << 32) | i, writer, i % SbcTraceEventCount, writer, i);
+	}
+	__atomic_add_fetch(&writersDone, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static int CheckSnapshot(const SBC_TRACE_EVENT *Events, SBC_U32 Count)
+{
+	SBC_U32 last[WRITERS];
+	int ok = 1;
+	SBC_U32 i;
+
+	memset(last, 0xff, sizeof(last));
+	for (i = 0; i < Count; ++i)
+	{
+		const SBC_TRACE_EVENT *e = &Events[i];
+		SBC_U32 writer = e->Args[0];
+
+		if (i != 0 && (SBC_S32)(e->Sequence - Events[i - 1].Sequence) <= 0) ok = 0;
+		if (writer >= WRITERS) { ok = 0; continue; }
+		if (e->Timestamp != (((SBC_U64)writer << 32) | e->Args[1])) ok = 0;
+		if (e->Processor != writer || e->Id != e->Args[1] % SbcTraceEventCount) ok = 0;
+
+		// Each writer's events in the order it recorded them
+		if (last[writer] != 0xffffffff && e->Args[1] <= last[writer]) ok = 0;
+		last[writer] = e->Args[1];
+	}
+	return ok;
+}
+
+static void TestConcurrent(void)
+{
+	static SBC_TRACE_EVENT snapshot[SBC_TRACE_RING_SIZE];
+	pthread_t threads[WRITERS];
+	SBC_U32 snapshots = 0, bad = 0, count;
+	int i;
+
+	SbcTraceRingInit(&ring);
+	for (i = 0; i < WRITERS; ++i) pthread_create(&threads[i], NULL, Writer, (void *)(size_t)i);
+
+	while (__atomic_load_n(&writersDone, __ATOMIC_SEQ_CST) != WRITERS)
+	{
+		count = SbcTraceSnapshot(&ring, snapshot);
+		if (!CheckSnapshot(snapshot, count)) ++bad;
+		++snapshots;
+	}
+	for (i = 0; i < WRITERS; ++i) pthread_join(threads[i], NULL);
+
+	CHECK(bad == 0);
+	CHECK(ring.Head == WRITERS * EVENTS_PER_WRITER);
+
+	// Quiet again, the last lap is there but for the dropped events
+	count = SbcTraceSnapshot(&ring, snapshot);
+	CHECK(CheckSnapshot(snapshot, count));
+	CHECK(count > SBC_TRACE_RING_SIZE / 2);
+	if (count != 0) CHECK(snapshot[count - 1].Sequence == WRITERS * EVENTS_PER_WRITER || ring.Dropped != 0);
+
+	printf("%u snapshots during the writes, %u events dropped\n", snapshots, ring.Dropped);
+}
+
+int main(void)
+{
+	TestEmpty();
+	TestWrap();
+	TestBusySlot();
+	TestLevel();
+	TestDump();
+	TestConcurrent();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbctrace_test passed\n");
+	return 0;
+}
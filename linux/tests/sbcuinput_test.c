@@ -0,0 +1,164 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+//
+// Frames built by the uinput sink: the first one carries the whole state,
+// later ones only what changed, every frame ends with SYN_REPORT and goes
+// out in a single write.
+//
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbcuinput.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static int FindEvent(const struct input_event *Events, SBC_U32 Count, SBC_U16 Type, SBC_U16 Code, SBC_S32 *Value)
+{
+	SBC_U32 i;
+
+	for (i = 0; i < Count; ++i)
+	{
+		if (Events[i].type == Type && Events[i].code == Code)
+		{
+			*Value = Events[i].value;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void TestFirstFrame(void)
+{
+	HIDFX2_INPUT_REPORT report;
+	SBC_EVDEV_STATE state;
+	struct input_event events[SBC_EVDEV_MAX_EVENTS];
+	SBC_U32 count;
+	SBC_S32 value;
+
+	memset(&state, 0, sizeof(state));
+	memset(&report, 0, sizeof(report));
+	report.Buttons0 = 0x01;
+	report.AimX = 200;
+	report.Gear = -1;
+
+	count = SbcEvdevBuildFrame(&state, SbcReportMode8Bit, (const SBC_U8 *)&report, events);
+	CHECK(count == SBC_EVDEV_MAX_EVENTS);
+	CHECK(events[count - 1].type == EV_SYN && events[count - 1].code == SYN_REPORT);
+	CHECK(FindEvent(events, count, EV_KEY, BTN_SOUTH, &value) && value == 1);
+	CHECK(FindEvent(events, count, EV_KEY, BTN_TRIGGER_HAPPY23, &value) && value == 0);
+	CHECK(FindEvent(events, count, EV_ABS, ABS_X, &value) && value == 200);
+	CHECK(FindEvent(events, count, EV_ABS, ABS_MISC + 1, &value) && value == -1);
+
+	// Same report again, nothing to send
+	CHECK(SbcEvdevBuildFrame(&state, SbcReportMode8Bit, (const SBC_U8 *)&report, events) == 0);
+}
+
+static void TestChanges(void)
+{
+	HIDFX2_INPUT_REPORT_16 report;
+	SBC_EVDEV_STATE state;
+	struct input_event events[SBC_EVDEV_MAX_EVENTS];
+	SBC_U32 count;
+	SBC_S32 value;
+
+	memset(&state, 0, sizeof(state));
+	memset(&report, 0, sizeof(report));
+	report.Buttons0 = 0x01;
+	SbcEvdevBuildFrame(&state, SbcReportMode16Bit, (const SBC_U8 *)&report, events);
+
+	// Release Button 1, press Button 17 and 39, move one axis
+	report.Buttons0 = 0x00;
+	report.Buttons2 = 0x01;
+	report.Buttons4 = 0x40;
+	report.Throttle = 40000;
+
+	count = SbcEvdevBuildFrame(&state, SbcReportMode16Bit, (const SBC_U8 *)&report, events);
+	CHECK(count == 5);
+	CHECK(FindEvent(events, count, EV_KEY, BTN_SOUTH, &value) && value == 0);
+	CHECK(FindEvent(events, count, EV_KEY, BTN_TRIGGER_HAPPY1, &value) && value == 1);
+	CHECK(FindEvent(events, count, EV_KEY, BTN_TRIGGER_HAPPY23, &value) && value == 1);
+	CHECK(FindEvent(events, count, EV_ABS, ABS_GAS, &value) && value == 40000);
+	CHECK(events[4].type == EV_SYN);
+
+	// The constant padding bit after the 39 buttons is ignored
+	report.Buttons4 |= 0x80;
+	CHECK(SbcEvdevBuildFrame(&state, SbcReportMode16Bit, (const SBC_U8 *)&report, events) == 0);
+
+	// Virtual buttons follow the 39 buttons
+	report.VirtualButtons = 0x81;
+	count = SbcEvdevBuildFrame(&state, SbcReportMode16Bit, (const SBC_U8 *)&report, events);
+	CHECK(count == 3);
+	CHECK(FindEvent(events, count, EV_KEY, BTN_TRIGGER_HAPPY24, &value) && value == 1);
+	CHECK(FindEvent(events, count, EV_KEY, BTN_TRIGGER_HAPPY31, &value) && value == 1);
+}
+
+static void TestSingleWrite(void)
+{
+	HIDFX2_INPUT_REPORT report;
+	SBC_UINPUT uinput;
+	struct input_event events[SBC_EVDEV_MAX_EVENTS];
+	int fds[2];
+	ssize_t got;
+
+	if (pipe(fds) != 0)
+	{
+		perror("pipe");
+		++failures;
+		return;
+	}
+
+	SbcUinputAttach(&uinput, fds[1], SbcReportMode8Bit);
+	memset(&report, 0, sizeof(report));
+	CHECK(SbcUinputWriteReport(&uinput, (const SBC_U8 *)&report, sizeof(report)) == 0);
+	got = read(fds[0], events, sizeof(events));
+	CHECK(got == (ssize_t)(SBC_EVDEV_MAX_EVENTS * sizeof(events[0])));
+
+	report.Brake = 10;
+	report.Buttons1 = 0x80;
+	CHECK(SbcUinputWriteReport(&uinput, (const SBC_U8 *)&report, sizeof(report)) == 0);
+	got = read(fds[0], events, sizeof(events));
+	CHECK(got == (ssize_t)(3 * sizeof(events[0])));
+
+	CHECK(SbcUinputWriteReport(&uinput, (const SBC_U8 *)&report, sizeof(report)) == 0);
+	CHECK(uinput.Frames == 2);
+	CHECK(uinput.Writes == 2);
+	CHECK(uinput.Events == SBC_EVDEV_MAX_EVENTS + 3);
+
+	// Wrong size for the mode
+	CHECK(SbcUinputWriteReport(&uinput, (const SBC_U8 *)&report, sizeof(report) - 1) == -1);
+	CHECK(uinput.Errors == 1);
+
+	uinput.PerEventWrites = 1;
+	report.Brake = 11;
+	CHECK(SbcUinputWriteReport(&uinput, (const SBC_U8 *)&report, sizeof(report)) == 0);
+	CHECK(uinput.Writes == 4);
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+int main(void)
+{
+	TestFirstFrame();
+	TestChanges();
+	TestSingleWrite();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("sbcuinput_test passed\n");
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "hidusbsteelbattalion.h"
+
+#if defined(EVENT_TRACING)
+#include "calibration.tmh"
+#endif
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, HidSteelBattalionCalibrationCreate)
+#pragma alloc_text(PAGE, HidSteelBattalionSetCalibration)
+#endif
+
+NTSTATUS HidSteelBattalionCalibrationCreate(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Allocates the calibration tables and compiles the calibration read from
+    the registry. Called from DeviceAdd after the settings are read.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    NT status value
+--*/
+{
+    NTSTATUS                status;
+    PDEVICE_EXTENSION       devContext = GetDeviceContext(Device);
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDFMEMORY               memory;
+    ULONG                   i;
+
+    PAGED_CODE();
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    status = WdfWaitLockCreate(&attributes, &devContext->CalibrationLock);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfWaitLockCreate failed 0x%x\n", status);
+        return status;
+    }
+
+    status = WdfMemoryCreate(&attributes, NonPagedPoolNx, POOL_TAG, sizeof(CALIBRATION_BUFFERS), &memory, (PVOID *)&devContext->Calibration);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfMemoryCreate for calibration tables failed 0x%x\n", status);
+        devContext->Calibration = NULL;
+        return status;
+    }
+
+    for (i = 0; i < SbcAxisCount; ++i)
+    {
+        if (!SbcCalibrationValidate(&devContext->CalibrationAxes[i]))
+        {
+            TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "Calibration of axis %u is not valid, calibration disabled\n", i);
+            RtlZeroMemory(devContext->CalibrationAxes, sizeof(devContext->CalibrationAxes));
+            break;
+        }
+    }
+
+    devContext->Calibration->Active = 0;
+    SbcCalibrationCompile(&devContext->Calibration->Tables[0], devContext->ReportMode, devContext->CalibrationAxes);
+
+    return STATUS_SUCCESS;
+}
+
+
+static VOID HidSteelBattalionActivateCalibration
+(
+    IN PDEVICE_EXTENSION DeviceContext,
+    IN ULONG Tables,
+    IN CONST SBC_AXIS_CALIBRATION *Axes
+)
+/*++
+Routine Description:
+    Switches the completion routine to freshly compiled calibration tables.
+    The switch runs at DISPATCH_LEVEL under StateLock, so it lives outside
+    the PAGE section of HidSteelBattalionSetCalibration.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+    Tables - Index of the tables to switch to
+    Axes - Calibration the tables were compiled from
+
+Return Value:
+    VOID
+--*/
+{
+    WdfSpinLockAcquire(DeviceContext->StateLock);
+    DeviceContext->Calibration->Active = Tables;
+    RtlCopyMemory(DeviceContext->CalibrationAxes, Axes, sizeof(DeviceContext->CalibrationAxes));
+    WdfSpinLockRelease(DeviceContext->StateLock);
+}
+
+
+NTSTATUS HidSteelBattalionSetCalibration
+(
+    IN WDFDEVICE Device,
+    IN PSBC_CALIBRATION_FEATURE_REPORT Report
+)
+/*++
+Routine Description:
+    Compiles a new calibration into the inactive tables, switches to them
+    and stores the calibration in the Calibration registry value so it
+    survives the device being unplugged.
+
+Arguments:
+    Device - Handle to a framework device object.
+    Report - Calibration feature report
+
+Return Value:
+    NT status value
+--*/
+{
+    PDEVICE_EXTENSION       devContext = GetDeviceContext(Device);
+    PCALIBRATION_BUFFERS    calibration = devContext->Calibration;
+    NTSTATUS                status;
+    WDFKEY                  key;
+    UNICODE_STRING          name;
+    ULONG                   next;
+    ULONG                   i;
+
+    PAGED_CODE();
+
+    for (i = 0; i < SbcAxisCount; ++i)
+    {
+        if (!SbcCalibrationValidate(&Report->Axes[i]))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Calibration of axis %u is not valid\n", i);
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    // Readers only use the active tables and only while holding StateLock,
+    // the other ones can be rebuilt without stopping them.
+    WdfWaitLockAcquire(devContext->CalibrationLock, NULL);
+
+    next = calibration->Active ^ 1;
+    SbcCalibrationCompile(&calibration->Tables[next], devContext->ReportMode, Report->Axes);
+
+    HidSteelBattalionActivateCalibration(devContext, next, Report->Axes);
+
+    WdfWaitLockRelease(devContext->CalibrationLock);
+
+    status = WdfDeviceOpenRegistryKey(Device, PLUGPLAY_REGKEY_DEVICE, KEY_WRITE, WDF_NO_OBJECT_ATTRIBUTES, &key);
+    if (NT_SUCCESS(status))
+    {
+        RtlInitUnicodeString(&name, L"Calibration");
+        status = WdfRegistryAssignValue(key, &name, REG_BINARY, sizeof(Report->Axes), Report->Axes);
+        WdfRegistryClose(key);
+    }
+
+    // The new calibration is in use even if it couldn't be stored
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_IOCTL, "Calibration not saved to the registry 0x%x\n", status);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+VOID HidSteelBattalionGetCalibration
+(
+    IN WDFDEVICE Device,
+    OUT PSBC_CALIBRATION_FEATURE_REPORT Report
+)
+/*++
+Routine Description:
+    Fills the calibration feature report with the calibration in use.
+
+Arguments:
+    Device - Handle to a framework device object.
+    Report - Receives the feature report
+
+Return Value:
+    VOID
+--*/
+{
+    PDEVICE_EXTENSION devContext = GetDeviceContext(Device);
+
+    Report->ReportId = SBC_REPORT_ID_CALIBRATION;
+
+    WdfSpinLockAcquire(devContext->StateLock);
+    RtlCopyMemory(Report->Axes, devContext->CalibrationAxes, sizeof(Report->Axes));
+    WdfSpinLockRelease(devContext->StateLock);
+}
@@ -0,0 +1,249 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "hidusbsteelbattalion.h"
+
+#if defined(EVENT_TRACING)
+#include "capture.tmh"
+#endif
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, HidSteelBattalionCaptureOpen)
+#pragma alloc_text(PAGE, HidSteelBattalionCaptureClose)
+#pragma alloc_text(PAGE, HidSteelBattalionEvtCaptureWorkItem)
+#endif
+
+NTSTATUS HidSteelBattalionCaptureOpen(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Opens the capture file named by the CaptureFile registry value and sets
+    up the ring and the work item that write the records to it. Records are
+    sized for ReaderTransferSize and appended if the file already exists
+    with records of that size. Does nothing if capture is not configured or
+    the file is already open. Called from PrepareHardware.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    NT status value
+--*/
+{
+    NTSTATUS                    status = STATUS_SUCCESS;
+    PDEVICE_EXTENSION           devContext = GetDeviceContext(Device);
+    WDF_OBJECT_ATTRIBUTES       attributes;
+    WDF_WORKITEM_CONFIG         workItemConfig;
+    WDFMEMORY                   memory;
+    UNICODE_STRING              path;
+    OBJECT_ATTRIBUTES           objectAttributes;
+    IO_STATUS_BLOCK             ioStatus;
+    FILE_STANDARD_INFORMATION   fileInfo;
+    SBC_CAPTURE_HEADER          header;
+    LARGE_INTEGER               offset;
+    ULONG                       recordSize = SbcCaptureRecordSize(devContext->ReaderTransferSize);
+    ULONG                       ringSize = SBC_CAPTURE_RING_SIZE * recordSize;
+
+    PAGED_CODE();
+
+    if (devContext->CapturePath == NULL || devContext->CaptureFile != NULL) return STATUS_SUCCESS;
+
+    WdfStringGetUnicodeString(devContext->CapturePath, &path);
+    if (path.Length == 0) return STATUS_SUCCESS;
+
+    // The buffers live as long as the device, only the file is closed and
+    // reopened when the hardware is released and prepared again.
+    if (devContext->Capture == NULL)
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = Device;
+
+        status = WdfSpinLockCreate(&attributes, &devContext->CaptureLock);
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfSpinLockCreate failed 0x%x\n", status);
+            return status;
+        }
+
+        WDF_WORKITEM_CONFIG_INIT(&workItemConfig, HidSteelBattalionEvtCaptureWorkItem);
+        status = WdfWorkItemCreate(&workItemConfig, &attributes, &devContext->CaptureWorkItem);
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfWorkItemCreate failed 0x%x\n", status);
+            return status;
+        }
+
+        status = WdfMemoryCreate(&attributes, NonPagedPoolNx, POOL_TAG, sizeof(CAPTURE_BUFFERS) + 2 * ringSize, &memory, (PVOID *)&devContext->Capture);
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfMemoryCreate for capture buffers failed 0x%x\n", status);
+            devContext->Capture = NULL;
+            return status;
+        }
+        SbcCaptureRingInit(&devContext->Capture->Ring, devContext->Capture + 1, recordSize);
+        devContext->Capture->Staging = (PUCHAR)(devContext->Capture + 1) + ringSize;
+    }
+
+    InitializeObjectAttributes(&objectAttributes, &path, OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+
+    status = ZwCreateFile(&devContext->CaptureFile, FILE_APPEND_DATA | FILE_READ_DATA | FILE_READ_ATTRIBUTES | SYNCHRONIZE, &objectAttributes, &ioStatus, NULL,
+        FILE_ATTRIBUTE_NORMAL, FILE_SHARE_READ, FILE_OPEN_IF, FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE, NULL, 0);
+    if (!NT_SUCCESS(status))
+	{
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "ZwCreateFile for the capture file failed 0x%x\n", status);
+        devContext->CaptureFile = NULL;
+        return status;
+    }
+
+    // New or empty file, write the header first. Records are only appended
+    // to a file that has the same record size.
+    status = ZwQueryInformationFile(devContext->CaptureFile, &ioStatus, &fileInfo, sizeof(fileInfo), FileStandardInformation);
+    if (NT_SUCCESS(status) && fileInfo.EndOfFile.QuadPart == 0)
+    {
+        SbcCaptureInitHeader(&header, HidSteelBattalionTimestamp(), recordSize);
+        status = ZwWriteFile(devContext->CaptureFile, NULL, NULL, NULL, &ioStatus, &header, sizeof(header), NULL, NULL);
+    }
+    else if (NT_SUCCESS(status))
+    {
+        offset.QuadPart = 0;
+        status = ZwReadFile(devContext->CaptureFile, NULL, NULL, NULL, &ioStatus, &header, sizeof(header), &offset, NULL);
+        if (NT_SUCCESS(status) && (ioStatus.Information != sizeof(header) || !SbcCaptureValidHeader(&header) || header.RecordSize != recordSize))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "Capture file is not a capture with %u byte records\n", recordSize);
+            status = STATUS_OBJECT_TYPE_MISMATCH;
+        }
+    }
+
+    if (!NT_SUCCESS(status))
+	{
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "Capture file header failed 0x%x\n", status);
+        ZwClose(devContext->CaptureFile);
+        devContext->CaptureFile = NULL;
+        return status;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DBG_PNP, "Capturing interrupt pipe to %wZ\n", &path);
+    return status;
+}
+
+
+VOID HidSteelBattalionCaptureClose(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Writes the pending records and closes the capture file. Called from
+    ReleaseHardware, after D0Exit has stopped the continuous reader.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    VOID
+--*/
+{
+    PDEVICE_EXTENSION devContext = GetDeviceContext(Device);
+
+    PAGED_CODE();
+
+    if (devContext->CaptureFile == NULL) return;
+
+    // The reader is stopped by now, the work item drains what is left
+    WdfWorkItemFlush(devContext->CaptureWorkItem);
+    HidSteelBattalionEvtCaptureWorkItem(devContext->CaptureWorkItem);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DBG_PNP, "Capture closed, %I64u records dropped\n", devContext->Capture->Ring.Dropped);
+
+    ZwClose(devContext->CaptureFile);
+    devContext->CaptureFile = NULL;
+}
+
+
+VOID HidSteelBattalionCaptureRecord
+(
+    IN PDEVICE_EXTENSION DeviceContext,
+    IN PVOID Data,
+    IN size_t Length,
+    IN ULONGLONG Arrival
+)
+/*++
+Routine Description:
+    Called by the read completion routine for every completed transfer. The
+    record is queued in the ring and written out by the work item.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+    Data - Transferred bytes, NULL if Length is zero
+    Length - NumBytesTransferred
+    Arrival - Timestamp the completion routine took, the one the latency
+        statistics are measured from
+
+Return Value:
+    VOID
+--*/
+{
+    WdfSpinLockAcquire(DeviceContext->CaptureLock);
+    SbcCaptureRingPush(&DeviceContext->Capture->Ring, Arrival, Data, (SBC_U32)Length);
+    WdfSpinLockRelease(DeviceContext->CaptureLock);
+
+    WdfWorkItemEnqueue(DeviceContext->CaptureWorkItem);
+}
+
+
+static ULONG HidSteelBattalionCapturePop(IN PDEVICE_EXTENSION DeviceContext)
+/*++
+Routine Description:
+    Moves the queued capture records to the staging buffer. CaptureLock
+    raises to DISPATCH_LEVEL, so this stays out of the PAGE section the
+    work item lives in.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+
+Return Value:
+    Number of records moved
+--*/
+{
+    ULONG count;
+
+    WdfSpinLockAcquire(DeviceContext->CaptureLock);
+    count = SbcCaptureRingPop(&DeviceContext->Capture->Ring, DeviceContext->Capture->Staging, SBC_CAPTURE_RING_SIZE);
+    WdfSpinLockRelease(DeviceContext->CaptureLock);
+
+    return count;
+}
+
+
+VOID HidSteelBattalionEvtCaptureWorkItem(IN WDFWORKITEM WorkItem)
+/*++
+Routine Description:
+    Appends the queued capture records to the capture file.
+
+Arguments:
+    WorkItem - Capture work item, its parent is the device.
+
+Return Value:
+    VOID
+--*/
+{
+    PDEVICE_EXTENSION   devContext = GetDeviceContext(WdfWorkItemGetParentObject(WorkItem));
+    PCAPTURE_BUFFERS    capture = devContext->Capture;
+    IO_STATUS_BLOCK     ioStatus;
+    NTSTATUS            status;
+    ULONG               count;
+
+    PAGED_CODE();
+
+    for (;;)
+    {
+        count = HidSteelBattalionCapturePop(devContext);
+        if (count == 0) break;
+
+        status = ZwWriteFile(devContext->CaptureFile, NULL, NULL, NULL, &ioStatus, capture->Staging, count * capture->Ring.RecordSize, NULL, NULL);
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "ZwWriteFile for the capture file failed 0x%x\n", status);
+            break;
+        }
+    }
+}
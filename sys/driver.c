@@ -23,6 +23,7 @@ ULONG DebugFlag = 0xff;
 #ifdef ALLOC_PRAGMA
     #pragma alloc_text( INIT, DriverEntry )
     #pragma alloc_text( PAGE, HidSteelBattalionEvtDeviceAdd)
+    #pragma alloc_text( PAGE, HidSteelBattalionReadDeviceSettings)
     #pragma alloc_text( PAGE, HidSteelBattalionEvtDriverContextCleanup)
 #endif
 
@@ -118,6 +119,7 @@ Return Value:
     // For usb devices, PrepareHardware callback is the to place select the
     // interface and configure the device.
     pnpPowerCallbacks.EvtDevicePrepareHardware = HidSteelBattalionEvtDevicePrepareHardware;
+    pnpPowerCallbacks.EvtDeviceReleaseHardware = HidSteelBattalionEvtDeviceReleaseHardware;
 
     // These two callbacks start and stop the wdfusb pipe continuous reader
     // as we go in and out of the D0-working state.
@@ -126,7 +128,12 @@ Return Value:
 
     WdfDeviceInitSetPnpPowerEventCallbacks(DeviceInit, &pnpPowerCallbacks);
 
+    // Every request gets a context to timestamp the read requests with
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, REQUEST_CONTEXT);
+    WdfDeviceInitSetRequestAttributes(DeviceInit, &attributes);
+
     WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DEVICE_EXTENSION);
+    attributes.EvtCleanupCallback = HidSteelBattalionEvtDeviceContextCleanup;
 
     // Create a framework device object.This call will in turn create
     // a WDM device object, attach to the lower stack, and set the
@@ -139,6 +146,37 @@ Return Value:
     }
 
     devContext = GetDeviceContext(hDevice);
+    status = HidSteelBattalionTraceCreate(hDevice);
+    if (!NT_SUCCESS(status)) return status;
+
+    HidSteelBattalionReadDeviceSettings(hDevice);
+    SbcReportCacheInit(&devContext->ReportCache);
+    SbcSnapshotInit(&devContext->State);
+    SbcLatencyInit(&devContext->DeliveryLatency);
+    SbcLatencyInit(&devContext->ReadWaitLatency);
+    devContext->StatsStarted = HidSteelBattalionTimestamp();
+
+    status = HidSteelBattalionLedCreate(hDevice);
+    if (!NT_SUCCESS(status)) return status;
+
+    status = HidSteelBattalionCalibrationCreate(hDevice);
+    if (!NT_SUCCESS(status)) return status;
+
+    status = HidSteelBattalionRemapCreate(hDevice);
+    if (!NT_SUCCESS(status)) return status;
+
+    status = HidSteelBattalionReportQueueCreate(hDevice);
+    if (!NT_SUCCESS(status)) return status;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = hDevice;
+
+    status = WdfSpinLockCreate(&attributes, &devContext->StateLock);
+    if (!NT_SUCCESS(status)) 
+	{
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfSpinLockCreate failed 0x%x\n", status);
+        return status;
+    }
 
     WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(&queueConfig, WdfIoQueueDispatchParallel);
     queueConfig.EvtIoInternalDeviceControl = HidSteelBattleEvtInternalDeviceControl;
@@ -168,10 +206,196 @@ Return Value:
         TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfIoQueueCreate failed 0x%x\n", status);
         return status;
     }
+
+    status = HidSteelBattalionEventsCreate(hDevice);
     return status;
 }
 
 
+static ULONG HidSteelBattalionQueryULong
+(
+    IN WDFKEY Key,
+    IN PCWSTR ValueName,
+    IN ULONG DefaultValue
+)
+{
+    UNICODE_STRING  name;
+    ULONG           value;
+
+    PAGED_CODE();
+
+    RtlInitUnicodeString(&name, ValueName);
+    if (Key == NULL || !NT_SUCCESS(WdfRegistryQueryULong(Key, &name, &value))) return DefaultValue;
+    return value;
+}
+
+
+static ULONG HidSteelBattalionQueryBinary
+(
+    IN WDFKEY Key,
+    IN PCWSTR ValueName,
+    OUT PVOID Buffer,
+    IN ULONG BufferLength
+)
+{
+    UNICODE_STRING  name;
+    ULONG           length = 0;
+    ULONG           type = REG_NONE;
+
+    PAGED_CODE();
+
+    RtlInitUnicodeString(&name, ValueName);
+    if (Key == NULL || !NT_SUCCESS(WdfRegistryQueryValue(Key, &name, BufferLength, Buffer, &length, &type)) || type != REG_BINARY) return 0;
+    return length;
+}
+
+
+VOID HidSteelBattalionReadDeviceSettings(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Reads the per device settings from the hardware key. The values are
+    created by the INF (see hidsteelbattalion_Settings.AddReg). Missing
+    values keep their defaults.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    VOID.
+--*/
+{
+    NTSTATUS            status;
+    WDFKEY              key = NULL;
+    PDEVICE_EXTENSION   devContext = GetDeviceContext(Device);
+    UCHAR               deadband[2 * SbcAxisCount];
+    SBC_RESPONSE_SETTINGS response;
+    SBC_SMOOTH_SETTINGS smoothing;
+    SBC_COMBO_SETTINGS  combos;
+    ULONG               length;
+    ULONG               i;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    UNICODE_STRING      name;
+
+    PAGED_CODE();
+
+    status = WdfDeviceOpenRegistryKey(Device, PLUGPLAY_REGKEY_DEVICE, KEY_READ, WDF_NO_OBJECT_ATTRIBUTES, &key);
+    if (!NT_SUCCESS(status)) 
+	{
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "WdfDeviceOpenRegistryKey failed 0x%x, using default settings\n", status);
+        key = NULL;
+    }
+
+    devContext->ReportMode = HidSteelBattalionQueryULong(key, L"HighPrecisionAxes", 0) ? SbcReportMode16Bit : SbcReportMode8Bit;
+
+    devContext->ChangeOnly = HidSteelBattalionQueryULong(key, L"ChangeOnly", 0) != 0;
+
+    SbcChangeFilterInit(&devContext->ChangeFilter, devContext->ReportMode);
+    devContext->ChangeFilter.KeepAliveNs = (ULONGLONG)HidSteelBattalionQueryULong(key, L"KeepAliveMs", 100) * 1000000;
+    length = HidSteelBattalionQueryBinary(key, L"ChangeDeadband", deadband, sizeof(deadband));
+    for (i = 0; i < SbcAxisCount && 2 * i + 1 < length; ++i)
+    {
+        devContext->ChangeFilter.Deadband[i] = (USHORT)(deadband[2 * i] | (deadband[2 * i + 1] << 8));
+    }
+
+    devContext->ReaderDepth = min(HidSteelBattalionQueryULong(key, L"ReaderDepth", 0), READER_MAX_DEPTH);
+    devContext->ReaderTransferSize = HidSteelBattalionQueryULong(key, L"ReaderTransferSize", READER_DEFAULT_TRANSFER_SIZE);
+    if (devContext->ReaderTransferSize < SBC_INPUT_PACKET_SIZE || devContext->ReaderTransferSize > READER_MAX_TRANSFER_SIZE)
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "ReaderTransferSize %u out of range, using %u\n", devContext->ReaderTransferSize, READER_DEFAULT_TRANSFER_SIZE);
+        devContext->ReaderTransferSize = READER_DEFAULT_TRANSFER_SIZE;
+    }
+
+    devContext->LedMaxFrameRate = HidSteelBattalionQueryULong(key, L"LedMaxFrameRate", LED_DEFAULT_MAX_FRAME_RATE);
+
+    // 0 keeps the latest-state delivery
+    devContext->ReportQueueDepth = HidSteelBattalionQueryULong(key, L"ReportQueueDepth", 0);
+
+    // The queued reports are whole, buffered mode keeps the single report
+    devContext->SplitReports = HidSteelBattalionQueryULong(key, L"SplitReports", 0) != 0;
+    if (devContext->SplitReports && devContext->ReportQueueDepth != 0)
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "SplitReports is ignored in buffered mode\n");
+        devContext->SplitReports = FALSE;
+    }
+
+    // Missing or invalid smoothing settings leave every axis unfiltered
+    length = HidSteelBattalionQueryBinary(key, L"AxisSmoothing", &smoothing, sizeof(smoothing));
+    if (length != 0 && (length != sizeof(smoothing) || !SbcSmoothValidate(&smoothing)))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "AxisSmoothing is not valid, ignored\n");
+        length = 0;
+    }
+    if (length == 0) RtlZeroMemory(&smoothing, sizeof(smoothing));
+    SbcSmoothPrepare(&devContext->Smoothing, &smoothing);
+
+    // Missing or invalid response curves leave every axis untouched
+    length = HidSteelBattalionQueryBinary(key, L"ResponseCurves", &response, sizeof(response));
+    if (length != 0 && (length != sizeof(response) || !SbcResponseValidate(&response)))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "ResponseCurves is not valid, ignored\n");
+        length = 0;
+    }
+    if (length == 0) RtlZeroMemory(&response, sizeof(response));
+    SbcResponsePrepare(&devContext->Response, &response);
+
+    // Written by the calibration feature report, missing means uncalibrated
+    length = HidSteelBattalionQueryBinary(key, L"Calibration", devContext->CalibrationAxes, sizeof(devContext->CalibrationAxes));
+    if (length != sizeof(devContext->CalibrationAxes))
+    {
+        if (length != 0) TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "Calibration has %u bytes, expected %u\n", length, (ULONG)sizeof(devContext->CalibrationAxes));
+        RtlZeroMemory(devContext->CalibrationAxes, sizeof(devContext->CalibrationAxes));
+    }
+
+    // Written by the remap feature report, missing leaves every button in place
+    length = HidSteelBattalionQueryBinary(key, L"ButtonRemap", devContext->RemapTargets, sizeof(devContext->RemapTargets));
+    if (length != 0 && (length != sizeof(devContext->RemapTargets) || !SbcRemapValidate(devContext->RemapTargets)))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "ButtonRemap is not valid, ignored\n");
+        length = 0;
+    }
+    if (length == 0) SbcRemapIdentity(devContext->RemapTargets);
+
+    // Missing or invalid combos leave the virtual buttons released
+    length = HidSteelBattalionQueryBinary(key, L"ButtonCombos", &combos, sizeof(combos));
+    if (length != 0 && (length != sizeof(combos) || !SbcComboValidate(&combos)))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "ButtonCombos is not valid, ignored\n");
+        length = 0;
+    }
+    if (length == 0) RtlZeroMemory(&combos, sizeof(combos));
+    SbcComboCompile(&devContext->Combos, &combos);
+    SbcComboReset(&devContext->ComboState);
+
+    // Capture file path, e.g. \??\C:\sbc.cap. Empty disables the capture.
+    if (key != NULL)
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = Device;
+        RtlInitUnicodeString(&name, L"CaptureFile");
+        if (NT_SUCCESS(WdfStringCreate(NULL, &attributes, &devContext->CapturePath)) &&
+            !NT_SUCCESS(WdfRegistryQueryString(key, &name, devContext->CapturePath)))
+        {
+            WdfObjectDelete(devContext->CapturePath);
+            devContext->CapturePath = NULL;
+        }
+
+        // Where the trace feature report dumps the trace ring
+        RtlInitUnicodeString(&name, L"TraceFile");
+        if (NT_SUCCESS(WdfStringCreate(NULL, &attributes, &devContext->TracePath)) &&
+            !NT_SUCCESS(WdfRegistryQueryString(key, &name, devContext->TracePath)))
+        {
+            WdfObjectDelete(devContext->TracePath);
+            devContext->TracePath = NULL;
+        }
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DBG_PNP, "Report mode %d, change only %d, split %d, reader depth %u, transfer size %u\n",
+        devContext->ReportMode, devContext->ChangeOnly, devContext->SplitReports, devContext->ReaderDepth, devContext->ReaderTransferSize);
+
+    if (key != NULL) WdfRegistryClose(key);
+}
+
+
 VOID HidSteelBattalionEvtDriverContextCleanup(IN WDFOBJECT Object)
 /*++
     Free resources allocated in DriverEntry that are not automatically
@@ -218,6 +442,13 @@ Return Value:
     CHAR       debugMessageBuffer[TEMP_BUFFER_SIZE];
     NTSTATUS   status;
 
+    // Only format the messages that are printed
+    if ((TraceEventsLevel > TRACE_LEVEL_ERROR) &&
+        (TraceEventsLevel > DebugLevel || ((TraceEventsFlag & DebugFlag) != TraceEventsFlag)))
+    {
+        return;
+    }
+
     va_start(list, DebugMessage);
 
     if (DebugMessage) 
@@ -234,13 +465,10 @@ Return Value:
         if(!NT_SUCCESS(status)) 
 		{
             DbgPrint (_DRIVER_NAME_": RtlStringCbVPrintfA failed 0x%x\n", status);
+            va_end(list);
             return;
         }
-        if ((TraceEventsLevel <= TRACE_LEVEL_ERROR) ||
-            (TraceEventsLevel <= DebugLevel && ((TraceEventsFlag & DebugFlag) == TraceEventsFlag))) 
-		{
-            DbgPrint("%s%s", _DRIVER_NAME_, debugMessageBuffer);
-        }
+        DbgPrint("%s%s", _DRIVER_NAME_, debugMessageBuffer);
     }
     va_end(list);
 
@@ -0,0 +1,295 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "hidusbsteelbattalion.h"
+#include <wdmsec.h>
+
+#if defined(EVENT_TRACING)
+#include "events.tmh"
+#endif
+
+//
+// Event devices are numbered from 0, each controller takes the lowest
+// number free when it is added
+//
+#define EVENT_DEVICE_MAX    (16)
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, HidSteelBattalionEventsCreate)
+#pragma alloc_text(PAGE, HidSteelBattalionEvtDeviceContextCleanup)
+#endif
+
+NTSTATUS HidSteelBattalionEventsCreate(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Creates the event device of the controller, \Device\SteelBattalionEvents<n>
+    with the \DosDevices\SteelBattalionEvents<n> link, and its queues.
+    hidclass owns the I/O of the device stack, so the events are read from a
+    control device of their own. Called at the end of DeviceAdd, the device
+    is deleted by HidSteelBattalionEvtDeviceContextCleanup.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    NT status value
+--*/
+{
+    NTSTATUS                status;
+    PDEVICE_EXTENSION       devContext = GetDeviceContext(Device);
+    PWDFDEVICE_INIT         init;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDF_IO_QUEUE_CONFIG     queueConfig;
+    WDFDEVICE               eventDevice;
+    ULONG                   index;
+
+    DECLARE_UNICODE_STRING_SIZE(name, 64);
+    DECLARE_UNICODE_STRING_SIZE(link, 64);
+
+    PAGED_CODE();
+
+    SbcEventRingInit(&devContext->Events);
+
+    for (index = 0; ; ++index)
+    {
+        // Any user can read the events, like the input reports
+        init = WdfControlDeviceInitAllocate(WdfDeviceGetDriver(Device), &SDDL_DEVOBJ_SYS_ALL_ADM_RWX_WORLD_R_RES_R);
+        if (init == NULL)
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfControlDeviceInitAllocate failed\n");
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        WdfDeviceInitSetExclusive(init, FALSE);
+
+        status = RtlUnicodeStringPrintf(&name, L"%ws%u", SBC_EVENT_DEVICE_NAME, index);
+        if (NT_SUCCESS(status)) status = WdfDeviceInitAssignName(init, &name);
+        if (NT_SUCCESS(status))
+        {
+            WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, EVENT_DEVICE_CONTEXT);
+            status = WdfDeviceCreate(&init, &attributes, &eventDevice);
+            if (NT_SUCCESS(status)) break;
+        }
+        WdfDeviceInitFree(init);
+
+        // A name taken by another controller moves on to the next one
+        if (status != STATUS_OBJECT_NAME_COLLISION || index + 1 == EVENT_DEVICE_MAX)
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfDeviceCreate for the event device failed 0x%x\n", status);
+            return status;
+        }
+    }
+
+    GetEventDeviceContext(eventDevice)->DeviceContext = devContext;
+    devContext->EventDevice = eventDevice;
+
+    status = RtlUnicodeStringPrintf(&link, L"%ws%u", SBC_EVENT_DOS_DEVICE_NAME, index);
+    if (NT_SUCCESS(status)) status = WdfDeviceCreateSymbolicLink(eventDevice, &link);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfDeviceCreateSymbolicLink failed 0x%x\n", status);
+        return status;
+    }
+
+    // Control devices don't take part in power management
+    WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(&queueConfig, WdfIoQueueDispatchParallel);
+    queueConfig.EvtIoDeviceControl = HidSteelBattalionEvtEventDeviceControl;
+    queueConfig.PowerManaged = WdfFalse;
+
+    status = WdfIoQueueCreate(eventDevice, &queueConfig, WDF_NO_OBJECT_ATTRIBUTES, WDF_NO_HANDLE);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfIoQueueCreate failed 0x%x\n", status);
+        return status;
+    }
+
+    WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
+    queueConfig.PowerManaged = WdfFalse;
+
+    status = WdfIoQueueCreate(eventDevice, &queueConfig, WDF_NO_OBJECT_ATTRIBUTES, &devContext->EventWaitQueue);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfIoQueueCreate failed 0x%x\n", status);
+        return status;
+    }
+
+    WdfControlFinishInitializing(eventDevice);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DBG_PNP, "Button events on %wZ\n", &link);
+    return STATUS_SUCCESS;
+}
+
+
+VOID HidSteelBattalionEvtDeviceContextCleanup(IN WDFOBJECT Device)
+/*++
+Routine Description:
+    Deletes the event device when the controller goes away. The continuous
+    reader has stopped by then, so nothing pushes events any more, and the
+    reads still waiting are cancelled with the device.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    VOID
+--*/
+{
+    PDEVICE_EXTENSION devContext = GetDeviceContext((WDFDEVICE)Device);
+
+    PAGED_CODE();
+
+    if (devContext->EventDevice != NULL)
+    {
+        WdfObjectDelete(devContext->EventDevice);
+        devContext->EventDevice = NULL;
+    }
+}
+
+
+static VOID HidSteelBattalionEventsComplete
+(
+    IN PDEVICE_EXTENSION DeviceContext,
+    IN WDFREQUEST Request
+)
+/*++
+Routine Description:
+    Completes an SBC_IOCTL_READ_BUTTON_EVENTS request with the events from
+    the one it asks for on, as many as fit, possibly none.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+    Request - Request with buffers already checked by the dispatch routine
+
+Return Value:
+    VOID
+--*/
+{
+    NTSTATUS                status;
+    PSBC_EVENT_READ_REQUEST input;
+    PSBC_EVENT_READ_REPLY   reply;
+    size_t                  length;
+    SBC_U32                 next, count, lost;
+
+    status = WdfRequestRetrieveInputBuffer(Request, sizeof(SBC_EVENT_READ_REQUEST), &input, NULL);
+    if (NT_SUCCESS(status))
+    {
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SBC_EVENT_READ_REPLY) + sizeof(SBC_BUTTON_EVENT), &reply, &length);
+    }
+    if (!NT_SUCCESS(status))
+    {
+        WdfRequestComplete(Request, status);
+        return;
+    }
+
+    // Buffered I/O, the reply overwrites the request
+    next = input->Next;
+    count = SbcEventRingRead(&DeviceContext->Events, &next, (PSBC_BUTTON_EVENT)(reply + 1),
+        (SBC_U32)((length - sizeof(SBC_EVENT_READ_REPLY)) / sizeof(SBC_BUTTON_EVENT)), &lost);
+
+    reply->Next = next;
+    reply->Count = count;
+    reply->Lost = lost;
+    reply->Reserved = 0;
+
+    WdfRequestCompleteWithInformation(Request, STATUS_SUCCESS, sizeof(SBC_EVENT_READ_REPLY) + count * sizeof(SBC_BUTTON_EVENT));
+}
+
+
+VOID HidSteelBattalionEvtEventDeviceControl
+(
+    IN WDFQUEUE     Queue,
+    IN WDFREQUEST   Request,
+    IN size_t       OutputBufferLength,
+    IN size_t       InputBufferLength,
+    IN ULONG        IoControlCode
+)
+/*++
+Routine Description:
+    Handles the IOCTLs of the event device. A read that asks for the next
+    event to be pushed with SBC_EVENT_READ_WAIT is parked in EventWaitQueue
+    until the completion routine pushes one.
+
+Arguments:
+    Queue - Handle to the default queue of the event device
+    Request - Handle to the request
+    OutputBufferLength - Length of the output buffer
+    InputBufferLength - Length of the input buffer
+    IoControlCode - The IOCTL code
+
+Return Value:
+    VOID
+--*/
+{
+    NTSTATUS                status;
+    PDEVICE_EXTENSION       devContext = GetEventDeviceContext(WdfIoQueueGetDevice(Queue))->DeviceContext;
+    PSBC_EVENT_READ_REQUEST input;
+    SBC_EVENT_READ_REQUEST  read;
+    PVOID                   output;
+
+    UNREFERENCED_PARAMETER(OutputBufferLength);
+    UNREFERENCED_PARAMETER(InputBufferLength);
+
+    if (IoControlCode != SBC_IOCTL_READ_BUTTON_EVENTS)
+    {
+        WdfRequestComplete(Request, STATUS_INVALID_DEVICE_REQUEST);
+        return;
+    }
+
+    status = WdfRequestRetrieveInputBuffer(Request, sizeof(SBC_EVENT_READ_REQUEST), &input, NULL);
+    if (NT_SUCCESS(status))
+    {
+        read = *input;
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SBC_EVENT_READ_REPLY) + sizeof(SBC_BUTTON_EVENT), &output, NULL);
+    }
+    if (!NT_SUCCESS(status))
+    {
+        WdfRequestComplete(Request, status);
+        return;
+    }
+
+    if ((read.Flags & SBC_EVENT_READ_WAIT) == 0 || read.Next != devContext->Events.Head)
+    {
+        HidSteelBattalionEventsComplete(devContext, Request);
+        return;
+    }
+
+    status = WdfRequestForwardToIoQueue(Request, devContext->EventWaitQueue);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfRequestForwardToIoQueue failed 0x%x\n", status);
+        WdfRequestComplete(Request, status);
+        return;
+    }
+
+    // An event pushed while the request was being parked didn't see it
+    if (read.Next != devContext->Events.Head)
+    {
+        HidSteelBattalionEventsNotify(devContext);
+    }
+}
+
+
+VOID HidSteelBattalionEventsNotify(IN PDEVICE_EXTENSION DeviceContext)
+/*++
+Routine Description:
+    Completes the reads waiting for an event. Called by the completion
+    routine after pushing events, once StateLock is released. The ring is
+    read without locks, so several callers can drain the queue at once.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+
+Return Value:
+    VOID
+--*/
+{
+    WDFREQUEST request;
+
+    while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(DeviceContext->EventWaitQueue, &request)))
+    {
+        HidSteelBattalionEventsComplete(DeviceContext, request);
+    }
+}
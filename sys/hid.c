@@ -49,6 +49,10 @@ Return Value:
     NTSTATUS            status = STATUS_SUCCESS;
     WDFDEVICE           device;
     PDEVICE_EXTENSION   devContext = NULL;
+    UCHAR               report[SBC_MAX_INPUT_REPORT_SIZE];
+    ULONG               reportSize;
+    UCHAR               reportId = SBC_REPORT_ID_INPUT;
+    ULONGLONG           now;
 
     UNREFERENCED_PARAMETER(OutputBufferLength);
     UNREFERENCED_PARAMETER(InputBufferLength);
@@ -56,7 +60,7 @@ Return Value:
     device = WdfIoQueueGetDevice(Queue);
     devContext = GetDeviceContext(device);
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, DBG_IOCTL, "%s, Queue:0x%p, Request:0x%p\n", DbgHidInternalIoctlString(IoControlCode), Queue, Request);
+    HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceIoctl, IoControlCode, 0);
 
     //
     // Please note that HIDCLASS provides the buffer in the Irp->UserBuffer
@@ -87,10 +91,52 @@ Return Value:
 
     case IOCTL_HID_READ_REPORT:
         // Returns a report from the device into a class driver-supplied buffer.
-        // For now queue the request to the manual queue. The request will
-        // be retrived and completd when continuous reader reads new data
-        // from the device.
+        // If the state changed since the last completed read the request is
+        // completed right away from the latest-state cache, with the next
+        // part that changed when the reports are split. Otherwise queue
+        // the request to the manual queue. The request will be retrived and
+        // completd when continuous reader reads new data from the device.
+        now = HidSteelBattalionTimestamp();
+
+        // In buffered mode reads always park and take the queued reports in
+        // order, the drain completes this one straight away if there are any.
+        if (devContext->ReportQueue != NULL)
+        {
+            GetRequestContext(Request)->QueuedTime = now;
+            status = WdfRequestForwardToIoQueue(Request, devContext->InterruptMsgQueue);
+            HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceReadQueued, status, 0);
+            if (!NT_SUCCESS(status))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfRequestForwardToIoQueue failed with status: 0x%x\n", status);
+                WdfRequestComplete(Request, status);
+                return;
+            }
+            HidSteelBattalionReportQueueDrain(devContext);
+            return;
+        }
+
+        WdfSpinLockAcquire(devContext->StateLock);
+        if (devContext->SplitReports)
+        {
+            reportSize = SbcSplitCacheTake(&devContext->ReportCache, devContext->ReportMode, &reportId, report);
+        }
+        else
+        {
+            reportSize = SbcReportCacheTake(&devContext->ReportCache, report);
+        }
+        if (reportSize != 0)
+        {
+            SbcLatencyRecord(&devContext->DeliveryLatency, now - devContext->ReportCacheTime);
+            SbcLatencyRecord(&devContext->ReadWaitLatency, 0);
+            HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceReadFromCache, reportSize, now - devContext->ReportCacheTime);
+            WdfSpinLockRelease(devContext->StateLock);
+            HidSteelBattalionCompleteReadReport(devContext, Request, reportId, report, reportSize);
+            return;
+        }
+        GetRequestContext(Request)->QueuedTime = now;
         status = WdfRequestForwardToIoQueue(Request, devContext->InterruptMsgQueue);
+        WdfSpinLockRelease(devContext->StateLock);
+        HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceReadQueued, status, 0);
         if (!NT_SUCCESS(status))
 		{
             TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfRequestForwardToIoQueue failed with status: 0x%x\n", status);
@@ -127,15 +173,28 @@ Return Value:
     case IOCTL_HID_SET_FEATURE:
         // This sends a HID class feature report to a top-level collection of
         // a HID class device.
+        status = HidSteelBattalionSetFeature(device, Request);
 		break;
 
     case IOCTL_HID_GET_FEATURE:
         // Get a HID class feature report from a top-level collection of
         // a HID class device.
+        status = HidSteelBattalionGetFeature(device, Request);
 		break;
 
 	case IOCTL_HID_WRITE_REPORT:
-        //Transmits a class driver-supplied report to the device.
+        // Transmits a class driver-supplied report to the device. Only the
+        // LED output report exists, it goes through the LED shadow.
+        status = HidSteelBattalionWriteReport(device, Request);
+        break;
+
+    case IOCTL_HID_GET_INPUT_REPORT:
+        // Polls the current state of the device (HidD_GetInputReport). It is
+        // answered from the published state snapshot without going to the
+        // device.
+        status = HidSteelBattalionGetInputReport(device, Request);
+        break;
+
     case IOCTL_HID_GET_STRING:
         // Requests that the HID minidriver retrieve a human-readable string
         // for either the manufacturer ID, the product ID, or the serial number
@@ -162,6 +221,44 @@ Return Value:
     return;
 }
 
+static CONST HID_REPORT_DESCRIPTOR *HidSteelBattalionSelectDescriptors
+(
+    IN PDEVICE_EXTENSION DeviceContext,
+    OUT CONST HID_DESCRIPTOR **HidDescriptor
+)
+/*++
+Routine Description:
+    Picks the descriptors for the report mode and the split reports setting
+    of the device.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+    HidDescriptor - Receives the HID descriptor
+
+Return Value:
+    The report descriptor
+--*/
+{
+    if (DeviceContext->SplitReports)
+    {
+        if (DeviceContext->ReportMode == SbcReportMode16Bit)
+        {
+            *HidDescriptor = &G_SplitHighPrecisionHidDescriptor;
+            return G_SplitHighPrecisionReportDescriptor;
+        }
+        *HidDescriptor = &G_SplitHidDescriptor;
+        return G_SplitReportDescriptor;
+    }
+
+    if (DeviceContext->ReportMode == SbcReportMode16Bit)
+    {
+        *HidDescriptor = &G_HighPrecisionHidDescriptor;
+        return G_HighPrecisionReportDescriptor;
+    }
+    *HidDescriptor = &G_DefaultHidDescriptor;
+    return G_DefaultReportDescriptor;
+}
+
 NTSTATUS HidSteelBattalionGetHidDescriptor
 (
     IN WDFDEVICE Device,
@@ -180,11 +277,12 @@ Return Value
     NT status code.
 --*/
 {
-    NTSTATUS            status = STATUS_SUCCESS;
-    size_t              bytesToCopy = 0;
-    WDFMEMORY           memory;
+    NTSTATUS                status = STATUS_SUCCESS;
+    size_t                  bytesToCopy = 0;
+    WDFMEMORY               memory;
+    CONST HID_DESCRIPTOR    *hidDescriptor;
 
-    UNREFERENCED_PARAMETER(Device);
+    HidSteelBattalionSelectDescriptors(GetDeviceContext(Device), &hidDescriptor);
 
     TraceEvents(TRACE_LEVEL_VERBOSE, DBG_IOCTL, "HidFx2GetHidDescriptor Entry\n");
 
@@ -205,15 +303,15 @@ Return Value
     }
 
     // Use hardcoded "HID Descriptor"
-    bytesToCopy = G_DefaultHidDescriptor.bLength;
+    bytesToCopy = hidDescriptor->bLength;
     if (bytesToCopy == 0) 
 	{
         status = STATUS_INVALID_DEVICE_STATE;
-        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "G_DefaultHidDescriptor is zero, 0x%x\n", status);
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "HID descriptor length is zero, 0x%x\n", status);
         return status;
     }
 
-    status = WdfMemoryCopyFromBuffer(memory, 0, (PVOID) &G_DefaultHidDescriptor, bytesToCopy);
+    status = WdfMemoryCopyFromBuffer(memory, 0, (PVOID) hidDescriptor, bytesToCopy);
     if (!NT_SUCCESS(status)) 
 	{
         TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfMemoryCopyFromBuffer failed 0x%x\n", status);
@@ -240,11 +338,13 @@ Return Value:
     NT status code.
 --*/
 {
-    NTSTATUS            status = STATUS_SUCCESS;
-    ULONG_PTR           bytesToCopy;
-    WDFMEMORY           memory;
+    NTSTATUS                        status = STATUS_SUCCESS;
+    ULONG_PTR                       bytesToCopy;
+    WDFMEMORY                       memory;
+    CONST HID_DESCRIPTOR            *hidDescriptor;
+    CONST HID_REPORT_DESCRIPTOR     *reportDescriptor;
 
-    UNREFERENCED_PARAMETER(Device);
+    reportDescriptor = HidSteelBattalionSelectDescriptors(GetDeviceContext(Device), &hidDescriptor);
 
     TraceEvents(TRACE_LEVEL_VERBOSE, DBG_IOCTL, "HidFx2GetReportDescriptor Entry\n");
 
@@ -265,15 +365,15 @@ Return Value:
     }
 
     // Use hardcoded Report descriptor
-    bytesToCopy = G_DefaultHidDescriptor.DescriptorList[0].wReportLength;
+    bytesToCopy = hidDescriptor->DescriptorList[0].wReportLength;
     if (bytesToCopy == 0) 
 	{
         status = STATUS_INVALID_DEVICE_STATE;
-        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "G_DefaultHidDescriptor's reportLenght is zero, 0x%x\n", status);
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "HID descriptor's reportLenght is zero, 0x%x\n", status);
         return status;
     }
 
-    status = WdfMemoryCopyFromBuffer(memory, 0, (PVOID) G_DefaultReportDescriptor, bytesToCopy);
+    status = WdfMemoryCopyFromBuffer(memory, 0, (PVOID) reportDescriptor, bytesToCopy);
     if (!NT_SUCCESS(status)) 
 	{
         TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfMemoryCopyFromBuffer failed 0x%x\n", status);
@@ -338,6 +438,342 @@ Return Value:
 }
 
 
+VOID HidSteelBattalionCompleteReadReport
+(
+    IN PDEVICE_EXTENSION DeviceContext,
+    IN WDFREQUEST Request,
+    IN UCHAR ReportId,
+    IN PVOID Report,
+    IN size_t ReportSize
+)
+/*++
+Routine Description:
+    Copies an input report, preceded by its report ID, into the buffer of an
+    IOCTL_HID_READ_REPORT request and completes it.
+
+Arguments:
+    DeviceContext - Device the report is from
+
+    Request - Read request from hidclass
+    ReportId - SBC_REPORT_ID_INPUT, or the ID of the part with split reports
+    Report - Translated input report, or the part
+    ReportSize - Size of the report or the part
+
+Return Value:
+    VOID
+--*/
+{
+    NTSTATUS status;
+    PUCHAR   outputBuffer;
+    size_t   bytesReturned;
+
+    status = WdfRequestRetrieveOutputBuffer(Request, ReportSize + 1, &outputBuffer, &bytesReturned);
+    if (NT_SUCCESS(status))
+    {
+        outputBuffer[0] = ReportId;
+        memcpy(outputBuffer + 1, Report, ReportSize);
+        HidSteelBattalionCount(DeviceContext, SbcStatReadsCompleted);
+        WdfRequestCompleteWithInformation(Request, STATUS_SUCCESS, ReportSize + 1);
+    }
+    else
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfRequestRetrieveOutputBuffer status %08x\n", status);
+        HidSteelBattalionCount(DeviceContext, SbcStatBufferFailures);
+        WdfRequestCompleteWithInformation(Request, status, 0);
+    }
+}
+
+
+NTSTATUS HidSteelBattalionGetInputReport(IN WDFDEVICE Device, IN WDFREQUEST Request)
+/*++
+Routine Description:
+    Handles IOCTL_HID_GET_INPUT_REPORT with a copy of the latest translated
+    report, read from the published state without taking StateLock. Neither
+    the interrupt pipe nor the pending reads are involved, and the report
+    stays pending for the next read. In change-only mode it is the latest
+    state too, including reports the filter held back. With split reports
+    any of the three parts can be polled.
+
+Arguments:
+    Device - Handle to WDF Device Object
+    Request - Handle to request object
+
+Return Value:
+    NT status code.
+--*/
+{
+    PDEVICE_EXTENSION   devContext = GetDeviceContext(Device);
+    PHID_XFER_PACKET    transferPacket;
+    SBC_SNAPSHOT_STATE  state;
+    ULONGLONG           age;
+    SBC_U32             offset = 0;
+    SBC_U32             size;
+    int                 part;
+
+    //
+    // Like for the feature reports, hidclass passes the HID_XFER_PACKET in
+    // Irp->UserBuffer.
+    //
+    transferPacket = (PHID_XFER_PACKET)WdfRequestWdmGetIrp(Request)->UserBuffer;
+    if (transferPacket == NULL || transferPacket->reportBuffer == NULL)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Irp->UserBuffer is NULL\n");
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    part = devContext->SplitReports ? SbcSplitPartOf(transferPacket->reportId) : -1;
+    if (devContext->SplitReports ? part < 0 : transferPacket->reportId != SBC_REPORT_ID_INPUT)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Unknown input report ID %u\n", transferPacket->reportId);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    size = part >= 0 ? SbcSplitSlice(devContext->ReportMode, (SBC_SPLIT_PART)part, &offset) : SbcInputReportSize(devContext->ReportMode);
+    if (transferPacket->reportBufferLen < size + 1)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Input report buffer too small %u\n", transferPacket->reportBufferLen);
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    //
+    // Polls run at PASSIVE_LEVEL, the writer at DISPATCH_LEVEL can't be
+    // interrupted by one on its own processor.
+    //
+    SbcSnapshotRead(&devContext->State, &state);
+    age = HidSteelBattalionTimestamp() - state.Timestamp;
+
+    // Nothing has arrived from the device yet
+    if (state.Size == 0) return STATUS_DEVICE_NOT_READY;
+
+    HidSteelBattalionCount(devContext, SbcStatInputReportsPolled);
+    HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceInputReportPolled, size, age);
+
+    transferPacket->reportBuffer[0] = transferPacket->reportId;
+    RtlCopyMemory(transferPacket->reportBuffer + 1, state.Report + offset, size);
+    WdfRequestSetInformation(Request, size + 1);
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS HidSteelBattalionGetFeature(IN WDFDEVICE Device, IN WDFREQUEST Request)
+/*++
+Routine Description:
+    Handles IOCTL_HID_GET_FEATURE for the feature reports of the vendor
+    defined collection.
+
+Arguments:
+    Device - Handle to WDF Device Object
+    Request - Handle to request object
+
+Return Value:
+    NT status code.
+--*/
+{
+    PDEVICE_EXTENSION           devContext = GetDeviceContext(Device);
+    PHID_XFER_PACKET            transferPacket;
+    SBC_LATENCY_FEATURE_REPORT  latency;
+    SBC_CALIBRATION_FEATURE_REPORT calibration;
+    SBC_REMAP_FEATURE_REPORT    remap;
+    SBC_TRACE_FEATURE_REPORT    trace;
+    SBC_STATS_FEATURE_REPORT    stats;
+    SBC_U64                     counters[SbcStatCount];
+    ULONG                       i;
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DBG_IOCTL, "HidSteelBattalionGetFeature Entry\n");
+
+    //
+    // IOCTL_HID_GET_FEATURE is METHOD_NEITHER, hidclass passes the
+    // HID_XFER_PACKET in Irp->UserBuffer.
+    //
+    transferPacket = (PHID_XFER_PACKET)WdfRequestWdmGetIrp(Request)->UserBuffer;
+    if (transferPacket == NULL || transferPacket->reportBuffer == NULL)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Irp->UserBuffer is NULL\n");
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    switch (transferPacket->reportId)
+    {
+    case SBC_REPORT_ID_LATENCY:
+        if (transferPacket->reportBufferLen < sizeof(latency))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Latency feature report buffer too small %u\n", transferPacket->reportBufferLen);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        WdfSpinLockAcquire(devContext->StateLock);
+        SbcLatencyBuildFeatureReport(&devContext->DeliveryLatency, &devContext->ReadWaitLatency, &latency);
+        WdfSpinLockRelease(devContext->StateLock);
+
+        RtlCopyMemory(transferPacket->reportBuffer, &latency, sizeof(latency));
+        WdfRequestSetInformation(Request, sizeof(latency));
+        return STATUS_SUCCESS;
+
+    case SBC_REPORT_ID_CALIBRATION:
+        if (transferPacket->reportBufferLen < sizeof(calibration))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Calibration feature report buffer too small %u\n", transferPacket->reportBufferLen);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        HidSteelBattalionGetCalibration(Device, &calibration);
+
+        RtlCopyMemory(transferPacket->reportBuffer, &calibration, sizeof(calibration));
+        WdfRequestSetInformation(Request, sizeof(calibration));
+        return STATUS_SUCCESS;
+
+    case SBC_REPORT_ID_REMAP:
+        if (transferPacket->reportBufferLen < sizeof(remap))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Remap feature report buffer too small %u\n", transferPacket->reportBufferLen);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        HidSteelBattalionGetRemap(Device, &remap);
+
+        RtlCopyMemory(transferPacket->reportBuffer, &remap, sizeof(remap));
+        WdfRequestSetInformation(Request, sizeof(remap));
+        return STATUS_SUCCESS;
+
+    case SBC_REPORT_ID_TRACE:
+        if (transferPacket->reportBufferLen < sizeof(trace))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Trace feature report buffer too small %u\n", transferPacket->reportBufferLen);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        SbcTraceBuildFeatureReport(devContext->Trace, &trace);
+
+        RtlCopyMemory(transferPacket->reportBuffer, &trace, sizeof(trace));
+        WdfRequestSetInformation(Request, sizeof(trace));
+        return STATUS_SUCCESS;
+
+    case SBC_REPORT_ID_STATS:
+        if (transferPacket->reportBufferLen < sizeof(stats))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Statistics feature report buffer too small %u\n", transferPacket->reportBufferLen);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        // Each counter is read atomically, they are not a consistent set
+        for (i = 0; i < SbcStatCount; ++i)
+        {
+            counters[i] = (SBC_U64)InterlockedCompareExchange64(&devContext->Counters[i], 0, 0);
+        }
+
+        WdfSpinLockAcquire(devContext->StateLock);
+        counters[SbcStatReportsDropped] = devContext->ReportCache.Dropped;
+        counters[SbcStatReportsSuppressed] = devContext->ChangeFilter.Suppressed;
+        counters[SbcStatQueueOverflows] = devContext->ReportQueue != NULL ? devContext->ReportQueue->Overflows : 0;
+        WdfSpinLockRelease(devContext->StateLock);
+
+        SbcStatsBuildFeatureReport(counters, devContext->StatsStarted, HidSteelBattalionTimestamp(), &stats);
+
+        RtlCopyMemory(transferPacket->reportBuffer, &stats, sizeof(stats));
+        WdfRequestSetInformation(Request, sizeof(stats));
+        return STATUS_SUCCESS;
+
+    default:
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Unknown feature report ID %u\n", transferPacket->reportId);
+        return STATUS_INVALID_PARAMETER;
+    }
+}
+
+
+NTSTATUS HidSteelBattalionSetFeature(IN WDFDEVICE Device, IN WDFREQUEST Request)
+/*++
+Routine Description:
+    Handles IOCTL_HID_SET_FEATURE. The calibration and remap feature
+    reports can be written. Writing the trace feature report dumps the
+    trace ring, its contents are ignored.
+
+Arguments:
+    Device - Handle to WDF Device Object
+    Request - Handle to request object
+
+Return Value:
+    NT status code.
+--*/
+{
+    NTSTATUS                        status;
+    PHID_XFER_PACKET                transferPacket;
+    SBC_CALIBRATION_FEATURE_REPORT  calibration;
+    SBC_REMAP_FEATURE_REPORT        remap;
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DBG_IOCTL, "HidSteelBattalionSetFeature Entry\n");
+
+    //
+    // IOCTL_HID_SET_FEATURE is METHOD_NEITHER, hidclass passes the
+    // HID_XFER_PACKET in Irp->UserBuffer.
+    //
+    transferPacket = (PHID_XFER_PACKET)WdfRequestWdmGetIrp(Request)->UserBuffer;
+    if (transferPacket == NULL || transferPacket->reportBuffer == NULL)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Irp->UserBuffer is NULL\n");
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    HidSteelBattalionTrace(INFORMATION, GetDeviceContext(Device), SbcTraceSetFeature, transferPacket->reportId, transferPacket->reportBufferLen);
+
+    switch (transferPacket->reportId)
+    {
+    case SBC_REPORT_ID_CALIBRATION:
+        if (transferPacket->reportBufferLen < sizeof(calibration))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Calibration feature report buffer too small %u\n", transferPacket->reportBufferLen);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        // Compiling the tables and writing the registry need PASSIVE_LEVEL,
+        // which is where HidD_SetFeature requests arrive.
+        if (KeGetCurrentIrql() != PASSIVE_LEVEL) return STATUS_INVALID_DEVICE_STATE;
+
+        RtlCopyMemory(&calibration, transferPacket->reportBuffer, sizeof(calibration));
+        status = HidSteelBattalionSetCalibration(Device, &calibration);
+        if (!NT_SUCCESS(status)) return status;
+
+        WdfRequestSetInformation(Request, sizeof(calibration));
+        return STATUS_SUCCESS;
+
+    case SBC_REPORT_ID_REMAP:
+        if (transferPacket->reportBufferLen < sizeof(remap))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Remap feature report buffer too small %u\n", transferPacket->reportBufferLen);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        if (KeGetCurrentIrql() != PASSIVE_LEVEL) return STATUS_INVALID_DEVICE_STATE;
+
+        RtlCopyMemory(&remap, transferPacket->reportBuffer, sizeof(remap));
+        status = HidSteelBattalionSetRemap(Device, &remap);
+        if (!NT_SUCCESS(status)) return status;
+
+        WdfRequestSetInformation(Request, sizeof(remap));
+        return STATUS_SUCCESS;
+
+    case SBC_REPORT_ID_TRACE:
+        if (transferPacket->reportBufferLen < sizeof(SBC_TRACE_FEATURE_REPORT))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Trace feature report buffer too small %u\n", transferPacket->reportBufferLen);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        // Writes the dump file
+        if (KeGetCurrentIrql() != PASSIVE_LEVEL) return STATUS_INVALID_DEVICE_STATE;
+
+        status = HidSteelBattalionTraceDump(Device);
+        if (!NT_SUCCESS(status)) return status;
+
+        WdfRequestSetInformation(Request, sizeof(SBC_TRACE_FEATURE_REPORT));
+        return STATUS_SUCCESS;
+
+    default:
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Unknown feature report ID %u\n", transferPacket->reportId);
+        return STATUS_INVALID_PARAMETER;
+    }
+}
+
+
 NTSTATUS HidSteelBattalionSendIdleNotification(IN WDFREQUEST Request)
 /*++
 Routine Description:
@@ -399,27 +835,9 @@ Return Value:
     sendStatus = WdfRequestSend(Request, nextLowerDriver, &options);
 
     if (sendStatus == FALSE) status = STATUS_UNSUCCESSFUL;
+    else HidSteelBattalionCount(GetDeviceContext(device), SbcStatIdleNotifications);
 
     return status;
 }
 
-PCHAR DbgHidInternalIoctlString(IN ULONG IoControlCode)
-{
-    switch (IoControlCode)
-    {
-    case IOCTL_HID_GET_DEVICE_DESCRIPTOR: return "IOCTL_HID_GET_DEVICE_DESCRIPTOR";
-    case IOCTL_HID_GET_REPORT_DESCRIPTOR: return "IOCTL_HID_GET_REPORT_DESCRIPTOR";
-    case IOCTL_HID_READ_REPORT: return "IOCTL_HID_READ_REPORT";
-    case IOCTL_HID_GET_DEVICE_ATTRIBUTES: return "IOCTL_HID_GET_DEVICE_ATTRIBUTES";
-    case IOCTL_HID_WRITE_REPORT: return "IOCTL_HID_WRITE_REPORT";
-    case IOCTL_HID_SET_FEATURE: return "IOCTL_HID_SET_FEATURE";
-    case IOCTL_HID_GET_FEATURE: return "IOCTL_HID_GET_FEATURE";
-    case IOCTL_HID_GET_STRING: return "IOCTL_HID_GET_STRING";
-    case IOCTL_HID_ACTIVATE_DEVICE: return "IOCTL_HID_ACTIVATE_DEVICE";
-    case IOCTL_HID_DEACTIVATE_DEVICE: return "IOCTL_HID_DEACTIVATE_DEVICE";
-    case IOCTL_HID_SEND_IDLE_NOTIFICATION_REQUEST: return "IOCTL_HID_SEND_IDLE_NOTIFICATION_REQUEST";
-    default: return "Unknown IOCTL";
-    }
-}
-
 
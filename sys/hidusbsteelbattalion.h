@@ -29,12 +29,40 @@ Copyright (c) Oscar Sebio Cajaraville 2019.
 #include <ntstrsafe.h>
 
 #include "trace.h"
+#include "sbccore.h"
+#include "sbccapture.h"
+#include "sbclatency.h"
+#include "sbcled.h"
+#include "sbccalib.h"
+#include "sbcresponse.h"
+#include "sbcremap.h"
+#include "sbccombo.h"
+#include "sbctrace.h"
+#include "sbcqueue.h"
+#include "sbcstats.h"
+#include "sbcsmooth.h"
+#include "sbcsnapshot.h"
+#include "sbcsplit.h"
+#include "sbcevents.h"
+#include "sbcdescriptor.h"
 
 #define _DRIVER_NAME_                 "STEEL BATTALION CONTROLLER: "
 #define POOL_TAG                      (ULONG) 'HSBC'
 
 #define INTERRUPT_ENDPOINT_INDEX     (0)
 
+//
+// Continuous reader limits. A depth of 0 leaves the framework default.
+//
+#define READER_DEFAULT_TRANSFER_SIZE (32)
+#define READER_MAX_TRANSFER_SIZE     (512)
+#define READER_MAX_DEPTH             (10)
+
+//
+// Default limit of the LED frames sent to the device, see LedMaxFrameRate
+//
+#define LED_DEFAULT_MAX_FRAME_RATE   (60)
+
 typedef UCHAR HID_REPORT_DESCRIPTOR, *PHID_REPORT_DESCRIPTOR;
 
 //
@@ -50,59 +78,12 @@ typedef UCHAR HID_REPORT_DESCRIPTOR, *PHID_REPORT_DESCRIPTOR;
 //
 // HID Report Descriptor
 //
+// Generated from the report layout in sbccore.h, see sbcdescriptor.h. The
+// game pad collection has the input report (SBC_REPORT_ID_INPUT), the
+// vendor defined collection the feature reports and the LED output report.
+//
 CONST HID_REPORT_DESCRIPTOR G_DefaultReportDescriptor[] = {
-	0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
-	0x09, 0x05,                    // USAGE (Game Pad)
-	0xa1, 0x01,                    // COLLECTION (Application)
-	0x75, 0x01,                    //   REPORT_SIZE (1)
-	0x95, 0x27,                    //   REPORT_COUNT (39)
-	0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
-	0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
-	0x05, 0x09,                    //   USAGE_PAGE (Button)
-	0x19, 0x01,                    //   USAGE_MINIMUM (Button 1)
-	0x29, 0x27,                    //   USAGE_MAXIMUM (Button 39)
-	0x81, 0x02,                    //   INPUT (Data,Var,Abs)
-	0x75, 0x01,                    //   REPORT_SIZE (1)
-	0x95, 0x01,                    //   REPORT_COUNT (1)
-	0x81, 0x03,                    //   INPUT (Cnst,Var,Abs)
-	0x05, 0x01,                    //   USAGE_PAGE (Generic Desktop)
-	0x09, 0x01,                    //   USAGE (Pointer)
-	0xa1, 0x00,                    //   COLLECTION (Physical)
-	0x09, 0x30,                    //     USAGE (X)
-	0x09, 0x31,                    //     USAGE (Y)
-	0x09, 0x32,                    //     USAGE (Z)
-	0x09, 0x33,                    //     USAGE (Rx)
-	0x09, 0x34,                    //     USAGE (Ry)
-	0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
-	0x26, 0xff, 0x00,              //     LOGICAL_MAXIMUM (255)
-	0x75, 0x08,                    //     REPORT_SIZE (8)
-	0x95, 0x05,                    //     REPORT_COUNT (5)
-	0x81, 0x02,                    //     INPUT (Data,Var,Abs)
-	0xc0,                          //   END_COLLECTION
-	0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
-	0x26, 0xff, 0x00,              //   LOGICAL_MAXIMUM (255)
-	0x05, 0x01,                    //   USAGE_PAGE (Generic Desktop)
-	0x09, 0x36,                    //   USAGE (Slider)
-	0x75, 0x08,                    //   REPORT_SIZE (8)
-	0x95, 0x01,                    //   REPORT_COUNT (1)
-	0x81, 0x02,                    //   INPUT (Data,Var,Abs)
-	0x05, 0x02,                    //   USAGE_PAGE (Simulation Controls)
-	0x09, 0xc5,                    //   USAGE (Brake)
-	0x09, 0xbb,                    //   USAGE (Throttle)
-	0x75, 0x08,                    //   REPORT_SIZE (8)
-	0x95, 0x02,                    //   REPORT_COUNT (2)
-	0x81, 0x02,                    //   INPUT (Data,Var,Abs)
-	0x09, 0xc2,                    //   USAGE (Weapons Select)
-	0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
-	0x26, 0xff, 0x00,              //   LOGICAL_MAXIMUM (255)
-	0x75, 0x08,                    //   REPORT_SIZE (8)
-	0x95, 0x01,                    //   REPORT_COUNT (1)
-	0x81, 0x02,                    //   INPUT (Data,Var,Abs)
-	0x09, 0xc7,                    //   USAGE (Shifter)
-	0x15, 0x80,                    //   LOGICAL_MINIMUM (-128)
-	0x25, 0x7f,                    //   LOGICAL_MAXIMUM (127)
-	0x81, 0x02,                    //   INPUT (Data,Var,Abs)
-	0xc0                           // END_COLLECTION
+	SBC_REPORT_DESCRIPTOR(SBC_HID_AXES_8)
 };
 
 
@@ -122,107 +103,87 @@ CONST HID_DESCRIPTOR G_DefaultHidDescriptor = {
     sizeof(G_DefaultReportDescriptor) }  // total length of report descriptor
 };
 
+//
+// Report descriptor used when the HighPrecisionAxes registry value is set.
+// Same collections and usages as G_DefaultReportDescriptor with the 8 axes
+// reported at 16 bits (see HIDFX2_INPUT_REPORT_16).
+//
+CONST HID_REPORT_DESCRIPTOR G_HighPrecisionReportDescriptor[] = {
+	SBC_REPORT_DESCRIPTOR(SBC_HID_AXES_16)
+};
+
+CONST HID_DESCRIPTOR G_HighPrecisionHidDescriptor = {
+    0x09,   // length of HID descriptor
+    0x21,   // descriptor type == HID  0x21
+    0x0100, // hid spec release
+    0x00,   // country code == Not Specified
+    0x01,   // number of HID class descriptors
+    { 0x22,   // descriptor type 
+    sizeof(G_HighPrecisionReportDescriptor) }  // total length of report descriptor
+};
+
+//
+// Report descriptors used when the SplitReports registry value is set. The
+// same fields in three input reports (see sbcsplit.h).
+//
+CONST HID_REPORT_DESCRIPTOR G_SplitReportDescriptor[] = {
+	SBC_SPLIT_REPORT_DESCRIPTOR(SBC_HID_AXES_8)
+};
+
+CONST HID_DESCRIPTOR G_SplitHidDescriptor = {
+    0x09,   // length of HID descriptor
+    0x21,   // descriptor type == HID  0x21
+    0x0100, // hid spec release
+    0x00,   // country code == Not Specified
+    0x01,   // number of HID class descriptors
+    { 0x22,   // descriptor type 
+    sizeof(G_SplitReportDescriptor) }  // total length of report descriptor
+};
+
+CONST HID_REPORT_DESCRIPTOR G_SplitHighPrecisionReportDescriptor[] = {
+	SBC_SPLIT_REPORT_DESCRIPTOR(SBC_HID_AXES_16)
+};
+
+CONST HID_DESCRIPTOR G_SplitHighPrecisionHidDescriptor = {
+    0x09,   // length of HID descriptor
+    0x21,   // descriptor type == HID  0x21
+    0x0100, // hid spec release
+    0x00,   // country code == Not Specified
+    0x01,   // number of HID class descriptors
+    { 0x22,   // descriptor type 
+    sizeof(G_SplitHighPrecisionReportDescriptor) }  // total length of report descriptor
+};
+
 #endif // USE_HARDCODED_HID_REPORT_DESCRIPTOR
 
 //
-// Data generated by the Steel Battalion Controller
-//
-// == Buttons order ==
-//
-// Buttons0:
-// 0x01 RightJoyMainWeapon
-// 0x02 RightJoyFire
-// 0x04 RightJoyLockOn
-// 0x08 Eject
-// 0x10 CockpitHatch
-// 0x20 Ignition
-// 0x40 Start
-// 0x80 MultiMonOpenClose
-//
-// Buttons 1
-// 0x01 MultiMonMapZoomInOut
-// 0x02 MultiMonModeSelect
-// 0x04 MultiMonSubMonitor
-// 0x08 MainMonZoomIn
-// 0x10 MainMonZoomOut
-// 0x20 FunctionFSS
-// 0x40 FunctionManipulator
-// 0x80 FunctionLineColorChange
-//
-// Buttons 2
-// 0x01 Washing
-// 0x02 Extinguisher
-// 0x04 Chaff
-// 0x08 FunctionTankDetach
-// 0x10 FunctionOverride
-// 0x20 FunctionNightScope
-// 0x40 FunctionF1
-// 0x80 FunctionF2
-//
-// Buttons 3
-// 0x01 FunctionF3
-// 0x02 WeaponCtrlMain
-// 0x04 WeaponCtrlSub
-// 0x08 WeaponCtrlMagazineChange
-// 0x10 Comm1
-// 0x20 Comm2
-// 0x40 Comm3
-// 0x80 Comm4 
-//
-// Buttons 4
-// 0x01 Comm5
-// 0x02 LeftJoySightChange
-// 0x04 ToggleFilterControl
-// 0x08 ToggleOxygenSupply
-// 0x10 ToggleFuelFlowRate
-// 0x20 ToggleBufferMaterial
-// 0x40 ToggleVTLocation
-//
-typedef struct _SBC_INPUT_DATA
+// Capture ring and the staging buffer the work item writes from. The
+// records of both follow the structure, sized for ReaderTransferSize.
+//
+typedef struct _CAPTURE_BUFFERS
+{
+    SBC_CAPTURE_RING    Ring;
+    PUCHAR              Staging;
+} CAPTURE_BUFFERS, *PCAPTURE_BUFFERS;
+
+//
+// Calibration tables. A new calibration is compiled into the table that is
+// not in use and then made active.
+//
+typedef struct _CALIBRATION_BUFFERS
 {
-	BYTE	_pad0;		
-	BYTE	_pad1;		
-	BYTE	Buttons0;
-	BYTE	Buttons1;
-	BYTE	Buttons2;
-	BYTE	Buttons3;
-	BYTE	Buttons4;
-	BYTE	_pad2;
-	USHORT	AimX;
-	USHORT	AimY;
-	SHORT	Rotation;
-	SHORT	SightX;
-	SHORT	SightY;
-	USHORT	Clutch;
-	USHORT	Brake;
-	USHORT	Throttle;
-	BYTE	Tuner;
-	CHAR	Gear;
-} SBC_INPUT_DATA, *PSBC_INPUT_DATA;
-
-//
-// HID Report Data
-//
-#include <pshpack1.h>
-typedef struct _HIDFX2_INPUT_REPORT 
+    ULONG                   Active;
+    SBC_CALIBRATION_TABLES  Tables[2];
+} CALIBRATION_BUFFERS, *PCALIBRATION_BUFFERS;
+
+//
+// Button remapping tables, swapped the same way as the calibration ones
+//
+typedef struct _REMAP_BUFFERS
 {
-	BYTE Buttons0;
-	BYTE Buttons1;
-	BYTE Buttons2;
-	BYTE Buttons3;
-	BYTE Buttons4;
-	BYTE AimX;
-	BYTE AimY;
-	BYTE Rotation;
-	BYTE SightX;
-	BYTE SightY;
-	BYTE Clutch;
-	BYTE Brake;
-	BYTE Throttle;
-	BYTE Tuner;
-	CHAR Gear;
-} HIDFX2_INPUT_REPORT, *PHIDFX2_INPUT_REPORT;
-#include <poppack.h>
+    ULONG               Active;
+    SBC_REMAP_TABLES    Tables[2];
+} REMAP_BUFFERS, *PREMAP_BUFFERS;
 
 typedef struct _DEVICE_EXTENSION
 {
@@ -237,10 +198,179 @@ typedef struct _DEVICE_EXTENSION
     // WDF Queue for read IOCTLs from hidclass that get satisfied from 
     // USB interrupt endpoint
     WDFQUEUE   InterruptMsgQueue;
+
+    // Continuous reader configuration, from the ReaderDepth and
+    // ReaderTransferSize registry values
+    ULONG      ReaderDepth;
+    ULONG      ReaderTransferSize;
+
+    // Statistics, read through the statistics feature report. The counters
+    // are interlocked, with more than one read the completion routine can
+    // run on several processors at once. The ones kept elsewhere under
+    // StateLock (dropped, suppressed and overflowed reports) are filled in
+    // when the report is built.
+    LONG64     Counters[SbcStatCount];
+    ULONGLONG  StatsStarted;
+
+    // Protects the report state below. Taken by the continuous reader and
+    // by the IOCTL_HID_READ_REPORT dispatch so a report is either delivered
+    // to a pending read or left in the cache for the next one.
+    WDFSPINLOCK StateLock;
+
+    // Input report layout, from the HighPrecisionAxes registry value
+    SBC_REPORT_MODE ReportMode;
+
+    // Latest translated report and whether it still has to be delivered
+    SBC_REPORT_CACHE ReportCache;
+
+    // Change-only mode: reports that don't differ from the last delivered
+    // one (within the axis deadbands) don't complete reads.
+    BOOLEAN ChangeOnly;
+    SBC_CHANGE_FILTER ChangeFilter;
+
+    // Split reports, from the SplitReports registry value: reads get the
+    // parts of the report that changed (see sbcsplit.h) instead of the
+    // whole report. Off in buffered mode.
+    BOOLEAN SplitReports;
+
+    // Capture of the raw interrupt pipe traffic to the file named by the
+    // CaptureFile registry value. CaptureFile is NULL when not capturing.
+    WDFSTRING           CapturePath;
+    HANDLE              CaptureFile;
+    WDFSPINLOCK         CaptureLock;
+    WDFWORKITEM         CaptureWorkItem;
+    PCAPTURE_BUFFERS    Capture;
+
+    // Latency histograms, read through the latency feature report. Protected
+    // by StateLock. ReportCacheTime is when the packet of the report in
+    // ReportCache arrived.
+    ULONGLONG               ReportCacheTime;
+    SBC_LATENCY_HISTOGRAM   DeliveryLatency;
+    SBC_LATENCY_HISTOGRAM   ReadWaitLatency;
+
+    // Panel LEDs. Output reports update the shadow, frames go to the
+    // interrupt OUT pipe one at a time at up to LedMaxFrameRate per second.
+    // LedPipe is NULL if the device has no OUT endpoint or it couldn't be
+    // started. The shadow is protected by LedLock.
+    WDFUSBPIPE          LedPipe;
+    ULONG               LedMaxFrameRate;
+    WDFSPINLOCK         LedLock;
+    SBC_LED_SHADOW      LedShadow;
+    WDFTIMER            LedTimer;
+    WDFREQUEST          LedRequest;
+    WDFMEMORY           LedMemory;
+
+    // Axis calibration, from the Calibration registry value and the
+    // calibration feature report. Reports are translated with the active
+    // tables. CalibrationAxes and Calibration->Active are protected by
+    // StateLock, CalibrationLock serializes the updates.
+    SBC_AXIS_CALIBRATION    CalibrationAxes[SbcAxisCount];
+    WDFWAITLOCK             CalibrationLock;
+    PCALIBRATION_BUFFERS    Calibration;
+
+    // Adaptive smoothing of the raw axes before the translation, from the
+    // AxisSmoothing registry value. Protected by StateLock.
+    SBC_SMOOTH              Smoothing;
+
+    // Deadzones and response curves applied after the calibration, from
+    // the ResponseCurves registry value. Read only after DeviceAdd.
+    SBC_RESPONSE            Response;
+
+    // Button remapping, from the ButtonRemap registry value and the remap
+    // feature report. Applied to every report with the active tables.
+    // RemapTargets and Remap->Active are protected by StateLock, RemapLock
+    // serializes the updates.
+    SBC_U8                  RemapTargets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+    WDFWAITLOCK             RemapLock;
+    PREMAP_BUFFERS          Remap;
+
+    // Chords and sequences driving the virtual buttons, from the
+    // ButtonCombos registry value. The tables are read only after
+    // DeviceAdd, ComboState is protected by StateLock.
+    SBC_COMBO_TABLES        Combos;
+    SBC_COMBO_STATE         ComboState;
+
+    // Binary trace of the I/O path, written without locks from any IRQL.
+    // Dumped to the file named by the TraceFile registry value when the
+    // trace feature report is set.
+    PSBC_TRACE_RING         Trace;
+    WDFSTRING               TracePath;
+
+    // Buffered mode, from the ReportQueueDepth registry value. Every report
+    // goes through ReportQueue and reads take them in order instead of the
+    // latest state in ReportCache. The completion routine pushes under
+    // StateLock, which makes it the single producer, ReportQueueDrains
+    // elects the single consumer. ReportQueue is NULL when the mode is off.
+    ULONG                   ReportQueueDepth;
+    PSBC_REPORT_QUEUE       ReportQueue;
+    LONG                    ReportQueueDrains;
+
+    // Latest translated report, before the change filter, published with a
+    // sequence lock. The completion routine writes it under StateLock,
+    // input report polls read it without taking any lock.
+    SBC_STATE_SNAPSHOT      State;
+
+    // Button event stream (see sbcevents.h). The completion routine pushes
+    // the edges of every report under StateLock, the reads of the event
+    // device copy them without taking any lock. EventDevice is the control
+    // device of this controller, EventWaitQueue parks the reads waiting
+    // for the next edge.
+    SBC_EVENT_RING          Events;
+    WDFDEVICE               EventDevice;
+    WDFQUEUE                EventWaitQueue;
 } DEVICE_EXTENSION, * PDEVICE_EXTENSION;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_EXTENSION, GetDeviceContext)
 
+//
+// Context of the event device of a controller
+//
+typedef struct _EVENT_DEVICE_CONTEXT
+{
+    PDEVICE_EXTENSION DeviceContext;
+} EVENT_DEVICE_CONTEXT, *PEVENT_DEVICE_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(EVENT_DEVICE_CONTEXT, GetEventDeviceContext)
+
+//
+// Context of every request the device receives
+//
+typedef struct _REQUEST_CONTEXT
+{
+    // When an IOCTL_HID_READ_REPORT was parked in InterruptMsgQueue
+    ULONGLONG QueuedTime;
+} REQUEST_CONTEXT, *PREQUEST_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(REQUEST_CONTEXT, GetRequestContext)
+
+//
+// Timestamps used by the portable code are in nanoseconds. They come from
+// the performance counter, the interrupt time only moves once per clock
+// tick which is too coarse to timestamp packets.
+//
+__forceinline ULONGLONG HidSteelBattalionTimestamp(VOID)
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter = KeQueryPerformanceCounter(&frequency);
+
+    return (ULONGLONG)(counter.QuadPart / frequency.QuadPart) * 1000000000 +
+        (ULONGLONG)(counter.QuadPart % frequency.QuadPart) * 1000000000 / (ULONGLONG)frequency.QuadPart;
+}
+
+//
+// Records an event in the trace ring of the device. Level is ERROR,
+// WARNING, INFORMATION or VERBOSE, events above SBC_TRACE_LEVEL are not
+// compiled in and their arguments are not evaluated.
+//
+#define HidSteelBattalionTrace(Level, DeviceContext, Id, Arg0, Arg1) \
+    SBC_TRACE_##Level((DeviceContext)->Trace, HidSteelBattalionTimestamp(), KeGetCurrentProcessorNumberEx(NULL), Id, Arg0, Arg1)
+
+//
+// Increments a statistics counter of the device
+//
+#define HidSteelBattalionCount(DeviceContext, Stat) \
+    InterlockedIncrement64(&(DeviceContext)->Counters[Stat])
+
 //
 // driver routine declarations
 //
@@ -256,13 +386,19 @@ WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_EXTENSION, GetDeviceContext)
 //
 DRIVER_INITIALIZE DriverEntry;
 EVT_WDF_DRIVER_DEVICE_ADD HidSteelBattalionEvtDeviceAdd;
+VOID HidSteelBattalionReadDeviceSettings(IN WDFDEVICE Device);
 EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL HidSteelBattleEvtInternalDeviceControl;
 
 NTSTATUS HidSteelBattalionGetHidDescriptor(IN WDFDEVICE Device, IN WDFREQUEST Request);
 NTSTATUS HidSteelBattalionGetReportDescriptor(IN WDFDEVICE Device, IN WDFREQUEST Request);
 NTSTATUS HidSteelBattalionGetDeviceAttributes(IN WDFREQUEST Request);
+VOID HidSteelBattalionCompleteReadReport(IN PDEVICE_EXTENSION DeviceContext, IN WDFREQUEST Request, IN UCHAR ReportId, IN PVOID Report, IN size_t ReportSize);
+NTSTATUS HidSteelBattalionGetInputReport(IN WDFDEVICE Device, IN WDFREQUEST Request);
+NTSTATUS HidSteelBattalionGetFeature(IN WDFDEVICE Device, IN WDFREQUEST Request);
+NTSTATUS HidSteelBattalionSetFeature(IN WDFDEVICE Device, IN WDFREQUEST Request);
 
 EVT_WDF_DEVICE_PREPARE_HARDWARE HidSteelBattalionEvtDevicePrepareHardware;
+EVT_WDF_DEVICE_RELEASE_HARDWARE HidSteelBattalionEvtDeviceReleaseHardware;
 EVT_WDF_DEVICE_D0_ENTRY HidSteelBattalionEvtDeviceD0Entry;
 EVT_WDF_DEVICE_D0_EXIT HidSteelBattalionEvtDeviceD0Exit;
 
@@ -270,9 +406,34 @@ PCHAR DbgDevicePowerString(IN WDF_POWER_DEVICE_STATE Type);
 NTSTATUS HidSteelBattalionConfigContReaderForInterruptEndPoint(PDEVICE_EXTENSION DeviceContext);
 
 EVT_WDF_USB_READER_COMPLETION_ROUTINE HidSteelBattalionEvtUsbInterruptPipeReadComplete;
+
+NTSTATUS HidSteelBattalionCaptureOpen(IN WDFDEVICE Device);
+VOID HidSteelBattalionCaptureClose(IN WDFDEVICE Device);
+VOID HidSteelBattalionCaptureRecord(IN PDEVICE_EXTENSION DeviceContext, IN PVOID Data, IN size_t Length, IN ULONGLONG Arrival);
+EVT_WDF_WORKITEM HidSteelBattalionEvtCaptureWorkItem;
 EVT_WDF_OBJECT_CONTEXT_CLEANUP HidSteelBattalionEvtDriverContextCleanup;
 
-PCHAR DbgHidInternalIoctlString(IN ULONG IoControlCode);
+NTSTATUS HidSteelBattalionLedCreate(IN WDFDEVICE Device);
+VOID HidSteelBattalionLedKick(IN PDEVICE_EXTENSION DeviceContext);
+NTSTATUS HidSteelBattalionWriteReport(IN WDFDEVICE Device, IN WDFREQUEST Request);
+EVT_WDF_REQUEST_COMPLETION_ROUTINE HidSteelBattalionEvtLedWriteComplete;
+EVT_WDF_TIMER HidSteelBattalionEvtLedTimer;
+
+NTSTATUS HidSteelBattalionCalibrationCreate(IN WDFDEVICE Device);
+NTSTATUS HidSteelBattalionSetCalibration(IN WDFDEVICE Device, IN PSBC_CALIBRATION_FEATURE_REPORT Report);
+VOID HidSteelBattalionGetCalibration(IN WDFDEVICE Device, OUT PSBC_CALIBRATION_FEATURE_REPORT Report);
+NTSTATUS HidSteelBattalionRemapCreate(IN WDFDEVICE Device);
+NTSTATUS HidSteelBattalionSetRemap(IN WDFDEVICE Device, IN PSBC_REMAP_FEATURE_REPORT Report);
+VOID HidSteelBattalionGetRemap(IN WDFDEVICE Device, OUT PSBC_REMAP_FEATURE_REPORT Report);
+NTSTATUS HidSteelBattalionTraceCreate(IN WDFDEVICE Device);
+NTSTATUS HidSteelBattalionTraceDump(IN WDFDEVICE Device);
+NTSTATUS HidSteelBattalionReportQueueCreate(IN WDFDEVICE Device);
+VOID HidSteelBattalionReportQueueDrain(IN PDEVICE_EXTENSION DeviceContext);
+NTSTATUS HidSteelBattalionEventsCreate(IN WDFDEVICE Device);
+VOID HidSteelBattalionEventsNotify(IN PDEVICE_EXTENSION DeviceContext);
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL HidSteelBattalionEvtEventDeviceControl;
+EVT_WDF_OBJECT_CONTEXT_CLEANUP HidSteelBattalionEvtDeviceContextCleanup;
+
 NTSTATUS HidSteelBattalionSendIdleNotification(IN WDFREQUEST Request);
 
 USBD_STATUS HidSteelBattalionValidateConfigurationDescriptor(IN PUSB_CONFIGURATION_DESCRIPTOR ConfigDesc, IN ULONG BufferLength, _Inout_ PUCHAR *Offset);
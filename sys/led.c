@@ -0,0 +1,267 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "hidusbsteelbattalion.h"
+
+#if defined(EVENT_TRACING)
+#include "led.tmh"
+#endif
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, HidSteelBattalionLedCreate)
+#endif
+
+NTSTATUS HidSteelBattalionLedCreate(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Creates the lock, the timer and the request used to send LED frames to
+    the interrupt OUT endpoint. Called from DeviceAdd after the settings are
+    read. The pipe itself is found in PrepareHardware.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    NT status value
+--*/
+{
+    NTSTATUS                status;
+    PDEVICE_EXTENSION       devContext = GetDeviceContext(Device);
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDF_TIMER_CONFIG        timerConfig;
+    PVOID                   buffer;
+
+    PAGED_CODE();
+
+    SbcLedShadowInit(&devContext->LedShadow, devContext->LedMaxFrameRate != 0 ? 1000000000ull / devContext->LedMaxFrameRate : 0);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    status = WdfSpinLockCreate(&attributes, &devContext->LedLock);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfSpinLockCreate failed 0x%x\n", status);
+        return status;
+    }
+
+    // The default timer resolution would round a 60 Hz limit up to 4 ticks
+    WDF_TIMER_CONFIG_INIT(&timerConfig, HidSteelBattalionEvtLedTimer);
+    timerConfig.UseHighResolutionTimer = WdfTrue;
+    status = WdfTimerCreate(&timerConfig, &attributes, &devContext->LedTimer);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfTimerCreate failed 0x%x\n", status);
+        return status;
+    }
+
+    status = WdfRequestCreate(&attributes, NULL, &devContext->LedRequest);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfRequestCreate failed 0x%x\n", status);
+        return status;
+    }
+
+    status = WdfMemoryCreate(&attributes, NonPagedPoolNx, POOL_TAG, SBC_LED_PACKET_SIZE, &devContext->LedMemory, &buffer);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfMemoryCreate for the LED frame failed 0x%x\n", status);
+        return status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+static VOID HidSteelBattalionLedSend
+(
+    IN PDEVICE_EXTENSION DeviceContext,
+    IN PUCHAR Frame
+)
+/*++
+Routine Description:
+    Sends a frame returned by SbcLedShadowPoll. Only one frame is in flight
+    at a time so the request and its buffer are reused.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+    Frame - SBC_LED_PACKET_SIZE bytes
+
+Return Value:
+    VOID
+--*/
+{
+    NTSTATUS                    status;
+    WDF_REQUEST_REUSE_PARAMS    reuseParams;
+
+    RtlCopyMemory(WdfMemoryGetBuffer(DeviceContext->LedMemory, NULL), Frame, SBC_LED_PACKET_SIZE);
+
+    WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+    WdfRequestReuse(DeviceContext->LedRequest, &reuseParams);
+
+    status = WdfUsbTargetPipeFormatRequestForWrite(DeviceContext->LedPipe, DeviceContext->LedRequest, DeviceContext->LedMemory, NULL);
+    if (NT_SUCCESS(status))
+    {
+        WdfRequestSetCompletionRoutine(DeviceContext->LedRequest, HidSteelBattalionEvtLedWriteComplete, DeviceContext);
+        if (WdfRequestSend(DeviceContext->LedRequest, WdfUsbTargetPipeGetIoTarget(DeviceContext->LedPipe), WDF_NO_SEND_OPTIONS)) return;
+        status = WdfRequestGetStatus(DeviceContext->LedRequest);
+    }
+
+    TraceEvents(TRACE_LEVEL_WARNING, DBG_IOCTL, "LED frame not sent 0x%x\n", status);
+
+    WdfSpinLockAcquire(DeviceContext->LedLock);
+    SbcLedShadowSendComplete(&DeviceContext->LedShadow, FALSE);
+    WdfSpinLockRelease(DeviceContext->LedLock);
+}
+
+
+VOID HidSteelBattalionLedKick(IN PDEVICE_EXTENSION DeviceContext)
+/*++
+Routine Description:
+    Sends the wanted LED state if the device doesn't show it yet and the
+    rate limit allows it, or arms the timer for when it will. Called after
+    a write from the host, when a frame completes and from the timer.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+
+Return Value:
+    VOID
+--*/
+{
+    UCHAR       frame[SBC_LED_PACKET_SIZE];
+    ULONGLONG   now = HidSteelBattalionTimestamp();
+    ULONGLONG   due;
+    int         send;
+
+    if (DeviceContext->LedPipe == NULL) return;
+
+    WdfSpinLockAcquire(DeviceContext->LedLock);
+    send = SbcLedShadowPoll(&DeviceContext->LedShadow, now, frame, &due);
+    WdfSpinLockRelease(DeviceContext->LedLock);
+
+    if (send)
+    {
+        HidSteelBattalionLedSend(DeviceContext, frame);
+    }
+    else if (due != 0)
+    {
+        WdfTimerStart(DeviceContext->LedTimer, WDF_REL_TIMEOUT_IN_US((due - now + 999) / 1000));
+    }
+}
+
+
+VOID HidSteelBattalionEvtLedWriteComplete
+(
+    IN WDFREQUEST Request,
+    IN WDFIOTARGET Target,
+    IN PWDF_REQUEST_COMPLETION_PARAMS Params,
+    IN WDFCONTEXT Context
+)
+/*++
+Routine Description:
+    Completion routine of the LED frames. A frame that the device took may
+    have been overtaken by newer writes, send them. After a failure nothing
+    is resent until the next write or the next time the device enters D0.
+
+Arguments:
+    Request - LED request
+    Target - Interrupt OUT pipe I/O target
+    Params - Completion parameters
+    Context - Pointer to device context structure
+
+Return Value:
+    VOID
+--*/
+{
+    PDEVICE_EXTENSION   devContext = Context;
+    NTSTATUS            status = Params->IoStatus.Status;
+
+    UNREFERENCED_PARAMETER(Request);
+    UNREFERENCED_PARAMETER(Target);
+
+    WdfSpinLockAcquire(devContext->LedLock);
+    SbcLedShadowSendComplete(&devContext->LedShadow, NT_SUCCESS(status));
+    WdfSpinLockRelease(devContext->LedLock);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_IOCTL, "LED frame failed 0x%x\n", status);
+        return;
+    }
+
+    HidSteelBattalionLedKick(devContext);
+}
+
+
+VOID HidSteelBattalionEvtLedTimer(IN WDFTIMER Timer)
+/*++
+Routine Description:
+    Sends the LED state held back by the rate limit.
+
+Arguments:
+    Timer - LED timer, its parent is the device.
+
+Return Value:
+    VOID
+--*/
+{
+    HidSteelBattalionLedKick(GetDeviceContext(WdfTimerGetParentObject(Timer)));
+}
+
+
+NTSTATUS HidSteelBattalionWriteReport(IN WDFDEVICE Device, IN WDFREQUEST Request)
+/*++
+Routine Description:
+    Handles IOCTL_HID_WRITE_REPORT. The LED output report only updates the
+    shadow state, the request is completed without waiting for the device.
+
+Arguments:
+    Device - Handle to WDF Device Object
+    Request - Handle to request object
+
+Return Value:
+    NT status code.
+--*/
+{
+    PDEVICE_EXTENSION   devContext = GetDeviceContext(Device);
+    PHID_XFER_PACKET    transferPacket;
+
+    //
+    // IOCTL_HID_WRITE_REPORT is METHOD_NEITHER, hidclass passes the
+    // HID_XFER_PACKET in Irp->UserBuffer. The report buffer starts with the
+    // report ID.
+    //
+    transferPacket = (PHID_XFER_PACKET)WdfRequestWdmGetIrp(Request)->UserBuffer;
+    if (transferPacket == NULL || transferPacket->reportBuffer == NULL)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Irp->UserBuffer is NULL\n");
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    if (transferPacket->reportId != SBC_REPORT_ID_LED)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Unknown output report ID %u\n", transferPacket->reportId);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (transferPacket->reportBufferLen < 1 + SBC_LED_PACKET_SIZE)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "LED output report buffer too small %u\n", transferPacket->reportBufferLen);
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    if (devContext->LedPipe == NULL) return STATUS_NOT_SUPPORTED;
+
+    WdfSpinLockAcquire(devContext->LedLock);
+    SbcLedShadowWrite(&devContext->LedShadow, transferPacket->reportBuffer + 1);
+    WdfSpinLockRelease(devContext->LedLock);
+
+    HidSteelBattalionLedKick(devContext);
+
+    WdfRequestSetInformation(Request, 1 + SBC_LED_PACKET_SIZE);
+    return STATUS_SUCCESS;
+}
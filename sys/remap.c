@@ -0,0 +1,174 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "hidusbsteelbattalion.h"
+
+#if defined(EVENT_TRACING)
+#include "remap.tmh"
+#endif
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, HidSteelBattalionRemapCreate)
+#pragma alloc_text(PAGE, HidSteelBattalionSetRemap)
+#endif
+
+NTSTATUS HidSteelBattalionRemapCreate(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Allocates the remapping tables and compiles the mapping read from the
+    registry. Called from DeviceAdd after the settings are read.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    NT status value
+--*/
+{
+    NTSTATUS                status;
+    PDEVICE_EXTENSION       devContext = GetDeviceContext(Device);
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDFMEMORY               memory;
+
+    PAGED_CODE();
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    status = WdfWaitLockCreate(&attributes, &devContext->RemapLock);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfWaitLockCreate failed 0x%x\n", status);
+        return status;
+    }
+
+    status = WdfMemoryCreate(&attributes, NonPagedPoolNx, POOL_TAG, sizeof(REMAP_BUFFERS), &memory, (PVOID *)&devContext->Remap);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfMemoryCreate for remap tables failed 0x%x\n", status);
+        devContext->Remap = NULL;
+        return status;
+    }
+
+    devContext->Remap->Active = 0;
+    SbcRemapCompile(&devContext->Remap->Tables[0], devContext->RemapTargets);
+
+    return STATUS_SUCCESS;
+}
+
+
+static VOID HidSteelBattalionActivateRemap
+(
+    IN PDEVICE_EXTENSION DeviceContext,
+    IN ULONG Tables,
+    IN CONST SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES]
+)
+/*++
+Routine Description:
+    Switches the completion routine to freshly compiled remap tables, under
+    StateLock at DISPATCH_LEVEL, which is why it isn't in the PAGE section
+    with HidSteelBattalionSetRemap.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+    Tables - Index of the tables to switch to
+    Targets - Mapping the tables were compiled from
+
+Return Value:
+    VOID
+--*/
+{
+    WdfSpinLockAcquire(DeviceContext->StateLock);
+    DeviceContext->Remap->Active = Tables;
+    RtlCopyMemory(DeviceContext->RemapTargets, Targets, sizeof(DeviceContext->RemapTargets));
+    WdfSpinLockRelease(DeviceContext->StateLock);
+}
+
+
+NTSTATUS HidSteelBattalionSetRemap
+(
+    IN WDFDEVICE Device,
+    IN PSBC_REMAP_FEATURE_REPORT Report
+)
+/*++
+Routine Description:
+    Compiles a new mapping into the inactive tables, switches to them and
+    stores the mapping in the ButtonRemap registry value.
+
+Arguments:
+    Device - Handle to a framework device object.
+    Report - Remap feature report
+
+Return Value:
+    NT status value
+--*/
+{
+    PDEVICE_EXTENSION   devContext = GetDeviceContext(Device);
+    PREMAP_BUFFERS      remap = devContext->Remap;
+    NTSTATUS            status;
+    WDFKEY              key;
+    UNICODE_STRING      name;
+    ULONG               next;
+
+    PAGED_CODE();
+
+    if (!SbcRemapValidate(Report->Targets))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Button remap targets the padding bit\n");
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    WdfWaitLockAcquire(devContext->RemapLock, NULL);
+
+    next = remap->Active ^ 1;
+    SbcRemapCompile(&remap->Tables[next], Report->Targets);
+
+    HidSteelBattalionActivateRemap(devContext, next, Report->Targets);
+
+    WdfWaitLockRelease(devContext->RemapLock);
+
+    status = WdfDeviceOpenRegistryKey(Device, PLUGPLAY_REGKEY_DEVICE, KEY_WRITE, WDF_NO_OBJECT_ATTRIBUTES, &key);
+    if (NT_SUCCESS(status))
+    {
+        RtlInitUnicodeString(&name, L"ButtonRemap");
+        status = WdfRegistryAssignValue(key, &name, REG_BINARY, sizeof(Report->Targets), Report->Targets);
+        WdfRegistryClose(key);
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_IOCTL, "Button remap not saved to the registry 0x%x\n", status);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+VOID HidSteelBattalionGetRemap
+(
+    IN WDFDEVICE Device,
+    OUT PSBC_REMAP_FEATURE_REPORT Report
+)
+/*++
+Routine Description:
+    Fills the remap feature report with the mapping in use.
+
+Arguments:
+    Device - Handle to a framework device object.
+    Report - Receives the feature report
+
+Return Value:
+    VOID
+--*/
+{
+    PDEVICE_EXTENSION devContext = GetDeviceContext(Device);
+
+    Report->ReportId = SBC_REPORT_ID_REMAP;
+
+    WdfSpinLockAcquire(devContext->StateLock);
+    RtlCopyMemory(Report->Targets, devContext->RemapTargets, sizeof(Report->Targets));
+    WdfSpinLockRelease(devContext->StateLock);
+}
@@ -0,0 +1,118 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "hidusbsteelbattalion.h"
+
+#if defined(EVENT_TRACING)
+#include "reportqueue.tmh"
+#endif
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, HidSteelBattalionReportQueueCreate)
+#endif
+
+NTSTATUS HidSteelBattalionReportQueueCreate(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Allocates the report queue of the buffered mode, if the ReportQueueDepth
+    registry value enables it. Called from DeviceAdd after the settings are
+    read.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    NT status value
+--*/
+{
+    NTSTATUS                status;
+    PDEVICE_EXTENSION       devContext = GetDeviceContext(Device);
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDFMEMORY               memory;
+    ULONG                   capacity;
+
+    PAGED_CODE();
+
+    devContext->ReportQueue = NULL;
+    if (devContext->ReportQueueDepth == 0) return STATUS_SUCCESS;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    // The ring header followed by its slots
+    capacity = SbcReportQueueCapacity(devContext->ReportQueueDepth);
+    status = WdfMemoryCreate(&attributes, NonPagedPoolNx, POOL_TAG, sizeof(SBC_REPORT_QUEUE) + capacity * sizeof(SBC_QUEUED_REPORT), &memory, (PVOID *)&devContext->ReportQueue);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfMemoryCreate for the report queue failed 0x%x\n", status);
+        devContext->ReportQueue = NULL;
+        return status;
+    }
+    SbcReportQueueInit(devContext->ReportQueue, (PSBC_QUEUED_REPORT)(devContext->ReportQueue + 1), capacity);
+    devContext->ReportQueueDrains = 0;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DBG_PNP, "Buffered mode, %u reports\n", capacity);
+
+    return STATUS_SUCCESS;
+}
+
+
+VOID HidSteelBattalionReportQueueDrain(IN PDEVICE_EXTENSION DeviceContext)
+/*++
+Routine Description:
+    Completes the reads parked in InterruptMsgQueue with the queued reports,
+    oldest report to oldest read, until either runs out. Called by the
+    producer after queuing a report and by the read dispatch after parking
+    a read.
+
+    Only one caller at a time drains the ring, which makes it the single
+    consumer. A caller that finds another one draining just counts itself
+    in ReportQueueDrains and returns, the one draining goes round again
+    until nobody else has asked, so neither a new report nor a new read is
+    left behind. The drain runs at DISPATCH_LEVEL so the thread draining
+    isn't preempted while others are relying on it.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+
+Return Value:
+    VOID
+--*/
+{
+    PSBC_REPORT_QUEUE   queue = DeviceContext->ReportQueue;
+    SBC_QUEUED_REPORT   entry;
+    WDFREQUEST          request;
+    NTSTATUS            status;
+    ULONGLONG           now;
+    LONG                drains;
+    KIRQL               oldIrql;
+
+    if (InterlockedIncrement(&DeviceContext->ReportQueueDrains) != 1) return;
+
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+    do
+    {
+        drains = DeviceContext->ReportQueueDrains;
+
+        while (!SbcReportQueueEmpty(queue))
+        {
+            status = WdfIoQueueRetrieveNextRequest(DeviceContext->InterruptMsgQueue, &request);
+            if (!NT_SUCCESS(status)) break;
+
+            SbcReportQueuePop(queue, &entry);
+
+            now = HidSteelBattalionTimestamp();
+            WdfSpinLockAcquire(DeviceContext->StateLock);
+            SbcLatencyRecord(&DeviceContext->DeliveryLatency, now - entry.Timestamp);
+            SbcLatencyRecord(&DeviceContext->ReadWaitLatency, now - GetRequestContext(request)->QueuedTime);
+            WdfSpinLockRelease(DeviceContext->StateLock);
+            HidSteelBattalionTrace(VERBOSE, DeviceContext, SbcTraceReportDelivered, entry.Size, now - entry.Timestamp);
+
+            HidSteelBattalionCompleteReadReport(DeviceContext, request, SBC_REPORT_ID_INPUT, entry.Report, entry.Size);
+        }
+    } while (InterlockedAdd(&DeviceContext->ReportQueueDrains, -drains) != 0);
+    KeLowerIrql(oldIrql);
+}
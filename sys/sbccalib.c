@@ -0,0 +1,192 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "sbccalib.h"
+
+#define ONE (65536)
+
+int SbcCalibrationValidate(const SBC_AXIS_CALIBRATION *Axis)
+/*++
+Routine Description:
+    Checks the parameters of an axis. Disabled axes are always valid.
+
+Arguments:
+    Axis - Calibration parameters
+
+Return Value:
+    Non zero if the parameters can be compiled
+--*/
+{
+	if (!(Axis->Flags & SBC_CALIBRATION_ENABLED)) return 1;
+	if (Axis->Flags & ~(SBC_CALIBRATION_ENABLED | SBC_CALIBRATION_INVERT)) return 0;
+	if (Axis->Curve > SBC_CALIBRATION_MAX_CURVE) return 0;
+	if (Axis->Min >= Axis->Max) return 0;
+	if (Axis->Center < Axis->Min || Axis->Center >= Axis->Max) return 0;
+
+	// One-sided
+	if (Axis->Center == Axis->Min) return Axis->Deadzone < Axis->Max - Axis->Min;
+
+	return Axis->Deadzone < Axis->Center - Axis->Min && Axis->Deadzone < Axis->Max - Axis->Center;
+}
+
+static SBC_U32 SbcCalibrationScale(SBC_U32 Distance, SBC_U32 Deadzone, SBC_U32 Span)
+{
+	// 0 to ONE over the travel past the deadzone
+	if (Distance <= Deadzone) return 0;
+	Distance -= Deadzone;
+	if (Distance >= Span) return ONE;
+	return (SBC_U32)(((SBC_U64)Distance * ONE) / Span);
+}
+
+static SBC_U32 SbcCalibrationCurve(SBC_U32 Position, SBC_U32 Curve)
+{
+	// Blend of the linear and the cubic response
+	SBC_U64 cube = ((SBC_U64)Position * Position * Position) >> 32;
+	return (SBC_U32)(((SBC_U64)Position * (SBC_CALIBRATION_MAX_CURVE - Curve) + cube * Curve) / SBC_CALIBRATION_MAX_CURVE);
+}
+
+SBC_U16 SbcCalibrateAxis
+(
+	const SBC_AXIS_CALIBRATION *Axis,
+	SBC_U16 Raw
+)
+/*++
+Routine Description:
+    Reference calibration of one raw value, used to fill the tables. The
+    travel outside the deadzone is scaled to the full output range, values
+    beyond Min and Max are clamped.
+
+Arguments:
+    Axis - Valid calibration parameters
+
+    Raw - Raw value in the 16 bit report domain
+
+Return Value:
+    Calibrated value, 0 to 65535
+--*/
+{
+	SBC_U32 position;
+	int negative = 0;
+
+	if (Axis->Center == Axis->Min)
+	{
+		position = Raw > Axis->Min ? SbcCalibrationScale(Raw - Axis->Min, Axis->Deadzone, Axis->Max - Axis->Min - Axis->Deadzone) : 0;
+		position = SbcCalibrationCurve(position, Axis->Curve);
+		if (Axis->Flags & SBC_CALIBRATION_INVERT) position = ONE - position;
+		return (SBC_U16)(((SBC_U64)position * 65535) / ONE);
+	}
+
+	if (Raw >= Axis->Center)
+	{
+		position = SbcCalibrationScale(Raw - Axis->Center, Axis->Deadzone, Axis->Max - Axis->Center - Axis->Deadzone);
+	}
+	else
+	{
+		position = SbcCalibrationScale(Axis->Center - Raw, Axis->Deadzone, Axis->Center - Axis->Min - Axis->Deadzone);
+		negative = 1;
+	}
+
+	position = SbcCalibrationCurve(position, Axis->Curve);
+	if (Axis->Flags & SBC_CALIBRATION_INVERT) negative = !negative;
+
+	if (negative) return (SBC_U16)(32768 - (((SBC_U64)position * 32768) / ONE));
+	return (SBC_U16)(32768 + (((SBC_U64)position * 32767) / ONE));
+}
+
+void SbcCalibrationCompile
+(
+	SBC_CALIBRATION_TABLES *Tables,
+	SBC_REPORT_MODE Mode,
+	const SBC_AXIS_CALIBRATION *Axes
+)
+/*++
+Routine Description:
+    Builds the lookup tables of the enabled axes. Each entry holds the
+    calibration of the first raw value it covers, so the values in between
+    can be interpolated with the next entry.
+
+Arguments:
+    Tables - Receives the tables
+
+    Mode - Report layout the tables are for
+
+    Axes - SbcAxisCount valid calibration parameters
+
+Return Value:
+    None
+--*/
+{
+	SBC_U32 axis, i;
+
+	Tables->Mode = Mode;
+	Tables->EnabledMask = 0;
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		if (!(Axes[axis].Flags & SBC_CALIBRATION_ENABLED)) continue;
+
+		Tables->EnabledMask |= 1u << axis;
+		for (i = 0; i < SBC_CALIBRATION_LUT_SIZE; ++i)
+		{
+			Tables->Lut[axis][i] = SbcCalibrateAxis(&Axes[axis], (SBC_U16)(i << SBC_CALIBRATION_LUT_SHIFT));
+		}
+		Tables->Lut[axis][SBC_CALIBRATION_LUT_SIZE] = SbcCalibrateAxis(&Axes[axis], 65535);
+	}
+}
+
+SBC_U32 SbcBuildCalibratedReport
+(
+	const SBC_CALIBRATION_TABLES *Tables,
+	const SBC_U8 *Packet,
+	void *Report
+)
+/*++
+Routine Description:
+    Same as SbcBuildInputReport with the calibrated axes taken from the
+    tables. The default translation skips them.
+
+Arguments:
+    Tables - Compiled calibration, its mode is the report mode
+
+    Packet - At least SBC_INPUT_PACKET_SIZE bytes received from the device
+
+    Report - Receives the report, at least SBC_MAX_INPUT_REPORT_SIZE bytes
+
+Return Value:
+    Size of the report in bytes
+--*/
+{
+	SBC_U8 *report = (SBC_U8 *)Report;
+	SBC_U32 size = SbcBuildInputReportExcept(Tables->Mode, Packet, Report, Tables->EnabledMask);
+	SBC_U32 mask = Tables->EnabledMask;
+	SBC_U32 axis;
+
+	if (Tables->Mode == SbcReportMode16Bit)
+	{
+		for (axis = 0; mask != 0; ++axis, mask >>= 1)
+		{
+			SBC_U8 *field = report + SbcAxisLayout[axis].ReportOffset[SbcReportMode16Bit];
+			SBC_U16 value;
+
+			if (!(mask & 1)) continue;
+
+			value = SbcCalibrationLookup(Tables->Lut[axis], SbcRawAxis(Packet, axis));
+			field[0] = (SBC_U8)value;
+			field[1] = (SBC_U8)(value >> 8);
+		}
+	}
+	else
+	{
+		for (axis = 0; mask != 0; ++axis, mask >>= 1)
+		{
+			if (!(mask & 1)) continue;
+
+			report[SbcAxisLayout[axis].ReportOffset[SbcReportMode8Bit]] = (SBC_U8)(SbcCalibrationLookup(Tables->Lut[axis], SbcRawAxis(Packet, axis)) >> 8);
+		}
+	}
+
+	return size;
+}
@@ -0,0 +1,99 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCCALIB_H_
+#define _SBCCALIB_H_
+
+//
+// Per axis calibration. The parameters come from the calibration feature
+// report and are compiled into one lookup table per axis, so calibrating an
+// axis while translating a packet is two table loads and an interpolation
+// between them, which keeps every bit of the 16 bit report.
+//
+// Raw values are in the 16 bit report domain: the packet value for AimX,
+// AimY and the pedals, the packet value offset by 0x8000 for Rotation,
+// SightX and SightY. The calibrated output goes from 0 to 65535 (0 to 255
+// in the 8 bit report), centered at 32768 unless the axis is one-sided.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tables are indexed by the top bits of the raw value, the low bits
+// interpolate between an entry and the next one
+#define SBC_CALIBRATION_LUT_BITS    (12)
+#define SBC_CALIBRATION_LUT_SIZE    (1 << SBC_CALIBRATION_LUT_BITS)
+#define SBC_CALIBRATION_LUT_SHIFT   (16 - SBC_CALIBRATION_LUT_BITS)
+
+#define SBC_CALIBRATION_ENABLED     (0x01)
+#define SBC_CALIBRATION_INVERT      (0x02)
+
+#define SBC_CALIBRATION_MAX_CURVE   (100)
+
+#pragma pack(push, 1)
+typedef struct _SBC_AXIS_CALIBRATION
+{
+	SBC_U16 Min;                // Raw value at the low end of the travel
+	SBC_U16 Center;             // Raw value at rest, equal to Min for one-sided axes (pedals)
+	SBC_U16 Max;                // Raw value at the high end of the travel
+	SBC_U16 Deadzone;           // Raw units around Center that report the rest position
+	SBC_U8  Curve;              // 0 linear up to 100 fully cubic, finer control near the rest position
+	SBC_U8  Flags;              // SBC_CALIBRATION_*
+} SBC_AXIS_CALIBRATION, *PSBC_AXIS_CALIBRATION;
+
+//
+// Feature report SBC_REPORT_ID_CALIBRATION, read and written whole. Axes
+// without SBC_CALIBRATION_ENABLED keep the default translation.
+//
+typedef struct _SBC_CALIBRATION_FEATURE_REPORT
+{
+	SBC_U8 ReportId;
+	SBC_AXIS_CALIBRATION Axes[SbcAxisCount];
+} SBC_CALIBRATION_FEATURE_REPORT, *PSBC_CALIBRATION_FEATURE_REPORT;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_AXIS_CALIBRATION_SIZE[(sizeof(SBC_AXIS_CALIBRATION) == 10) ? 1 : -1];
+typedef char SBC_ASSERT_CALIBRATION_FEATURE_REPORT_SIZE[(sizeof(SBC_CALIBRATION_FEATURE_REPORT) == 81) ? 1 : -1];
+
+//
+// Compiled calibration for one report mode. Lut holds the 16 bit
+// calibration of the raw values i << SBC_CALIBRATION_LUT_SHIFT, the last
+// entry the one of 65535. The 8 bit report keeps the top byte of the
+// interpolated value.
+//
+typedef struct _SBC_CALIBRATION_TABLES
+{
+	SBC_REPORT_MODE Mode;
+	SBC_U32 EnabledMask;        // Bit n set if axis n is calibrated
+	SBC_U16 Lut[SbcAxisCount][SBC_CALIBRATION_LUT_SIZE + 1];
+} SBC_CALIBRATION_TABLES, *PSBC_CALIBRATION_TABLES;
+
+static __inline SBC_U16 SbcRawAxis(const SBC_U8 *Packet, SBC_U32 Axis)
+{
+	const SBC_AXIS_LAYOUT *layout = &SbcAxisLayout[Axis];
+	return (SBC_U16)(SbcLoadU16(Packet + layout->PacketOffset) ^ (layout->Signed << 15));
+}
+
+static __inline SBC_U16 SbcCalibrationLookup(const SBC_U16 *Lut, SBC_U16 Raw)
+{
+	SBC_U32 i = Raw >> SBC_CALIBRATION_LUT_SHIFT;
+	SBC_U32 f = Raw & ((1u << SBC_CALIBRATION_LUT_SHIFT) - 1);
+	return (SBC_U16)((Lut[i] * ((1u << SBC_CALIBRATION_LUT_SHIFT) - f) + Lut[i + 1] * f + (1u << (SBC_CALIBRATION_LUT_SHIFT - 1))) >> SBC_CALIBRATION_LUT_SHIFT);
+}
+
+int SbcCalibrationValidate(const SBC_AXIS_CALIBRATION *Axis);
+SBC_U16 SbcCalibrateAxis(const SBC_AXIS_CALIBRATION *Axis, SBC_U16 Raw);
+void SbcCalibrationCompile(SBC_CALIBRATION_TABLES *Tables, SBC_REPORT_MODE Mode, const SBC_AXIS_CALIBRATION *Axes);
+SBC_U32 SbcBuildCalibratedReport(const SBC_CALIBRATION_TABLES *Tables, const SBC_U8 *Packet, void *Report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCCALIB_H_
@@ -0,0 +1,155 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <string.h>
+
+#include "sbccapture.h"
+
+SBC_U32 SbcCaptureRecordSize(SBC_U32 TransferSize)
+/*++
+Routine Description:
+    Size of the records for a reader transfer size: the record header and
+    room for a whole transfer, in multiples of 16 bytes, between
+    SBC_CAPTURE_MIN_DATA_SIZE and SBC_CAPTURE_MAX_DATA_SIZE.
+
+Arguments:
+    TransferSize - Buffer size of the reads
+
+Return Value:
+    Record size in bytes
+--*/
+{
+	SBC_U32 data = (TransferSize + 15) & ~15u;
+
+	if (data < SBC_CAPTURE_MIN_DATA_SIZE) data = SBC_CAPTURE_MIN_DATA_SIZE;
+	if (data > SBC_CAPTURE_MAX_DATA_SIZE) data = SBC_CAPTURE_MAX_DATA_SIZE;
+	return (SBC_U32)sizeof(SBC_CAPTURE_RECORD) + data;
+}
+
+void SbcCaptureInitHeader(SBC_CAPTURE_HEADER *Header, SBC_U64 StartTime, SBC_U32 RecordSize)
+{
+	memset(Header, 0, sizeof(*Header));
+	Header->Magic = SBC_CAPTURE_MAGIC;
+	Header->Version = SBC_CAPTURE_VERSION;
+	Header->RecordSize = (SBC_U16)RecordSize;
+	Header->StartTime = StartTime;
+}
+
+int SbcCaptureValidHeader(const SBC_CAPTURE_HEADER *Header)
+{
+	return Header->Magic == SBC_CAPTURE_MAGIC &&
+		Header->Version == SBC_CAPTURE_VERSION &&
+		Header->RecordSize == SbcCaptureRecordSize(Header->RecordSize - (SBC_U32)sizeof(SBC_CAPTURE_RECORD));
+}
+
+void SbcCaptureFillRecord
+(
+	SBC_CAPTURE_RECORD *Record,
+	SBC_U32 RecordSize,
+	SBC_U32 Sequence,
+	SBC_U64 Timestamp,
+	const void *Data,
+	SBC_U32 Length
+)
+/*++
+Routine Description:
+    Fills a capture record. Only the data that fits the record is kept,
+    which is all of it when the record size comes from the transfer size.
+    Length always records the transferred size.
+
+Arguments:
+    Record - Record to fill
+
+    RecordSize - Size of the record, header included
+
+    Sequence - Sequence number of the record
+
+    Timestamp - Time the transfer completed, in nanoseconds
+
+    Data - Transferred bytes, may be NULL if Length is zero
+
+    Length - Number of bytes transferred
+
+Return Value:
+    None
+--*/
+{
+	SBC_U8 *data = (SBC_U8 *)(Record + 1);
+	SBC_U32 room = RecordSize - (SBC_U32)sizeof(SBC_CAPTURE_RECORD);
+	SBC_U32 size = Length < room ? Length : room;
+
+	Record->Timestamp = Timestamp;
+	Record->Length = Length;
+	Record->Sequence = Sequence;
+	if (size != 0) memcpy(data, Data, size);
+	memset(data + size, 0, room - size);
+}
+
+void SbcCaptureRingInit(SBC_CAPTURE_RING *Ring, void *Records, SBC_U32 RecordSize)
+{
+	Ring->Records = (SBC_U8 *)Records;
+	Ring->RecordSize = RecordSize;
+	Ring->Head = 0;
+	Ring->Tail = 0;
+	Ring->Sequence = 0;
+	Ring->Dropped = 0;
+}
+
+int SbcCaptureRingPush
+(
+	SBC_CAPTURE_RING *Ring,
+	SBC_U64 Timestamp,
+	const void *Data,
+	SBC_U32 Length
+)
+/*++
+Routine Description:
+    Appends a record to the ring.
+
+Return Value:
+    Non zero if the record was stored, zero if the ring was full and it was
+    dropped.
+--*/
+{
+	SBC_U32 sequence = Ring->Sequence++;
+
+	if (Ring->Head - Ring->Tail >= SBC_CAPTURE_RING_SIZE)
+	{
+		++Ring->Dropped;
+		return 0;
+	}
+
+	SbcCaptureFillRecord((SBC_CAPTURE_RECORD *)(Ring->Records + (Ring->Head % SBC_CAPTURE_RING_SIZE) * Ring->RecordSize),
+		Ring->RecordSize, sequence, Timestamp, Data, Length);
+	++Ring->Head;
+	return 1;
+}
+
+SBC_U32 SbcCaptureRingPop
+(
+	SBC_CAPTURE_RING *Ring,
+	void *Records,
+	SBC_U32 MaxRecords
+)
+/*++
+Routine Description:
+    Takes up to MaxRecords records from the ring, oldest first.
+
+Return Value:
+    Number of records copied to Records, back to back.
+--*/
+{
+	SBC_U8 *out = (SBC_U8 *)Records;
+	SBC_U32 count = 0;
+
+	while (count < MaxRecords && Ring->Tail != Ring->Head)
+	{
+		memcpy(out + count * Ring->RecordSize, Ring->Records + (Ring->Tail % SBC_CAPTURE_RING_SIZE) * Ring->RecordSize, Ring->RecordSize);
+		++count;
+		++Ring->Tail;
+	}
+	return count;
+}
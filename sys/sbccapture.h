@@ -0,0 +1,93 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCCAPTURE_H_
+#define _SBCCAPTURE_H_
+
+//
+// Capture of the raw interrupt pipe traffic.
+//
+// A capture file is a SBC_CAPTURE_HEADER followed by SBC_CAPTURE_RECORDs,
+// one per completed read of the continuous reader, including the zero
+// length and short ones. Each record is followed by its data, room for a
+// whole transfer of the reader the file was captured with, so the records
+// of a file all have the RecordSize of its header. Records are only ever
+// appended and have a fixed size so the file can be memory mapped and
+// indexed directly. All values are little endian.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_CAPTURE_MAGIC           (0x43434253)    // "SBCC"
+#define SBC_CAPTURE_VERSION         (1)
+#define SBC_CAPTURE_MIN_DATA_SIZE   (32)
+#define SBC_CAPTURE_MAX_DATA_SIZE   (512)
+
+typedef struct _SBC_CAPTURE_HEADER
+{
+	SBC_U32 Magic;
+	SBC_U16 Version;
+	SBC_U16 RecordSize;         // SbcCaptureRecordSize of the reader transfer size
+	SBC_U64 StartTime;          // Same clock as the record timestamps
+	SBC_U8  Reserved[16];
+} SBC_CAPTURE_HEADER, *PSBC_CAPTURE_HEADER;
+
+typedef struct _SBC_CAPTURE_RECORD
+{
+	SBC_U64 Timestamp;          // Monotonic, nanoseconds
+	SBC_U32 Length;             // NumBytesTransferred
+	SBC_U32 Sequence;           // Gaps mean records dropped by the capture
+	// Followed by the first Length bytes, zero padded to the record size
+} SBC_CAPTURE_RECORD, *PSBC_CAPTURE_RECORD;
+
+typedef char SBC_ASSERT_CAPTURE_HEADER_SIZE[(sizeof(SBC_CAPTURE_HEADER) == 32) ? 1 : -1];
+typedef char SBC_ASSERT_CAPTURE_RECORD_SIZE[(sizeof(SBC_CAPTURE_RECORD) == 16) ? 1 : -1];
+
+#define SBC_CAPTURE_MAX_RECORD_SIZE (sizeof(SBC_CAPTURE_RECORD) + SBC_CAPTURE_MAX_DATA_SIZE)
+
+static __inline const SBC_U8 *SbcCaptureRecordData(const SBC_CAPTURE_RECORD *Record)
+{
+	return (const SBC_U8 *)(Record + 1);
+}
+
+SBC_U32 SbcCaptureRecordSize(SBC_U32 TransferSize);
+void SbcCaptureInitHeader(SBC_CAPTURE_HEADER *Header, SBC_U64 StartTime, SBC_U32 RecordSize);
+int SbcCaptureValidHeader(const SBC_CAPTURE_HEADER *Header);
+void SbcCaptureFillRecord(SBC_CAPTURE_RECORD *Record, SBC_U32 RecordSize, SBC_U32 Sequence, SBC_U64 Timestamp, const void *Data, SBC_U32 Length);
+
+//
+// Bounded buffer between the read completion routine, which can't touch
+// files, and the code that writes the records out. The caller serializes
+// the access. When the ring is full new records are dropped and counted,
+// their sequence numbers are still consumed so the gap shows in the file.
+// The caller provides the storage, SBC_CAPTURE_RING_SIZE records of the
+// record size of the file.
+//
+#define SBC_CAPTURE_RING_SIZE   (256)
+
+typedef struct _SBC_CAPTURE_RING
+{
+	SBC_U8 *Records;
+	SBC_U32 RecordSize;
+	SBC_U32 Head;               // Next record to write, free running
+	SBC_U32 Tail;               // Next record to read, free running
+	SBC_U32 Sequence;
+	SBC_U64 Dropped;
+} SBC_CAPTURE_RING, *PSBC_CAPTURE_RING;
+
+void SbcCaptureRingInit(SBC_CAPTURE_RING *Ring, void *Records, SBC_U32 RecordSize);
+int SbcCaptureRingPush(SBC_CAPTURE_RING *Ring, SBC_U64 Timestamp, const void *Data, SBC_U32 Length);
+SBC_U32 SbcCaptureRingPop(SBC_CAPTURE_RING *Ring, void *Records, SBC_U32 MaxRecords);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCCAPTURE_H_
@@ -0,0 +1,246 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <string.h>
+
+#include "sbccombo.h"
+
+#define SBC_COMBO_NS_PER_MS         (1000000ull)
+
+// Timers bit of a sequence waiting for the end of its pulse
+#define SBC_COMBO_PULSE_TIMER(Index)    (0x100u << (Index))
+
+int SbcComboValidate(const SBC_COMBO_SETTINGS *Settings)
+/*++
+Routine Description:
+    Checks the type, the flags and the step count of every combo, and that
+    every step has buttons and none of them is the padding bit.
+
+Arguments:
+    Settings - Combo settings
+
+Return Value:
+    Non zero if the settings can be compiled
+--*/
+{
+	SBC_U32 combo, step;
+
+	for (combo = 0; combo < SBC_COMBO_MAX; ++combo)
+	{
+		const SBC_COMBO_DEFINITION *definition = &Settings->Combos[combo];
+
+		if (definition->Type == SBC_COMBO_OFF) continue;
+		if (definition->Type >= SBC_COMBO_TYPE_COUNT) return 0;
+		if (definition->Reserved != 0 || (definition->Flags & ~SBC_COMBO_EXCLUSIVE) != 0) return 0;
+		if (definition->StepCount == 0 || definition->StepCount > SBC_COMBO_MAX_STEPS) return 0;
+		if (definition->Type == SBC_COMBO_CHORD && definition->StepCount != 1) return 0;
+
+		for (step = 0; step < definition->StepCount; ++step)
+		{
+			SBC_U64 buttons = SbcLoadButtonMask(definition->Steps[step].Buttons);
+			if (buttons == 0 || (buttons & ~SBC_BUTTON_MASK) != 0 || definition->Steps[step].Reserved != 0) return 0;
+		}
+	}
+	return 1;
+}
+
+void SbcComboCompile
+(
+	SBC_COMBO_TABLES *Tables,
+	const SBC_COMBO_SETTINGS *Settings
+)
+/*++
+Routine Description:
+    Builds the tables for valid settings. Combos that are off take no room,
+    so the cost of a report only depends on the combos in use.
+
+Arguments:
+    Tables - Receives the tables
+
+    Settings - Settings accepted by SbcComboValidate
+
+Return Value:
+    None
+--*/
+{
+	SBC_U32 combo, step;
+
+	memset(Tables, 0, sizeof(*Tables));
+
+	for (combo = 0; combo < SBC_COMBO_MAX; ++combo)
+	{
+		const SBC_COMBO_DEFINITION *definition = &Settings->Combos[combo];
+		int exclusive = (definition->Flags & SBC_COMBO_EXCLUSIVE) != 0;
+		SBC_U64 used = 0;
+
+		if (definition->Type == SBC_COMBO_CHORD)
+		{
+			SBC_CHORD *chord = &Tables->Chords[Tables->ChordCount++];
+
+			chord->Buttons = SbcLoadButtonMask(definition->Steps[0].Buttons);
+			chord->Released = exclusive ? SBC_BUTTON_MASK & ~chord->Buttons : 0;
+			chord->HoldNs = definition->HoldMs * SBC_COMBO_NS_PER_MS;
+			chord->Bit = 1u << combo;
+			Tables->Watch |= chord->Buttons | chord->Released;
+		}
+		else if (definition->Type == SBC_COMBO_SEQUENCE)
+		{
+			SBC_SEQUENCE *sequence = &Tables->Sequences[Tables->SequenceCount++];
+
+			for (step = 0; step < definition->StepCount; ++step)
+			{
+				used |= SbcLoadButtonMask(definition->Steps[step].Buttons);
+			}
+			if (exclusive) used = SBC_BUTTON_MASK;
+
+			for (step = 0; step < definition->StepCount; ++step)
+			{
+				SBC_COMBO_TRANSITION *transition = &sequence->Steps[step];
+				SBC_U32 timeout = definition->Steps[step].TimeoutMs;
+
+				transition->Buttons = SbcLoadButtonMask(definition->Steps[step].Buttons);
+				transition->Abort = used & ~transition->Buttons;
+				transition->TimeoutNs = step != 0 && timeout != 0 ? timeout * SBC_COMBO_NS_PER_MS : SBC_COMBO_NO_TIMEOUT;
+			}
+			sequence->StepCount = definition->StepCount;
+			sequence->Bit = 1u << combo;
+			sequence->PulseNs = definition->PulseMs * SBC_COMBO_NS_PER_MS;
+			Tables->Watch |= used;
+		}
+	}
+}
+
+void SbcComboReset(SBC_COMBO_STATE *State)
+{
+	memset(State, 0, sizeof(*State));
+}
+
+SBC_U32 SbcComboUpdate
+(
+	const SBC_COMBO_TABLES *Tables,
+	SBC_COMBO_STATE *State,
+	SBC_REPORT_MODE Mode,
+	void *Report,
+	SBC_U64 Now
+)
+/*++
+Routine Description:
+    Evaluates the combos on the buttons of a translated report and stores
+    the virtual buttons in it. Only one caller at a time per state.
+
+Arguments:
+    Tables - Compiled combos
+
+    State - Evaluation state, carried from report to report
+
+    Mode - Report layout
+
+    Report - Translated report, before the remapping
+
+    Now - Arrival of the packet the report was built from
+
+Return Value:
+    Number of virtual buttons that went from released to pressed
+--*/
+{
+	SBC_U8 *report = (SBC_U8 *)Report;
+	SBC_U64 buttons, pressed;
+	SBC_U32 output, changed, count = 0;
+	SBC_U32 i, s;
+
+	// Translated reports come with the virtual buttons released
+	if (Tables->ChordCount == 0 && Tables->SequenceCount == 0) return 0;
+
+	buttons = SbcLoadButtonMask(report) & SBC_BUTTON_MASK;
+	pressed = buttons & ~State->Buttons;
+	output = State->Output;
+
+	if (((buttons ^ State->Buttons) & Tables->Watch) == 0 && State->Timers == 0) goto Store;
+
+	for (i = 0; i < Tables->ChordCount; ++i)
+	{
+		const SBC_CHORD *chord = &Tables->Chords[i];
+		SBC_U32 bit = 1u << i;
+
+		if ((buttons & chord->Buttons) != chord->Buttons || (buttons & chord->Released) != 0)
+		{
+			State->ChordHeld &= ~bit;
+			State->Timers &= ~bit;
+			output &= ~chord->Bit;
+			continue;
+		}
+
+		if (!(State->ChordHeld & bit))
+		{
+			State->ChordHeld |= bit;
+			State->ChordSince[i] = Now;
+		}
+
+		if (Now - State->ChordSince[i] >= chord->HoldNs)
+		{
+			State->Timers &= ~bit;
+			output |= chord->Bit;
+		}
+		else
+		{
+			State->Timers |= bit;
+		}
+	}
+
+	for (i = 0; i < Tables->SequenceCount; ++i)
+	{
+		const SBC_SEQUENCE *sequence = &Tables->Sequences[i];
+		const SBC_COMBO_TRANSITION *step;
+
+		// A completed sequence is released at the end of its pulse, or
+		// without one when its last step is
+		if (output & sequence->Bit)
+		{
+			SBC_U64 last = sequence->Steps[sequence->StepCount - 1].Buttons;
+			if (sequence->PulseNs != 0 ? Now >= State->ReleaseAt[i] : (buttons & last) != last)
+			{
+				output &= ~sequence->Bit;
+				State->Timers &= ~SBC_COMBO_PULSE_TIMER(i);
+			}
+		}
+
+		// Only presses move the state machine, a timeout is noticed on the
+		// next one
+		if (pressed == 0) continue;
+
+		s = State->Step[i];
+		if (s != 0 && (Now > State->Deadline[i] || (pressed & sequence->Steps[s].Abort) != 0)) s = 0;
+
+		step = &sequence->Steps[s];
+		if ((pressed & step->Buttons) != 0 && (buttons & step->Buttons) == step->Buttons)
+		{
+			if (++s == sequence->StepCount)
+			{
+				s = 0;
+				output |= sequence->Bit;
+				if (sequence->PulseNs != 0)
+				{
+					State->ReleaseAt[i] = Now + sequence->PulseNs;
+					State->Timers |= SBC_COMBO_PULSE_TIMER(i);
+				}
+			}
+			else
+			{
+				step = &sequence->Steps[s];
+				State->Deadline[i] = step->TimeoutNs == SBC_COMBO_NO_TIMEOUT ? SBC_COMBO_NO_TIMEOUT : Now + step->TimeoutNs;
+			}
+		}
+		State->Step[i] = (SBC_U8)s;
+	}
+
+	for (changed = output & ~(SBC_U32)State->Output; changed != 0; changed &= changed - 1) ++count;
+
+Store:
+	State->Buttons = buttons;
+	State->Output = (SBC_U8)output;
+	report[SbcInputReportSize(Mode) - 1] = (SBC_U8)output;
+	return count;
+}
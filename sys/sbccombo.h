@@ -0,0 +1,153 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCCOMBO_H_
+#define _SBCCOMBO_H_
+
+//
+// Combo engine. Chords (buttons held together) and timed sequences (buttons
+// pressed one after the other) of the physical buttons drive the virtual
+// buttons of the report, so applications get Ignition held with Start as a
+// button of its own instead of detecting it every frame.
+//
+// Combo n drives virtual button n. A chord is pressed while all its buttons
+// are held, after they have been held for HoldMs. A sequence is a state
+// machine with one state per step: state s waits for the buttons of step s
+// to be held with at least one of them just pressed, and moves to s + 1.
+// Pressing another button of the sequence, or any other button with
+// SBC_COMBO_EXCLUSIVE, starts over, and so does taking longer than the
+// TimeoutMs of the step. After the last step the virtual button is pressed
+// for PulseMs, or while the last step is held if PulseMs is 0.
+//
+// The settings are compiled into fixed size tables of 64 bit button masks,
+// so evaluating a report is a few masks per combo and at most one transition
+// per sequence, with no allocation and no loop over the steps. A report that
+// changes none of the buttons the combos look at, with no hold or pulse
+// running, only stores the virtual buttons. Times are checked when reports
+// arrive, which the controller sends continuously.
+//
+// Combos see the physical buttons, so the remapping (see sbcremap.h) doesn't
+// change them and doesn't touch the virtual buttons.
+//
+
+#include "sbccore.h"
+#include "sbcremap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_COMBO_MAX               (SBC_VIRTUAL_BUTTON_COUNT)
+#define SBC_COMBO_MAX_STEPS         (8)
+
+// Combo types
+#define SBC_COMBO_OFF               (0)     // Virtual button always released
+#define SBC_COMBO_CHORD             (1)     // The buttons of step 0 held together
+#define SBC_COMBO_SEQUENCE          (2)     // The steps pressed in order
+#define SBC_COMBO_TYPE_COUNT        (3)
+
+// Flags
+#define SBC_COMBO_EXCLUSIVE         (0x01)  // Chord: no other button held. Sequence: any other button starts over
+
+#pragma pack(push, 1)
+typedef struct _SBC_COMBO_STEP_SETTINGS
+{
+	SBC_U8  Buttons[SBC_REPORT_BUTTON_BYTES];   // Little endian mask, in report order like sbcremap.h
+	SBC_U8  Reserved;
+	SBC_U16 TimeoutMs;              // Sequence: most time since the previous step, 0 for no limit
+} SBC_COMBO_STEP_SETTINGS, *PSBC_COMBO_STEP_SETTINGS;
+
+typedef struct _SBC_COMBO_DEFINITION
+{
+	SBC_U8  Type;                   // SBC_COMBO_*
+	SBC_U8  Flags;
+	SBC_U8  StepCount;              // Chord: 1. Sequence: 1 to SBC_COMBO_MAX_STEPS
+	SBC_U8  Reserved;
+	SBC_U16 HoldMs;                 // Chord: time held before the virtual button is pressed
+	SBC_U16 PulseMs;                // Sequence: time pressed after the last step, 0 while it is held
+	SBC_COMBO_STEP_SETTINGS Steps[SBC_COMBO_MAX_STEPS];
+} SBC_COMBO_DEFINITION, *PSBC_COMBO_DEFINITION;
+
+//
+// Stored as is in the ButtonCombos registry value
+//
+typedef struct _SBC_COMBO_SETTINGS
+{
+	SBC_COMBO_DEFINITION Combos[SBC_COMBO_MAX];
+} SBC_COMBO_SETTINGS, *PSBC_COMBO_SETTINGS;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_COMBO_STEP_SETTINGS_SIZE[(sizeof(SBC_COMBO_STEP_SETTINGS) == 8) ? 1 : -1];
+typedef char SBC_ASSERT_COMBO_SETTINGS_SIZE[(sizeof(SBC_COMBO_SETTINGS) == 576) ? 1 : -1];
+
+#define SBC_COMBO_NO_TIMEOUT        (~0ull)
+
+//
+// Sequence state s: the buttons that complete step s and the presses that
+// start over instead
+//
+typedef struct _SBC_COMBO_TRANSITION
+{
+	SBC_U64 Buttons;
+	SBC_U64 Abort;
+	SBC_U64 TimeoutNs;              // From step s - 1, SBC_COMBO_NO_TIMEOUT for no limit
+} SBC_COMBO_TRANSITION, *PSBC_COMBO_TRANSITION;
+
+typedef struct _SBC_SEQUENCE
+{
+	SBC_COMBO_TRANSITION Steps[SBC_COMBO_MAX_STEPS];
+	SBC_U32 StepCount;
+	SBC_U32 Bit;                    // Virtual button mask
+	SBC_U64 PulseNs;
+} SBC_SEQUENCE, *PSBC_SEQUENCE;
+
+typedef struct _SBC_CHORD
+{
+	SBC_U64 Buttons;                // Held
+	SBC_U64 Released;               // Not held
+	SBC_U64 HoldNs;
+	SBC_U32 Bit;                    // Virtual button mask
+	SBC_U32 Reserved;
+} SBC_CHORD, *PSBC_CHORD;
+
+//
+// Compiled settings, read only once compiled. Chords and sequences are
+// packed at the start of their arrays.
+//
+typedef struct _SBC_COMBO_TABLES
+{
+	SBC_U32 ChordCount;
+	SBC_U32 SequenceCount;
+	SBC_U64 Watch;                  // Buttons any combo looks at
+	SBC_CHORD Chords[SBC_COMBO_MAX];
+	SBC_SEQUENCE Sequences[SBC_COMBO_MAX];
+} SBC_COMBO_TABLES, *PSBC_COMBO_TABLES;
+
+//
+// Evaluation state, indexed like the compiled chords and sequences
+//
+typedef struct _SBC_COMBO_STATE
+{
+	SBC_U64 Buttons;                // Physical buttons of the previous report
+	SBC_U64 ChordSince[SBC_COMBO_MAX];
+	SBC_U64 Deadline[SBC_COMBO_MAX];
+	SBC_U64 ReleaseAt[SBC_COMBO_MAX];
+	SBC_U32 ChordHeld;              // Bit n set if chord n is held
+	SBC_U32 Timers;                 // Bit n set if chord n is waiting for its hold, bit 8 + n if sequence n for its pulse
+	SBC_U8  Step[SBC_COMBO_MAX];    // Sequence states
+	SBC_U8  Output;                 // Virtual buttons
+} SBC_COMBO_STATE, *PSBC_COMBO_STATE;
+
+int SbcComboValidate(const SBC_COMBO_SETTINGS *Settings);
+void SbcComboCompile(SBC_COMBO_TABLES *Tables, const SBC_COMBO_SETTINGS *Settings);
+void SbcComboReset(SBC_COMBO_STATE *State);
+SBC_U32 SbcComboUpdate(const SBC_COMBO_TABLES *Tables, SBC_COMBO_STATE *State, SBC_REPORT_MODE Mode, void *Report, SBC_U64 Now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCCOMBO_H_
@@ -0,0 +1,290 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sbccore.h"
+
+//
+// Conversions of the fields generated from the layout tables in sbccore.h.
+// Signed is a constant in every expansion so only one side of each
+// conditional is compiled.
+//
+static __inline SBC_U8 SbcConvertAxis8(const SBC_U8 *Data, int Signed)
+{
+	return Signed ? (SBC_U8)(((int)SbcLoadS16(Data)) / 256 + 128) : (SBC_U8)(((int)SbcLoadU16(Data)) / 256);
+}
+
+static __inline SBC_U16 SbcConvertAxis16(const SBC_U8 *Data, int Signed)
+{
+	return Signed ? (SBC_U16)(SbcLoadU16(Data) ^ 0x8000) : SbcLoadU16(Data);
+}
+
+static __inline SBC_U8 SbcConvertTuner(SBC_U8 Value)
+{
+	return Value;
+}
+
+static __inline SBC_S8 SbcConvertGear(SBC_U8 Value)
+{
+	SBC_S8 gear = (SBC_S8)Value;
+	return (SBC_S8)(gear < 0 ? gear + 1 : gear);
+}
+
+#define SBC_AXIS_LAYOUT_ENTRY(Name, Offset, Signed, Centered) \
+	{ Offset, Signed, Centered, { offsetof(HIDFX2_INPUT_REPORT, Name), offsetof(HIDFX2_INPUT_REPORT_16, Name) } },
+#define SBC_AXIS_LAYOUT_POINTER(Name, Offset, Signed, Page, Usage)  SBC_AXIS_LAYOUT_ENTRY(Name, Offset, Signed, 1)
+#define SBC_AXIS_LAYOUT_OTHER(Name, Offset, Signed, Page, Usage)    SBC_AXIS_LAYOUT_ENTRY(Name, Offset, Signed, 0)
+
+const SBC_AXIS_LAYOUT SbcAxisLayout[SbcAxisCount] =
+{
+	SBC_LAYOUT_POINTER_AXES(SBC_AXIS_LAYOUT_POINTER)
+	SBC_LAYOUT_OTHER_AXES(SBC_AXIS_LAYOUT_OTHER)
+};
+
+#define SBC_TRANSLATE_BUTTONS(Name, Offset) \
+	Report->Name = Packet[Offset];
+#define SBC_TRANSLATE_AXIS_8(Name, Offset, Signed, Page, Usage) \
+	if (!(Skip & (1u << SbcAxis##Name))) Report->Name = SbcConvertAxis8(Packet + (Offset), Signed);
+#define SBC_TRANSLATE_AXIS_16(Name, Offset, Signed, Page, Usage) \
+	if (!(Skip & (1u << SbcAxis##Name))) Report->Name = SbcConvertAxis16(Packet + (Offset), Signed);
+#define SBC_TRANSLATE_VALUE(Name, Offset, Type, Convert, ...) \
+	Report->Name = Convert(Packet[Offset]);
+
+//
+// Skip is a mask of axes left for the caller to fill, a constant 0 when
+// the whole report is translated.
+//
+static __inline void SbcTranslate8(const SBC_U8 *Packet, HIDFX2_INPUT_REPORT *Report, SBC_U32 Skip)
+{
+	SBC_LAYOUT_BUTTON_BYTES(SBC_TRANSLATE_BUTTONS)
+	SBC_LAYOUT_AXES(SBC_TRANSLATE_AXIS_8)
+	SBC_LAYOUT_VALUES(SBC_TRANSLATE_VALUE)
+	Report->VirtualButtons = 0;
+}
+
+static __inline void SbcTranslate16(const SBC_U8 *Packet, HIDFX2_INPUT_REPORT_16 *Report, SBC_U32 Skip)
+{
+	SBC_LAYOUT_BUTTON_BYTES(SBC_TRANSLATE_BUTTONS)
+	SBC_LAYOUT_AXES(SBC_TRANSLATE_AXIS_16)
+	SBC_LAYOUT_VALUES(SBC_TRANSLATE_VALUE)
+	Report->VirtualButtons = 0;
+}
+
+void SbcTranslateReport
+(
+	const SBC_U8 *Packet,
+	HIDFX2_INPUT_REPORT *Report
+)
+/*++
+Routine Description:
+    Converts a raw packet from the interrupt endpoint into the HID input
+    report. Axes are reduced to 8 bits, signed axes are re-centered at 128
+    and the neutral gear is folded into 0.
+
+Arguments:
+    Packet - At least SBC_INPUT_PACKET_SIZE bytes received from the device
+
+    Report - Receives the translated report
+
+Return Value:
+    None
+--*/
+{
+	SbcTranslate8(Packet, Report, 0);
+}
+
+void SbcTranslateReport16
+(
+	const SBC_U8 *Packet,
+	HIDFX2_INPUT_REPORT_16 *Report
+)
+/*++
+Routine Description:
+    Same as SbcTranslateReport keeping the full 16 bits of every axis.
+
+Arguments:
+    Packet - At least SBC_INPUT_PACKET_SIZE bytes received from the device
+
+    Report - Receives the translated report
+
+Return Value:
+    None
+--*/
+{
+	SbcTranslate16(Packet, Report, 0);
+}
+
+SBC_U32 SbcInputReportSize(SBC_REPORT_MODE Mode)
+{
+	return Mode == SbcReportMode16Bit ? sizeof(HIDFX2_INPUT_REPORT_16) : sizeof(HIDFX2_INPUT_REPORT);
+}
+
+SBC_U32 SbcBuildInputReport
+(
+	SBC_REPORT_MODE Mode,
+	const SBC_U8 *Packet,
+	void *Report
+)
+/*++
+Routine Description:
+    Translates a packet into the input report for the given mode.
+
+Arguments:
+    Mode - Report layout
+
+    Packet - At least SBC_INPUT_PACKET_SIZE bytes received from the device
+
+    Report - Receives the report, at least SBC_MAX_INPUT_REPORT_SIZE bytes
+
+Return Value:
+    Size of the report in bytes
+--*/
+{
+	if (Mode == SbcReportMode16Bit)
+	{
+		SbcTranslateReport16(Packet, (HIDFX2_INPUT_REPORT_16 *)Report);
+		return sizeof(HIDFX2_INPUT_REPORT_16);
+	}
+
+	SbcTranslateReport(Packet, (HIDFX2_INPUT_REPORT *)Report);
+	return sizeof(HIDFX2_INPUT_REPORT);
+}
+
+SBC_U32 SbcBuildInputReportExcept
+(
+	SBC_REPORT_MODE Mode,
+	const SBC_U8 *Packet,
+	void *Report,
+	SBC_U32 AxisMask
+)
+/*++
+Routine Description:
+    Same as SbcBuildInputReport without writing the axes the caller fills
+    in itself, such as the calibrated ones.
+
+Arguments:
+    Mode - Report layout
+
+    Packet - At least SBC_INPUT_PACKET_SIZE bytes received from the device
+
+    Report - Receives the report, at least SBC_MAX_INPUT_REPORT_SIZE bytes
+
+    AxisMask - Bit n set if axis n is left untouched
+
+Return Value:
+    Size of the report in bytes
+--*/
+{
+	if (Mode == SbcReportMode16Bit)
+	{
+		SbcTranslate16(Packet, (HIDFX2_INPUT_REPORT_16 *)Report, AxisMask);
+		return sizeof(HIDFX2_INPUT_REPORT_16);
+	}
+
+	SbcTranslate8(Packet, (HIDFX2_INPUT_REPORT *)Report, AxisMask);
+	return sizeof(HIDFX2_INPUT_REPORT);
+}
+
+void SbcReportCacheInit(SBC_REPORT_CACHE *Cache)
+{
+	memset(Cache, 0, sizeof(*Cache));
+}
+
+void SbcReportCacheStore
+(
+	SBC_REPORT_CACHE *Cache,
+	const void *Report,
+	SBC_U32 Size,
+	int Delivered
+)
+/*++
+Routine Description:
+    Records a freshly translated report.
+
+Arguments:
+    Cache - Latest-state slot
+
+    Report - Translated report
+
+    Size - Size of the report, up to SBC_MAX_INPUT_REPORT_SIZE
+
+    Delivered - Non zero if the report has been handed to a pending read
+                request, zero if it was left for the next read.
+
+Return Value:
+    None
+--*/
+{
+	if (Cache->Dirty) ++Cache->Dropped;
+
+	memcpy(Cache->Latest, Report, Size);
+	Cache->Size = Size;
+	if (Delivered)
+	{
+		memcpy(Cache->Delivered, Report, Size);
+		Cache->Dirty = 0;
+	}
+	else
+	{
+		Cache->Dirty = memcmp(Cache->Latest, Cache->Delivered, Size) != 0;
+	}
+}
+
+SBC_U32 SbcReportCacheTake
+(
+	SBC_REPORT_CACHE *Cache,
+	void *Report
+)
+/*++
+Routine Description:
+    Called when a read request arrives. If the state has changed since the
+    last delivered report the latest one is returned and marked as delivered.
+
+Arguments:
+    Cache - Latest-state slot
+
+    Report - Receives the report to complete the read with, at least
+             SBC_MAX_INPUT_REPORT_SIZE bytes
+
+Return Value:
+    Size of the report if the read can be completed now, zero if it has to
+    wait for the next packet.
+--*/
+{
+	if (!Cache->Dirty) return 0;
+
+	memcpy(Report, Cache->Latest, Cache->Size);
+	memcpy(Cache->Delivered, Cache->Latest, Cache->Size);
+	Cache->Dirty = 0;
+	return Cache->Size;
+}
+
+SBC_U32 SbcReportCachePeek
+(
+	const SBC_REPORT_CACHE *Cache,
+	void *Report
+)
+/*++
+Routine Description:
+    Called when the state is polled instead of read. Returns the latest
+    report whether it was delivered or not, and leaves it pending for the
+    next read.
+
+Arguments:
+    Cache - Latest-state slot
+
+    Report - Receives the latest report, at least SBC_MAX_INPUT_REPORT_SIZE
+             bytes
+
+Return Value:
+    Size of the report, zero if no report has been stored yet.
+--*/
+{
+	memcpy(Report, Cache->Latest, Cache->Size);
+	return Cache->Size;
+}
@@ -0,0 +1,384 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCCORE_H_
+#define _SBCCORE_H_
+
+//
+// Portable part of the driver.
+//
+// Nothing in here depends on WDF, WDM or the Windows headers so the same
+// code that runs in the read completion routine can be built, tested and
+// benchmarked in user mode on any platform (see the linux directory).
+//
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned char       SBC_U8;
+typedef signed char         SBC_S8;
+typedef unsigned short      SBC_U16;
+typedef short               SBC_S16;
+typedef unsigned int        SBC_U32;
+typedef int                 SBC_S32;
+typedef unsigned long long  SBC_U64;
+typedef long long           SBC_S64;
+
+//
+// Data generated by the Steel Battalion Controller
+//
+// The controller sends 26 byte packets through the interrupt endpoint. All
+// the 16 bit values are little endian. The packet is decoded with explicit
+// byte loads so nothing depends on the compiler's struct layout.
+//
+//  Offset  Size  Field
+//       0     2  (padding)
+//       2     1  Buttons0
+//       3     1  Buttons1
+//       4     1  Buttons2
+//       5     1  Buttons3
+//       6     1  Buttons4
+//       7     1  (padding)
+//       8     2  AimX       (unsigned)
+//      10     2  AimY       (unsigned)
+//      12     2  Rotation   (signed)
+//      14     2  SightX     (signed)
+//      16     2  SightY     (signed)
+//      18     2  Clutch     (unsigned)
+//      20     2  Brake      (unsigned)
+//      22     2  Throttle   (unsigned)
+//      24     1  Tuner
+//      25     1  Gear       (signed, -2 is reverse, -1 is neutral)
+//
+// == Buttons order ==
+//
+// Buttons0:
+// 0x01 RightJoyMainWeapon
+// 0x02 RightJoyFire
+// 0x04 RightJoyLockOn
+// 0x08 Eject
+// 0x10 CockpitHatch
+// 0x20 Ignition
+// 0x40 Start
+// 0x80 MultiMonOpenClose
+//
+// Buttons 1
+// 0x01 MultiMonMapZoomInOut
+// 0x02 MultiMonModeSelect
+// 0x04 MultiMonSubMonitor
+// 0x08 MainMonZoomIn
+// 0x10 MainMonZoomOut
+// 0x20 FunctionFSS
+// 0x40 FunctionManipulator
+// 0x80 FunctionLineColorChange
+//
+// Buttons 2
+// 0x01 Washing
+// 0x02 Extinguisher
+// 0x04 Chaff
+// 0x08 FunctionTankDetach
+// 0x10 FunctionOverride
+// 0x20 FunctionNightScope
+// 0x40 FunctionF1
+// 0x80 FunctionF2
+//
+// Buttons 3
+// 0x01 FunctionF3
+// 0x02 WeaponCtrlMain
+// 0x04 WeaponCtrlSub
+// 0x08 WeaponCtrlMagazineChange
+// 0x10 Comm1
+// 0x20 Comm2
+// 0x40 Comm3
+// 0x80 Comm4
+//
+// Buttons 4
+// 0x01 Comm5
+// 0x02 LeftJoySightChange
+// 0x04 ToggleFilterControl
+// 0x08 ToggleOxygenSupply
+// 0x10 ToggleFuelFlowRate
+// 0x20 ToggleBufferMaterial
+// 0x40 ToggleVTLocation
+//
+#define SBC_INPUT_PACKET_SIZE       (26)
+
+#define SBC_OFFSET_BUTTONS0         (2)
+#define SBC_OFFSET_BUTTONS1         (3)
+#define SBC_OFFSET_BUTTONS2         (4)
+#define SBC_OFFSET_BUTTONS3         (5)
+#define SBC_OFFSET_BUTTONS4         (6)
+#define SBC_OFFSET_AIMX             (8)
+#define SBC_OFFSET_AIMY             (10)
+#define SBC_OFFSET_ROTATION         (12)
+#define SBC_OFFSET_SIGHTX           (14)
+#define SBC_OFFSET_SIGHTY           (16)
+#define SBC_OFFSET_CLUTCH           (18)
+#define SBC_OFFSET_BRAKE            (20)
+#define SBC_OFFSET_THROTTLE         (22)
+#define SBC_OFFSET_TUNER            (24)
+#define SBC_OFFSET_GEAR             (25)
+
+//
+// Input report layout
+//
+// The report structures, the SbcAxis enum, the SbcAxisLayout table, the
+// translation in sbccore.c and the report descriptors in sbcdescriptor.h
+// are all generated from the tables below, so adding or moving a field
+// changes all of them at once. Each table is a list of X(...) rows
+// expanded with a macro for X.
+//
+// Button bytes: X(Name, packet offset)
+//
+#define SBC_LAYOUT_BUTTON_BYTES(X) \
+	X(Buttons0, SBC_OFFSET_BUTTONS0) \
+	X(Buttons1, SBC_OFFSET_BUTTONS1) \
+	X(Buttons2, SBC_OFFSET_BUTTONS2) \
+	X(Buttons3, SBC_OFFSET_BUTTONS3) \
+	X(Buttons4, SBC_OFFSET_BUTTONS4)
+
+//
+// Axes: X(Name, packet offset, signed, HID usage page, HID usage). 8 or 16
+// bits in the report depending on the report mode. The pointer axes go in
+// a Pointer physical collection.
+//
+#define SBC_LAYOUT_POINTER_AXES(X) \
+	X(AimX,     SBC_OFFSET_AIMX,     0, SBC_HID_PAGE_GENERIC_DESKTOP, 0x30)   /* X */ \
+	X(AimY,     SBC_OFFSET_AIMY,     0, SBC_HID_PAGE_GENERIC_DESKTOP, 0x31)   /* Y */ \
+	X(Rotation, SBC_OFFSET_ROTATION, 1, SBC_HID_PAGE_GENERIC_DESKTOP, 0x32)   /* Z */ \
+	X(SightX,   SBC_OFFSET_SIGHTX,   1, SBC_HID_PAGE_GENERIC_DESKTOP, 0x33)   /* Rx */ \
+	X(SightY,   SBC_OFFSET_SIGHTY,   1, SBC_HID_PAGE_GENERIC_DESKTOP, 0x34)   /* Ry */
+
+#define SBC_LAYOUT_OTHER_AXES(X) \
+	X(Clutch,   SBC_OFFSET_CLUTCH,   0, SBC_HID_PAGE_GENERIC_DESKTOP, 0x36)   /* Slider */ \
+	X(Brake,    SBC_OFFSET_BRAKE,    0, SBC_HID_PAGE_SIMULATION,      0xc5)   /* Brake */ \
+	X(Throttle, SBC_OFFSET_THROTTLE, 0, SBC_HID_PAGE_SIMULATION,      0xbb)   /* Throttle */
+
+#define SBC_LAYOUT_AXES(X) SBC_LAYOUT_POINTER_AXES(X) SBC_LAYOUT_OTHER_AXES(X)
+
+//
+// Values after the axes, the same in every report mode:
+// X(Name, packet offset, type, conversion, HID usage page, HID usage,
+// logical minimum, logical maximum)
+//
+#define SBC_LAYOUT_VALUES(X) \
+	X(Tuner,    SBC_OFFSET_TUNER,    SBC_U8, SbcConvertTuner, SBC_HID_PAGE_SIMULATION, 0xc2, 0, 255)      /* Weapons Select */ \
+	X(Gear,     SBC_OFFSET_GEAR,     SBC_S8, SbcConvertGear,  SBC_HID_PAGE_SIMULATION, 0xc7, -128, 127)   /* Shifter */
+
+#define SBC_HID_PAGE_GENERIC_DESKTOP    (0x01)
+#define SBC_HID_PAGE_SIMULATION         (0x02)
+
+#define SBC_BUTTON_COUNT            (39)
+
+//
+// Virtual buttons, one byte after the values. They have no packet source:
+// the combo engine (see sbccombo.h) sets them and without it they stay
+// released. Their usages follow the ones of the physical buttons.
+//
+#define SBC_VIRTUAL_BUTTON_COUNT    (8)
+
+#define SBC_LAYOUT_COUNT(...)               + 1
+#define SBC_LAYOUT_VALUE_SIZE(Name, Offset, Type, ...)  + sizeof(Type)
+
+#define SBC_REPORT_BUTTON_BYTES     (0 SBC_LAYOUT_BUTTON_BYTES(SBC_LAYOUT_COUNT))
+#define SBC_POINTER_AXIS_COUNT      (0 SBC_LAYOUT_POINTER_AXES(SBC_LAYOUT_COUNT))
+
+// Size in bytes of an input report with AxisBytes per axis
+#define SBC_INPUT_REPORT_SIZE(AxisBytes) \
+	(SBC_REPORT_BUTTON_BYTES + (0 SBC_LAYOUT_AXES(SBC_LAYOUT_COUNT)) * (AxisBytes) + (0 SBC_LAYOUT_VALUES(SBC_LAYOUT_VALUE_SIZE)) + 1)
+
+#define SBC_LAYOUT_FIELD_BUTTONS(Name, Offset)                  SBC_U8 Name;
+#define SBC_LAYOUT_FIELD_AXIS_8(Name, Offset, Signed, Page, Usage)  SBC_U8 Name;
+#define SBC_LAYOUT_FIELD_AXIS_16(Name, Offset, Signed, Page, Usage) SBC_U16 Name;
+#define SBC_LAYOUT_FIELD_VALUE(Name, Offset, Type, ...)         Type Name;
+
+//
+// HID Report Data
+//
+#pragma pack(push, 1)
+typedef struct _HIDFX2_INPUT_REPORT
+{
+	SBC_LAYOUT_BUTTON_BYTES(SBC_LAYOUT_FIELD_BUTTONS)
+	SBC_LAYOUT_AXES(SBC_LAYOUT_FIELD_AXIS_8)
+	SBC_LAYOUT_VALUES(SBC_LAYOUT_FIELD_VALUE)
+	SBC_U8 VirtualButtons;
+} HIDFX2_INPUT_REPORT, *PHIDFX2_INPUT_REPORT;
+#pragma pack(pop)
+
+//
+// High precision HID Report Data. Same fields with the 8 axes at full 16 bit
+// resolution. Signed axes are offset by 0x8000 so every axis goes from 0 to
+// 65535 with the center at 32768.
+//
+#pragma pack(push, 1)
+typedef struct _HIDFX2_INPUT_REPORT_16
+{
+	SBC_LAYOUT_BUTTON_BYTES(SBC_LAYOUT_FIELD_BUTTONS)
+	SBC_LAYOUT_AXES(SBC_LAYOUT_FIELD_AXIS_16)
+	SBC_LAYOUT_VALUES(SBC_LAYOUT_FIELD_VALUE)
+	SBC_U8 VirtualButtons;
+} HIDFX2_INPUT_REPORT_16, *PHIDFX2_INPUT_REPORT_16;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_INPUT_REPORT_SIZE[(sizeof(HIDFX2_INPUT_REPORT) == 16 && sizeof(HIDFX2_INPUT_REPORT) == SBC_INPUT_REPORT_SIZE(1)) ? 1 : -1];
+typedef char SBC_ASSERT_INPUT_REPORT_16_SIZE[(sizeof(HIDFX2_INPUT_REPORT_16) == 24 && sizeof(HIDFX2_INPUT_REPORT_16) == SBC_INPUT_REPORT_SIZE(2)) ? 1 : -1];
+typedef char SBC_ASSERT_BUTTON_COUNT[(SBC_BUTTON_COUNT <= SBC_REPORT_BUTTON_BYTES * 8) ? 1 : -1];
+typedef char SBC_ASSERT_VIRTUAL_BUTTON_COUNT[(SBC_VIRTUAL_BUTTON_COUNT == 8) ? 1 : -1];
+
+#define SBC_MAX_INPUT_REPORT_SIZE   (sizeof(HIDFX2_INPUT_REPORT_16))
+
+//
+// Axes in report order
+//
+#define SBC_LAYOUT_AXIS_ENUM(Name, Offset, Signed, Page, Usage) SbcAxis##Name,
+
+typedef enum _SBC_AXIS
+{
+	SBC_LAYOUT_AXES(SBC_LAYOUT_AXIS_ENUM)
+	SbcAxisCount
+} SBC_AXIS;
+
+//
+// Axes by index, for the code that loops over them instead of expanding
+// the layout tables. Generated from SBC_LAYOUT_AXES in sbccore.c.
+//
+typedef struct _SBC_AXIS_LAYOUT
+{
+	SBC_U8 PacketOffset;
+	SBC_U8 Signed;              // Two's complement in the packet
+	SBC_U8 Centered;            // Pointer axis, at rest in the middle of its range
+	SBC_U8 ReportOffset[2];     // Offset in the report, indexed by SBC_REPORT_MODE
+} SBC_AXIS_LAYOUT;
+
+extern const SBC_AXIS_LAYOUT SbcAxisLayout[SbcAxisCount];
+
+//
+// Report IDs. The game pad collection carries the input report and the
+// vendor defined collection (usage page 0xFF00) the feature reports and
+// the LED output report (see sbcled.h). The input report structures don't
+// include the ID, it is prepended when a read request is completed.
+// Feature and output reports start with it. With split reports (see
+// sbcsplit.h) the buttons, the sticks and the other controls have their
+// own input reports instead of SBC_REPORT_ID_INPUT.
+//
+#define SBC_REPORT_ID_INPUT         (1)
+#define SBC_REPORT_ID_LATENCY       (2)
+#define SBC_REPORT_ID_LED           (3)
+#define SBC_REPORT_ID_CALIBRATION   (4)
+#define SBC_REPORT_ID_REMAP         (5)
+#define SBC_REPORT_ID_TRACE         (6)
+#define SBC_REPORT_ID_STATS         (7)
+#define SBC_REPORT_ID_BUTTONS       (8)
+#define SBC_REPORT_ID_STICKS        (9)
+#define SBC_REPORT_ID_CONTROLS      (10)
+
+//
+// Input report layout exposed to hidclass. Selected per device with the
+// HighPrecisionAxes registry value.
+//
+typedef enum _SBC_REPORT_MODE
+{
+	SbcReportMode8Bit = 0,
+	SbcReportMode16Bit = 1,
+} SBC_REPORT_MODE;
+
+//
+// Little endian loads from the raw packet
+//
+static __inline SBC_U16 SbcLoadU16(const SBC_U8 *Data)
+{
+	return (SBC_U16)(Data[0] | (Data[1] << 8));
+}
+
+static __inline SBC_S16 SbcLoadS16(const SBC_U8 *Data)
+{
+	return (SBC_S16)SbcLoadU16(Data);
+}
+
+//
+// Ordering of the stores and loads shared with another processor by the
+// lock-free rings and the snapshot. The fence is free on x86 and x64,
+// where only the compiler has to be kept from reordering them.
+//
+#if defined(_MSC_VER)
+#if defined(_M_ARM64)
+#define SbcFence()              __dmb(_ARM64_BARRIER_ISH)
+#else
+#define SbcFence()              _ReadWriteBarrier()
+#endif
+#else
+#define SbcFence()              __atomic_thread_fence(__ATOMIC_ACQ_REL)
+#endif
+
+void SbcTranslateReport(const SBC_U8 *Packet, HIDFX2_INPUT_REPORT *Report);
+void SbcTranslateReport16(const SBC_U8 *Packet, HIDFX2_INPUT_REPORT_16 *Report);
+SBC_U32 SbcInputReportSize(SBC_REPORT_MODE Mode);
+SBC_U32 SbcBuildInputReport(SBC_REPORT_MODE Mode, const SBC_U8 *Packet, void *Report);
+SBC_U32 SbcBuildInputReportExcept(SBC_REPORT_MODE Mode, const SBC_U8 *Packet, void *Report, SBC_U32 AxisMask);
+
+//
+// Latest-state slot. Keeps the last translated report and whether it has
+// changed since the last one handed to a read request, so a read arriving
+// when there is undelivered state can be completed without waiting for the
+// next packet from the device. Polls get the latest report without
+// affecting the reads. The caller serializes the access.
+//
+typedef struct _SBC_REPORT_CACHE
+{
+	SBC_U8 Latest[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U8 Delivered[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U32 Size;
+	SBC_U8 Dirty;
+
+	// Split reports: mask of the parts that still have to be delivered
+	SBC_U8 DirtyParts;
+
+	// Undelivered changes replaced by a newer report before a read took them
+	SBC_U64 Dropped;
+} SBC_REPORT_CACHE, *PSBC_REPORT_CACHE;
+
+void SbcReportCacheInit(SBC_REPORT_CACHE *Cache);
+void SbcReportCacheStore(SBC_REPORT_CACHE *Cache, const void *Report, SBC_U32 Size, int Delivered);
+SBC_U32 SbcReportCacheTake(SBC_REPORT_CACHE *Cache, void *Report);
+SBC_U32 SbcReportCachePeek(const SBC_REPORT_CACHE *Cache, void *Report);
+
+//
+// Change detection. Decides whether a new report is different enough from
+// the last one that was let through to be worth waking up the readers.
+// Buttons, tuner and gear must match exactly, axes may move up to their
+// deadband (in report units). A report is always let through after
+// KeepAliveNs without one. The caller serializes the access.
+//
+typedef struct _SBC_CHANGE_FILTER
+{
+	// Configuration
+	SBC_U16 Deadband[SbcAxisCount];
+	SBC_U64 KeepAliveNs;            // 0 disables the keep-alive
+	SBC_REPORT_MODE Mode;
+
+	// State
+	SBC_U8 Last[SBC_MAX_INPUT_REPORT_SIZE];
+	SBC_U64 LastTime;
+	SBC_U8 HaveLast;
+
+	// Counters
+	SBC_U64 Passed;
+	SBC_U64 Suppressed;
+} SBC_CHANGE_FILTER, *PSBC_CHANGE_FILTER;
+
+void SbcChangeFilterInit(SBC_CHANGE_FILTER *Filter, SBC_REPORT_MODE Mode);
+int SbcChangeFilterCheck(SBC_CHANGE_FILTER *Filter, const void *Report, SBC_U64 Now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCCORE_H_
@@ -0,0 +1,157 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCDESCRIPTOR_H_
+#define _SBCDESCRIPTOR_H_
+
+//
+// HID report descriptors, generated at compile time from the layout tables
+// in sbccore.h and the sizes of the feature and output report structures.
+//
+// SBC_REPORT_DESCRIPTOR(Axes) expands to the bytes of a descriptor, to be
+// used as the initializer of an array. Axes selects the axis resolution,
+// SBC_HID_AXES_8 or SBC_HID_AXES_16. The game pad collection has the input
+// report (SBC_REPORT_ID_INPUT), every axis and value with its own main item,
+// and the virtual buttons of the combo engine last as buttons 40 to 47.
+// The vendor defined collection has one report per row of
+// SBC_LAYOUT_VENDOR_REPORTS.
+//
+// SBC_SPLIT_REPORT_DESCRIPTOR(Axes) has the same fields in the same order
+// split in the three input reports of sbcsplit.h.
+//
+
+#include "sbccore.h"
+#include "sbclatency.h"
+#include "sbcled.h"
+#include "sbccalib.h"
+#include "sbcremap.h"
+#include "sbctrace.h"
+#include "sbcstats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Short items
+//
+#define SBC_HID_U16(Value)              (SBC_U8)((Value) & 0xff), (SBC_U8)(((Value) >> 8) & 0xff)
+#define SBC_HID_U32(Value)              SBC_HID_U16(Value), SBC_HID_U16((Value) >> 16)
+
+#define SBC_HID_USAGE_PAGE(Page)        0x05, (SBC_U8)(Page)
+#define SBC_HID_USAGE_PAGE_VENDOR       0x06, 0x00, 0xff
+#define SBC_HID_USAGE(Usage)            0x09, (SBC_U8)(Usage)
+#define SBC_HID_USAGE_MINIMUM(Usage)    0x19, (SBC_U8)(Usage)
+#define SBC_HID_USAGE_MAXIMUM(Usage)    0x29, (SBC_U8)(Usage)
+#define SBC_HID_LOGICAL_MINIMUM(Value)  0x16, SBC_HID_U16(Value)
+#define SBC_HID_LOGICAL_MAXIMUM(Value)  0x26, SBC_HID_U16(Value)
+#define SBC_HID_LOGICAL_MAXIMUM_32(Value) 0x27, SBC_HID_U32(Value)
+#define SBC_HID_REPORT_ID(Id)           0x85, (SBC_U8)(Id)
+#define SBC_HID_REPORT_SIZE(Bits)       0x75, (SBC_U8)(Bits)
+#define SBC_HID_REPORT_COUNT(Count)     0x96, SBC_HID_U16(Count)
+#define SBC_HID_COLLECTION(Type)        0xa1, (SBC_U8)(Type)
+#define SBC_HID_END_COLLECTION          0xc0
+#define SBC_HID_INPUT(Flags)            0x81, (SBC_U8)(Flags)
+#define SBC_HID_OUTPUT(Flags)           0x91, (SBC_U8)(Flags)
+#define SBC_HID_FEATURE(Flags)          0xb1, (SBC_U8)(Flags)
+
+#define SBC_HID_PHYSICAL                (0x00)
+#define SBC_HID_APPLICATION             (0x01)
+
+#define SBC_HID_DATA_VAR_ABS            (0x02)
+#define SBC_HID_CNST_VAR_ABS            (0x03)
+
+#define SBC_HID_PAGE_BUTTON             (0x09)
+#define SBC_HID_USAGE_POINTER           (0x01)
+#define SBC_HID_USAGE_GAME_PAD          (0x05)
+
+//
+// Axis resolutions
+//
+#define SBC_HID_AXES_8 \
+	SBC_HID_LOGICAL_MINIMUM(0), SBC_HID_LOGICAL_MAXIMUM(255), SBC_HID_REPORT_SIZE(8)
+#define SBC_HID_AXES_16 \
+	SBC_HID_LOGICAL_MINIMUM(0), SBC_HID_LOGICAL_MAXIMUM_32(65535), SBC_HID_REPORT_SIZE(16)
+
+//
+// Reports of the vendor defined collection: X(report ID, main item, bits per
+// element, bytes after the report ID). Each report has the vendor usage
+// equal to its ID.
+//
+#define SBC_LAYOUT_VENDOR_REPORTS(X) \
+	X(SBC_REPORT_ID_LATENCY,     SBC_HID_FEATURE, 8, sizeof(SBC_LATENCY_FEATURE_REPORT) - 1) \
+	X(SBC_REPORT_ID_LED,         SBC_HID_OUTPUT,  4, SBC_LED_PACKET_SIZE) \
+	X(SBC_REPORT_ID_CALIBRATION, SBC_HID_FEATURE, 8, sizeof(SBC_CALIBRATION_FEATURE_REPORT) - 1) \
+	X(SBC_REPORT_ID_REMAP,       SBC_HID_FEATURE, 8, sizeof(SBC_REMAP_FEATURE_REPORT) - 1) \
+	X(SBC_REPORT_ID_TRACE,       SBC_HID_FEATURE, 8, sizeof(SBC_TRACE_FEATURE_REPORT) - 1) \
+	X(SBC_REPORT_ID_STATS,       SBC_HID_FEATURE, 8, sizeof(SBC_STATS_FEATURE_REPORT) - 1)
+
+#define SBC_HID_AXIS(Name, Offset, Signed, Page, Usage) \
+	SBC_HID_USAGE_PAGE(Page), SBC_HID_USAGE(Usage), SBC_HID_INPUT(SBC_HID_DATA_VAR_ABS),
+
+#define SBC_HID_VALUE(Name, Offset, Type, Convert, Page, Usage, Minimum, Maximum) \
+	SBC_HID_USAGE_PAGE(Page), SBC_HID_USAGE(Usage), \
+	SBC_HID_LOGICAL_MINIMUM(Minimum), SBC_HID_LOGICAL_MAXIMUM(Maximum), \
+	SBC_HID_REPORT_SIZE(8 * sizeof(Type)), SBC_HID_INPUT(SBC_HID_DATA_VAR_ABS),
+
+#define SBC_HID_VENDOR_REPORT(Id, Main, Bits, Bytes) \
+	SBC_HID_REPORT_ID(Id), SBC_HID_USAGE(Id), \
+	SBC_HID_LOGICAL_MINIMUM(0), SBC_HID_LOGICAL_MAXIMUM((1 << (Bits)) - 1), \
+	SBC_HID_REPORT_SIZE(Bits), SBC_HID_REPORT_COUNT((Bytes) * 8 / (Bits)), Main(SBC_HID_DATA_VAR_ABS),
+
+// Report ID item starting a part, only with split reports
+#define SBC_HID_SPLIT_ID_0(Id)
+#define SBC_HID_SPLIT_ID_1(Id)          SBC_HID_REPORT_ID(Id),
+
+#define SBC_REPORT_DESCRIPTOR(Axes)         SBC_HID_REPORT_DESCRIPTOR(0, Axes)
+#define SBC_SPLIT_REPORT_DESCRIPTOR(Axes)   SBC_HID_REPORT_DESCRIPTOR(1, Axes)
+
+#define SBC_HID_REPORT_DESCRIPTOR(Split, ...) \
+	SBC_HID_USAGE_PAGE(SBC_HID_PAGE_GENERIC_DESKTOP), \
+	SBC_HID_USAGE(SBC_HID_USAGE_GAME_PAD), \
+	SBC_HID_COLLECTION(SBC_HID_APPLICATION), \
+		SBC_HID_REPORT_ID((Split) ? SBC_REPORT_ID_BUTTONS : SBC_REPORT_ID_INPUT), \
+		SBC_HID_USAGE_PAGE(SBC_HID_PAGE_BUTTON), \
+		SBC_HID_USAGE_MINIMUM(1), \
+		SBC_HID_USAGE_MAXIMUM(SBC_BUTTON_COUNT), \
+		SBC_HID_LOGICAL_MINIMUM(0), \
+		SBC_HID_LOGICAL_MAXIMUM(1), \
+		SBC_HID_REPORT_SIZE(1), \
+		SBC_HID_REPORT_COUNT(SBC_BUTTON_COUNT), \
+		SBC_HID_INPUT(SBC_HID_DATA_VAR_ABS), \
+		SBC_HID_REPORT_COUNT(SBC_REPORT_BUTTON_BYTES * 8 - SBC_BUTTON_COUNT), \
+		SBC_HID_INPUT(SBC_HID_CNST_VAR_ABS), \
+		SBC_HID_SPLIT_ID_##Split(SBC_REPORT_ID_STICKS) \
+		__VA_ARGS__, \
+		SBC_HID_REPORT_COUNT(1), \
+		SBC_HID_USAGE_PAGE(SBC_HID_PAGE_GENERIC_DESKTOP), \
+		SBC_HID_USAGE(SBC_HID_USAGE_POINTER), \
+		SBC_HID_COLLECTION(SBC_HID_PHYSICAL), \
+			SBC_LAYOUT_POINTER_AXES(SBC_HID_AXIS) \
+		SBC_HID_END_COLLECTION, \
+		SBC_HID_SPLIT_ID_##Split(SBC_REPORT_ID_CONTROLS) \
+		SBC_LAYOUT_OTHER_AXES(SBC_HID_AXIS) \
+		SBC_LAYOUT_VALUES(SBC_HID_VALUE) \
+		SBC_HID_USAGE_PAGE(SBC_HID_PAGE_BUTTON), \
+		SBC_HID_USAGE_MINIMUM(SBC_BUTTON_COUNT + 1), \
+		SBC_HID_USAGE_MAXIMUM(SBC_BUTTON_COUNT + SBC_VIRTUAL_BUTTON_COUNT), \
+		SBC_HID_LOGICAL_MINIMUM(0), \
+		SBC_HID_LOGICAL_MAXIMUM(1), \
+		SBC_HID_REPORT_SIZE(1), \
+		SBC_HID_REPORT_COUNT(SBC_VIRTUAL_BUTTON_COUNT), \
+		SBC_HID_INPUT(SBC_HID_DATA_VAR_ABS), \
+	SBC_HID_END_COLLECTION, \
+	SBC_HID_USAGE_PAGE_VENDOR, \
+	SBC_HID_USAGE(1), \
+	SBC_HID_COLLECTION(SBC_HID_APPLICATION), \
+		SBC_LAYOUT_VENDOR_REPORTS(SBC_HID_VENDOR_REPORT) \
+	SBC_HID_END_COLLECTION
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCDESCRIPTOR_H_
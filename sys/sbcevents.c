@@ -0,0 +1,181 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <string.h>
+
+#include "sbcevents.h"
+
+#define SBC_EVENT_MASK              (SBC_EVENT_RING_SIZE - 1)
+#define SBC_EVENT_BUTTONS           ((1ull << SBC_BUTTON_COUNT) - 1)
+
+// Sequence of a slot being written. Half the numbering away from the event
+// going in, so it can't match any event a reader may be looking for.
+#define SBC_EVENT_WRITING(Number)   (((Number) + 1) ^ 0x80000000u)
+
+void SbcEventRingInit(SBC_EVENT_RING *Ring)
+{
+	memset((void *)Ring, 0, sizeof(*Ring));
+	Ring->Magic = SBC_EVENT_MAGIC;
+	Ring->Version = SBC_EVENT_VERSION;
+	Ring->Size = SBC_EVENT_RING_SIZE;
+}
+
+int SbcEventRingValid(const SBC_EVENT_RING *Ring)
+{
+	return Ring->Magic == SBC_EVENT_MAGIC && Ring->Version == SBC_EVENT_VERSION && Ring->Size == SBC_EVENT_RING_SIZE;
+}
+
+SBC_U32 SbcEventRingUpdate
+(
+	SBC_EVENT_RING *Ring,
+	const void *Report,
+	SBC_U64 Timestamp
+)
+/*++
+Routine Description:
+    Pushes an event for every button that changed since the previous
+    report. Only one writer at a time.
+
+Arguments:
+    Ring - Event ring
+
+    Report - Translated report, the button bytes first
+
+    Timestamp - Arrival of the packet the report was built from
+
+Return Value:
+    Number of events pushed
+--*/
+{
+	const SBC_U8 *report = (const SBC_U8 *)Report;
+	SBC_U64 buttons = 0, changed;
+	SBC_U32 head = Ring->Head;
+	SBC_U32 count = 0;
+	SBC_U32 i, button;
+	SBC_EVENT_SLOT *slot;
+
+	for (i = 0; i < SBC_REPORT_BUTTON_BYTES; ++i) buttons |= (SBC_U64)report[i] << (8 * i);
+	buttons &= SBC_EVENT_BUTTONS;
+
+	changed = buttons ^ Ring->Buttons;
+	Ring->Buttons = buttons;
+
+	while (changed != 0)
+	{
+		button = SbcLowestBit(changed);
+		changed &= changed - 1;
+
+		slot = &Ring->Slots[head & SBC_EVENT_MASK];
+
+		// Readers stop asking for the event this one replaces, the ones
+		// still copying it retry
+		if (head - Ring->Oldest == SBC_EVENT_RING_SIZE)
+		{
+			Ring->Oldest = head - SBC_EVENT_RING_SIZE + 1;
+			SbcFence();
+		}
+		slot->Sequence = SBC_EVENT_WRITING(head);
+		SbcFence();
+
+		slot->Value = button | (SBC_U32)((buttons >> button) & 1) << 8;
+		slot->Timestamp = Timestamp;
+
+		SbcFence();
+		slot->Sequence = head + 1;
+		SbcFence();
+		Ring->Head = ++head;
+		++count;
+	}
+
+	return count;
+}
+
+SBC_U32 SbcEventRingRead
+(
+	const SBC_EVENT_RING *Ring,
+	SBC_U32 *Next,
+	SBC_BUTTON_EVENT *Events,
+	SBC_U32 Max,
+	SBC_U32 *Lost
+)
+/*++
+Routine Description:
+    Copies the events from *Next on, without blocking the writer.
+
+Arguments:
+    Ring - Event ring
+
+    Next - Number of the first event wanted, receives the number of the
+           next event to ask for. A number before the oldest event starts
+           at the oldest one and counts the ones in between as lost. A
+           number ahead of the writer (a ring that was created again)
+           starts over at the oldest event without losing any.
+
+    Events - Receives the events
+
+    Max - Room in Events
+
+    Lost - Optional, receives the number of events that were overwritten
+           before they could be copied
+
+Return Value:
+    Number of events copied
+--*/
+{
+	const volatile SBC_EVENT_SLOT *slot;
+	SBC_U32 next = *Next;
+	SBC_U32 oldest, head, sequence, value;
+	SBC_U32 count = 0, lost = 0;
+	SBC_U64 timestamp;
+
+	// Oldest first, so it is never past the head read after it
+	oldest = Ring->Oldest;
+	SbcFence();
+	head = Ring->Head;
+	SbcFence();
+
+	if ((SBC_S32)(head - next) < 0) next = oldest;
+
+	while (count < Max && next != head)
+	{
+		if ((SBC_S32)(next - oldest) < 0)
+		{
+			lost += oldest - next;
+			next = oldest;
+			continue;
+		}
+
+		slot = &Ring->Slots[next & SBC_EVENT_MASK];
+		sequence = slot->Sequence;
+		SbcFence();
+		value = slot->Value;
+		timestamp = slot->Timestamp;
+		SbcFence();
+
+		if (sequence != next + 1 || slot->Sequence != sequence)
+		{
+			// The writer came round and is replacing it, it moved Oldest
+			// past it first
+			oldest = Ring->Oldest;
+			SbcFence();
+			head = Ring->Head;
+			SbcFence();
+			continue;
+		}
+
+		Events[count].Timestamp = timestamp;
+		Events[count].Sequence = next;
+		Events[count].Button = (SBC_U8)value;
+		Events[count].Pressed = (SBC_U8)(value >> 8);
+		Events[count].Reserved = 0;
+		++count;
+		++next;
+	}
+
+	*Next = next;
+	if (Lost != NULL) *Lost = lost;
+	return count;
+}
@@ -0,0 +1,152 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCEVENTS_H_
+#define _SBCEVENTS_H_
+
+//
+// Button event stream.
+//
+// Every translated report is compared with the previous one: the button
+// bytes are XORed and each bit that changed becomes an event with the
+// arrival time of the packet, the button index and whether it went down or
+// up, lowest button first. Applications that only care about button edges
+// (key bindings, macro tools, input recorders) follow the events instead
+// of diffing reports themselves, and see every edge in order even when the
+// reports come faster than they read them. The stream starts with all the
+// buttons released, so the first report turns into a press for every
+// button already down (the toggle switches).
+//
+// The events go into a ring of SBC_EVENT_RING_SIZE slots written by a
+// single writer, the read completion routine in the driver and the
+// transfer completion in the Linux daemon. Any number of readers follow it
+// without locks, each keeping the number of the next event it wants. Every
+// slot has its own sequence: the writer invalidates it before writing the
+// event and stores the event number plus one after, a reader keeps an event
+// only if it found that number before and after copying it. The writer
+// publishes Head after each event and moves Oldest past a slot before it
+// overwrites it. A reader behind Oldest is moved to it and told how many
+// events it lost. Event numbers wrap around, they are compared by their
+// signed difference.
+//
+// The ring has no pointers, so like the published state it can live in
+// memory shared between processes (see linux/sbcshm.h). In the driver it
+// is read through SBC_IOCTL_READ_BUTTON_EVENTS on the event device of the
+// controller.
+//
+
+#include "sbccore.h"
+#include "sbcsnapshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_EVENT_MAGIC             (0x45564253)    // "SBVE"
+#define SBC_EVENT_VERSION           (2)
+
+// Power of two, events are numbered modulo 2^32
+#define SBC_EVENT_RING_SIZE         (256)
+
+typedef char SBC_ASSERT_EVENT_RING_SIZE[((SBC_EVENT_RING_SIZE & (SBC_EVENT_RING_SIZE - 1)) == 0) ? 1 : -1];
+
+typedef struct _SBC_BUTTON_EVENT
+{
+	SBC_U64 Timestamp;          // Arrival of the packet, nanoseconds
+	SBC_U32 Sequence;           // Event number
+	SBC_U8  Button;             // Button index, 0 to SBC_BUTTON_COUNT - 1
+	SBC_U8  Pressed;            // 1 when pressed, 0 when released
+	SBC_U16 Reserved;
+} SBC_BUTTON_EVENT, *PSBC_BUTTON_EVENT;
+
+typedef char SBC_ASSERT_BUTTON_EVENT_SIZE[(sizeof(SBC_BUTTON_EVENT) == 16) ? 1 : -1];
+
+typedef struct _SBC_EVENT_SLOT
+{
+	volatile SBC_U32 Sequence;  // Event number + 1 once written
+	volatile SBC_U32 Value;     // Button | Pressed << 8
+	volatile SBC_U64 Timestamp;
+} SBC_EVENT_SLOT;
+
+typedef struct _SBC_EVENT_RING
+{
+	SBC_U32 Magic;              // SBC_EVENT_MAGIC
+	SBC_U16 Version;            // SBC_EVENT_VERSION
+	SBC_U16 Size;               // SBC_EVENT_RING_SIZE
+	volatile SBC_U32 Head;      // Number of the next event to be written
+	volatile SBC_U32 Oldest;    // Number of the oldest event still in the ring
+	SBC_U64 Buttons;            // Writer only, button bits of the last report
+	SBC_EVENT_SLOT Slots[SBC_EVENT_RING_SIZE];
+} SBC_EVENT_RING, *PSBC_EVENT_RING;
+
+//
+// Custom IOCTL of the event device,
+// CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800, METHOD_BUFFERED, FILE_READ_ACCESS).
+// The input buffer is an SBC_EVENT_READ_REQUEST, the output buffer an
+// SBC_EVENT_READ_REPLY followed by room for the events. With
+// SBC_EVENT_READ_WAIT the request waits for an event if there is none yet.
+// A waiting request may still complete without events, the reader asks
+// again with the Next it got back.
+//
+#define SBC_IOCTL_READ_BUTTON_EVENTS    (0x00226000)
+
+#define SBC_EVENT_DEVICE_NAME       L"\\Device\\SteelBattalionEvents"
+#define SBC_EVENT_DOS_DEVICE_NAME   L"\\DosDevices\\SteelBattalionEvents"
+#define SBC_EVENT_USER_PATH         "\\\\.\\SteelBattalionEvents"     // Followed by the controller number
+
+#define SBC_EVENT_READ_WAIT         (1)
+
+typedef struct _SBC_EVENT_READ_REQUEST
+{
+	SBC_U32 Next;               // First event wanted, 0 for a new reader
+	SBC_U32 Flags;              // SBC_EVENT_READ_*
+} SBC_EVENT_READ_REQUEST, *PSBC_EVENT_READ_REQUEST;
+
+typedef struct _SBC_EVENT_READ_REPLY
+{
+	SBC_U32 Next;               // Next to ask for
+	SBC_U32 Count;              // Events that follow
+	SBC_U32 Lost;               // Events overwritten before the reader got to them
+	SBC_U32 Reserved;
+	// SBC_BUTTON_EVENT Events[Count];
+} SBC_EVENT_READ_REPLY, *PSBC_EVENT_READ_REPLY;
+
+//
+// Index of the lowest bit set, Value must not be 0
+//
+static __inline SBC_U32 SbcLowestBit(SBC_U64 Value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)Value)) return index;
+	_BitScanForward(&index, (unsigned long)(Value >> 32));
+	return index + 32;
+#elif defined(__GNUC__)
+	return (SBC_U32)__builtin_ctzll(Value);
+#else
+	SBC_U32 index = 0;
+	while ((Value & 1) == 0) { Value >>= 1; ++index; }
+	return index;
+#endif
+}
+
+void SbcEventRingInit(SBC_EVENT_RING *Ring);
+int SbcEventRingValid(const SBC_EVENT_RING *Ring);
+
+// Writer side. Returns the number of events pushed.
+SBC_U32 SbcEventRingUpdate(SBC_EVENT_RING *Ring, const void *Report, SBC_U64 Timestamp);
+
+// Reader side. Copies up to Max events starting at *Next and advances it.
+// Lost, if not NULL, receives the number of events from *Next on that were
+// overwritten before they could be copied. Returns the number of events
+// copied.
+SBC_U32 SbcEventRingRead(const SBC_EVENT_RING *Ring, SBC_U32 *Next, SBC_BUTTON_EVENT *Events, SBC_U32 Max, SBC_U32 *Lost);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCEVENTS_H_
@@ -0,0 +1,92 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <string.h>
+
+#include "sbccore.h"
+
+void SbcChangeFilterInit
+(
+	SBC_CHANGE_FILTER *Filter,
+	SBC_REPORT_MODE Mode
+)
+/*++
+Routine Description:
+    Clears the filter. Every axis starts with no deadband and the keep-alive
+    disabled, the caller sets Deadband and KeepAliveNs afterwards.
+
+Arguments:
+    Filter - Change filter
+
+    Mode - Layout of the reports that will be checked
+
+Return Value:
+    None
+--*/
+{
+	memset(Filter, 0, sizeof(*Filter));
+	Filter->Mode = Mode;
+}
+
+static __inline SBC_U32 SbcAxisDistance(SBC_U32 A, SBC_U32 B)
+{
+	return A > B ? A - B : B - A;
+}
+
+int SbcChangeFilterCheck
+(
+	SBC_CHANGE_FILTER *Filter,
+	const void *Report,
+	SBC_U64 Now
+)
+/*++
+Routine Description:
+    Compares a new report with the last one that passed the filter.
+
+Arguments:
+    Filter - Change filter
+
+    Report - Translated report in the filter's mode
+
+    Now - Timestamp of the report in nanoseconds
+
+Return Value:
+    Non zero if the report has to be delivered, in which case it becomes
+    the new reference. Zero if it is suppressed.
+--*/
+{
+	const SBC_U8 *report = (const SBC_U8 *)Report;
+	const SBC_U8 *last = Filter->Last;
+	SBC_U32 size = SbcInputReportSize(Filter->Mode);
+	SBC_U32 axisSize = Filter->Mode == SbcReportMode16Bit ? 2 : 1;
+	SBC_U32 tail = SBC_REPORT_BUTTON_BYTES + SbcAxisCount * axisSize;
+	SBC_U32 i;
+
+	if (!Filter->HaveLast) goto Pass;
+	if (Filter->KeepAliveNs != 0 && Now - Filter->LastTime >= Filter->KeepAliveNs) goto Pass;
+
+	// Buttons, tuner, gear and virtual buttons
+	if (memcmp(report, last, SBC_REPORT_BUTTON_BYTES) != 0) goto Pass;
+	if (memcmp(report + tail, last + tail, size - tail) != 0) goto Pass;
+
+	for (i = 0; i < SbcAxisCount; ++i)
+	{
+		const SBC_U8 *a = report + SBC_REPORT_BUTTON_BYTES + i * axisSize;
+		const SBC_U8 *b = last + SBC_REPORT_BUTTON_BYTES + i * axisSize;
+		SBC_U32 distance = axisSize == 2 ? SbcAxisDistance(SbcLoadU16(a), SbcLoadU16(b)) : SbcAxisDistance(*a, *b);
+		if (distance > Filter->Deadband[i]) goto Pass;
+	}
+
+	++Filter->Suppressed;
+	return 0;
+
+Pass:
+	memcpy(Filter->Last, report, size);
+	Filter->LastTime = Now;
+	Filter->HaveLast = 1;
+	++Filter->Passed;
+	return 1;
+}
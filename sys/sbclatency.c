@@ -0,0 +1,82 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <string.h>
+
+#include "sbclatency.h"
+
+void SbcLatencyInit(SBC_LATENCY_HISTOGRAM *Histogram)
+{
+	memset(Histogram, 0, sizeof(*Histogram));
+}
+
+SBC_U64 SbcLatencyPercentile
+(
+	const SBC_LATENCY_HISTOGRAM *Histogram,
+	SBC_U32 Permille
+)
+/*++
+Routine Description:
+    Estimates a percentile from the histogram.
+
+Arguments:
+    Histogram - Latency histogram
+
+    Permille - Percentile in tenths of a percent, 500 for the median, 990
+               for p99, 1000 for the maximum
+
+Return Value:
+    Upper bound of the bucket holding the percentile, never more than the
+    largest value recorded. Zero if the histogram is empty.
+--*/
+{
+	SBC_U64 rank;
+	SBC_U64 seen = 0;
+	SBC_U32 i;
+
+	if (Histogram->Count == 0) return 0;
+	if (Permille > 1000) Permille = 1000;
+
+	rank = (Histogram->Count * Permille + 999) / 1000;
+	if (rank == 0) rank = 1;
+
+	for (i = 0; i < SBC_LATENCY_BUCKETS - 1; ++i)
+	{
+		seen += Histogram->Buckets[i];
+		if (seen >= rank)
+		{
+			SBC_U64 upper = (2ull << i) - 1;
+			return upper < Histogram->Max ? upper : Histogram->Max;
+		}
+	}
+	return Histogram->Max;
+}
+
+static SBC_U32 SbcSaturate32(SBC_U64 Value)
+{
+	return Value > 0xffffffffull ? 0xffffffffu : (SBC_U32)Value;
+}
+
+static void SbcLatencySummarize(const SBC_LATENCY_HISTOGRAM *Histogram, SBC_LATENCY_SUMMARY *Summary)
+{
+	Summary->Count = SbcSaturate32(Histogram->Count);
+	Summary->P50 = SbcSaturate32(SbcLatencyPercentile(Histogram, 500));
+	Summary->P99 = SbcSaturate32(SbcLatencyPercentile(Histogram, 990));
+	Summary->Max = SbcSaturate32(Histogram->Max);
+	memcpy(Summary->Buckets, Histogram->Buckets, sizeof(Summary->Buckets));
+}
+
+void SbcLatencyBuildFeatureReport
+(
+	const SBC_LATENCY_HISTOGRAM *Delivery,
+	const SBC_LATENCY_HISTOGRAM *ReadWait,
+	SBC_LATENCY_FEATURE_REPORT *Report
+)
+{
+	Report->ReportId = SBC_REPORT_ID_LATENCY;
+	SbcLatencySummarize(Delivery, &Report->Delivery);
+	SbcLatencySummarize(ReadWait, &Report->ReadWait);
+}
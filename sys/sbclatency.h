@@ -0,0 +1,109 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCLATENCY_H_
+#define _SBCLATENCY_H_
+
+//
+// Fixed bucket log2 latency histograms.
+//
+// Bucket i counts the values in [2^i, 2^(i+1)) nanoseconds, bucket 0 also
+// counts 0 and the last bucket everything from 2^31 ns (about 2 seconds)
+// up. Recording a value is a bit scan and an increment so it can be done
+// for every packet in the read completion routine. Percentiles are
+// resolved to the upper bound of their bucket, i.e. within a factor of 2.
+//
+
+#include "sbccore.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_LATENCY_BUCKETS     (32)
+
+typedef struct _SBC_LATENCY_HISTOGRAM
+{
+	SBC_U32 Buckets[SBC_LATENCY_BUCKETS];
+	SBC_U64 Count;
+	SBC_U64 Max;
+} SBC_LATENCY_HISTOGRAM, *PSBC_LATENCY_HISTOGRAM;
+
+//
+// Index of the highest bit set, 0 for 0
+//
+static __inline SBC_U32 SbcLog2(SBC_U64 Value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(Value >> 32))) return index + 32;
+	return _BitScanReverse(&index, (unsigned long)Value) ? index : 0;
+#elif defined(__GNUC__)
+	return Value != 0 ? 63 - (SBC_U32)__builtin_clzll(Value) : 0;
+#else
+	SBC_U32 index = 0;
+	while (Value >>= 1) ++index;
+	return index;
+#endif
+}
+
+static __inline SBC_U32 SbcLatencyBucket(SBC_U64 Value)
+{
+	SBC_U32 bucket = SbcLog2(Value);
+	return bucket < SBC_LATENCY_BUCKETS ? bucket : SBC_LATENCY_BUCKETS - 1;
+}
+
+static __inline void SbcLatencyRecord(SBC_LATENCY_HISTOGRAM *Histogram, SBC_U64 Value)
+{
+	++Histogram->Buckets[SbcLatencyBucket(Value)];
+	++Histogram->Count;
+	if (Value > Histogram->Max) Histogram->Max = Value;
+}
+
+void SbcLatencyInit(SBC_LATENCY_HISTOGRAM *Histogram);
+SBC_U64 SbcLatencyPercentile(const SBC_LATENCY_HISTOGRAM *Histogram, SBC_U32 Permille);
+
+//
+// Latency feature report (SBC_REPORT_ID_LATENCY) on the vendor defined
+// collection. Times are in nanoseconds and saturate at 0xFFFFFFFF, as do
+// the counts. Little endian.
+//
+#pragma pack(push, 1)
+typedef struct _SBC_LATENCY_SUMMARY
+{
+	SBC_U32 Count;
+	SBC_U32 P50;
+	SBC_U32 P99;
+	SBC_U32 Max;
+	SBC_U32 Buckets[SBC_LATENCY_BUCKETS];
+} SBC_LATENCY_SUMMARY, *PSBC_LATENCY_SUMMARY;
+
+typedef struct _SBC_LATENCY_FEATURE_REPORT
+{
+	SBC_U8 ReportId;
+
+	// From the packet arriving in the read completion routine to the
+	// report being handed to hidclass in a read request
+	SBC_LATENCY_SUMMARY Delivery;
+
+	// Time IOCTL_HID_READ_REPORT requests wait for a report
+	SBC_LATENCY_SUMMARY ReadWait;
+} SBC_LATENCY_FEATURE_REPORT, *PSBC_LATENCY_FEATURE_REPORT;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_LATENCY_FEATURE_REPORT_SIZE[(sizeof(SBC_LATENCY_FEATURE_REPORT) == 289) ? 1 : -1];
+
+void SbcLatencyBuildFeatureReport(const SBC_LATENCY_HISTOGRAM *Delivery, const SBC_LATENCY_HISTOGRAM *ReadWait, SBC_LATENCY_FEATURE_REPORT *Report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCLATENCY_H_
@@ -0,0 +1,145 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <string.h>
+
+#include "sbcled.h"
+
+void SbcLedShadowInit(SBC_LED_SHADOW *Shadow, SBC_U64 MinIntervalNs)
+{
+	memset(Shadow, 0, sizeof(*Shadow));
+	Shadow->MinIntervalNs = MinIntervalNs;
+}
+
+void SbcLedShadowReset(SBC_LED_SHADOW *Shadow)
+/*++
+Routine Description:
+    Forgets what the device shows, e.g. after it has been powered down, so
+    the next poll sends the wanted state again. There must be no frame in
+    flight.
+
+Arguments:
+    Shadow - LED state
+
+Return Value:
+    None
+--*/
+{
+	Shadow->SentValid = 0;
+	Shadow->InFlight = 0;
+}
+
+void SbcLedShadowWrite
+(
+	SBC_LED_SHADOW *Shadow,
+	const SBC_U8 *Packet
+)
+/*++
+Routine Description:
+    Records the LED state written by the host. Nothing is sent from here,
+    call SbcLedShadowPoll afterwards.
+
+Arguments:
+    Shadow - LED state
+
+    Packet - SBC_LED_PACKET_SIZE bytes of brightness nibbles
+
+Return Value:
+    None
+--*/
+{
+	++Shadow->Writes;
+
+	if (memcmp(Shadow->Wanted, Packet, SBC_LED_PACKET_SIZE) == 0)
+	{
+		++Shadow->Unchanged;
+		return;
+	}
+
+	// A change still waiting to be sent is replaced by this one
+	if (memcmp(Shadow->Wanted, Shadow->Sent, SBC_LED_PACKET_SIZE) != 0) ++Shadow->Coalesced;
+
+	memcpy(Shadow->Wanted, Packet, SBC_LED_PACKET_SIZE);
+}
+
+int SbcLedShadowPoll
+(
+	SBC_LED_SHADOW *Shadow,
+	SBC_U64 Now,
+	SBC_U8 *Frame,
+	SBC_U64 *Due
+)
+/*++
+Routine Description:
+    Decides whether a frame has to go to the device now. When it does the
+    frame is marked as in flight and SbcLedShadowSendComplete must be called
+    once the transfer finishes.
+
+Arguments:
+    Shadow - LED state
+
+    Now - Current time in nanoseconds
+
+    Frame - Receives the SBC_LED_PACKET_SIZE bytes to send
+
+    Due - Receives when to poll again if a frame is held back by the rate
+          limit, zero otherwise
+
+Return Value:
+    Non zero if Frame has to be sent
+--*/
+{
+	*Due = 0;
+
+	if (Shadow->InFlight) return 0;
+	if (Shadow->SentValid && memcmp(Shadow->Wanted, Shadow->Sent, SBC_LED_PACKET_SIZE) == 0) return 0;
+
+	if (Shadow->MinIntervalNs != 0 && Shadow->Frames != 0 && Now - Shadow->LastSendTime < Shadow->MinIntervalNs)
+	{
+		*Due = Shadow->LastSendTime + Shadow->MinIntervalNs;
+		return 0;
+	}
+
+	memcpy(Shadow->Sent, Shadow->Wanted, SBC_LED_PACKET_SIZE);
+	memcpy(Frame, Shadow->Wanted, SBC_LED_PACKET_SIZE);
+	Shadow->InFlight = 1;
+	Shadow->LastSendTime = Now;
+	++Shadow->Frames;
+	return 1;
+}
+
+void SbcLedShadowSendComplete
+(
+	SBC_LED_SHADOW *Shadow,
+	int Success
+)
+/*++
+Routine Description:
+    Called when the frame returned by SbcLedShadowPoll has been transferred.
+    If it failed the device state is unknown and the next poll resends the
+    wanted state. Poll again afterwards, the host may have written a new
+    state meanwhile.
+
+Arguments:
+    Shadow - LED state
+
+    Success - Non zero if the device took the frame
+
+Return Value:
+    None
+--*/
+{
+	Shadow->InFlight = 0;
+	if (Success)
+	{
+		Shadow->SentValid = 1;
+	}
+	else
+	{
+		Shadow->SentValid = 0;
+		++Shadow->Failed;
+	}
+}
@@ -0,0 +1,123 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCLED_H_
+#define _SBCLED_H_
+
+//
+// Panel LEDs. The controller takes a 34 byte packet on its interrupt OUT
+// endpoint with a 4 bit brightness per LED, two LEDs per byte, the even
+// LED in the low nibble. The output report with SBC_REPORT_ID_LED carries
+// the same 34 bytes after the report ID.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_LED_PACKET_SIZE         (34)
+#define SBC_LED_MAX_BRIGHTNESS      (15)
+
+//
+// LED index, the nibble of the packet it is controlled by. The first four
+// nibbles are not connected to anything.
+//
+typedef enum _SBC_LED
+{
+	SbcLedEject = 4,
+	SbcLedCockpitHatch,
+	SbcLedIgnition,
+	SbcLedStart,
+	SbcLedMultiMonOpenClose,
+	SbcLedMultiMonMapZoomInOut,
+	SbcLedMultiMonModeSelect,
+	SbcLedMultiMonSubMonitor,
+	SbcLedMainMonZoomIn,
+	SbcLedMainMonZoomOut,
+	SbcLedFunctionFSS,
+	SbcLedFunctionManipulator,
+	SbcLedFunctionLineColorChange,
+	SbcLedWashing,
+	SbcLedExtinguisher,
+	SbcLedChaff,
+	SbcLedFunctionTankDetach,
+	SbcLedFunctionOverride,
+	SbcLedFunctionNightScope,
+	SbcLedFunctionF1,
+	SbcLedFunctionF2,
+	SbcLedFunctionF3,
+	SbcLedWeaponCtrlMain,
+	SbcLedWeaponCtrlSub,
+	SbcLedWeaponCtrlMagazineChange,
+	SbcLedComm1,
+	SbcLedComm2,
+	SbcLedComm3,
+	SbcLedComm4,
+	SbcLedComm5,
+	SbcLedUnused34,
+	SbcLedGearR,
+	SbcLedGearN,
+	SbcLedGear1,
+	SbcLedGear2,
+	SbcLedGear3,
+	SbcLedGear4,
+	SbcLedGear5,
+	SbcLedCount
+} SBC_LED;
+
+static __inline void SbcLedSet(SBC_U8 *Packet, SBC_U32 Led, SBC_U32 Brightness)
+{
+	SBC_U32 shift = (Led & 1) * 4;
+
+	if (Brightness > SBC_LED_MAX_BRIGHTNESS) Brightness = SBC_LED_MAX_BRIGHTNESS;
+	Packet[Led / 2] = (SBC_U8)((Packet[Led / 2] & ~(0xF << shift)) | (Brightness << shift));
+}
+
+static __inline SBC_U32 SbcLedGet(const SBC_U8 *Packet, SBC_U32 Led)
+{
+	return (Packet[Led / 2] >> ((Led & 1) * 4)) & 0xF;
+}
+
+//
+// Shadow of the LED state. Writes from the host only update the wanted
+// state, a frame goes to the device when it differs from what the device
+// already shows, there is no frame in flight and at least MinIntervalNs
+// have passed since the last one. Bursts of writes collapse into the
+// latest state. The caller serializes the access.
+//
+typedef struct _SBC_LED_SHADOW
+{
+	// Configuration
+	SBC_U64 MinIntervalNs;              // 0 disables the rate limit
+
+	// State
+	SBC_U8 Wanted[SBC_LED_PACKET_SIZE]; // Last state written by the host
+	SBC_U8 Sent[SBC_LED_PACKET_SIZE];   // State shown by the device, or in flight
+	SBC_U64 LastSendTime;
+	SBC_U8 SentValid;                   // Zero until a frame has reached the device
+	SBC_U8 InFlight;
+
+	// Counters
+	SBC_U64 Writes;                     // Host writes
+	SBC_U64 Unchanged;                  // Host writes equal to the wanted state
+	SBC_U64 Frames;                     // Frames handed to the device
+	SBC_U64 Coalesced;                  // Changed host writes replaced before they were sent
+	SBC_U64 Failed;                     // Frames the device didn't take
+} SBC_LED_SHADOW, *PSBC_LED_SHADOW;
+
+void SbcLedShadowInit(SBC_LED_SHADOW *Shadow, SBC_U64 MinIntervalNs);
+void SbcLedShadowReset(SBC_LED_SHADOW *Shadow);
+void SbcLedShadowWrite(SBC_LED_SHADOW *Shadow, const SBC_U8 *Packet);
+int SbcLedShadowPoll(SBC_LED_SHADOW *Shadow, SBC_U64 Now, SBC_U8 *Frame, SBC_U64 *Due);
+void SbcLedShadowSendComplete(SBC_LED_SHADOW *Shadow, int Success);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCLED_H_
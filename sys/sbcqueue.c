@@ -0,0 +1,104 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sbcqueue.h"
+
+SBC_U32 SbcReportQueueCapacity(SBC_U32 Depth)
+{
+	SBC_U32 capacity = SBC_REPORT_QUEUE_MIN_DEPTH;
+
+	if (Depth >= SBC_REPORT_QUEUE_MAX_DEPTH) return SBC_REPORT_QUEUE_MAX_DEPTH;
+	while (capacity < Depth) capacity <<= 1;
+	return capacity;
+}
+
+void SbcReportQueueInit(SBC_REPORT_QUEUE *Queue, SBC_QUEUED_REPORT *Entries, SBC_U32 Capacity)
+{
+	memset(Queue, 0, sizeof(*Queue));
+	Queue->Entries = Entries;
+	Queue->Mask = Capacity - 1;
+}
+
+int SbcReportQueuePush(SBC_REPORT_QUEUE *Queue, const void *Report, SBC_U32 Size, SBC_U64 Timestamp)
+/*++
+Routine Description:
+    Appends a report. The slot is filled before Head moves past it, so the
+    consumer never sees a partial report.
+
+Arguments:
+    Queue - Ring to append to
+
+    Report - Translated report, Size bytes
+
+    Size - Up to SBC_MAX_INPUT_REPORT_SIZE
+
+    Timestamp - Arrival of the packet the report was built from
+
+Return Value:
+    1 if queued, 0 if the ring was full and the report was dropped
+--*/
+{
+	SBC_U32 head = Queue->Head;
+	SBC_U32 count = head - Queue->Tail;
+	SBC_QUEUED_REPORT *slot;
+
+	if (count > Queue->Mask)
+	{
+		++Queue->Overflows;
+		return 0;
+	}
+
+	// The consumer is done with the slot once it has moved Tail past it
+	SbcFence();
+
+	slot = &Queue->Entries[head & Queue->Mask];
+	slot->Timestamp = Timestamp;
+	slot->Size = Size;
+	memcpy(slot->Report, Report, Size);
+
+	SbcFence();
+	Queue->Head = head + 1;
+
+	++Queue->Queued;
+	if (count + 1 > Queue->HighWater) Queue->HighWater = count + 1;
+	return 1;
+}
+
+int SbcReportQueuePop(SBC_REPORT_QUEUE *Queue, SBC_QUEUED_REPORT *Report)
+/*++
+Routine Description:
+    Takes the oldest report. The slot is copied out before Tail moves past
+    it, so the producer doesn't refill it halfway through the copy.
+
+Arguments:
+    Queue - Ring to take from
+
+    Report - Receives the report
+
+Return Value:
+    1 if a report was taken, 0 if the ring was empty
+--*/
+{
+	SBC_U32 tail = Queue->Tail;
+	const SBC_QUEUED_REPORT *slot;
+
+	if (Queue->Head == tail) return 0;
+
+	// The slot was filled before Head moved past it
+	SbcFence();
+
+	slot = &Queue->Entries[tail & Queue->Mask];
+	Report->Timestamp = slot->Timestamp;
+	Report->Size = slot->Size;
+	memcpy(Report->Report, slot->Report, slot->Size);
+
+	SbcFence();
+	Queue->Tail = tail + 1;
+	return 1;
+}
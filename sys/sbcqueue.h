@@ -0,0 +1,95 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCQUEUE_H_
+#define _SBCQUEUE_H_
+
+//
+// Report queue for the buffered mode.
+//
+// A bounded single producer, single consumer ring of translated reports.
+// The producer is the read completion routine, the consumer whoever is
+// completing IOCTL_HID_READ_REPORT requests with the queued reports, and
+// neither of them takes a lock to use the ring. Each side only writes its
+// own index: the producer fills a slot and then publishes it by moving
+// Head, the consumer copies a slot out and then frees it by moving Tail.
+//
+// When the ring is full the new report is dropped and counted, the queued
+// ones are never overwritten so the consumer always sees an ordered run of
+// samples with explicit gaps.
+//
+// The caller guarantees that there is only one producer and one consumer
+// at a time.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_REPORT_QUEUE_MIN_DEPTH  (2)
+#define SBC_REPORT_QUEUE_MAX_DEPTH  (4096)
+
+typedef struct _SBC_QUEUED_REPORT
+{
+	SBC_U64 Timestamp;          // Arrival of the packet, nanoseconds
+	SBC_U32 Size;
+	SBC_U8  Report[SBC_MAX_INPUT_REPORT_SIZE];
+} SBC_QUEUED_REPORT, *PSBC_QUEUED_REPORT;
+
+//
+// The producer and the consumer indexes are kept on different cache lines
+// so the two sides don't keep taking the line from each other.
+//
+typedef struct _SBC_REPORT_QUEUE
+{
+	// Written by the producer
+	volatile SBC_U32 Head;      // Next slot to fill, free running
+	SBC_U32 HighWater;          // Most reports queued at once
+	SBC_U64 Queued;             // Reports pushed
+	SBC_U64 Overflows;          // Reports dropped because the ring was full
+	SBC_U8  ProducerPad[40];
+
+	// Written by the consumer
+	volatile SBC_U32 Tail;      // Next slot to take, free running
+	SBC_U8  ConsumerPad[60];
+
+	// Read only after SbcReportQueueInit
+	SBC_QUEUED_REPORT *Entries;
+	SBC_U32 Mask;               // Capacity - 1, the capacity is a power of two
+} SBC_REPORT_QUEUE, *PSBC_REPORT_QUEUE;
+
+//
+// Capacity used for a requested depth: rounded up to a power of two within
+// SBC_REPORT_QUEUE_MIN_DEPTH and SBC_REPORT_QUEUE_MAX_DEPTH
+//
+SBC_U32 SbcReportQueueCapacity(SBC_U32 Depth);
+
+void SbcReportQueueInit(SBC_REPORT_QUEUE *Queue, SBC_QUEUED_REPORT *Entries, SBC_U32 Capacity);
+
+// Producer side. Returns 0 if the ring was full and the report was dropped.
+int SbcReportQueuePush(SBC_REPORT_QUEUE *Queue, const void *Report, SBC_U32 Size, SBC_U64 Timestamp);
+
+// Consumer side. Returns 0 if the ring was empty.
+int SbcReportQueuePop(SBC_REPORT_QUEUE *Queue, SBC_QUEUED_REPORT *Report);
+
+// Consumer side, a producer may add more reports right after
+static __inline int SbcReportQueueEmpty(const SBC_REPORT_QUEUE *Queue)
+{
+	return Queue->Head == Queue->Tail;
+}
+
+static __inline SBC_U32 SbcReportQueueCount(const SBC_REPORT_QUEUE *Queue)
+{
+	return Queue->Head - Queue->Tail;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCQUEUE_H_
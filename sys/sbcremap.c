@@ -0,0 +1,87 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "sbcremap.h"
+
+void SbcRemapIdentity(SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES])
+/*++
+Routine Description:
+    Fills a mapping that leaves every button where it is.
+
+Arguments:
+    Targets - Receives the mapping
+
+Return Value:
+    None
+--*/
+{
+	SBC_U32 button;
+
+	for (button = 0; button < SBC_BUTTON_COUNT; ++button)
+	{
+		SbcStoreButtonMask(Targets[button], 1ull << button);
+	}
+}
+
+int SbcRemapValidate(const SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES])
+/*++
+Routine Description:
+    Checks that no button is mapped to the padding bit.
+
+Arguments:
+    Targets - Mapping
+
+Return Value:
+    Non zero if the mapping can be compiled
+--*/
+{
+	SBC_U32 button;
+
+	for (button = 0; button < SBC_BUTTON_COUNT; ++button)
+	{
+		if (SbcLoadButtonMask(Targets[button]) & ~SBC_BUTTON_MASK) return 0;
+	}
+	return 1;
+}
+
+void SbcRemapCompile
+(
+	SBC_REMAP_TABLES *Tables,
+	const SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES]
+)
+/*++
+Routine Description:
+    Builds the tables for a valid mapping. Each entry is the OR of the
+    targets of the buttons set in its index.
+
+Arguments:
+    Tables - Receives the tables
+
+    Targets - Mapping accepted by SbcRemapValidate
+
+Return Value:
+    None
+--*/
+{
+	SBC_U32 byte, value, bit;
+
+	for (byte = 0; byte < SBC_REPORT_BUTTON_BYTES; ++byte)
+	{
+		Tables->Lut[byte][0] = 0;
+
+		// Every value is a smaller value plus its highest bit
+		for (bit = 0; bit < 8; ++bit)
+		{
+			SBC_U32 button = byte * 8 + bit;
+			SBC_U64 target = button < SBC_BUTTON_COUNT ? SbcLoadButtonMask(Targets[button]) : 0;
+
+			for (value = 0; value < (1u << bit); ++value)
+			{
+				Tables->Lut[byte][value | (1u << bit)] = Tables->Lut[byte][value] | target;
+			}
+		}
+	}
+}
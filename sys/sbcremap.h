@@ -0,0 +1,84 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCREMAP_H_
+#define _SBCREMAP_H_
+
+//
+// Button remapping. Each of the 39 buttons of the controller sets any
+// number of report buttons: itself by default, another one to permute, more
+// than one to duplicate it, none to disable it.
+//
+// The mapping is compiled into one 256 entry table per button byte holding
+// the report buttons set by every value of that byte, so remapping a report
+// is five loads and four ORs with no branches.
+//
+// Buttons are numbered in report order: button n is bit n % 8 of byte
+// n / 8 of the report (Buttons0 bit 0 is button 0). Bit 7 of Buttons4 is
+// padding and always cleared.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_BUTTON_MASK             ((1ull << SBC_BUTTON_COUNT) - 1)
+
+//
+// Feature report SBC_REPORT_ID_REMAP, read and written whole. Targets[n] is
+// the little endian mask of the report buttons that button n sets.
+//
+#pragma pack(push, 1)
+typedef struct _SBC_REMAP_FEATURE_REPORT
+{
+	SBC_U8 ReportId;
+	SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES];
+} SBC_REMAP_FEATURE_REPORT, *PSBC_REMAP_FEATURE_REPORT;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_REMAP_FEATURE_REPORT_SIZE[(sizeof(SBC_REMAP_FEATURE_REPORT) == 196) ? 1 : -1];
+
+typedef struct _SBC_REMAP_TABLES
+{
+	SBC_U64 Lut[SBC_REPORT_BUTTON_BYTES][256];
+} SBC_REMAP_TABLES, *PSBC_REMAP_TABLES;
+
+static __inline SBC_U64 SbcLoadButtonMask(const SBC_U8 *Bytes)
+{
+	return (SBC_U64)Bytes[0] | ((SBC_U64)Bytes[1] << 8) | ((SBC_U64)Bytes[2] << 16) | ((SBC_U64)Bytes[3] << 24) | ((SBC_U64)Bytes[4] << 32);
+}
+
+static __inline void SbcStoreButtonMask(SBC_U8 *Bytes, SBC_U64 Mask)
+{
+	Bytes[0] = (SBC_U8)Mask;
+	Bytes[1] = (SBC_U8)(Mask >> 8);
+	Bytes[2] = (SBC_U8)(Mask >> 16);
+	Bytes[3] = (SBC_U8)(Mask >> 24);
+	Bytes[4] = (SBC_U8)(Mask >> 32);
+}
+
+//
+// Remaps the button bytes at the start of a translated report in place
+//
+static __inline void SbcRemapButtons(const SBC_REMAP_TABLES *Tables, void *Report)
+{
+	SBC_U8 *buttons = (SBC_U8 *)Report;
+	SBC_U64 mask = Tables->Lut[0][buttons[0]] | Tables->Lut[1][buttons[1]] | Tables->Lut[2][buttons[2]] |
+		Tables->Lut[3][buttons[3]] | Tables->Lut[4][buttons[4]];
+	SbcStoreButtonMask(buttons, mask);
+}
+
+void SbcRemapIdentity(SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES]);
+int SbcRemapValidate(const SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES]);
+void SbcRemapCompile(SBC_REMAP_TABLES *Tables, const SBC_U8 Targets[SBC_BUTTON_COUNT][SBC_REPORT_BUTTON_BYTES]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCREMAP_H_
@@ -0,0 +1,445 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "sbcresponse.h"
+
+#define ONE     (SBC_RESPONSE_ONE)
+#define ONE24   (1u << 24)
+
+// Taylor series of 2^f = e^(f ln 2) in Q30. The ninth term is below the
+// rounding of the Q16 results for 0 <= f < 1.
+static const SBC_U64 SbcExp2Coefficients[] =
+{
+	1073741824, 744261118, 257941248, 59597083, 10327387,
+	1431680, 165394, 16377, 1419, 109
+};
+
+static const SBC_U32 SbcResponsePairAxes[SbcResponsePairCount][2] =
+{
+	{ SbcAxisAimX, SbcAxisAimY },
+	{ SbcAxisSightX, SbcAxisSightY },
+};
+
+SBC_U64 SbcExp2Q30(SBC_U32 Exponent)
+/*++
+Routine Description:
+    Fixed point 2^x.
+
+Arguments:
+    Exponent - x in Q24, up to 8.0
+
+Return Value:
+    2^x in Q30
+--*/
+{
+	SBC_U64 fraction = (SBC_U64)(Exponent & 0xFFFFFF) << 6;
+	SBC_U64 value = SbcExp2Coefficients[9];
+	int i;
+
+	for (i = 8; i >= 0; --i)
+	{
+		value = SbcExp2Coefficients[i] + ((value * fraction) >> 30);
+	}
+	return value << (Exponent >> 24);
+}
+
+SBC_U32 SbcSqrtU64(SBC_U64 Value)
+/*++
+Routine Description:
+    Integer square root, rounded down.
+
+Arguments:
+    Value - Radicand
+
+Return Value:
+    floor(sqrt(Value))
+--*/
+{
+	SBC_U64 result = 0;
+	SBC_U64 bit = 1ull << 62;
+
+	while (bit > Value) bit >>= 2;
+
+	// Without branches, whether each bit is set is a coin flip for the
+	// branch predictor
+	while (bit != 0)
+	{
+		SBC_U64 trial = result + bit;
+		SBC_U64 mask = 0 - (SBC_U64)(Value >= trial);
+		Value -= trial & mask;
+		result = (result >> 1) + (bit & mask);
+		bit >>= 2;
+	}
+	return (SBC_U32)result;
+}
+
+static SBC_U32 SbcResponseSaturation(SBC_U16 Saturation)
+{
+	return Saturation != 0 ? Saturation : ONE;
+}
+
+int SbcResponseValidate(const SBC_RESPONSE_SETTINGS *Settings)
+/*++
+Routine Description:
+    Checks the settings of every axis and pair.
+
+Arguments:
+    Settings - Response settings
+
+Return Value:
+    Non zero if the settings can be prepared
+--*/
+{
+	SBC_U32 axis, pair, i;
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		const SBC_AXIS_RESPONSE_SETTINGS *a = &Settings->Axes[axis];
+
+		if (a->Type >= SBC_RESPONSE_TYPE_COUNT) return 0;
+		if (a->Type == SBC_RESPONSE_OFF) continue;
+		if (a->Deadzone >= SbcResponseSaturation(a->Saturation)) return 0;
+		if (a->Type == SBC_RESPONSE_EXPONENTIAL && a->Strength > SBC_RESPONSE_MAX_EXPONENT) return 0;
+		if (a->Type == SBC_RESPONSE_PIECEWISE)
+		{
+			if (a->PointCount > SBC_RESPONSE_MAX_POINTS) return 0;
+			for (i = 0; i < a->PointCount; ++i)
+			{
+				if (a->PointX[i] <= (i == 0 ? 0 : a->PointX[i - 1])) return 0;
+			}
+		}
+	}
+
+	for (pair = 0; pair < SbcResponsePairCount; ++pair)
+	{
+		if (Settings->RadialDeadzone[pair] == 0 && Settings->RadialSaturation[pair] == 0) continue;
+		if (Settings->RadialDeadzone[pair] >= SbcResponseSaturation(Settings->RadialSaturation[pair])) return 0;
+		if (Settings->Axes[SbcResponsePairAxes[pair][0]].Type == SBC_RESPONSE_OFF) return 0;
+		if (Settings->Axes[SbcResponsePairAxes[pair][1]].Type == SBC_RESPONSE_OFF) return 0;
+	}
+
+	return 1;
+}
+
+void SbcResponsePrepare
+(
+	SBC_RESPONSE *Response,
+	const SBC_RESPONSE_SETTINGS *Settings
+)
+/*++
+Routine Description:
+    Precomputes the valid settings for SbcResponseApply.
+
+Arguments:
+    Response - Receives the prepared curves
+
+    Settings - Settings accepted by SbcResponseValidate
+
+Return Value:
+    None
+--*/
+{
+	SBC_U32 axis, pair, i;
+
+	Response->EnabledMask = 0;
+	Response->RadialMask = 0;
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		const SBC_AXIS_RESPONSE_SETTINGS *a = &Settings->Axes[axis];
+		SBC_RESPONSE_CURVE *curve = &Response->Axes[axis];
+
+		curve->Type = a->Type;
+		curve->Deadzone = a->Deadzone;
+		curve->Scale = (1ull << 40) / (SbcResponseSaturation(a->Saturation) - a->Deadzone);
+		curve->Strength = a->Strength;
+		curve->ExpDenominator = 0;
+		curve->Knots = 0;
+
+		if (a->Type == SBC_RESPONSE_OFF) continue;
+		Response->EnabledMask |= 1u << axis;
+
+		if (a->Type == SBC_RESPONSE_EXPONENTIAL && a->Strength != 0)
+		{
+			curve->ExpDenominator = SbcExp2Q30((SBC_U32)a->Strength << 16) - (1u << 30);
+		}
+
+		if (a->Type == SBC_RESPONSE_PIECEWISE)
+		{
+			curve->KnotX[0] = 0;
+			curve->KnotY[0] = 0;
+			for (i = 0; i < a->PointCount; ++i)
+			{
+				curve->KnotX[i + 1] = a->PointX[i];
+				curve->KnotY[i + 1] = a->PointY[i];
+			}
+			curve->KnotX[i + 1] = ONE;
+			curve->KnotY[i + 1] = ONE;
+			curve->Knots = i + 2;
+
+			for (i = 0; i + 1 < curve->Knots; ++i)
+			{
+				SBC_S64 dx = curve->KnotX[i + 1] - curve->KnotX[i];
+				SBC_S64 dy = ((SBC_S64)curve->KnotY[i + 1] - (SBC_S64)curve->KnotY[i]) * ONE;
+				curve->Slope[i] = (dy + (dy < 0 ? -dx / 2 : dx / 2)) / dx;
+			}
+		}
+	}
+
+	for (pair = 0; pair < SbcResponsePairCount; ++pair)
+	{
+		SBC_U32 deadzone = Settings->RadialDeadzone[pair];
+
+		Response->RadialDeadzone[pair] = deadzone;
+		Response->RadialSpan[pair] = SbcResponseSaturation(Settings->RadialSaturation[pair]) - deadzone;
+		Response->RadialScale[pair] = (1ull << 40) / Response->RadialSpan[pair];
+		if (deadzone != 0 || Settings->RadialSaturation[pair] != 0) Response->RadialMask |= 1u << pair;
+	}
+}
+
+static SBC_U32 SbcResponseCurve24
+(
+	const SBC_RESPONSE_CURVE *Curve,
+	SBC_U64 Travel
+)
+{
+	SBC_U64 y;
+
+	switch (Curve->Type)
+	{
+	case SBC_RESPONSE_EXPONENTIAL:
+	{
+		SBC_U64 numerator;
+		if (Curve->ExpDenominator == 0) return (SBC_U32)((Travel + 128) >> 8);
+		numerator = SbcExp2Q30((SBC_U32)((Travel * Curve->Strength) >> 8)) - (1u << 30);
+		y = ((numerator << 16) + Curve->ExpDenominator / 2) / Curve->ExpDenominator;
+		break;
+	}
+
+	case SBC_RESPONSE_SCURVE:
+	{
+		// 3t^2 - 2t^3 eases in and out of the ends
+		SBC_U64 t2 = (Travel * Travel) >> 24;
+		SBC_U64 t3 = (t2 * Travel) >> 24;
+		SBC_U64 smooth = 3 * t2 - 2 * t3;
+		y = (Travel * (ONE - Curve->Strength) + smooth * Curve->Strength + (ONE24 >> 1)) >> 24;
+		break;
+	}
+
+	case SBC_RESPONSE_PIECEWISE:
+	{
+		SBC_U32 i = 0;
+		SBC_S64 delta;
+
+		while (i + 2 < Curve->Knots && Travel >= ((SBC_U64)Curve->KnotX[i + 1] << 8)) ++i;
+
+		delta = (SBC_S64)(Travel - ((SBC_U64)Curve->KnotX[i] << 8)) * Curve->Slope[i];
+		delta = delta >= 0 ? (delta + (ONE24 >> 1)) >> 24 : -((-delta + (ONE24 >> 1)) >> 24);
+		delta += Curve->KnotY[i];
+		y = delta < 0 ? 0 : (SBC_U64)delta;
+		break;
+	}
+
+	default:
+		y = (Travel + 128) >> 8;
+		break;
+	}
+
+	return y > ONE ? ONE : (SBC_U32)y;
+}
+
+SBC_U32 SbcResponseCurve
+(
+	const SBC_RESPONSE_CURVE *Curve,
+	SBC_U32 Travel
+)
+/*++
+Routine Description:
+    Evaluates the curve alone.
+
+Arguments:
+    Curve - Prepared curve
+
+    Travel - Input in Q16, 0 to 1.0
+
+Return Value:
+    Output in Q16, 0 to 1.0
+--*/
+{
+	return SbcResponseCurve24(Curve, (SBC_U64)(Travel > ONE ? ONE : Travel) << 8);
+}
+
+SBC_U32 SbcResponseAxial
+(
+	const SBC_RESPONSE_CURVE *Curve,
+	SBC_U32 Travel
+)
+/*++
+Routine Description:
+    Applies the axial deadzone and saturation, then the curve.
+
+Arguments:
+    Curve - Prepared curve
+
+    Travel - Input in Q16, 0 to 1.0
+
+Return Value:
+    Output in Q16, 0 to 1.0
+--*/
+{
+	SBC_U64 t;
+
+	if (Travel <= Curve->Deadzone) return 0;
+	t = ((SBC_U64)(Travel - Curve->Deadzone) * Curve->Scale + (1u << 15)) >> 16;
+	return SbcResponseCurve24(Curve, t > ONE24 ? ONE24 : t);
+}
+
+void SbcResponseApply
+(
+	const SBC_RESPONSE *Response,
+	SBC_S32 *Travel
+)
+/*++
+Routine Description:
+    Applies the deadzones and curves to the travel of every axis.
+
+Arguments:
+    Response - Prepared settings
+
+    Travel - SbcAxisCount values in Q16: -1.0 to 1.0 for the centered
+             axes, 0 to 1.0 for the pedals. Replaced by the output.
+
+Return Value:
+    None
+--*/
+{
+	SBC_U32 handled = 0;
+	SBC_U32 pair, axis;
+
+	for (pair = 0; pair < SbcResponsePairCount; ++pair)
+	{
+		SBC_U32 ax = SbcResponsePairAxes[pair][0];
+		SBC_U32 ay = SbcResponsePairAxes[pair][1];
+		SBC_U64 x, y, t, length, deadzone, span;
+		SBC_U32 output;
+
+		if (!(Response->RadialMask & (1u << pair))) continue;
+		handled |= (1u << ax) | (1u << ay);
+
+		// Length in Q24
+		x = (SBC_U64)(Travel[ax] < 0 ? -(SBC_S64)Travel[ax] : Travel[ax]);
+		y = (SBC_U64)(Travel[ay] < 0 ? -(SBC_S64)Travel[ay] : Travel[ay]);
+		length = SbcSqrtU64((x * x + y * y) << 16);
+		deadzone = (SBC_U64)Response->RadialDeadzone[pair] << 8;
+		span = (SBC_U64)Response->RadialSpan[pair] << 8;
+		if (length <= deadzone)
+		{
+			Travel[ax] = 0;
+			Travel[ay] = 0;
+			continue;
+		}
+
+		// Scale the vector so its length follows the curve of the X axis
+		t = length - deadzone >= span ? ONE24 : ((length - deadzone) * Response->RadialScale[pair] + (1u << 23)) >> 24;
+		output = SbcResponseCurve24(&Response->Axes[ax], t);
+
+		x = ((x * output << 8) + length / 2) / length;
+		y = ((y * output << 8) + length / 2) / length;
+		Travel[ax] = Travel[ax] < 0 ? -(SBC_S32)x : (SBC_S32)x;
+		Travel[ay] = Travel[ay] < 0 ? -(SBC_S32)y : (SBC_S32)y;
+	}
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		SBC_S32 v = Travel[axis];
+		SBC_U32 magnitude;
+
+		if (!(Response->EnabledMask & (1u << axis)) || (handled & (1u << axis))) continue;
+
+		magnitude = (SBC_U32)(v < 0 ? -v : v);
+		magnitude = SbcResponseAxial(&Response->Axes[axis], magnitude > ONE ? ONE : magnitude);
+		Travel[axis] = v < 0 ? -(SBC_S32)magnitude : (SBC_S32)magnitude;
+	}
+}
+
+void SbcResponseApplyReport
+(
+	const SBC_RESPONSE *Response,
+	SBC_REPORT_MODE Mode,
+	void *Report
+)
+/*++
+Routine Description:
+    Applies the deadzones and curves to the axes of a translated report.
+
+Arguments:
+    Response - Prepared settings
+
+    Mode - Report layout
+
+    Report - Report built by SbcBuildInputReport or SbcBuildCalibratedReport
+
+Return Value:
+    None
+--*/
+{
+	SBC_U8 *report = (SBC_U8 *)Report;
+	SBC_U32 half = Mode == SbcReportMode16Bit ? 32768 : 128;
+	SBC_U32 shift = Mode == SbcReportMode16Bit ? 1 : 9;     // half << shift == 1.0
+	SBC_U32 full = 2 * half - 1;
+	SBC_S32 travel[SbcAxisCount];
+	SBC_U32 axis;
+
+	if (Response->EnabledMask == 0) return;
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		const SBC_U8 *field = report + SbcAxisLayout[axis].ReportOffset[Mode];
+		SBC_U32 v = Mode == SbcReportMode16Bit ? SbcLoadU16(field) : field[0];
+
+		if (SbcAxisLayout[axis].Centered)
+		{
+			travel[axis] = ((SBC_S32)v - (SBC_S32)half) * (1 << shift);
+		}
+		else
+		{
+			// Scaled so full travel is exactly 1.0
+			travel[axis] = (SBC_S32)(Mode == SbcReportMode16Bit ? v + (v >> 15) : v * 257 + (v >> 7));
+		}
+	}
+
+	SbcResponseApply(Response, travel);
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		SBC_U8 *field = report + SbcAxisLayout[axis].ReportOffset[Mode];
+		SBC_S32 t = travel[axis];
+		SBC_U32 v;
+
+		if (!(Response->EnabledMask & (1u << axis))) continue;
+
+		if (SbcAxisLayout[axis].Centered)
+		{
+			SBC_S32 s = (SBC_S32)((((SBC_U64)(t < 0 ? -t : t)) * half + ONE / 2) >> 16);
+			v = (SBC_U32)((SBC_S32)half + (t < 0 ? -s : s));
+			if (v > full) v = full;
+		}
+		else
+		{
+			v = (SBC_U32)(((SBC_U64)t * full + ONE / 2) >> 16);
+		}
+
+		if (Mode == SbcReportMode16Bit)
+		{
+			field[0] = (SBC_U8)v;
+			field[1] = (SBC_U8)(v >> 8);
+		}
+		else
+		{
+			field[0] = (SBC_U8)v;
+		}
+	}
+}
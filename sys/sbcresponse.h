@@ -0,0 +1,124 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCRESPONSE_H_
+#define _SBCRESPONSE_H_
+
+//
+// Response curves and deadzones, applied to the axes of a translated report
+// after the calibration.
+//
+// Everything is integer arithmetic in Q16 (65536 is 1.0) so it can run in
+// the read completion routine. Each axis is reduced to its travel from rest:
+// the signed distance from the center for AimX, AimY, Rotation, SightX and
+// SightY, the distance from the released position for the pedals. The travel
+// goes through an optional axial deadzone and saturation, then through the
+// curve, and is put back in the report.
+//
+// The aim stick and the sight stick can use a radial deadzone instead, which
+// works on the length of the (X, Y) vector so diagonals behave the same as
+// the axes. The pair then uses the curve of its X axis.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_RESPONSE_ONE            (65536)
+
+// Curve types
+#define SBC_RESPONSE_OFF            (0)     // Axis left as translated
+#define SBC_RESPONSE_LINEAR         (1)     // Only the deadzone and saturation
+#define SBC_RESPONSE_EXPONENTIAL    (2)     // (2^(k*t) - 1) / (2^k - 1)
+#define SBC_RESPONSE_SCURVE         (3)     // Blend of t and smoothstep(t)
+#define SBC_RESPONSE_PIECEWISE      (4)     // Straight lines through the user points
+#define SBC_RESPONSE_TYPE_COUNT     (5)
+
+// Exponential strength is k in 1/256, up to 2^8 between the steepest and
+// the flattest slope
+#define SBC_RESPONSE_MAX_EXPONENT   (8 * 256)
+
+#define SBC_RESPONSE_MAX_POINTS     (6)
+
+typedef enum _SBC_RESPONSE_PAIR
+{
+	SbcResponsePairAim = 0,         // AimX, AimY
+	SbcResponsePairSight,           // SightX, SightY
+	SbcResponsePairCount
+} SBC_RESPONSE_PAIR;
+
+#pragma pack(push, 1)
+typedef struct _SBC_AXIS_RESPONSE_SETTINGS
+{
+	SBC_U8  Type;                   // SBC_RESPONSE_*
+	SBC_U8  PointCount;             // Piecewise: points used, up to SBC_RESPONSE_MAX_POINTS
+	SBC_U16 Strength;               // Exponential: k in 1/256. S-curve: 0 (linear) to 65535 (smoothstep)
+	SBC_U16 Deadzone;               // Travel reported as rest, in 1/65536 of the full travel
+	SBC_U16 Saturation;             // Travel reported as full, 0 for the full travel
+	SBC_U16 PointX[SBC_RESPONSE_MAX_POINTS];    // Piecewise: increasing input travel, above 0
+	SBC_U16 PointY[SBC_RESPONSE_MAX_POINTS];    // Piecewise: output at each PointX
+} SBC_AXIS_RESPONSE_SETTINGS, *PSBC_AXIS_RESPONSE_SETTINGS;
+
+//
+// Stored as is in the ResponseCurves registry value
+//
+typedef struct _SBC_RESPONSE_SETTINGS
+{
+	SBC_AXIS_RESPONSE_SETTINGS Axes[SbcAxisCount];
+	SBC_U16 RadialDeadzone[SbcResponsePairCount];   // Both 0 keeps the pair axial
+	SBC_U16 RadialSaturation[SbcResponsePairCount];
+} SBC_RESPONSE_SETTINGS, *PSBC_RESPONSE_SETTINGS;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_AXIS_RESPONSE_SETTINGS_SIZE[(sizeof(SBC_AXIS_RESPONSE_SETTINGS) == 32) ? 1 : -1];
+typedef char SBC_ASSERT_RESPONSE_SETTINGS_SIZE[(sizeof(SBC_RESPONSE_SETTINGS) == 264) ? 1 : -1];
+
+//
+// Settings prepared for the hot path: reciprocals and slopes computed once
+// so applying the curves needs no division except for the radial pairs and
+// the exponential curve. Between the deadzone and the curve the travel is
+// kept in Q24 so steep curves don't magnify the rounding.
+//
+typedef struct _SBC_RESPONSE_CURVE
+{
+	SBC_U32 Type;
+	SBC_U32 Deadzone;               // Q16
+	SBC_U64 Scale;                  // 2^40 / travel between deadzone and saturation (Q16 to Q24)
+	SBC_U32 Strength;
+	SBC_U64 ExpDenominator;         // Q30 2^k - 1
+	SBC_U32 Knots;                  // Piecewise: points including (0, 0) and (1, 1)
+	SBC_U32 KnotX[SBC_RESPONSE_MAX_POINTS + 2];
+	SBC_U32 KnotY[SBC_RESPONSE_MAX_POINTS + 2];
+	SBC_S64 Slope[SBC_RESPONSE_MAX_POINTS + 1];     // Q16
+} SBC_RESPONSE_CURVE, *PSBC_RESPONSE_CURVE;
+
+typedef struct _SBC_RESPONSE
+{
+	SBC_U32 EnabledMask;            // Bit n set if axis n is processed
+	SBC_U32 RadialMask;             // Bit n set if pair n uses the radial deadzone
+	SBC_RESPONSE_CURVE Axes[SbcAxisCount];
+	SBC_U32 RadialDeadzone[SbcResponsePairCount];
+	SBC_U32 RadialSpan[SbcResponsePairCount];
+	SBC_U64 RadialScale[SbcResponsePairCount];
+} SBC_RESPONSE, *PSBC_RESPONSE;
+
+int SbcResponseValidate(const SBC_RESPONSE_SETTINGS *Settings);
+void SbcResponsePrepare(SBC_RESPONSE *Response, const SBC_RESPONSE_SETTINGS *Settings);
+SBC_U32 SbcResponseCurve(const SBC_RESPONSE_CURVE *Curve, SBC_U32 Travel);
+SBC_U32 SbcResponseAxial(const SBC_RESPONSE_CURVE *Curve, SBC_U32 Travel);
+void SbcResponseApply(const SBC_RESPONSE *Response, SBC_S32 *Travel);
+void SbcResponseApplyReport(const SBC_RESPONSE *Response, SBC_REPORT_MODE Mode, void *Report);
+
+SBC_U64 SbcExp2Q30(SBC_U32 Exponent);
+SBC_U32 SbcSqrtU64(SBC_U64 Value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCRESPONSE_H_
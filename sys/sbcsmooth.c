@@ -0,0 +1,190 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sbcsmooth.h"
+
+#define ONE                 (65536)
+#define ALPHA_ONE           (1ll << SBC_SMOOTH_ALPHA_BITS)
+#define TWO_PI_Q24          (105414357ull)
+
+//
+// Packet offset of every axis and whether it is signed, from the layout
+//
+typedef struct _SBC_SMOOTH_FIELD
+{
+	SBC_U8 Offset;
+	SBC_U8 Signed;
+} SBC_SMOOTH_FIELD;
+
+#define SBC_SMOOTH_FIELD_ROW(Name, Offset, Signed, Page, Usage)     { Offset, Signed },
+
+static const SBC_SMOOTH_FIELD SbcSmoothFields[SbcAxisCount] =
+{
+	SBC_LAYOUT_AXES(SBC_SMOOTH_FIELD_ROW)
+};
+
+int SbcSmoothValidate(const SBC_SMOOTH_SETTINGS *Settings)
+{
+	SBC_U32 axis;
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		if (Settings->Axes[axis].Reserved != 0) return 0;
+	}
+	return 1;
+}
+
+void SbcSmoothPrepare(SBC_SMOOTH *Smooth, const SBC_SMOOTH_SETTINGS *Settings)
+{
+	SBC_U32 axis;
+
+	memset(Smooth, 0, sizeof(*Smooth));
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		const SBC_AXIS_SMOOTH_SETTINGS *settings = &Settings->Axes[axis];
+		SBC_SMOOTH_AXIS *filter = &Smooth->Axes[axis];
+
+		if (settings->MinCutoff == 0) continue;
+
+		Smooth->EnabledMask |= 1u << axis;
+		filter->MinCutoff = settings->MinCutoff;
+		filter->Beta = settings->Beta;
+		filter->DerivativeCutoff = settings->DerivativeCutoff != 0 ? settings->DerivativeCutoff : SBC_SMOOTH_DEFAULT_DERIVATIVE_CUTOFF;
+	}
+}
+
+void SbcSmoothReset(SBC_SMOOTH *Smooth)
+{
+	Smooth->HaveLast = 0;
+}
+
+SBC_U32 SbcSmoothAlpha(SBC_U32 Cutoff, SBC_U64 DtNs)
+/*++
+Routine Description:
+    Smoothing factor of a first order low pass, a / (1 + a) with
+    a = 2 pi fc dt.
+
+Arguments:
+    Cutoff - fc in 1/100 Hz, up to SBC_SMOOTH_MAX_CUTOFF
+
+    DtNs - dt in nanoseconds, up to SBC_SMOOTH_MAX_GAP_NS
+
+Return Value:
+    Factor in Q24, 0 to just under 1.0
+--*/
+{
+	// a in Q24 from fc * dt in 1/100 Hz ns, split so the product fits
+	SBC_U64 k = (SBC_U64)Cutoff * DtNs;
+	SBC_U64 a = k / 100000 * TWO_PI_Q24 / 1000000 + k % 100000 * TWO_PI_Q24 / 100000000000ull;
+
+	return (SBC_U32)((a << SBC_SMOOTH_ALPHA_BITS) / (a + ALPHA_ONE));
+}
+
+SBC_U32 SbcSmoothStep(SBC_SMOOTH_AXIS *Axis, SBC_U32 Raw, SBC_U64 DtNs)
+/*++
+Routine Description:
+    Runs one sample through the filter of an axis.
+
+Arguments:
+    Axis - Filter of the axis
+
+    Raw - New raw value, 0 to 65535
+
+    DtNs - Time since the previous sample, SBC_SMOOTH_MIN_DT_NS to
+        SBC_SMOOTH_MAX_GAP_NS. 0 restarts the filter at Raw.
+
+Return Value:
+    Filtered raw value
+--*/
+{
+	SBC_S32 x = (SBC_S32)(Raw << 8);
+	SBC_S64 delta, speed;
+	SBC_U64 cutoff;
+	SBC_U32 alpha;
+
+	if (DtNs == 0)
+	{
+		Axis->Value = x;
+		Axis->Speed = 0;
+		return Raw;
+	}
+
+	// Speed from the last filtered value, through its own low pass
+	delta = (SBC_S64)x - Axis->Value;
+	speed = delta * 1000000000 / (SBC_S64)DtNs / 256;
+	alpha = SbcSmoothAlpha(Axis->DerivativeCutoff, DtNs);
+	Axis->Speed += (speed - Axis->Speed) * alpha / ALPHA_ONE;
+
+	// The faster the axis moves the higher the cutoff, and the less lag
+	cutoff = Axis->MinCutoff + (SBC_U64)Axis->Beta * (SBC_U64)(Axis->Speed < 0 ? -Axis->Speed : Axis->Speed) / ONE;
+	if (cutoff > SBC_SMOOTH_MAX_CUTOFF) cutoff = SBC_SMOOTH_MAX_CUTOFF;
+
+	alpha = SbcSmoothAlpha((SBC_U32)cutoff, DtNs);
+	Axis->Value += (SBC_S32)(delta * alpha / ALPHA_ONE);
+
+	return (SBC_U32)(Axis->Value + 128) >> 8;
+}
+
+SBC_U32 SbcSmoothLoadAxis(const SBC_U8 *Packet, SBC_U32 Axis)
+{
+	SBC_U32 v = SbcLoadU16(Packet + SbcSmoothFields[Axis].Offset);
+	return SbcSmoothFields[Axis].Signed ? v ^ 0x8000 : v;
+}
+
+void SbcSmoothStoreAxis(SBC_U8 *Packet, SBC_U32 Axis, SBC_U32 Value)
+{
+	SBC_U8 *p = Packet + SbcSmoothFields[Axis].Offset;
+
+	if (SbcSmoothFields[Axis].Signed) Value ^= 0x8000;
+	p[0] = (SBC_U8)Value;
+	p[1] = (SBC_U8)(Value >> 8);
+}
+
+void SbcSmoothPacket
+(
+	SBC_SMOOTH *Smooth,
+	SBC_U8 *Packet,
+	SBC_U64 Now
+)
+/*++
+Routine Description:
+    Filters the enabled axes of a raw packet in place.
+
+Arguments:
+    Smooth - Filters
+
+    Packet - Raw packet, SBC_INPUT_PACKET_SIZE bytes
+
+    Now - Arrival of the packet, nanoseconds
+
+Return Value:
+    None
+--*/
+{
+	SBC_U64 dt = 0;
+	SBC_U32 axis;
+
+	if (Smooth->EnabledMask == 0) return;
+
+	// With several reads pending packets can be handled out of order
+	if (Smooth->HaveLast)
+	{
+		if (Now <= Smooth->LastTime) dt = SBC_SMOOTH_MIN_DT_NS;
+		else if (Now - Smooth->LastTime <= SBC_SMOOTH_MAX_GAP_NS) dt = Now - Smooth->LastTime;
+		if (dt != 0 && dt < SBC_SMOOTH_MIN_DT_NS) dt = SBC_SMOOTH_MIN_DT_NS;
+	}
+	if (!Smooth->HaveLast || Now > Smooth->LastTime) Smooth->LastTime = Now;
+	Smooth->HaveLast = 1;
+
+	for (axis = 0; axis < SbcAxisCount; ++axis)
+	{
+		if (!(Smooth->EnabledMask & (1u << axis))) continue;
+		SbcSmoothStoreAxis(Packet, axis, SbcSmoothStep(&Smooth->Axes[axis], SbcSmoothLoadAxis(Packet, axis), dt));
+	}
+}
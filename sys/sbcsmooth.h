@@ -0,0 +1,106 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCSMOOTH_H_
+#define _SBCSMOOTH_H_
+
+//
+// Adaptive smoothing of the raw axes, before the translation.
+//
+// Each axis can go through a one euro filter: a first order low pass whose
+// cutoff rises with the speed of the axis. At rest the cutoff stays at
+// MinCutoff and the few LSBs of jitter of a worn potentiometer are filtered
+// out; on a fast move the cutoff goes up by Beta per unit of speed and the
+// filter adds little lag. The speed is itself the derivative of the
+// filtered value through a low pass at DerivativeCutoff.
+//
+// Everything is integer arithmetic. The smoothing factor of a low pass at
+// cutoff fc over dt seconds is a / (1 + a) with a = 2 pi fc dt, in Q24 so
+// low cutoffs at high packet rates keep their precision, and the filter
+// follows the actual time between packets. Values are kept in the raw units
+// of the packet with 8 fractional bits, the signed axes offset by 0x8000
+// like the calibration does.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_SMOOTH_ALPHA_BITS                   (24)
+
+// Cutoffs are in 1/100 Hz
+#define SBC_SMOOTH_DEFAULT_DERIVATIVE_CUTOFF    (100)
+#define SBC_SMOOTH_MAX_CUTOFF                   (100000)
+
+// Packets further apart than this restart the filters at the new value
+#define SBC_SMOOTH_MAX_GAP_NS                   (100000000ull)
+
+// Shorter intervals, and packets arriving out of order, count as this
+#define SBC_SMOOTH_MIN_DT_NS                    (10000ull)
+
+#pragma pack(push, 1)
+typedef struct _SBC_AXIS_SMOOTH_SETTINGS
+{
+	SBC_U16 MinCutoff;          // Cutoff at rest, 1/100 Hz. 0 leaves the axis unfiltered
+	SBC_U16 Beta;               // Cutoff increase in 1/100 Hz per full travel per second
+	SBC_U16 DerivativeCutoff;   // Cutoff of the speed estimate, 1/100 Hz. 0 for 1 Hz
+	SBC_U16 Reserved;           // 0
+} SBC_AXIS_SMOOTH_SETTINGS, *PSBC_AXIS_SMOOTH_SETTINGS;
+
+//
+// Stored as is in the AxisSmoothing registry value
+//
+typedef struct _SBC_SMOOTH_SETTINGS
+{
+	SBC_AXIS_SMOOTH_SETTINGS Axes[SbcAxisCount];
+} SBC_SMOOTH_SETTINGS, *PSBC_SMOOTH_SETTINGS;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_SMOOTH_SETTINGS_SIZE[(sizeof(SBC_SMOOTH_SETTINGS) == 64) ? 1 : -1];
+
+typedef struct _SBC_SMOOTH_AXIS
+{
+	// Configuration, 1/100 Hz
+	SBC_U32 MinCutoff;
+	SBC_U32 Beta;
+	SBC_U32 DerivativeCutoff;
+
+	// State
+	SBC_S32 Value;              // Filtered raw value, 8 fractional bits
+	SBC_S64 Speed;              // Filtered speed, raw units per second
+} SBC_SMOOTH_AXIS, *PSBC_SMOOTH_AXIS;
+
+//
+// Filters of every axis. The caller serializes the access.
+//
+typedef struct _SBC_SMOOTH
+{
+	SBC_U32 EnabledMask;        // Bit n set if axis n is filtered
+	SBC_U64 LastTime;
+	SBC_U8  HaveLast;
+	SBC_SMOOTH_AXIS Axes[SbcAxisCount];
+} SBC_SMOOTH, *PSBC_SMOOTH;
+
+int SbcSmoothValidate(const SBC_SMOOTH_SETTINGS *Settings);
+void SbcSmoothPrepare(SBC_SMOOTH *Smooth, const SBC_SMOOTH_SETTINGS *Settings);
+void SbcSmoothReset(SBC_SMOOTH *Smooth);
+
+SBC_U32 SbcSmoothAlpha(SBC_U32 Cutoff, SBC_U64 DtNs);
+SBC_U32 SbcSmoothStep(SBC_SMOOTH_AXIS *Axis, SBC_U32 Raw, SBC_U64 DtNs);
+
+// Raw value of an axis in a packet, the signed ones offset by 0x8000
+SBC_U32 SbcSmoothLoadAxis(const SBC_U8 *Packet, SBC_U32 Axis);
+void SbcSmoothStoreAxis(SBC_U8 *Packet, SBC_U32 Axis, SBC_U32 Value);
+
+void SbcSmoothPacket(SBC_SMOOTH *Smooth, SBC_U8 *Packet, SBC_U64 Now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCSMOOTH_H_
@@ -0,0 +1,119 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sbcsnapshot.h"
+
+void SbcSnapshotInit(SBC_STATE_SNAPSHOT *Snapshot)
+{
+	memset((void *)Snapshot, 0, sizeof(*Snapshot));
+	Snapshot->Magic = SBC_SNAPSHOT_MAGIC;
+	Snapshot->Version = SBC_SNAPSHOT_VERSION;
+	Snapshot->StateSize = sizeof(SBC_SNAPSHOT_STATE);
+}
+
+int SbcSnapshotValid(const SBC_STATE_SNAPSHOT *Snapshot)
+{
+	return Snapshot->Magic == SBC_SNAPSHOT_MAGIC && Snapshot->Version == SBC_SNAPSHOT_VERSION &&
+		Snapshot->StateSize == sizeof(SBC_SNAPSHOT_STATE);
+}
+
+void SbcSnapshotPublish
+(
+	SBC_STATE_SNAPSHOT *Snapshot,
+	SBC_REPORT_MODE Mode,
+	const void *Report,
+	SBC_U32 Size,
+	SBC_U64 Timestamp
+)
+/*++
+Routine Description:
+    Replaces the published state. Only one writer at a time.
+
+Arguments:
+    Snapshot - Published state
+
+    Mode - Report mode of the report
+
+    Report - Translated report, Size bytes
+
+    Size - Up to SBC_MAX_INPUT_REPORT_SIZE
+
+    Timestamp - Arrival of the packet the report was built from
+
+Return Value:
+    None
+--*/
+{
+	SBC_SNAPSHOT_STATE state;
+	SBC_U64 words[SBC_SNAPSHOT_WORDS];
+	SBC_U32 sequence = Snapshot->Sequence;
+	SBC_U32 i;
+
+	memset(&state, 0, sizeof(state));
+	state.Timestamp = Timestamp;
+	state.Published = Snapshot->State[offsetof(SBC_SNAPSHOT_STATE, Published) / sizeof(SBC_U64)] + 1;
+	state.Size = Size;
+	state.Mode = (SBC_U32)Mode;
+	memcpy(state.Report, Report, Size);
+	memcpy(words, &state, sizeof(words));
+
+	// Odd: readers that copy from here on retry
+	Snapshot->Sequence = sequence + 1;
+	SbcFence();
+
+	for (i = 0; i < SBC_SNAPSHOT_WORDS; ++i) Snapshot->State[i] = words[i];
+
+	SbcFence();
+	Snapshot->Sequence = sequence + 2;
+}
+
+int SbcSnapshotTryRead
+(
+	const SBC_STATE_SNAPSHOT *Snapshot,
+	SBC_SNAPSHOT_STATE *State
+)
+/*++
+Routine Description:
+    Copies the published state if the writer doesn't update it during the
+    copy.
+
+Arguments:
+    Snapshot - Published state
+
+    State - Receives the state. Its contents are undefined on failure.
+
+Return Value:
+    1 if the copy is consistent, 0 if it has to be tried again
+--*/
+{
+	SBC_U64 words[SBC_SNAPSHOT_WORDS];
+	SBC_U32 before, after;
+	SBC_U32 i;
+
+	before = Snapshot->Sequence;
+	if (before & 1) return 0;
+	SbcFence();
+
+	for (i = 0; i < SBC_SNAPSHOT_WORDS; ++i) words[i] = Snapshot->State[i];
+
+	SbcFence();
+	after = Snapshot->Sequence;
+	if (after != before) return 0;
+
+	memcpy(State, words, sizeof(*State));
+	return 1;
+}
+
+SBC_U32 SbcSnapshotRead(const SBC_STATE_SNAPSHOT *Snapshot, SBC_SNAPSHOT_STATE *State)
+{
+	SBC_U32 retries = 0;
+
+	while (!SbcSnapshotTryRead(Snapshot, State)) ++retries;
+	return retries;
+}
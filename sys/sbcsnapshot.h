@@ -0,0 +1,85 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCSNAPSHOT_H_
+#define _SBCSNAPSHOT_H_
+
+//
+// Published state of the controller.
+//
+// The latest translated report, published with a sequence lock so any
+// number of readers can copy it at any time without a lock and without
+// slowing the writer down. The writer makes Sequence odd, stores the state
+// and makes it even again. A reader copies the state between two loads of
+// Sequence and keeps the copy only if both loads returned the same even
+// value, otherwise the writer was in the middle of an update and the reader
+// tries again.
+//
+// There is a single writer, the read completion routine in the driver and
+// the transfer completion in the Linux daemon, which serialize their
+// updates. A reader must not run on top of the writer on the same
+// processor (from an interrupt), it would spin forever.
+//
+// The snapshot has no pointers, so it can live in memory shared between
+// processes (see linux/sbcshm.h).
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SBC_SNAPSHOT_MAGIC          (0x53534253)    // "SBSS"
+#define SBC_SNAPSHOT_VERSION        (1)
+
+typedef struct _SBC_SNAPSHOT_STATE
+{
+	SBC_U64 Timestamp;          // Arrival of the packet, nanoseconds
+	SBC_U64 Published;          // Reports published so far, this one included
+	SBC_U32 Size;               // Size of the report, 0 if nothing was published yet
+	SBC_U32 Mode;               // SBC_REPORT_MODE of the report
+	SBC_U8  Report[24];         // Translated report, no report ID
+} SBC_SNAPSHOT_STATE, *PSBC_SNAPSHOT_STATE;
+
+typedef char SBC_ASSERT_SNAPSHOT_REPORT_SIZE[(SBC_MAX_INPUT_REPORT_SIZE <= 24) ? 1 : -1];
+typedef char SBC_ASSERT_SNAPSHOT_STATE_SIZE[(sizeof(SBC_SNAPSHOT_STATE) % 8 == 0) ? 1 : -1];
+
+#define SBC_SNAPSHOT_WORDS          (sizeof(SBC_SNAPSHOT_STATE) / sizeof(SBC_U64))
+
+//
+// The sequence and the state fit in a cache line, a reader only has to
+// fetch one line per copy
+//
+typedef struct _SBC_STATE_SNAPSHOT
+{
+	SBC_U32 Magic;              // SBC_SNAPSHOT_MAGIC
+	SBC_U16 Version;            // SBC_SNAPSHOT_VERSION
+	SBC_U16 StateSize;          // sizeof(SBC_SNAPSHOT_STATE)
+	volatile SBC_U32 Sequence;  // Odd while the state is being written
+	SBC_U32 Reserved;
+	volatile SBC_U64 State[SBC_SNAPSHOT_WORDS];
+} SBC_STATE_SNAPSHOT, *PSBC_STATE_SNAPSHOT;
+
+typedef char SBC_ASSERT_STATE_SNAPSHOT_SIZE[(sizeof(SBC_STATE_SNAPSHOT) == 64) ? 1 : -1];
+
+void SbcSnapshotInit(SBC_STATE_SNAPSHOT *Snapshot);
+int SbcSnapshotValid(const SBC_STATE_SNAPSHOT *Snapshot);
+
+// Writer side
+void SbcSnapshotPublish(SBC_STATE_SNAPSHOT *Snapshot, SBC_REPORT_MODE Mode, const void *Report, SBC_U32 Size, SBC_U64 Timestamp);
+
+// Reader side. A single attempt, 0 if the writer got in the way.
+int SbcSnapshotTryRead(const SBC_STATE_SNAPSHOT *Snapshot, SBC_SNAPSHOT_STATE *State);
+
+// Reader side. Returns the number of attempts that were retried.
+SBC_U32 SbcSnapshotRead(const SBC_STATE_SNAPSHOT *Snapshot, SBC_SNAPSHOT_STATE *State);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCSNAPSHOT_H_
@@ -0,0 +1,192 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <string.h>
+
+#include "sbcsplit.h"
+
+#define SBC_SPLIT_ID(Name, Id) Id,
+
+static const SBC_U8 SbcSplitIds[SbcSplitCount] = { SBC_LAYOUT_SPLIT_REPORTS(SBC_SPLIT_ID) };
+
+SBC_U8 SbcSplitReportId(SBC_SPLIT_PART Part)
+{
+	return SbcSplitIds[Part];
+}
+
+int SbcSplitPartOf(SBC_U8 ReportId)
+/*++
+Routine Description:
+    Finds the part sent with a report ID.
+
+Arguments:
+    ReportId - Report ID from the application
+
+Return Value:
+    The SBC_SPLIT_PART, -1 if the ID isn't one of the split reports
+--*/
+{
+	int part;
+
+	for (part = 0; part < SbcSplitCount; ++part)
+	{
+		if (SbcSplitIds[part] == ReportId) return part;
+	}
+	return -1;
+}
+
+SBC_U32 SbcSplitSlice
+(
+	SBC_REPORT_MODE Mode,
+	SBC_SPLIT_PART Part,
+	SBC_U32 *Offset
+)
+/*++
+Routine Description:
+    Locates a part in the full translated report.
+
+Arguments:
+    Mode - Report layout
+
+    Part - Part of the report
+
+    Offset - Receives the offset of the part in the full report
+
+Return Value:
+    Size of the part in bytes, without the report ID
+--*/
+{
+	SBC_U32 sticks = SBC_POINTER_AXIS_COUNT * (Mode == SbcReportMode16Bit ? 2 : 1);
+
+	switch (Part)
+	{
+	case SbcSplitButtons:
+		*Offset = 0;
+		return SBC_REPORT_BUTTON_BYTES;
+	case SbcSplitSticks:
+		*Offset = SBC_REPORT_BUTTON_BYTES;
+		return sticks;
+	default:
+		*Offset = SBC_REPORT_BUTTON_BYTES + sticks;
+		return SbcInputReportSize(Mode) - *Offset;
+	}
+}
+
+SBC_U32 SbcSplitChanges
+(
+	SBC_REPORT_MODE Mode,
+	const void *Previous,
+	const void *Report
+)
+/*++
+Routine Description:
+    Compares two full reports part by part.
+
+Arguments:
+    Mode - Report layout
+
+    Previous - Report the application has
+
+    Report - New report
+
+Return Value:
+    Mask with bit n set if part n differs
+--*/
+{
+	const SBC_U8 *previous = (const SBC_U8 *)Previous;
+	const SBC_U8 *report = (const SBC_U8 *)Report;
+	SBC_U32 changes = 0;
+	SBC_U32 part, offset, size;
+
+	for (part = 0; part < SbcSplitCount; ++part)
+	{
+		size = SbcSplitSlice(Mode, (SBC_SPLIT_PART)part, &offset);
+		if (memcmp(previous + offset, report + offset, size) != 0) changes |= 1u << part;
+	}
+	return changes;
+}
+
+SBC_U32 SbcSplitCacheStore
+(
+	SBC_REPORT_CACHE *Cache,
+	SBC_REPORT_MODE Mode,
+	const void *Report,
+	SBC_U32 Size,
+	int Resend
+)
+/*++
+Routine Description:
+    Records a freshly translated report and marks the parts that differ
+    from the ones delivered as pending.
+
+Arguments:
+    Cache - Latest-state slot
+
+    Mode - Report layout
+
+    Report - Translated report
+
+    Size - Size of the report, SbcInputReportSize(Mode)
+
+    Resend - Non zero to mark the buttons pending when nothing changed, so
+             a read waiting for this report gets one. Used when a read is
+             pending, which without the change-only filter happens for
+             every packet and with it for the keep-alive.
+
+Return Value:
+    Mask of the parts pending
+--*/
+{
+	if (Cache->Dirty) ++Cache->Dropped;
+
+	memcpy(Cache->Latest, Report, Size);
+	Cache->Size = Size;
+	Cache->DirtyParts = (SBC_U8)SbcSplitChanges(Mode, Cache->Delivered, Cache->Latest);
+	if (Cache->DirtyParts == 0 && Resend) Cache->DirtyParts = 1u << SbcSplitButtons;
+	Cache->Dirty = Cache->DirtyParts != 0;
+	return Cache->DirtyParts;
+}
+
+SBC_U32 SbcSplitCacheTake
+(
+	SBC_REPORT_CACHE *Cache,
+	SBC_REPORT_MODE Mode,
+	SBC_U8 *ReportId,
+	void *Report
+)
+/*++
+Routine Description:
+    Called when a read request can be completed. Returns the first pending
+    part of the latest report and marks it as delivered.
+
+Arguments:
+    Cache - Latest-state slot
+
+    Mode - Report layout
+
+    ReportId - Receives the report ID of the part
+
+    Report - Receives the part, at least SBC_MAX_INPUT_REPORT_SIZE bytes
+
+Return Value:
+    Size of the part without the report ID, zero if nothing is pending.
+--*/
+{
+	SBC_U32 part, offset, size;
+
+	if (Cache->DirtyParts == 0) return 0;
+
+	for (part = 0; (Cache->DirtyParts & (1u << part)) == 0; ++part) {}
+
+	size = SbcSplitSlice(Mode, (SBC_SPLIT_PART)part, &offset);
+	memcpy(Report, Cache->Latest + offset, size);
+	memcpy(Cache->Delivered + offset, Cache->Latest + offset, size);
+	*ReportId = SbcSplitIds[part];
+
+	Cache->DirtyParts &= (SBC_U8)~(1u << part);
+	Cache->Dirty = Cache->DirtyParts != 0;
+	return size;
+}
@@ -0,0 +1,65 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCSPLIT_H_
+#define _SBCSPLIT_H_
+
+//
+// Split input reports.
+//
+// With the SplitReports registry value the game pad collection declares
+// three input reports instead of SBC_REPORT_ID_INPUT: the five button
+// bytes, the pointer axes (the sticks) and the other axes with the tuner,
+// the gear and the virtual buttons. Each one is a contiguous slice of the full translated
+// report, so the translation doesn't change, and a packet only sends the
+// parts that differ from the ones delivered last. A button edge becomes a
+// 6 byte report with 39 usages for hidclass and the application to parse
+// instead of the whole report.
+//
+// The latest-state cache keeps the parts still to be delivered in
+// DirtyParts. A read takes one part, lowest first, so a packet that
+// changes several parts completes several reads.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Parts in report order: X(Name, report ID)
+//
+#define SBC_LAYOUT_SPLIT_REPORTS(X) \
+	X(Buttons,  SBC_REPORT_ID_BUTTONS) \
+	X(Sticks,   SBC_REPORT_ID_STICKS) \
+	X(Controls, SBC_REPORT_ID_CONTROLS)
+
+#define SBC_LAYOUT_SPLIT_ENUM(Name, Id) SbcSplit##Name,
+
+typedef enum _SBC_SPLIT_PART
+{
+	SBC_LAYOUT_SPLIT_REPORTS(SBC_LAYOUT_SPLIT_ENUM)
+	SbcSplitCount
+} SBC_SPLIT_PART;
+
+#define SBC_SPLIT_ALL               ((1u << SbcSplitCount) - 1)
+
+SBC_U8 SbcSplitReportId(SBC_SPLIT_PART Part);
+int SbcSplitPartOf(SBC_U8 ReportId);
+SBC_U32 SbcSplitSlice(SBC_REPORT_MODE Mode, SBC_SPLIT_PART Part, SBC_U32 *Offset);
+SBC_U32 SbcSplitChanges(SBC_REPORT_MODE Mode, const void *Previous, const void *Report);
+
+// Latest-state cache in split mode, instead of SbcReportCacheStore and
+// SbcReportCacheTake. The caller serializes the access.
+SBC_U32 SbcSplitCacheStore(SBC_REPORT_CACHE *Cache, SBC_REPORT_MODE Mode, const void *Report, SBC_U32 Size, int Resend);
+SBC_U32 SbcSplitCacheTake(SBC_REPORT_CACHE *Cache, SBC_REPORT_MODE Mode, SBC_U8 *ReportId, void *Report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCSPLIT_H_
@@ -0,0 +1,102 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sbcstats.h"
+
+#define SBC_STAT_INFO_ROW(Id, Name, Description)    { Name, Description },
+
+static const SBC_STAT_INFO SbcStats[SbcStatCount] =
+{
+	SBC_STATS_COUNTERS(SBC_STAT_INFO_ROW)
+};
+
+const SBC_STAT_INFO *SbcStatInfo(SBC_U32 Id)
+{
+	return Id < SbcStatCount ? &SbcStats[Id] : NULL;
+}
+
+void SbcStatsBuildFeatureReport
+(
+	const SBC_U64 *Counters,
+	SBC_U64 Started,
+	SBC_U64 Timestamp,
+	SBC_STATS_FEATURE_REPORT *Report
+)
+/*++
+Routine Description:
+    Fills the statistics feature report.
+
+Arguments:
+    Counters - SbcStatCount counter values
+
+    Started - When the device was added
+
+    Timestamp - When the counters were read
+
+    Report - Receives the feature report
+
+Return Value:
+    None
+--*/
+{
+	memset(Report, 0, sizeof(*Report));
+	Report->ReportId = SBC_REPORT_ID_STATS;
+	Report->Version = SBC_STATS_VERSION;
+	Report->Count = SbcStatCount;
+	Report->Started = Started;
+	Report->Timestamp = Timestamp;
+	memcpy(Report->Counters, Counters, SbcStatCount * sizeof(SBC_U64));
+}
+
+int SbcStatsValidReport(const SBC_STATS_FEATURE_REPORT *Report)
+{
+	return Report->ReportId == SBC_REPORT_ID_STATS && Report->Version == SBC_STATS_VERSION &&
+		Report->Count <= SBC_STATS_MAX_COUNTERS && Report->Timestamp >= Report->Started;
+}
+
+int SbcStatsDelta
+(
+	const SBC_STATS_FEATURE_REPORT *Before,
+	const SBC_STATS_FEATURE_REPORT *After,
+	SBC_U64 *Deltas,
+	SBC_U64 *Interval
+)
+/*++
+Routine Description:
+    Differences between two snapshots of the same device.
+
+Arguments:
+    Before - Older snapshot
+
+    After - Newer snapshot
+
+    Deltas - Receives SBC_STATS_MAX_COUNTERS increments
+
+    Interval - Receives the time between the snapshots, nanoseconds
+
+Return Value:
+    1 if the snapshots can be compared, 0 otherwise
+--*/
+{
+	SBC_U32 i;
+
+	memset(Deltas, 0, SBC_STATS_MAX_COUNTERS * sizeof(SBC_U64));
+	*Interval = 0;
+
+	// A device that was removed and added again starts from 0
+	if (Before->Started != After->Started || After->Timestamp < Before->Timestamp) return 0;
+
+	for (i = 0; i < Before->Count && i < After->Count; ++i)
+	{
+		if (After->Counters[i] < Before->Counters[i]) return 0;
+		Deltas[i] = After->Counters[i] - Before->Counters[i];
+	}
+	*Interval = After->Timestamp - Before->Timestamp;
+	return 1;
+}
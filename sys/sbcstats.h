@@ -0,0 +1,108 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCSTATS_H_
+#define _SBCSTATS_H_
+
+//
+// Device statistics.
+//
+// Free running 64 bit counters of what the driver did since the device was
+// added, read with the statistics feature report. The counters never reset
+// while the device is present, so the rate of anything over an interval is
+// the difference of two snapshots divided by the difference of their
+// timestamps (linux/sbcstats.c decodes and diffs them). Started tells
+// snapshots of different device instances apart.
+//
+
+#include "sbccore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Counters: X(ID, name, description). IDs are only ever appended so older
+// snapshots still decode.
+//
+#define SBC_STATS_COUNTERS(X) \
+	X(SbcStatPacketsReceived,   "packets_received",     "Transfers completed by the interrupt pipe") \
+	X(SbcStatZeroLengthReads,   "zero_length_reads",    "Transfers without data") \
+	X(SbcStatShortReads,        "short_reads",          "Transfers shorter than a packet") \
+	X(SbcStatReportsDropped,    "reports_dropped",      "Reports replaced in the cache before a read took them") \
+	X(SbcStatReadsCompleted,    "reads_completed",      "Read requests completed with a report") \
+	X(SbcStatBufferFailures,    "buffer_failures",      "Read requests failed retrieving their buffer") \
+	X(SbcStatD0Entries,         "d0_entries",           "Transitions into D0") \
+	X(SbcStatD0Exits,           "d0_exits",             "Transitions out of D0") \
+	X(SbcStatIdleNotifications, "idle_notifications",   "Idle notifications sent to the USB stack") \
+	X(SbcStatReportsSuppressed, "reports_suppressed",   "Reports held back by the change-only filter") \
+	X(SbcStatQueueOverflows,    "queue_overflows",      "Reports dropped by a full report queue") \
+	X(SbcStatInputReportsPolled, "input_reports_polled", "Get input report requests served from the cache") \
+	X(SbcStatButtonEvents,      "button_events",        "Button edges pushed to the event stream") \
+	X(SbcStatComboMatches,      "combo_matches",        "Virtual buttons pressed by the combo engine")
+
+#define SBC_STATS_COUNTER_ID(Id, Name, Description)     Id,
+
+typedef enum _SBC_STAT
+{
+	SBC_STATS_COUNTERS(SBC_STATS_COUNTER_ID)
+	SbcStatCount
+} SBC_STAT;
+
+//
+// Room in the feature report, counters added later fit without changing
+// its size
+//
+#define SBC_STATS_MAX_COUNTERS      (24)
+#define SBC_STATS_VERSION           (1)
+
+typedef char SBC_ASSERT_STATS_COUNT[(SbcStatCount <= SBC_STATS_MAX_COUNTERS) ? 1 : -1];
+
+//
+// Name and description of a counter, NULL for unknown IDs
+//
+typedef struct _SBC_STAT_INFO
+{
+	const char *Name;
+	const char *Description;
+} SBC_STAT_INFO;
+
+const SBC_STAT_INFO *SbcStatInfo(SBC_U32 Id);
+
+//
+// Statistics feature report, also the format of a snapshot file. All
+// values are little endian.
+//
+#pragma pack(push, 1)
+typedef struct _SBC_STATS_FEATURE_REPORT
+{
+	SBC_U8  ReportId;           // SBC_REPORT_ID_STATS
+	SBC_U8  Version;            // SBC_STATS_VERSION
+	SBC_U16 Count;              // Valid counters, SbcStatCount of the driver
+	SBC_U32 Reserved;           // 0
+	SBC_U64 Started;            // When the device was added, nanoseconds
+	SBC_U64 Timestamp;          // When the counters were read, same clock
+	SBC_U64 Counters[SBC_STATS_MAX_COUNTERS];
+} SBC_STATS_FEATURE_REPORT, *PSBC_STATS_FEATURE_REPORT;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_STATS_FEATURE_REPORT_SIZE[(sizeof(SBC_STATS_FEATURE_REPORT) == 216) ? 1 : -1];
+
+void SbcStatsBuildFeatureReport(const SBC_U64 *Counters, SBC_U64 Started, SBC_U64 Timestamp, SBC_STATS_FEATURE_REPORT *Report);
+int SbcStatsValidReport(const SBC_STATS_FEATURE_REPORT *Report);
+
+//
+// Counter increments from Before to After and the time between them in
+// nanoseconds. Counters missing from either snapshot are 0. Returns 0 if
+// the snapshots are from different device instances or out of order.
+//
+int SbcStatsDelta(const SBC_STATS_FEATURE_REPORT *Before, const SBC_STATS_FEATURE_REPORT *After, SBC_U64 *Deltas, SBC_U64 *Interval);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCSTATS_H_
@@ -0,0 +1,104 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sbctrace.h"
+
+#define SBC_TRACE_EVENT_INFO_ROW(Id, Name, Arg0, Arg1)  { Name, { Arg0, Arg1 } },
+
+static const SBC_TRACE_EVENT_INFO SbcTraceEvents[SbcTraceEventCount] =
+{
+	SBC_TRACE_EVENTS(SBC_TRACE_EVENT_INFO_ROW)
+};
+
+void SbcTraceRingInit(SBC_TRACE_RING *Ring)
+{
+	memset(Ring, 0, sizeof(*Ring));
+}
+
+SBC_U32 SbcTraceSnapshot(SBC_TRACE_RING *Ring, SBC_TRACE_EVENT *Events)
+/*++
+Routine Description:
+    Copies the events in the ring, oldest first, while writers may still be
+    recording. An event is only copied if its slot holds the same complete
+    event before and after the copy. Events being written, and the oldest
+    ones if writers lap the copy, are left out.
+
+Arguments:
+    Ring - Ring to copy
+
+    Events - Receives up to SBC_TRACE_RING_SIZE events
+
+Return Value:
+    Number of events copied
+--*/
+{
+	SBC_U32 head, index, sequence;
+	SBC_U32 count = 0;
+
+	head = Ring->Head;
+	SbcFence();
+
+	// The indexes before the first lap don't match any event
+	for (index = head - SBC_TRACE_RING_SIZE; index != head; ++index)
+	{
+		volatile SBC_TRACE_EVENT *event = &Ring->Events[index % SBC_TRACE_RING_SIZE];
+		SBC_TRACE_EVENT *copy = &Events[count];
+
+		sequence = event->Sequence;
+		if (sequence != index + 1 || sequence == 0) continue;
+		SbcFence();
+
+		copy->Timestamp = event->Timestamp;
+		copy->Id = event->Id;
+		copy->Processor = event->Processor;
+		copy->Args[0] = event->Args[0];
+		copy->Args[1] = event->Args[1];
+		copy->Sequence = sequence;
+
+		SbcFence();
+		if (event->Sequence == sequence) ++count;
+	}
+
+	return count;
+}
+
+const SBC_TRACE_EVENT_INFO *SbcTraceEventInfo(SBC_U32 Id)
+{
+	return Id < SbcTraceEventCount ? &SbcTraceEvents[Id] : NULL;
+}
+
+void SbcTraceInitHeader(SBC_TRACE_HEADER *Header, SBC_U32 Count, SBC_U32 Written, SBC_U32 Dropped, SBC_U64 DumpTime)
+{
+	memset(Header, 0, sizeof(*Header));
+	Header->Magic = SBC_TRACE_MAGIC;
+	Header->Version = SBC_TRACE_VERSION;
+	Header->EventSize = sizeof(SBC_TRACE_EVENT);
+	Header->Count = Count;
+	Header->Written = Written;
+	Header->Dropped = Dropped;
+	Header->DumpTime = DumpTime;
+	Header->Level = SBC_TRACE_LEVEL;
+}
+
+int SbcTraceValidHeader(const SBC_TRACE_HEADER *Header)
+{
+	return Header->Magic == SBC_TRACE_MAGIC &&
+		Header->Version == SBC_TRACE_VERSION &&
+		Header->EventSize == sizeof(SBC_TRACE_EVENT) &&
+		Header->Count <= SBC_TRACE_RING_SIZE;
+}
+
+void SbcTraceBuildFeatureReport(SBC_TRACE_RING *Ring, SBC_TRACE_FEATURE_REPORT *Report)
+{
+	Report->ReportId = SBC_REPORT_ID_TRACE;
+	Report->Level = SBC_TRACE_LEVEL;
+	Report->Capacity = SBC_TRACE_RING_SIZE;
+	Report->Written = Ring->Head;
+	Report->Dropped = Ring->Dropped;
+}
@@ -0,0 +1,252 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#ifndef _SBCTRACE_H_
+#define _SBCTRACE_H_
+
+//
+// Binary trace ring.
+//
+// Events are fixed size records with an ID from SBC_TRACE_EVENTS, a
+// timestamp, the processor and two 32 bit arguments. Nothing is formatted
+// when an event is recorded, the decoder (linux/sbctracedump.c) turns a
+// dump into text or a Chrome trace.
+//
+// The ring is a flight recorder that keeps the last SBC_TRACE_RING_SIZE
+// events, and writers never wait, so events can be recorded from any IRQL
+// on any processor without a lock. A writer claims an index with an
+// interlocked increment of Head and then takes the slot by swapping its
+// sequence for SBC_TRACE_BUSY. If the slot is still being filled by a
+// writer a whole lap behind, or already holds a newer event, the event is
+// dropped and counted instead. SbcTraceSnapshot copies the ring while it is
+// being written and skips the slots that are busy or were overwritten
+// during the copy.
+//
+// The SBC_TRACE_<level> macros compile to nothing, arguments included, when
+// the level is above SBC_TRACE_LEVEL.
+//
+
+#include "sbccore.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Same values as the TRACE_LEVEL_ constants of evntrace.h
+//
+#define SBC_TRACE_LEVEL_NONE        (0)
+#define SBC_TRACE_LEVEL_ERROR       (2)
+#define SBC_TRACE_LEVEL_WARNING     (3)
+#define SBC_TRACE_LEVEL_INFORMATION (4)
+#define SBC_TRACE_LEVEL_VERBOSE     (5)
+
+//
+// Events up to this level are recorded. Checked builds of the driver also
+// record the verbose ones, one or more per packet.
+//
+#if !defined(SBC_TRACE_LEVEL)
+#if defined(DBG) && DBG
+#define SBC_TRACE_LEVEL             SBC_TRACE_LEVEL_VERBOSE
+#else
+#define SBC_TRACE_LEVEL             SBC_TRACE_LEVEL_INFORMATION
+#endif
+#endif
+
+//
+// Events: X(ID, name, first argument, second argument). Arguments without
+// a name are not shown by the decoder. IDs are only ever appended so old
+// dumps still decode.
+//
+#define SBC_TRACE_EVENTS(X) \
+	X(SbcTracePacket,           "Packet",           "length",       NULL) \
+	X(SbcTracePacketDropped,    "PacketDropped",    "length",       NULL) \
+	X(SbcTraceReportSuppressed, "ReportSuppressed", NULL,           NULL) \
+	X(SbcTraceReportCached,     "ReportCached",     "size",         NULL) \
+	X(SbcTraceReportDelivered,  "ReportDelivered",  "size",         "latency_ns") \
+	X(SbcTraceIoctl,            "Ioctl",            "code",         NULL) \
+	X(SbcTraceReadFromCache,    "ReadFromCache",    "size",         "age_ns") \
+	X(SbcTraceReadQueued,       "ReadQueued",       "status",       NULL) \
+	X(SbcTraceSetFeature,       "SetFeature",       "report_id",    "length") \
+	X(SbcTraceD0Entry,          "D0Entry",          "previous_state", "status") \
+	X(SbcTraceD0Exit,           "D0Exit",           "target_state", NULL) \
+	X(SbcTraceReportQueued,     "ReportQueued",     "size",         "depth") \
+	X(SbcTraceQueueOverflow,    "QueueOverflow",    "overflows",    NULL) \
+	X(SbcTraceInputReportPolled, "InputReportPolled", "size",       "age_ns") \
+	X(SbcTraceButtonEvents,     "ButtonEvents",     "count",        "head") \
+	X(SbcTraceComboMatch,       "ComboMatch",       "pressed",      "virtual")
+
+#define SBC_TRACE_EVENT_ID(Id, Name, Arg0, Arg1)    Id,
+
+typedef enum _SBC_TRACE_ID
+{
+	SBC_TRACE_EVENTS(SBC_TRACE_EVENT_ID)
+	SbcTraceEventCount
+} SBC_TRACE_ID;
+
+typedef struct _SBC_TRACE_EVENT
+{
+	SBC_U64 Timestamp;          // Monotonic, nanoseconds
+	SBC_U32 Sequence;           // Index of the event plus 1, 0 if empty, SBC_TRACE_BUSY while written
+	SBC_U16 Id;                 // SBC_TRACE_ID
+	SBC_U16 Processor;
+	SBC_U32 Args[2];
+} SBC_TRACE_EVENT, *PSBC_TRACE_EVENT;
+
+typedef char SBC_ASSERT_TRACE_EVENT_SIZE[(sizeof(SBC_TRACE_EVENT) == 24) ? 1 : -1];
+
+#define SBC_TRACE_RING_SIZE     (1024)
+#define SBC_TRACE_BUSY          (0xffffffff)
+
+typedef struct _SBC_TRACE_RING
+{
+	SBC_TRACE_EVENT Events[SBC_TRACE_RING_SIZE];
+	volatile SBC_U32 Head;      // Next event to write, free running
+	volatile SBC_U32 Dropped;   // Events that found their slot taken
+} SBC_TRACE_RING, *PSBC_TRACE_RING;
+
+//
+// The interlocked operations are full barriers, the slot stores and loads
+// are ordered with SbcFence.
+//
+#if defined(_MSC_VER)
+#define SbcTraceIncrement(Value) ((SBC_U32)_InterlockedIncrement((volatile long *)(Value)) - 1)
+#define SbcTraceSwap(Value, Old, New) \
+	((SBC_U32)_InterlockedCompareExchange((volatile long *)(Value), (long)(New), (long)(Old)) == (Old))
+#else
+#define SbcTraceIncrement(Value) __atomic_fetch_add((Value), 1, __ATOMIC_SEQ_CST)
+#define SbcTraceSwap(Value, Old, New) \
+	__sync_bool_compare_and_swap((Value), (Old), (New))
+#endif
+
+static __inline void SbcTraceWrite
+(
+	SBC_TRACE_RING *Ring,
+	SBC_U64 Timestamp,
+	SBC_U32 Processor,
+	SBC_U32 Id,
+	SBC_U32 Arg0,
+	SBC_U32 Arg1
+)
+{
+	SBC_U32 index = SbcTraceIncrement(&Ring->Head);
+	volatile SBC_TRACE_EVENT *event = &Ring->Events[index % SBC_TRACE_RING_SIZE];
+	SBC_U32 previous = event->Sequence;
+
+	// Free or holding an older event
+	if (previous == SBC_TRACE_BUSY || (SBC_S32)(previous - (index + 1)) > 0 ||
+		!SbcTraceSwap(&event->Sequence, previous, SBC_TRACE_BUSY))
+	{
+		SbcTraceIncrement(&Ring->Dropped);
+		return;
+	}
+
+	event->Timestamp = Timestamp;
+	event->Id = (SBC_U16)Id;
+	event->Processor = (SBC_U16)Processor;
+	event->Args[0] = Arg0;
+	event->Args[1] = Arg1;
+	SbcFence();
+	event->Sequence = index + 1;
+}
+
+#define SBC_TRACE_WRITE(Ring, Timestamp, Processor, Id, Arg0, Arg1) \
+	SbcTraceWrite((Ring), (Timestamp), (SBC_U32)(Processor), (Id), (SBC_U32)(Arg0), (SBC_U32)(Arg1))
+#define SBC_TRACE_NOTHING(Ring, Timestamp, Processor, Id, Arg0, Arg1) \
+	((void)0)
+
+#if SBC_TRACE_LEVEL >= SBC_TRACE_LEVEL_ERROR
+#define SBC_TRACE_ERROR         SBC_TRACE_WRITE
+#else
+#define SBC_TRACE_ERROR         SBC_TRACE_NOTHING
+#endif
+
+#if SBC_TRACE_LEVEL >= SBC_TRACE_LEVEL_WARNING
+#define SBC_TRACE_WARNING       SBC_TRACE_WRITE
+#else
+#define SBC_TRACE_WARNING       SBC_TRACE_NOTHING
+#endif
+
+#if SBC_TRACE_LEVEL >= SBC_TRACE_LEVEL_INFORMATION
+#define SBC_TRACE_INFORMATION   SBC_TRACE_WRITE
+#else
+#define SBC_TRACE_INFORMATION   SBC_TRACE_NOTHING
+#endif
+
+#if SBC_TRACE_LEVEL >= SBC_TRACE_LEVEL_VERBOSE
+#define SBC_TRACE_VERBOSE       SBC_TRACE_WRITE
+#else
+#define SBC_TRACE_VERBOSE       SBC_TRACE_NOTHING
+#endif
+
+void SbcTraceRingInit(SBC_TRACE_RING *Ring);
+SBC_U32 SbcTraceSnapshot(SBC_TRACE_RING *Ring, SBC_TRACE_EVENT *Events);
+
+//
+// Name and argument names of an event, NULL for unknown IDs
+//
+typedef struct _SBC_TRACE_EVENT_INFO
+{
+	const char *Name;
+	const char *Args[2];
+} SBC_TRACE_EVENT_INFO;
+
+const SBC_TRACE_EVENT_INFO *SbcTraceEventInfo(SBC_U32 Id);
+
+//
+// Dump file: a SBC_TRACE_HEADER followed by Count events, oldest first.
+// All values are little endian.
+//
+#define SBC_TRACE_MAGIC         (0x54434253)    // "SBCT"
+#define SBC_TRACE_VERSION       (1)
+
+typedef struct _SBC_TRACE_HEADER
+{
+	SBC_U32 Magic;
+	SBC_U16 Version;
+	SBC_U16 EventSize;          // sizeof(SBC_TRACE_EVENT)
+	SBC_U32 Count;              // Events in the file
+	SBC_U32 Written;            // Events recorded when the dump was taken, free running
+	SBC_U64 DumpTime;           // Same clock as the event timestamps
+	SBC_U32 Dropped;            // Events that found their slot taken
+	SBC_U8  Level;              // SBC_TRACE_LEVEL the driver was built with
+	SBC_U8  Reserved[3];
+} SBC_TRACE_HEADER, *PSBC_TRACE_HEADER;
+
+typedef char SBC_ASSERT_TRACE_HEADER_SIZE[(sizeof(SBC_TRACE_HEADER) == 32) ? 1 : -1];
+
+void SbcTraceInitHeader(SBC_TRACE_HEADER *Header, SBC_U32 Count, SBC_U32 Written, SBC_U32 Dropped, SBC_U64 DumpTime);
+int SbcTraceValidHeader(const SBC_TRACE_HEADER *Header);
+
+//
+// Feature report of the trace. Reading it returns the state of the ring,
+// writing it dumps the ring to the file named by the TraceFile registry
+// value.
+//
+#pragma pack(push, 1)
+typedef struct _SBC_TRACE_FEATURE_REPORT
+{
+	SBC_U8  ReportId;           // SBC_REPORT_ID_TRACE
+	SBC_U8  Level;              // SBC_TRACE_LEVEL the driver was built with
+	SBC_U16 Capacity;           // SBC_TRACE_RING_SIZE
+	SBC_U32 Written;            // Events recorded, free running
+	SBC_U32 Dropped;            // Events that found their slot taken
+} SBC_TRACE_FEATURE_REPORT, *PSBC_TRACE_FEATURE_REPORT;
+#pragma pack(pop)
+
+typedef char SBC_ASSERT_TRACE_FEATURE_REPORT_SIZE[(sizeof(SBC_TRACE_FEATURE_REPORT) == 12) ? 1 : -1];
+
+void SbcTraceBuildFeatureReport(SBC_TRACE_RING *Ring, SBC_TRACE_FEATURE_REPORT *Report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SBCTRACE_H_
@@ -0,0 +1,124 @@
+/*
+
+Copyright (c) Oscar Sebio Cajaraville 2019.
+
+*/
+
+#include "hidusbsteelbattalion.h"
+
+#if defined(EVENT_TRACING)
+#include "tracering.tmh"
+#endif
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, HidSteelBattalionTraceCreate)
+#pragma alloc_text(PAGE, HidSteelBattalionTraceDump)
+#endif
+
+NTSTATUS HidSteelBattalionTraceCreate(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Allocates the trace ring of the device. Called from DeviceAdd before
+    anything that records events.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    NT status value
+--*/
+{
+    NTSTATUS                status;
+    PDEVICE_EXTENSION       devContext = GetDeviceContext(Device);
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDFMEMORY               memory;
+
+    PAGED_CODE();
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    status = WdfMemoryCreate(&attributes, NonPagedPoolNx, POOL_TAG, sizeof(SBC_TRACE_RING), &memory, (PVOID *)&devContext->Trace);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "WdfMemoryCreate for the trace ring failed 0x%x\n", status);
+        devContext->Trace = NULL;
+        return status;
+    }
+    SbcTraceRingInit(devContext->Trace);
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS HidSteelBattalionTraceDump(IN WDFDEVICE Device)
+/*++
+Routine Description:
+    Writes a snapshot of the trace ring to the file named by the TraceFile
+    registry value, replacing the previous dump. Events keep being recorded
+    while the snapshot is taken. Called when the trace feature report is
+    set.
+
+Arguments:
+    Device - Handle to a framework device object.
+
+Return Value:
+    NT status value
+--*/
+{
+    NTSTATUS            status;
+    PDEVICE_EXTENSION   devContext = GetDeviceContext(Device);
+    WDFMEMORY           memory;
+    PSBC_TRACE_EVENT    events;
+    SBC_TRACE_HEADER    header;
+    UNICODE_STRING      path;
+    OBJECT_ATTRIBUTES   objectAttributes;
+    IO_STATUS_BLOCK     ioStatus;
+    HANDLE              file;
+    ULONG               written;
+    ULONG               count;
+
+    PAGED_CODE();
+
+    if (devContext->TracePath == NULL) return STATUS_INVALID_DEVICE_STATE;
+
+    WdfStringGetUnicodeString(devContext->TracePath, &path);
+    if (path.Length == 0) return STATUS_INVALID_DEVICE_STATE;
+
+    status = WdfMemoryCreate(WDF_NO_OBJECT_ATTRIBUTES, PagedPool, POOL_TAG, sizeof(SBC_TRACE_EVENT) * SBC_TRACE_RING_SIZE, &memory, (PVOID *)&events);
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfMemoryCreate for the trace dump failed 0x%x\n", status);
+        return status;
+    }
+
+    written = devContext->Trace->Head;
+    count = SbcTraceSnapshot(devContext->Trace, events);
+    SbcTraceInitHeader(&header, count, written, devContext->Trace->Dropped, HidSteelBattalionTimestamp());
+
+    InitializeObjectAttributes(&objectAttributes, &path, OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+
+    status = ZwCreateFile(&file, GENERIC_WRITE | SYNCHRONIZE, &objectAttributes, &ioStatus, NULL,
+        FILE_ATTRIBUTE_NORMAL, FILE_SHARE_READ, FILE_OVERWRITE_IF, FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE, NULL, 0);
+    if (NT_SUCCESS(status))
+    {
+        status = ZwWriteFile(file, NULL, NULL, NULL, &ioStatus, &header, sizeof(header), NULL, NULL);
+        if (NT_SUCCESS(status) && count != 0)
+        {
+            status = ZwWriteFile(file, NULL, NULL, NULL, &ioStatus, events, count * sizeof(SBC_TRACE_EVENT), NULL, NULL);
+        }
+        ZwClose(file);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DBG_IOCTL, "Trace dumped to %wZ, %u events\n", &path, count);
+    }
+    else
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "Trace dump to %wZ failed 0x%x\n", &path, status);
+    }
+
+    WdfObjectDelete(memory);
+    return status;
+}
@@ -12,6 +12,7 @@ Copyright (c) Oscar Sebio Caajaraville 2019.
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE, HidSteelBattalionEvtDevicePrepareHardware)
+#pragma alloc_text(PAGE, HidSteelBattalionEvtDeviceReleaseHardware)
 #pragma alloc_text(PAGE, HidSteelBattalionEvtDeviceD0Exit)
 #pragma alloc_text(PAGE, HidSteelBattalionConfigContReaderForInterruptEndPoint)
 #pragma alloc_text(PAGE, HidSteelBattalionValidateConfigurationDescriptor)
@@ -47,6 +48,9 @@ Return Value:
     WDF_USB_DEVICE_SELECT_CONFIG_PARAMS configParams;
     WDF_OBJECT_ATTRIBUTES               attributes;
     PUSB_DEVICE_DESCRIPTOR              usbDeviceDescriptor = NULL;
+    WDF_USB_PIPE_INFORMATION            pipeInfo;
+    WDFUSBPIPE                          pipe;
+    BYTE                                i;
 
     UNREFERENCED_PARAMETER(ResourceList);
     UNREFERENCED_PARAMETER(ResourceListTranslated);
@@ -127,6 +131,30 @@ Return Value:
     // Tell the framework that it's okay to read less than MaximumPacketSize
     WdfUsbTargetPipeSetNoMaximumPacketSizeCheck(devContext->InterruptPipe);
 
+    // The LEDs are driven through the interrupt OUT endpoint. Without it the
+    // device still works, the LED output report just isn't supported.
+    devContext->LedPipe = NULL;
+    for (i = 0; i < WdfUsbInterfaceGetNumConfiguredPipes(devContext->UsbInterface); ++i)
+    {
+        WDF_USB_PIPE_INFORMATION_INIT(&pipeInfo);
+        pipe = WdfUsbInterfaceGetConfiguredPipe(devContext->UsbInterface, i, &pipeInfo);
+        if (pipeInfo.PipeType == WdfUsbPipeTypeInterrupt && WdfUsbTargetPipeIsOutEndpoint(pipe))
+        {
+            devContext->LedPipe = pipe;
+            break;
+        }
+    }
+    if (devContext->LedPipe == NULL)
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "No interrupt OUT pipe, LEDs disabled\n");
+    }
+
+    // A capture that can't be opened doesn't stop the device from working
+    if (!NT_SUCCESS(HidSteelBattalionCaptureOpen(Device)))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "Interrupt pipe capture disabled\n");
+    }
+
     //configure continuous reader
     status = HidSteelBattalionConfigContReaderForInterruptEndPoint(devContext);
 
@@ -136,6 +164,36 @@ Return Value:
 }
 
 
+NTSTATUS HidSteelBattalionEvtDeviceReleaseHardware
+(
+    IN WDFDEVICE    Device,
+    IN WDFCMRESLIST ResourceListTranslated
+)
+/*++
+Routine Description:
+    Undoes what PrepareHardware did that is not cleaned up by the framework.
+    The continuous reader is already stopped at this point.
+
+Arguments:
+    Device - handle to a device
+
+    ResourceListTranslated - A handle to a framework resource-list object
+    that identifies the translated hardware resources
+
+Return Value:
+    NT status value
+--*/
+{
+    UNREFERENCED_PARAMETER(ResourceListTranslated);
+
+    PAGED_CODE();
+
+    HidSteelBattalionCaptureClose(Device);
+
+    return STATUS_SUCCESS;
+}
+
+
 NTSTATUS HidSteelBattalionConfigContReaderForInterruptEndPoint
 (
     PDEVICE_EXTENSION DeviceContext
@@ -159,13 +217,19 @@ Return Value:
 
     TraceEvents(TRACE_LEVEL_VERBOSE, DBG_INIT, "HidSteelBattalionConfigContReaderForInterruptEndPoint Enter\n");
 
-    WDF_USB_CONTINUOUS_READER_CONFIG_INIT(&contReaderConfig, HidSteelBattalionEvtUsbInterruptPipeReadComplete, DeviceContext, 32);
+    WDF_USB_CONTINUOUS_READER_CONFIG_INIT(&contReaderConfig, HidSteelBattalionEvtUsbInterruptPipeReadComplete, DeviceContext, DeviceContext->ReaderTransferSize);
     
     // Reader requests are not posted to the target automatically.
     // Driver must explictly call WdfIoTargetStart to kick start the
     // reader.  In this sample, it's done in D0Entry.
     // By defaut, framework queues two requests to the target
     // endpoint. Driver can configure up to 10 requests with CONFIG macro.
+    // More requests cover longer gaps between a read completing and the
+    // framework sending it again, at the cost of buffers (see ReaderDepth).
+    if (DeviceContext->ReaderDepth != 0)
+    {
+        contReaderConfig.NumPendingReads = DeviceContext->ReaderDepth;
+    }
     status = WdfUsbTargetPipeConfigContinuousReader(DeviceContext->InterruptPipe, &contReaderConfig);
 
     if (!NT_SUCCESS(status)) 
@@ -180,6 +244,73 @@ Return Value:
 }
 
 
+static VOID HidSteelBattalionDeliverSplitReports
+(
+    IN PDEVICE_EXTENSION DeviceContext,
+    IN PVOID Report,
+    IN ULONG ReportSize,
+    IN ULONGLONG Arrival
+)
+/*++
+Routine Description:
+    Delivers a report as split reports (see sbcsplit.h): each part that
+    changed completes one of the pending reads, parts left without a read
+    wait in the latest-state cache for the next ones. Called by the
+    completion routine with StateLock held, releases it.
+
+Arguments:
+    DeviceContext - Pointer to device context structure
+    Report - Translated report
+    ReportSize - Size of the report
+    Arrival - Arrival of the packet
+
+Return Value:
+    VOID
+--*/
+{
+    WDFREQUEST  requests[SbcSplitCount];
+    UCHAR       ids[SbcSplitCount];
+    UCHAR       parts[SbcSplitCount][SBC_MAX_INPUT_REPORT_SIZE];
+    ULONG       sizes[SbcSplitCount];
+    ULONG       count = 0;
+    ULONG       pending;
+    ULONG       i;
+    ULONGLONG   now;
+    NTSTATUS    status;
+
+    // A pending read gets a report even if nothing changed, like without
+    // split reports
+    status = WdfIoQueueRetrieveNextRequest(DeviceContext->InterruptMsgQueue, &requests[0]);
+    SbcSplitCacheStore(&DeviceContext->ReportCache, DeviceContext->ReportMode, Report, ReportSize, NT_SUCCESS(status));
+    DeviceContext->ReportCacheTime = Arrival;
+
+    now = HidSteelBattalionTimestamp();
+    while (NT_SUCCESS(status))
+    {
+        sizes[count] = SbcSplitCacheTake(&DeviceContext->ReportCache, DeviceContext->ReportMode, &ids[count], parts[count]);
+        SbcLatencyRecord(&DeviceContext->DeliveryLatency, now - Arrival);
+        SbcLatencyRecord(&DeviceContext->ReadWaitLatency, now - GetRequestContext(requests[count])->QueuedTime);
+        HidSteelBattalionTrace(VERBOSE, DeviceContext, SbcTraceReportDelivered, sizes[count], now - Arrival);
+        ++count;
+
+        if (DeviceContext->ReportCache.DirtyParts == 0) break;
+        status = WdfIoQueueRetrieveNextRequest(DeviceContext->InterruptMsgQueue, &requests[count]);
+    }
+    pending = DeviceContext->ReportCache.DirtyParts;
+    WdfSpinLockRelease(DeviceContext->StateLock);
+
+    if (pending != 0)
+    {
+        HidSteelBattalionTrace(VERBOSE, DeviceContext, SbcTraceReportCached, ReportSize, 0);
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        HidSteelBattalionCompleteReadReport(DeviceContext, requests[i], ids[i], parts[i], sizes[i]);
+    }
+}
+
+
 VOID HidSteelBattalionEvtUsbInterruptPipeReadComplete
 (
     WDFUSBPIPE  Pipe,
@@ -211,74 +342,146 @@ Return Value:
 {
     PDEVICE_EXTENSION  devContext = Context;
     PUCHAR             inputData = NULL;
+    ULONGLONG          arrival = HidSteelBattalionTimestamp();
 
-    UNREFERENCED_PARAMETER(NumBytesTransferred);
     UNREFERENCED_PARAMETER(Pipe);
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DBG_INIT, "HidSteelBattalionEvtUsbInterruptPipeReadComplete Enter\n");
+    HidSteelBattalionTrace(VERBOSE, devContext, SbcTracePacket, NumBytesTransferred, 0);
+
+    HidSteelBattalionCount(devContext, SbcStatPacketsReceived);
+
+    // Every transfer goes to the capture, including the ones dropped below
+    if (devContext->CaptureFile != NULL)
+    {
+        HidSteelBattalionCaptureRecord(devContext, NumBytesTransferred != 0 ? WdfMemoryGetBuffer(Buffer, NULL) : NULL, NumBytesTransferred, arrival);
+    }
 
     if (NumBytesTransferred == 0) 
 	{
-        TraceEvents(TRACE_LEVEL_WARNING, DBG_INIT, "HidSteelBattalionEvtUsbInterruptPipeReadComplete Zero length read occured on the Interrupt Pipe's Continuous Reader\n");
+        HidSteelBattalionCount(devContext, SbcStatZeroLengthReads);
+        HidSteelBattalionTrace(WARNING, devContext, SbcTracePacketDropped, 0, 0);
         return;
     }
 
-	if (NumBytesTransferred < 26)
+	if (NumBytesTransferred < SBC_INPUT_PACKET_SIZE)
 	{
-		TraceEvents(TRACE_LEVEL_WARNING, DBG_INIT, "HidSteelBattalionEvtUsbInterruptPipeReadComplete length is smaller than expected on the Interrupt Pipe's Continuous Reader\n");
+		HidSteelBattalionCount(devContext, SbcStatShortReads);
+		HidSteelBattalionTrace(WARNING, devContext, SbcTracePacketDropped, NumBytesTransferred, 0);
 		return;
 	}
 
 	inputData = WdfMemoryGetBuffer(Buffer, NULL);
-	//TraceEvents(TRACE_LEVEL_VERBOSE, DBG_INIT, "%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
-	//	inputData[0], inputData[1], inputData[2], inputData[3], inputData[4], inputData[5], inputData[6], inputData[7], inputData[8], inputData[9], inputData[10], inputData[11], inputData[12], inputData[13], inputData[14], inputData[15], inputData[16], inputData[17], inputData[18], inputData[19], inputData[20], inputData[21], inputData[22], inputData[23], inputData[24], inputData[25], inputData[26], inputData[27], inputData[28], inputData[29], inputData[30], inputData[31]);
-
-	PSBC_INPUT_DATA sbcData = (PSBC_INPUT_DATA)inputData;
-
-	HIDFX2_INPUT_REPORT r;
-	r.Buttons0 = sbcData->Buttons0;
-	r.Buttons1 = sbcData->Buttons1;
-	r.Buttons2 = sbcData->Buttons2;
-	r.Buttons3 = sbcData->Buttons3;
-	r.Buttons4 = sbcData->Buttons4;
-	r.AimX = (BYTE)(((int)sbcData->AimX) / 256);
-	r.AimY = (BYTE)(((int)sbcData->AimY) / 256);
-	r.Rotation = (BYTE)(((int)sbcData->Rotation) / 256 + 128);
-	r.SightX = (BYTE)(((int)sbcData->SightX) / 256 + 128);
-	r.SightY = (BYTE)(((int)sbcData->SightY) / 256 + 128);
-	r.Clutch = (BYTE)(((int)sbcData->Clutch) / 256);
-	r.Brake = (BYTE)(((int)sbcData->Brake) / 256);
-	r.Throttle = (BYTE)(((int)sbcData->Throttle) / 256);
-	r.Tuner = sbcData->Tuner;
-	r.Gear = sbcData->Gear < 0 ? sbcData->Gear + 1 : sbcData->Gear;
+
+	UCHAR packet[SBC_INPUT_PACKET_SIZE];
+	UCHAR r[SBC_MAX_INPUT_REPORT_SIZE];
+	ULONG reportSize;
+	ULONG events;
+	ULONG matches;
 
 	NTSTATUS status;
 	WDFREQUEST request;
 
-	status = WdfIoQueueRetrieveNextRequest(devContext->InterruptMsgQueue, &request);
-	if (!NT_SUCCESS(status))
+	WdfSpinLockAcquire(devContext->StateLock);
+
+	// The smoothing filters keep their state from packet to packet
+	if (devContext->Smoothing.EnabledMask != 0)
+	{
+		RtlCopyMemory(packet, inputData, SBC_INPUT_PACKET_SIZE);
+		SbcSmoothPacket(&devContext->Smoothing, packet, arrival);
+		inputData = packet;
+	}
+
+	// Under the lock so new calibration or remap tables aren't swapped in
+	// halfway
+	reportSize = SbcBuildCalibratedReport(&devContext->Calibration->Tables[devContext->Calibration->Active], inputData, r);
+	SbcResponseApplyReport(&devContext->Response, devContext->ReportMode, r);
+
+	// Combos are on the buttons of the panel, before the remapping
+	matches = SbcComboUpdate(&devContext->Combos, &devContext->ComboState, devContext->ReportMode, r, arrival);
+	if (matches != 0)
+	{
+		InterlockedAdd64(&devContext->Counters[SbcStatComboMatches], matches);
+		HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceComboMatch, matches, devContext->ComboState.Output);
+	}
+
+	SbcRemapButtons(&devContext->Remap->Tables[devContext->Remap->Active], r);
+
+	// Polls see every state, whether a read gets it or not
+	SbcSnapshotPublish(&devContext->State, devContext->ReportMode, r, reportSize, arrival);
+
+	// So do the readers of the button events, change-only mode or not.
+	// The ones waiting are completed once StateLock is released.
+	events = SbcEventRingUpdate(&devContext->Events, r, arrival);
+	if (events != 0)
+	{
+		InterlockedAdd64(&devContext->Counters[SbcStatButtonEvents], events);
+		HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceButtonEvents, events, devContext->Events.Head);
+	}
+
+	// In change-only mode a report that doesn't differ from the last one
+	// doesn't wake up anybody.
+	if (devContext->ChangeOnly && !SbcChangeFilterCheck(&devContext->ChangeFilter, r, arrival))
+	{
+		WdfSpinLockRelease(devContext->StateLock);
+		if (events != 0) HidSteelBattalionEventsNotify(devContext);
+		HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceReportSuppressed, 0, 0);
+		return;
+	}
+
+	// In buffered mode every report is queued for the reads to take in
+	// order. The cache still follows the latest state but never hands it
+	// out.
+	if (devContext->ReportQueue != NULL)
 	{
-		TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfIoQueueRetrieveNextRequest status %08x\n", status);
+		SBC_U32 depth;
+		int queued = SbcReportQueuePush(devContext->ReportQueue, r, reportSize, arrival);
+		depth = SbcReportQueueCount(devContext->ReportQueue);
+		SbcReportCacheStore(&devContext->ReportCache, r, reportSize, TRUE);
+		devContext->ReportCacheTime = arrival;
+		WdfSpinLockRelease(devContext->StateLock);
+		if (events != 0) HidSteelBattalionEventsNotify(devContext);
+
+		if (queued)
+		{
+			HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceReportQueued, reportSize, depth);
+		}
+		else
+		{
+			HidSteelBattalionTrace(WARNING, devContext, SbcTraceQueueOverflow, devContext->ReportQueue->Overflows, 0);
+		}
+		HidSteelBattalionReportQueueDrain(devContext);
 		return;
 	}
 
-	PVOID outputBuffer;
-	size_t bytesReturned;
-	size_t reportSize = sizeof(r);
-	status = WdfRequestRetrieveOutputBuffer(request, reportSize, &outputBuffer, &bytesReturned);
+	if (devContext->SplitReports)
+	{
+		HidSteelBattalionDeliverSplitReports(devContext, r, reportSize, arrival);
+		if (events != 0) HidSteelBattalionEventsNotify(devContext);
+		return;
+	}
+
+	// If there is no read pending keep the report so the next read gets it
+	// straight away instead of waiting for another packet.
+	status = WdfIoQueueRetrieveNextRequest(devContext->InterruptMsgQueue, &request);
+	SbcReportCacheStore(&devContext->ReportCache, r, reportSize, NT_SUCCESS(status));
+	devContext->ReportCacheTime = arrival;
 	if (NT_SUCCESS(status))
 	{
-		//memcpy(outputBuffer, &(devContext->CurrentInputReport), sizeof(HIDFX2_INPUT_REPORT));
-		memcpy(outputBuffer, &r, reportSize);
-		WdfRequestCompleteWithInformation(request, STATUS_SUCCESS, reportSize);
+		ULONGLONG now = HidSteelBattalionTimestamp();
+		SbcLatencyRecord(&devContext->DeliveryLatency, now - arrival);
+		SbcLatencyRecord(&devContext->ReadWaitLatency, now - GetRequestContext(request)->QueuedTime);
+		HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceReportDelivered, reportSize, now - arrival);
 	}
-	else
+	WdfSpinLockRelease(devContext->StateLock);
+	if (events != 0) HidSteelBattalionEventsNotify(devContext);
+
+	if (!NT_SUCCESS(status))
 	{
-		TraceEvents(TRACE_LEVEL_ERROR, DBG_IOCTL, "WdfRequestRetrieveOutputBuffer status %08x\n", status);
-		WdfRequestCompleteWithInformation(request, status, 0);
+		HidSteelBattalionTrace(VERBOSE, devContext, SbcTraceReportCached, reportSize, 0);
+		return;
 	}
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DBG_INIT, "HidSteelBattalionEvtUsbInterruptPipeReadComplete Exit\n");
+	HidSteelBattalionCompleteReadReport(devContext, request, SBC_REPORT_ID_INPUT, r, reportSize);
 }
 
 NTSTATUS HidSteelBattalionEvtDeviceD0Entry
@@ -317,6 +520,7 @@ Return Value:
 {
     PDEVICE_EXTENSION   devContext = NULL;
     NTSTATUS            status = STATUS_SUCCESS;
+    NTSTATUS            ledStatus;
 
     devContext = GetDeviceContext(Device);
 
@@ -324,7 +528,28 @@ Return Value:
 
 	status = WdfIoTargetStart(WdfUsbTargetPipeGetIoTarget(devContext->InterruptPipe));
 
+    // The device comes up with its LEDs off, send it the current state.
+    // Like a device without the OUT endpoint, it works without its LEDs.
+    if (NT_SUCCESS(status) && devContext->LedPipe != NULL)
+    {
+        ledStatus = WdfIoTargetStart(WdfUsbTargetPipeGetIoTarget(devContext->LedPipe));
+        if (NT_SUCCESS(ledStatus))
+        {
+            WdfSpinLockAcquire(devContext->LedLock);
+            SbcLedShadowReset(&devContext->LedShadow);
+            WdfSpinLockRelease(devContext->LedLock);
+            HidSteelBattalionLedKick(devContext);
+        }
+        else
+        {
+            TraceEvents(TRACE_LEVEL_WARNING, DBG_PNP, "WdfIoTargetStart for the LED pipe failed 0x%x, LEDs disabled\n", ledStatus);
+            devContext->LedPipe = NULL;
+        }
+    }
+
     TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "HidSteelBattalionEvtDeviceD0Entry Exit, status: 0x%x\n", status);
+    HidSteelBattalionCount(devContext, SbcStatD0Entries);
+    HidSteelBattalionTrace(INFORMATION, devContext, SbcTraceD0Entry, PreviousState, status);
 
     return status;
 }
@@ -375,8 +600,31 @@ Return Value:
     TraceEvents(TRACE_LEVEL_VERBOSE, DBG_PNP, "HidSteelBattalionEvtDeviceD0Exit Enter- moving to %s\n", DbgDevicePowerString(TargetState));
 
     devContext = GetDeviceContext(Device);
+    HidSteelBattalionCount(devContext, SbcStatD0Exits);
+    HidSteelBattalionTrace(INFORMATION, devContext, SbcTraceD0Exit, TargetState, 0);
     WdfIoTargetStop(WdfUsbTargetPipeGetIoTarget(devContext->InterruptPipe), WdfIoTargetCancelSentIo);
 
+    if (devContext->LedPipe != NULL)
+    {
+        WdfTimerStop(devContext->LedTimer, TRUE);
+        WdfIoTargetStop(WdfUsbTargetPipeGetIoTarget(devContext->LedPipe), WdfIoTargetCancelSentIo);
+
+        TraceEvents(TRACE_LEVEL_INFORMATION, DBG_PNP, "LEDs: %I64u writes, %I64u unchanged, %I64u coalesced, %I64u frames, %I64u failed\n",
+            devContext->LedShadow.Writes, devContext->LedShadow.Unchanged, devContext->LedShadow.Coalesced,
+            devContext->LedShadow.Frames, devContext->LedShadow.Failed);
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DBG_PNP, "Reader: %I64d transfers, %I64d zero length, %I64d short, %I64u reports dropped\n",
+        devContext->Counters[SbcStatPacketsReceived], devContext->Counters[SbcStatZeroLengthReads],
+        devContext->Counters[SbcStatShortReads], devContext->ReportCache.Dropped);
+
+    if (devContext->ReportQueue != NULL)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DBG_PNP, "Report queue: %I64u queued, %I64u overflows, %u pending, at most %u of %u\n",
+            devContext->ReportQueue->Queued, devContext->ReportQueue->Overflows, SbcReportQueueCount(devContext->ReportQueue),
+            devContext->ReportQueue->HighWater, devContext->ReportQueue->Mask + 1);
+    }
+
     TraceEvents(TRACE_LEVEL_ERROR, DBG_PNP, "HidSteelBattalionEvtDeviceD0Exit Exit\n");
 
     return STATUS_SUCCESS;